@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbableSurfaceComponent.h"
+#include "ClimbingSystem.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "GameFramework/Actor.h"
+
+const FName UClimbableSurfaceComponent::ClimbableProxyProfileName(TEXT("ClimbableProxy"));
+const FName UClimbableSurfaceComponent::ClimbableWallProfileName(TEXT("ClimbableWall"));
+
+UClimbableSurfaceComponent::UClimbableSurfaceComponent() {
+	// 只给攀爬检测用，不挡人也不挡其他检测，不产生重叠事件
+	SetCollisionProfileName(ClimbableProxyProfileName);
+	SetGenerateOverlapEvents(false);
+	CanCharacterStepUpOn = ECB_No;
+
+	// 绝大多数代理贴在不动的墙上，Static的才会被表面缓存收进去
+	Mobility = EComponentMobility::Static;
+
+	ClimbSpeedScale = 1.f;
+	GripType = EClimbGripType::Rock;
+	FitPadding = 0.f;
+}
+
+void UClimbableSurfaceComponent::FitToOwnerMeshes() {
+	const AActor* Owner = GetOwner();
+	if (!Owner) {
+		return;
+	}
+
+	// 在父组件的空间里合并所有网格的包围盒，代理自己不旋转
+	const FTransform ParentTransform = GetAttachParent() ? GetAttachParent()->GetComponentTransform() : FTransform::Identity;
+	FBox Bounds(ForceInit);
+	Owner->ForEachComponent<UStaticMeshComponent>(false, [&Bounds, &ParentTransform](const UStaticMeshComponent* MeshComponent) {
+		if (const UStaticMesh* Mesh = MeshComponent->GetStaticMesh()) {
+			Bounds += Mesh->GetBoundingBox().TransformBy(MeshComponent->GetComponentTransform().GetRelativeTransform(ParentTransform));
+		}
+	});
+	if (!Bounds.IsValid) {
+		UE_LOG(LogClimbing, Warning, TEXT("%s: no static mesh on %s to fit the climbable proxy to"), *GetName(), *Owner->GetName());
+		return;
+	}
+
+	Modify();
+	SetRelativeTransform(FTransform(Bounds.GetCenter()));
+	SetBoxExtent((Bounds.GetExtent() + FVector(FitPadding)).ComponentMax(FVector(1.f)));
+}
+
+float UClimbableSurfaceComponent::GetClimbSpeedScale(const UPrimitiveComponent* Component) {
+	const UClimbableSurfaceComponent* Surface = FromComponent(Component);
+	return Surface ? Surface->ClimbSpeedScale : 1.f;
+}
+
+EClimbGripType UClimbableSurfaceComponent::GetGripType(const UPrimitiveComponent* Component) {
+	const UClimbableSurfaceComponent* Surface = FromComponent(Component);
+	return Surface ? Surface->GripType : EClimbGripType::Rock;
+}
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/BoxComponent.h"
+#include "ClimbableSurfaceComponent.generated.h"
+
+/** 墙面的抓握方式，AnimBP用它选手型，攀爬本身不区分 */
+UENUM(BlueprintType)
+enum class EClimbGripType : uint8 {
+	Rock,		// 粗糙的岩壁、砖墙
+	Ledge,		// 窄的突起或者墙沿
+	Ladder,		// 梯子、网格
+	Pipe,		// 竖着的管子、柱子
+};
+
+/**
+ * 可攀爬墙面的简化碰撞代理，只响应Climbable通道，攀爬的所有检测只会打到它
+ * 视觉上的网格(植被、装饰、复杂碰撞)不再参与攀爬检测，窄相只需要算一个Box，也不会再把不该爬的东西当成墙
+ * 简单碰撞是一个Box，可以被UClimbableSurfaceSubsystem缓存和被Ledge烘焙，默认是Static，挂在会动的物体上时要改成Movable(这时不会被缓存)
+ *
+ * Climbable通道对BlockAll这类静态几何体默认是Block，没有代理的墙也能爬；Pawn、物理物体和动态物体的预设都忽略这个通道
+ * 新的墙显式加入：简单碰撞就是墙面的静态网格用ClimbableWall预设，形状复杂的墙加一个代理并让网格忽略Climbable
+ * 不想被爬的静态网格把Climbable的响应改成Ignore
+ */
+UCLASS(ClassGroup = (Climbing), meta = (BlueprintSpawnableComponent))
+class UClimbableSurfaceComponent : public UBoxComponent
+{
+	GENERATED_BODY()
+
+public:
+	UClimbableSurfaceComponent();
+
+	static const FName ClimbableProxyProfileName;	// DefaultEngine.ini里的ClimbableProxy碰撞预设
+	static const FName ClimbableWallProfileName;	// DefaultEngine.ini里的ClimbableWall碰撞预设，给本身就是墙的静态网格用
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Climbing, meta = (ClampMin = "0", UIMin = "0", UIMax = "2"))
+	float ClimbSpeedScale;			// 在这面墙上的攀爬速度倍率
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Climbing)
+	EClimbGripType GripType;
+
+	UPROPERTY(EditAnywhere, Category = Climbing)
+	float FitPadding;				// 自动适配Owner的网格时Box每边额外扩大的距离，负数表示往里缩
+
+	/**
+	 * 把Box适配成Owner上所有StaticMesh的包围盒(在父组件的空间里)，只在编辑器里按一次，结果保存在组件上
+	 * 网格的形状比较复杂时还是手动摆几个代理比较准
+	 */
+	UFUNCTION(CallInEditor, Category = Climbing)
+	void FitToOwnerMeshes();
+
+	// 检测打到的组件是攀爬代理时返回它，否则返回空，调用方用默认的攀爬参数
+	static const UClimbableSurfaceComponent* FromComponent(const UPrimitiveComponent* Component) { return Cast<UClimbableSurfaceComponent>(Component); }
+	static float GetClimbSpeedScale(const UPrimitiveComponent* Component);
+	static EClimbGripType GetGripType(const UPrimitiveComponent* Component);
+};
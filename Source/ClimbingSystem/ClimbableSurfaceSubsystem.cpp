@@ -0,0 +1,577 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbableSurfaceSubsystem.h"
+#include "ClimbingDebugSubsystem.h"
+#include "ClimbingStats.h"
+#include "ClimbingSystem.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "PhysicsEngine/BodySetup.h"
+
+static TAutoConsoleVariable<int32> CVarClimbingSurfaceCache(
+	TEXT("Climbing.SurfaceCache"),
+	1,
+	TEXT("攀爬检测是否先查询静态几何体的缓存\n")
+	TEXT("0: 每次都做LineTrace\n")
+	TEXT("1: 先查缓存，没命中再LineTrace (默认)"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarClimbingSurfaceCacheValidateDynamic(
+	TEXT("Climbing.SurfaceCache.ValidateDynamic"),
+	1,
+	TEXT("缓存命中之后是否再对会动的物体做一次到命中点为止的检测\n")
+	TEXT("0: 直接用缓存的结果，命中点前面挡着的动态物体会被忽略\n")
+	TEXT("1: 只查动态物体，挡住了就用动态物体的结果 (默认)"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarClimbingSurfaceCacheCellSize(
+	TEXT("Climbing.SurfaceCache.CellSize"),
+	200.f,
+	TEXT("缓存网格的格子大小，只在关卡开始时生效"),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorld ClimbingSurfaceCacheStatsCommand(
+	TEXT("Climbing.SurfaceCache.Stats"),
+	TEXT("输出攀爬表面缓存的命中/未命中次数，并清零计数"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (const UClimbableSurfaceSubsystem* Subsystem = World ? World->GetSubsystem<UClimbableSurfaceSubsystem>() : nullptr) {
+			const uint64 Hits = Subsystem->GetNumCacheHits();
+			const uint64 Misses = Subsystem->GetNumCacheMisses();
+			const double HitRate = Hits + Misses > 0 ? double(Hits) / double(Hits + Misses) * 100.0 : 0.0;
+			UE_LOG(LogClimbing, Display, TEXT("Climbing surface cache: %d patches, %llu hits, %llu misses (%.1f%% hit rate)"), Subsystem->GetNumPatches(), Hits, Misses, HitRate);
+			const_cast<UClimbableSurfaceSubsystem*>(Subsystem)->ResetCounters();
+		}
+	}));
+
+// 一个面覆盖的格子太多的话就不缓存了，这种面(比如整个地图的地板)直接走LineTrace
+static constexpr int32 MaxCellsPerPatch = 4096;
+
+// 缓存里只有静态几何体的简单碰撞，要查复杂碰撞或者只查动态物体的检测不能用缓存
+static bool CanUseSurfaceCache(const FCollisionQueryParams& Params) {
+	return !Params.bTraceComplex && Params.MobilityType != EQueryMobilityType::Dynamic;
+}
+
+// 缓存的面不知道这次检测要忽略谁，打到被忽略的组件或Actor时当作没命中，交给真正的LineTrace去找后面的东西
+static bool IsCachedHitIgnored(const FHitResult& Hit, const FCollisionQueryParams& Params) {
+	const UPrimitiveComponent* Component = Hit.GetComponent();
+	if (!Component) {
+		return true;
+	}
+	if (Params.GetIgnoredComponents().Contains(Component->GetUniqueID())) {
+		return true;
+	}
+	const AActor* Owner = Component->GetOwner();
+	return Owner && Params.GetIgnoredActors().Contains(Owner->GetUniqueID());
+}
+
+bool UClimbableSurfaceSubsystem::LineTraceClimbing(const UWorld* World, FHitResult& OutHit, const FVector& Start, const FVector& End, ECollisionChannel TraceChannel, const FCollisionQueryParams& Params) {
+	INC_DWORD_STAT(STAT_ClimbingLineTraces);
+
+	const UClimbableSurfaceSubsystem* Subsystem = World->GetSubsystem<UClimbableSurfaceSubsystem>();
+	if (Subsystem && TraceChannel == ECC_Climbable && CanUseSurfaceCache(Params) && CVarClimbingSurfaceCache.GetValueOnGameThread() != 0) {
+		if (Subsystem->LineTraceCache(OutHit, Start, End) && !IsCachedHitIgnored(OutHit, Params)) {
+			++Subsystem->NumCacheHits;
+			// 缓存里只有不会动的几何体，命中点前面可能还挡着会动的物体，只在动态物体里查一次到命中点为止的检测
+			if (CVarClimbingSurfaceCacheValidateDynamic.GetValueOnGameThread() != 0) {
+				FCollisionQueryParams DynamicParams(Params);
+				DynamicParams.MobilityType = EQueryMobilityType::Dynamic;
+				INC_DWORD_STAT(STAT_ClimbingPhysicsTraces);
+				++Subsystem->NumPhysicsTraces;
+				FHitResult DynamicHit;
+				if (World->LineTraceSingleByChannel(DynamicHit, Start, OutHit.ImpactPoint, TraceChannel, DynamicParams)) {
+					// 时间要按整条检测线算，和直接LineTrace的结果一致
+					DynamicHit.TraceEnd = End;
+					DynamicHit.Time *= OutHit.Time;
+					OutHit = DynamicHit;
+				}
+			}
+			CLIMBING_DEBUG_PROBE(World, Start, End, &OutHit);
+			return true;
+		}
+		++Subsystem->NumCacheMisses;
+	}
+
+	INC_DWORD_STAT(STAT_ClimbingPhysicsTraces);
+	if (Subsystem) {
+		++Subsystem->NumPhysicsTraces;
+	}
+	const bool bHit = World->LineTraceSingleByChannel(OutHit, Start, End, TraceChannel, Params);
+	CLIMBING_DEBUG_PROBE(World, Start, End, &OutHit);
+	return bHit;
+}
+
+bool UClimbableSurfaceSubsystem::AsyncLineTraceClimbing(UWorld* World, FClimbingAsyncTrace& OutTrace, const FVector& Start, const FVector& End, ECollisionChannel TraceChannel, const FCollisionQueryParams& Params) {
+	INC_DWORD_STAT(STAT_ClimbingLineTraces);
+	OutTrace = FClimbingAsyncTrace();
+
+	const UClimbableSurfaceSubsystem* Subsystem = World->GetSubsystem<UClimbableSurfaceSubsystem>();
+	FVector TraceEnd = End;
+	FCollisionQueryParams TraceParams(Params);
+	if (Subsystem && TraceChannel == ECC_Climbable && CanUseSurfaceCache(Params) && CVarClimbingSurfaceCache.GetValueOnGameThread() != 0) {
+		if (Subsystem->LineTraceCache(OutTrace.CachedHit, Start, End) && !IsCachedHitIgnored(OutTrace.CachedHit, Params)) {
+			++Subsystem->NumCacheHits;
+			OutTrace.bCached = true;
+			if (CVarClimbingSurfaceCacheValidateDynamic.GetValueOnGameThread() == 0) {
+				return true;
+			}
+			// 和LineTraceClimbing一样，只查命中点前面的动态物体
+			TraceEnd = OutTrace.CachedHit.ImpactPoint;
+			TraceParams.MobilityType = EQueryMobilityType::Dynamic;
+		} else {
+			++Subsystem->NumCacheMisses;
+		}
+	}
+
+	OutTrace.Handle = World->AsyncLineTraceByChannel(EAsyncTraceType::Single, Start, TraceEnd, TraceChannel, TraceParams);
+	CountAsyncTraces(World, 1);
+	return false;
+}
+
+bool UClimbableSurfaceSubsystem::ResolveAsyncLineTraceClimbing(const UWorld* World, const FClimbingAsyncTrace& Trace, FHitResult& OutHit, bool& bOutHit) {
+	FHitResult TraceHit;
+	bool bTraceHit = false;
+	if (Trace.Handle.IsValid()) {
+		FTraceDatum Datum;
+		if (!World->QueryTraceData(Trace.Handle, Datum)) {
+			return false;
+		}
+		bTraceHit = Datum.OutHits.Num() > 0 && Datum.OutHits[0].bBlockingHit;
+		TraceHit = bTraceHit ? Datum.OutHits[0] : FHitResult(Datum.Start, Datum.End);
+	} else if (!Trace.bCached) {
+		return false;
+	}
+
+	if (Trace.bCached) {
+		OutHit = Trace.CachedHit;
+		if (bTraceHit) {
+			// 时间要按整条检测线算，和直接LineTrace的结果一致
+			TraceHit.TraceEnd = Trace.CachedHit.TraceEnd;
+			TraceHit.Time *= Trace.CachedHit.Time;
+			OutHit = TraceHit;
+		}
+		bOutHit = true;
+	} else {
+		OutHit = TraceHit;
+		bOutHit = bTraceHit;
+	}
+	CLIMBING_DEBUG_PROBE(World, OutHit.TraceStart, OutHit.TraceEnd, &OutHit);
+	return true;
+}
+
+bool UClimbableSurfaceSubsystem::LineTraceCache(FHitResult& OutHit, const FVector& Start, const FVector& End) const {
+	if (Patches.Num() == 0) {
+		return false;
+	}
+
+	const FVector Direction = End - Start;
+	const FIntVector MinCell = GetCellCoord(Start.ComponentMin(End));
+	const FIntVector MaxCell = GetCellCoord(Start.ComponentMax(End));
+
+	// 检测线可能先打到没缓存的静态几何体，这种情况交给真正的LineTrace
+	for (const TPair<TObjectKey<UPrimitiveComponent>, FBox>& Pair : LargeUncachedBounds) {
+		if (FMath::LineBoxIntersection(Pair.Value, Start, End, Direction)) {
+			return false;
+		}
+	}
+	if (UncachedCells.Num() > 0) {
+		for (int32 X = MinCell.X; X <= MaxCell.X; ++X) {
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y) {
+				for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z) {
+					if (UncachedCells.Contains(FIntVector(X, Y, Z))) {
+						return false;
+					}
+				}
+			}
+		}
+	}
+
+	PatchQueryStamps.SetNumZeroed(Patches.GetMaxIndex());
+	if (++QueryStamp == 0) {
+		// 计数器回绕了，清掉所有的标记
+		FMemory::Memzero(PatchQueryStamps.GetData(), PatchQueryStamps.Num() * sizeof(uint32));
+		QueryStamp = 1;
+	}
+
+	double BestTime = TNumericLimits<double>::Max();
+	int32 BestPatch = INDEX_NONE;
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; ++X) {
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y) {
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z) {
+				const TArray<int32>* CellPatches = Cells.Find(FIntVector(X, Y, Z));
+				if (!CellPatches) {
+					continue;
+				}
+
+				for (const int32 PatchIndex : *CellPatches) {
+					if (PatchQueryStamps[PatchIndex] == QueryStamp) {
+						continue;
+					}
+					PatchQueryStamps[PatchIndex] = QueryStamp;
+
+					// 只接受从正面射入的线
+					const FClimbableSurfacePatch& Patch = Patches[PatchIndex];
+					const double Denominator = FVector::DotProduct(Direction, Patch.Normal);
+					if (Denominator >= -UE_KINDA_SMALL_NUMBER) {
+						continue;
+					}
+
+					const double Time = FVector::DotProduct(Patch.Center - Start, Patch.Normal) / Denominator;
+					if (Time < 0.0 || Time > 1.0 || Time >= BestTime) {
+						continue;
+					}
+
+					const FVector Offset = Start + Direction * Time - Patch.Center;
+					if (FMath::Abs(FVector::DotProduct(Offset, Patch.AxisU)) > Patch.HalfU || FMath::Abs(FVector::DotProduct(Offset, Patch.AxisV)) > Patch.HalfV) {
+						continue;
+					}
+
+					BestTime = Time;
+					BestPatch = PatchIndex;
+				}
+			}
+		}
+	}
+
+	if (BestPatch == INDEX_NONE) {
+		return false;
+	}
+
+	const FClimbableSurfacePatch& Patch = Patches[BestPatch];
+	const FVector HitLocation = Start + Direction * BestTime;
+
+	OutHit = FHitResult(Start, End);
+	OutHit.bBlockingHit = true;
+	OutHit.Time = BestTime;
+	OutHit.Distance = Direction.Size() * BestTime;
+	OutHit.Location = HitLocation;
+	OutHit.ImpactPoint = HitLocation;
+	OutHit.Normal = Patch.Normal;
+	OutHit.ImpactNormal = Patch.Normal;
+	OutHit.Component = Patch.Component;
+	if (const UPrimitiveComponent* Component = Patch.Component.Get()) {
+		OutHit.HitObjectHandle = FActorInstanceHandle(Component->GetOwner());
+	}
+	return true;
+}
+
+void UClimbableSurfaceSubsystem::CountAsyncTraces(const UWorld* World, int32 NumTraces) {
+	INC_DWORD_STAT_BY(STAT_ClimbingAsyncTraces, NumTraces);
+	if (const UClimbableSurfaceSubsystem* Subsystem = World->GetSubsystem<UClimbableSurfaceSubsystem>()) {
+		Subsystem->NumAsyncTraces += NumTraces;
+	}
+}
+
+void UClimbableSurfaceSubsystem::ForEachPatchInLevel(const ULevel* Level, TFunctionRef<void(const FClimbableSurfacePatch&)> Callback) const {
+	for (const TPair<TObjectKey<UPrimitiveComponent>, FCachedComponent>& Pair : CachedComponents) {
+		if (Level && Pair.Value.Level.Get() != Level) {
+			continue;
+		}
+		for (const int32 PatchIndex : Pair.Value.PatchIndices) {
+			Callback(Patches[PatchIndex]);
+		}
+	}
+}
+
+void UClimbableSurfaceSubsystem::ResetCounters() {
+	NumCacheHits = 0;
+	NumCacheMisses = 0;
+	NumPhysicsTraces = 0;
+	NumAsyncTraces = 0;
+}
+
+bool UClimbableSurfaceSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UClimbableSurfaceSubsystem::OnWorldBeginPlay(UWorld& InWorld) {
+	Super::OnWorldBeginPlay(InWorld);
+
+	CellSize = FMath::Max(CVarClimbingSurfaceCacheCellSize.GetValueOnGameThread(), 10.f);
+
+	for (ULevel* Level : InWorld.GetLevels()) {
+		AddLevel(Level);
+	}
+
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UClimbableSurfaceSubsystem::OnLevelAddedToWorld);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &UClimbableSurfaceSubsystem::OnLevelRemovedFromWorld);
+	CreatePhysicsHandle = UActorComponent::GlobalCreatePhysicsDelegate.AddUObject(this, &UClimbableSurfaceSubsystem::OnComponentCreatePhysicsState);
+	DestroyPhysicsHandle = UActorComponent::GlobalDestroyPhysicsDelegate.AddUObject(this, &UClimbableSurfaceSubsystem::OnComponentDestroyPhysicsState);
+
+	UE_LOG(LogClimbing, Log, TEXT("Climbing surface cache built: %d patches in %d cells"), Patches.Num(), Cells.Num());
+}
+
+void UClimbableSurfaceSubsystem::Deinitialize() {
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+	UActorComponent::GlobalCreatePhysicsDelegate.Remove(CreatePhysicsHandle);
+	UActorComponent::GlobalDestroyPhysicsDelegate.Remove(DestroyPhysicsHandle);
+
+	TArray<TObjectKey<UPrimitiveComponent>> ComponentKeys;
+	CachedComponents.GetKeys(ComponentKeys);
+	for (const TObjectKey<UPrimitiveComponent>& ComponentKey : ComponentKeys) {
+		RemoveComponent(ComponentKey);
+	}
+
+	Super::Deinitialize();
+}
+
+void UClimbableSurfaceSubsystem::AddLevel(ULevel* Level) {
+	if (!Level) {
+		return;
+	}
+
+	for (AActor* Actor : Level->Actors) {
+		if (!Actor) {
+			continue;
+		}
+		Actor->ForEachComponent<UPrimitiveComponent>(false, [this](UPrimitiveComponent* Component) {
+			AddComponent(Component);
+		});
+	}
+}
+
+void UClimbableSurfaceSubsystem::RemoveLevel(ULevel* Level) {
+	TArray<TObjectKey<UPrimitiveComponent>> ComponentKeys;
+	for (const TPair<TObjectKey<UPrimitiveComponent>, FCachedComponent>& Pair : CachedComponents) {
+		if (!Pair.Value.Level.IsValid() || Pair.Value.Level.Get() == Level) {
+			ComponentKeys.Add(Pair.Key);
+		}
+	}
+	for (const TObjectKey<UPrimitiveComponent>& ComponentKey : ComponentKeys) {
+		RemoveComponent(ComponentKey);
+	}
+}
+
+bool UClimbableSurfaceSubsystem::GatherClimbableBoxes(const UPrimitiveComponent* Component, const FTransform& ComponentTransform, TArray<FClimbableBox>& OutBoxes) {
+	// 只缓存会挡住Climbable通道的组件，缓存的结果才和攀爬检测的LineTrace一致
+	if (!Component->IsQueryCollisionEnabled() || Component->GetCollisionResponseToChannel(ECC_Climbable) != ECR_Block) {
+		return false;
+	}
+
+	const UBodySetup* BodySetup = Component->GetBodySetup();
+	if (!BodySetup || BodySetup->GetCollisionTraceFlag() == CTF_UseComplexAsSimple) {
+		return false;
+	}
+
+	// 简单碰撞全部由Box组成的时候缓存才和LineTrace的结果一致
+	const FKAggregateGeom& AggGeom = BodySetup->AggGeom;
+	if (AggGeom.BoxElems.Num() == 0 || AggGeom.SphereElems.Num() > 0 || AggGeom.SphylElems.Num() > 0 || AggGeom.ConvexElems.Num() > 0 || AggGeom.TaperedCapsuleElems.Num() > 0 || AggGeom.LevelSetElems.Num() > 0) {
+		return false;
+	}
+
+	for (const FKBoxElem& BoxElem : AggGeom.BoxElems) {
+		const FTransform BoxTransform = BoxElem.GetTransform() * ComponentTransform;
+		const FVector Scale = BoxTransform.GetScale3D().GetAbs();
+
+		FClimbableBox& Box = OutBoxes.AddDefaulted_GetRef();
+		Box.Center = BoxTransform.GetLocation();
+		Box.Axes[0] = BoxTransform.GetUnitAxis(EAxis::X);
+		Box.Axes[1] = BoxTransform.GetUnitAxis(EAxis::Y);
+		Box.Axes[2] = BoxTransform.GetUnitAxis(EAxis::Z);
+		Box.HalfExtents[0] = BoxElem.X * 0.5 * Scale.X;
+		Box.HalfExtents[1] = BoxElem.Y * 0.5 * Scale.Y;
+		Box.HalfExtents[2] = BoxElem.Z * 0.5 * Scale.Z;
+	}
+	return true;
+}
+
+void UClimbableSurfaceSubsystem::AddComponent(UPrimitiveComponent* Component) {
+	// 只缓存不会动的几何体
+	if (!Component || !Component->IsRegistered() || Component->Mobility == EComponentMobility::Movable) {
+		return;
+	}
+
+	const TObjectKey<UPrimitiveComponent> ComponentKey(Component);
+	if (CachedComponents.Contains(ComponentKey)) {
+		return;
+	}
+
+	// 不挡Climbable通道的组件和攀爬检测无关
+	if (!Component->IsQueryCollisionEnabled() || Component->GetCollisionResponseToChannel(ECC_Climbable) != ECR_Block) {
+		return;
+	}
+
+	FCachedComponent& Cached = CachedComponents.Add(ComponentKey);
+	Cached.Level = Component->GetComponentLevel();
+	Cached.TransformUpdatedHandle = Component->TransformUpdated.AddUObject(this, &UClimbableSurfaceSubsystem::OnComponentTransformUpdated);
+
+	// 简单碰撞不全是Box的组件缓存不了，只记下它占的地方，经过这里的检测走LineTrace
+	TArray<FClimbableBox> Boxes;
+	if (!GatherClimbableBoxes(Component, Component->GetComponentTransform(), Boxes)) {
+		Cached.UncachedBounds = Component->Bounds.GetBox();
+		AddUncachedBounds(Cached.UncachedBounds, ComponentKey);
+		return;
+	}
+
+	bool bAllPatchesCached = true;
+
+	for (const FClimbableBox& Box : Boxes) {
+		// Box的6个面，朝下的面不会被攀爬用到，不缓存
+		for (int32 Axis = 0; Axis < 3; ++Axis) {
+			const int32 AxisU = (Axis + 1) % 3;
+			const int32 AxisV = (Axis + 2) % 3;
+			for (const double Sign : { 1.0, -1.0 }) {
+				FClimbableSurfacePatch Patch;
+				Patch.Normal = Box.Axes[Axis] * Sign;
+				if (Patch.Normal.Z < -0.5) {
+					continue;
+				}
+				Patch.Center = Box.Center + Patch.Normal * Box.HalfExtents[Axis];
+				Patch.AxisU = Box.Axes[AxisU];
+				Patch.AxisV = Box.Axes[AxisV];
+				Patch.HalfU = Box.HalfExtents[AxisU];
+				Patch.HalfV = Box.HalfExtents[AxisV];
+				Patch.TopZ = Patch.Center.Z + FMath::Abs(Patch.AxisU.Z) * Patch.HalfU + FMath::Abs(Patch.AxisV.Z) * Patch.HalfV;
+				Patch.Component = Component;
+				bAllPatchesCached &= AddPatch(Patch, Cached.PatchIndices);
+			}
+		}
+	}
+
+	// 有面太大被丢掉了，缓存里这个组件不完整
+	if (!bAllPatchesCached) {
+		Cached.UncachedBounds = Component->Bounds.GetBox();
+		AddUncachedBounds(Cached.UncachedBounds, ComponentKey);
+	}
+}
+
+void UClimbableSurfaceSubsystem::RemoveComponent(TObjectKey<UPrimitiveComponent> ComponentKey) {
+	FCachedComponent Cached;
+	if (!CachedComponents.RemoveAndCopyValue(ComponentKey, Cached)) {
+		return;
+	}
+
+	if (UPrimitiveComponent* Component = ComponentKey.ResolveObjectPtr()) {
+		Component->TransformUpdated.Remove(Cached.TransformUpdatedHandle);
+	}
+
+	if (Cached.UncachedBounds.IsValid) {
+		RemoveUncachedBounds(Cached.UncachedBounds, ComponentKey);
+	}
+
+	for (const int32 PatchIndex : Cached.PatchIndices) {
+		const FClimbableSurfacePatch& Patch = Patches[PatchIndex];
+		const FVector Extent = Patch.AxisU.GetAbs() * Patch.HalfU + Patch.AxisV.GetAbs() * Patch.HalfV;
+		const FIntVector MinCell = GetCellCoord(Patch.Center - Extent);
+		const FIntVector MaxCell = GetCellCoord(Patch.Center + Extent);
+		for (int32 X = MinCell.X; X <= MaxCell.X; ++X) {
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y) {
+				for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z) {
+					const FIntVector CellCoord(X, Y, Z);
+					if (TArray<int32>* CellPatches = Cells.Find(CellCoord)) {
+						CellPatches->RemoveSwap(PatchIndex);
+						if (CellPatches->Num() == 0) {
+							Cells.Remove(CellCoord);
+						}
+					}
+				}
+			}
+		}
+		Patches.RemoveAt(PatchIndex);
+	}
+}
+
+bool UClimbableSurfaceSubsystem::AddPatch(const FClimbableSurfacePatch& Patch, TArray<int32>& OutPatchIndices) {
+	const FVector Extent = Patch.AxisU.GetAbs() * Patch.HalfU + Patch.AxisV.GetAbs() * Patch.HalfV;
+	const FIntVector MinCell = GetCellCoord(Patch.Center - Extent);
+	const FIntVector MaxCell = GetCellCoord(Patch.Center + Extent);
+	const int64 NumCells = int64(MaxCell.X - MinCell.X + 1) * int64(MaxCell.Y - MinCell.Y + 1) * int64(MaxCell.Z - MinCell.Z + 1);
+	if (NumCells > MaxCellsPerPatch) {
+		return false;
+	}
+
+	const int32 PatchIndex = Patches.Add(Patch);
+	OutPatchIndices.Add(PatchIndex);
+	for (int32 X = MinCell.X; X <= MaxCell.X; ++X) {
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y) {
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z) {
+				Cells.FindOrAdd(FIntVector(X, Y, Z)).Add(PatchIndex);
+			}
+		}
+	}
+	return true;
+}
+
+void UClimbableSurfaceSubsystem::AddUncachedBounds(const FBox& Bounds, TObjectKey<UPrimitiveComponent> ComponentKey) {
+	const FIntVector MinCell = GetCellCoord(Bounds.Min);
+	const FIntVector MaxCell = GetCellCoord(Bounds.Max);
+	const int64 NumCells = int64(MaxCell.X - MinCell.X + 1) * int64(MaxCell.Y - MinCell.Y + 1) * int64(MaxCell.Z - MinCell.Z + 1);
+	if (NumCells > MaxCellsPerPatch) {
+		LargeUncachedBounds.Add(ComponentKey, Bounds);
+		return;
+	}
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; ++X) {
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y) {
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z) {
+				++UncachedCells.FindOrAdd(FIntVector(X, Y, Z));
+			}
+		}
+	}
+}
+
+void UClimbableSurfaceSubsystem::RemoveUncachedBounds(const FBox& Bounds, TObjectKey<UPrimitiveComponent> ComponentKey) {
+	if (LargeUncachedBounds.Remove(ComponentKey) > 0) {
+		return;
+	}
+
+	const FIntVector MinCell = GetCellCoord(Bounds.Min);
+	const FIntVector MaxCell = GetCellCoord(Bounds.Max);
+	for (int32 X = MinCell.X; X <= MaxCell.X; ++X) {
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y) {
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z) {
+				const FIntVector CellCoord(X, Y, Z);
+				if (int32* Count = UncachedCells.Find(CellCoord)) {
+					if (--*Count <= 0) {
+						UncachedCells.Remove(CellCoord);
+					}
+				}
+			}
+		}
+	}
+}
+
+void UClimbableSurfaceSubsystem::OnLevelAddedToWorld(ULevel* Level, UWorld* World) {
+	if (World == GetWorld()) {
+		AddLevel(Level);
+	}
+}
+
+void UClimbableSurfaceSubsystem::OnLevelRemovedFromWorld(ULevel* Level, UWorld* World) {
+	// Level为空表示整个World都要被清掉了
+	if (World == GetWorld() && Level) {
+		RemoveLevel(Level);
+	}
+}
+
+void UClimbableSurfaceSubsystem::OnComponentTransformUpdated(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport) {
+	// 只重建这一个组件的面
+	if (UPrimitiveComponent* PrimitiveComponent = Cast<UPrimitiveComponent>(Component)) {
+		RemoveComponent(PrimitiveComponent);
+		AddComponent(PrimitiveComponent);
+	}
+}
+
+void UClimbableSurfaceSubsystem::OnComponentCreatePhysicsState(UActorComponent* Component) {
+	// 关卡开始之后注册的组件(运行时生成的Actor、重新打开碰撞的组件)，AddComponent自己会过滤掉不该缓存的
+	if (Component->GetWorld() == GetWorld()) {
+		AddComponent(Cast<UPrimitiveComponent>(Component));
+	}
+}
+
+void UClimbableSurfaceSubsystem::OnComponentDestroyPhysicsState(UActorComponent* Component) {
+	// 组件被销毁、反注册或者物理状态重建时，物理场景里已经没有它了，缓存里也不能再有
+	if (UPrimitiveComponent* PrimitiveComponent = Cast<UPrimitiveComponent>(Component)) {
+		RemoveComponent(PrimitiveComponent);
+	}
+}
+
+FIntVector UClimbableSurfaceSubsystem::GetCellCoord(const FVector& Location) const {
+	return FIntVector(
+		FMath::FloorToInt32(Location.X / CellSize),
+		FMath::FloorToInt32(Location.Y / CellSize),
+		FMath::FloorToInt32(Location.Z / CellSize));
+}
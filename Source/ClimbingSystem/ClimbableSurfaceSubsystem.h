@@ -0,0 +1,211 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/HitResult.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "UObject/ObjectKey.h"
+#include "ClimbableSurfaceSubsystem.generated.h"
+
+class ULevel;
+class USceneComponent;
+class UPrimitiveComponent;
+class UActorComponent;
+
+/** 缓存下来的一块平面，来自可攀爬的静态几何体简单碰撞里的Box的一个面 */
+struct FClimbableSurfacePatch {
+	FVector Center;			// 面的中心
+	FVector Normal;			// 面的朝外法线
+	FVector AxisU;			// 面内的两条轴
+	FVector AxisV;
+	double HalfU;			// 沿AxisU/AxisV方向的半长
+	double HalfV;
+	double TopZ;			// 这个面最高点的高度，也就是顶边的高度
+	TWeakObjectPtr<UPrimitiveComponent> Component;
+
+	FPlane GetPlane() const { return FPlane(Center, Normal); }
+};
+
+/** 静态几何体简单碰撞里的一个Box，已经变换到世界空间 */
+struct FClimbableBox {
+	FVector Center;
+	FVector Axes[3];
+	double HalfExtents[3];
+
+	bool ContainsPoint(const FVector& Point) const {
+		const FVector Offset = Point - Center;
+		for (int32 Axis = 0; Axis < 3; ++Axis) {
+			if (FMath::Abs(FVector::DotProduct(Offset, Axes[Axis])) > HalfExtents[Axis]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * 射线和Box求交，起点在Box里面时不算命中
+	 * @param OutNormal 射线进入的那个面的朝外法线
+	 */
+	bool IntersectRay(const FVector& Start, const FVector& Direction, double MaxDistance, double& OutDistance, FVector& OutNormal) const {
+		const FVector Offset = Start - Center;
+		double EnterDistance = 0.0;
+		double ExitDistance = MaxDistance;
+		int32 EnterAxis = INDEX_NONE;
+		double EnterSign = 1.0;
+		for (int32 Axis = 0; Axis < 3; ++Axis) {
+			const double Origin = FVector::DotProduct(Offset, Axes[Axis]);
+			const double Slope = FVector::DotProduct(Direction, Axes[Axis]);
+			if (FMath::Abs(Slope) < UE_SMALL_NUMBER) {
+				if (FMath::Abs(Origin) > HalfExtents[Axis]) {
+					return false;
+				}
+				continue;
+			}
+
+			// 沿正方向走时先穿过负方向的面
+			double Near = (-HalfExtents[Axis] - Origin) / Slope;
+			double Far = (HalfExtents[Axis] - Origin) / Slope;
+			double Sign = -1.0;
+			if (Near > Far) {
+				Swap(Near, Far);
+				Sign = 1.0;
+			}
+			if (Near > EnterDistance) {
+				EnterDistance = Near;
+				EnterAxis = Axis;
+				EnterSign = Sign;
+			}
+			ExitDistance = FMath::Min(ExitDistance, Far);
+			if (EnterDistance > ExitDistance) {
+				return false;
+			}
+		}
+		if (EnterAxis == INDEX_NONE) {
+			return false;
+		}
+
+		OutDistance = EnterDistance;
+		OutNormal = Axes[EnterAxis] * EnterSign;
+		return true;
+	}
+};
+
+/** AsyncLineTraceClimbing提交的一次检测，下一帧交给ResolveAsyncLineTraceClimbing */
+struct FClimbingAsyncTrace {
+	FTraceHandle Handle;		// 缓存命中并且不需要检查动态物体时无效
+	FHitResult CachedHit;
+	bool bCached = false;		// 缓存命中了，异步检测只查到命中点为止的动态物体
+};
+
+/**
+ * 在关卡加载时把静态几何体的面缓存到均匀网格里，攀爬相关的检测先查这个缓存，查不到再去做真正的LineTrace
+ * 组件移动、物理状态创建/销毁或者关卡流送进出时只重建受影响的组件
+ * 缓存命中之后还会只对动态物体做一次到命中点为止的检测，缓存不会越过挡在前面的会动的物体
+ * 挡住Climbable通道但是没法缓存的静态几何体(凸包、复杂碰撞、太大被丢掉的面)会把它包围盒覆盖的格子标记出来，经过这些格子的检测不查缓存
+ */
+UCLASS()
+class UClimbableSurfaceSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * 攀爬用的LineTrace，先查缓存，缓存没命中再去物理场景里查询
+	 * 缓存里只有挡住Climbable通道的静态几何体，只有Climbable通道的检测会查缓存，其他通道(比如检测地面的Visibility)直接LineTrace
+	 * bTraceComplex或者只查动态物体的检测不查缓存；缓存打到Params里忽略的组件或Actor时当作没命中
+	 */
+	static bool LineTraceClimbing(const UWorld* World, FHitResult& OutHit, const FVector& Start, const FVector& End, ECollisionChannel TraceChannel, const FCollisionQueryParams& Params);
+
+	/**
+	 * 取出组件的简单碰撞里的所有Box
+	 * @return 组件会挡住Climbable通道并且简单碰撞全部由Box组成时返回true
+	 */
+	static bool GatherClimbableBoxes(const UPrimitiveComponent* Component, const FTransform& ComponentTransform, TArray<FClimbableBox>& OutBoxes);
+
+	// 攀爬代码自己提交的异步检测不经过LineTraceClimbing，提交时在这里计数
+	static void CountAsyncTraces(const UWorld* World, int32 NumTraces);
+
+	/**
+	 * LineTraceClimbing的异步版本，查缓存的规则一样，物理场景里的检测改成异步提交
+	 * @return 结果已经确定(缓存命中并且不需要检查动态物体)时返回true，这时OutTrace里没有有效的Handle
+	 */
+	static bool AsyncLineTraceClimbing(UWorld* World, FClimbingAsyncTrace& OutTrace, const FVector& Start, const FVector& End, ECollisionChannel TraceChannel, const FCollisionQueryParams& Params);
+
+	/**
+	 * 取AsyncLineTraceClimbing的结果，一般在提交的下一帧调用
+	 * @return 结果还没回来或者已经过期时返回false；bOutHit表示有没有打到
+	 */
+	static bool ResolveAsyncLineTraceClimbing(const UWorld* World, const FClimbingAsyncTrace& Trace, FHitResult& OutHit, bool& bOutHit);
+
+	/**
+	 * 只查缓存，命中时填充OutHit
+	 * 检测线经过没缓存的静态几何体时返回false，这时缓存里的结果可能比真正的命中点远
+	 */
+	bool LineTraceCache(FHitResult& OutHit, const FVector& Start, const FVector& End) const;
+
+	// 遍历某个关卡里缓存下来的所有面，Level为空时遍历全部
+	void ForEachPatchInLevel(const ULevel* Level, TFunctionRef<void(const FClimbableSurfacePatch&)> Callback) const;
+
+	int32 GetNumPatches() const { return Patches.Num(); }
+	uint64 GetNumCacheHits() const { return NumCacheHits; }
+	uint64 GetNumCacheMisses() const { return NumCacheMisses; }
+	uint64 GetNumPhysicsTraces() const { return NumPhysicsTraces; }	// 真正进入物理场景的同步检测
+	uint64 GetNumAsyncTraces() const { return NumAsyncTraces; }
+	void ResetCounters();
+
+	// UWorldSubsystem interface
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FCachedComponent {
+		TArray<int32> PatchIndices;
+		TWeakObjectPtr<ULevel> Level;
+		FDelegateHandle TransformUpdatedHandle;
+		FBox UncachedBounds = FBox(ForceInit);	// 有效时表示这个组件(或者它的一部分面)没进缓存，包围盒里的检测不能信任缓存
+	};
+
+	void AddLevel(ULevel* Level);
+	void RemoveLevel(ULevel* Level);
+	void AddComponent(UPrimitiveComponent* Component);
+	void RemoveComponent(TObjectKey<UPrimitiveComponent> ComponentKey);
+	bool AddPatch(const FClimbableSurfacePatch& Patch, TArray<int32>& OutPatchIndices);
+	void AddUncachedBounds(const FBox& Bounds, TObjectKey<UPrimitiveComponent> ComponentKey);
+	void RemoveUncachedBounds(const FBox& Bounds, TObjectKey<UPrimitiveComponent> ComponentKey);
+
+	void OnLevelAddedToWorld(ULevel* Level, UWorld* World);
+	void OnLevelRemovedFromWorld(ULevel* Level, UWorld* World);
+	void OnComponentTransformUpdated(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+	void OnComponentCreatePhysicsState(UActorComponent* Component);
+	void OnComponentDestroyPhysicsState(UActorComponent* Component);
+
+	FIntVector GetCellCoord(const FVector& Location) const;
+
+	double CellSize = 200.0;
+	TSparseArray<FClimbableSurfacePatch> Patches;
+	TMap<FIntVector, TArray<int32>> Cells;
+	TMap<TObjectKey<UPrimitiveComponent>, FCachedComponent> CachedComponents;
+
+	// 没缓存的静态几何体覆盖的格子，值是覆盖这个格子的组件数；覆盖的格子太多的组件单独放着，查询时逐个和检测线求交
+	TMap<FIntVector, int32> UncachedCells;
+	TMap<TObjectKey<UPrimitiveComponent>, FBox> LargeUncachedBounds;
+
+	// 查询时用来给Patch去重，同一个Patch可能在多个格子里
+	mutable TArray<uint32> PatchQueryStamps;
+	mutable uint32 QueryStamp = 0;
+
+	mutable uint64 NumCacheHits = 0;
+	mutable uint64 NumCacheMisses = 0;
+	mutable uint64 NumPhysicsTraces = 0;
+	mutable uint64 NumAsyncTraces = 0;
+
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
+	FDelegateHandle CreatePhysicsHandle;
+	FDelegateHandle DestroyPhysicsHandle;
+};
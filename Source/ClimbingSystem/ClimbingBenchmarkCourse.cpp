@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingBenchmarkCourse.h"
+#include "ClimbableSurfaceComponent.h"
+#include "ClimbingSystem.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/StaticMesh.h"
+#include "UObject/ConstructorHelpers.h"
+
+AClimbingBenchmarkCourse::AClimbingBenchmarkCourse() {
+	PrimaryActorTick.bCanEverTick = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+	RootComponent->SetMobility(EComponentMobility::Static);
+
+	static ConstructorHelpers::FObjectFinder<UStaticMesh> CubeMeshFinder(TEXT("/Engine/BasicShapes/Cube.Cube"));
+	CubeMesh = CubeMeshFinder.Object;
+
+	NumLanes = 0;
+}
+
+void AClimbingBenchmarkCourse::Build(int32 InNumLanes, const FClimbingBenchmarkCourseSettings& InSettings) {
+	for (UStaticMeshComponent* Box : Boxes) {
+		Box->DestroyComponent();
+	}
+	Boxes.Reset();
+
+	NumLanes = FMath::Max(InNumLanes, 1);
+	Settings = InSettings;
+
+	// 赛道沿本地Y排开，沿本地X前进，地板的顶面在本地Z=0
+	// 地板从起点后面一段一直铺到墙后面，保证掉下来或者翻过去之后都有地面
+	const float FloorMinX = -Settings.RunUpLength;
+	const float FloorMaxX = Settings.RunUpLength * 2.f + Settings.WallThickness;
+	const float CourseWidth = NumLanes * Settings.LaneSpacing;
+	AddBox(FVector((FloorMinX + FloorMaxX) * 0.5f, 0.f, -50.f), FVector(FloorMaxX - FloorMinX, CourseWidth, 100.f), false);
+
+	for (int32 LaneIndex = 0; LaneIndex < NumLanes; ++LaneIndex) {
+		const FVector LaneStart = GetTransform().InverseTransformPosition(GetLaneStart(LaneIndex));
+		AddBox(
+			LaneStart + FVector(Settings.RunUpLength + Settings.WallThickness * 0.5f, 0.f, Settings.WallHeight * 0.5f),
+			FVector(Settings.WallThickness, Settings.WallWidth, Settings.WallHeight), true);
+	}
+}
+
+FVector AClimbingBenchmarkCourse::GetLaneStart(int32 LaneIndex) const {
+	const float LaneY = (LaneIndex - (NumLanes - 1) * 0.5f) * Settings.LaneSpacing;
+	return GetTransform().TransformPosition(FVector(0.f, LaneY, 0.f));
+}
+
+UStaticMeshComponent* AClimbingBenchmarkCourse::AddBox(const FVector& LocalCenter, const FVector& Size, bool bClimbable) {
+	// 注册之前设置好Mesh和Mobility，静态组件注册之后就不能再改了
+	UStaticMeshComponent* Box = NewObject<UStaticMeshComponent>(this);
+	Box->SetMobility(EComponentMobility::Static);
+	Box->SetStaticMesh(CubeMesh);
+	// Cube的简单碰撞本身就是一个Box，不需要额外的代理；墙用ClimbableWall，BlockAll默认也挡Climbable，地板要显式忽略
+	Box->SetCollisionProfileName(bClimbable ? UClimbableSurfaceComponent::ClimbableWallProfileName : UCollisionProfile::BlockAll_ProfileName);
+	if (!bClimbable) {
+		Box->SetCollisionResponseToChannel(ECC_Climbable, ECR_Ignore);
+	}
+	Box->SetupAttachment(RootComponent);
+	Box->SetRelativeLocation(LocalCenter);
+	Box->SetRelativeScale3D(Size / 100.f);
+	Box->RegisterComponent();
+
+	Boxes.Add(Box);
+	return Box;
+}
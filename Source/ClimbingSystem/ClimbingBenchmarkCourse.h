@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "ClimbingBenchmarkCourse.generated.h"
+
+class UStaticMesh;
+class UStaticMeshComponent;
+
+/** 一条赛道的尺寸，所有赛道都一样 */
+USTRUCT(BlueprintType)
+struct FClimbingBenchmarkCourseSettings {
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = Course)
+	float LaneSpacing = 300.f;		// 相邻两条赛道的间距
+
+	UPROPERTY(EditAnywhere, Category = Course)
+	float RunUpLength = 600.f;		// 起点到墙面的距离
+
+	UPROPERTY(EditAnywhere, Category = Course)
+	float WallHeight = 400.f;
+
+	UPROPERTY(EditAnywhere, Category = Course)
+	float WallWidth = 200.f;
+
+	UPROPERTY(EditAnywhere, Category = Course)
+	float WallThickness = 200.f;	// 墙的顶面就是Mantle之后站的Ledge
+};
+
+/**
+ * 程序化生成的攀爬测试场地: 一块地板，每条赛道一堵墙
+ * 所有几何体都是静态的Box，墙会挡住Climbable通道，可以被UClimbableSurfaceSubsystem缓存，也可以被Ledge烘焙
+ * 需要在UWorld::BeginPlay之前生成(比如GameMode的InitGame里)，表面缓存才能在关卡开始时把它收进去
+ */
+UCLASS(NotPlaceable)
+class AClimbingBenchmarkCourse : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AClimbingBenchmarkCourse();
+
+	void Build(int32 InNumLanes, const FClimbingBenchmarkCourseSettings& InSettings);
+
+	int32 GetNumLanes() const { return NumLanes; }
+
+	// 赛道的起点(地面上)，角色面朝GetLaneForward()出发
+	FVector GetLaneStart(int32 LaneIndex) const;
+	FVector GetLaneForward() const { return GetActorForwardVector(); }
+
+	// 起点沿前进方向到墙面的距离和墙顶的高度(世界空间)
+	float GetRunUpLength() const { return Settings.RunUpLength; }
+	float GetWallTopZ() const { return GetActorLocation().Z + Settings.WallHeight; }
+
+private:
+	UStaticMeshComponent* AddBox(const FVector& LocalCenter, const FVector& Size, bool bClimbable);
+
+	UPROPERTY()
+	UStaticMesh* CubeMesh;		// /Engine/BasicShapes/Cube，100x100x100，简单碰撞是一个Box
+
+	UPROPERTY()
+	TArray<UStaticMeshComponent*> Boxes;
+
+	FClimbingBenchmarkCourseSettings Settings;
+	int32 NumLanes;
+};
@@ -0,0 +1,530 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingBenchmarkGameMode.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "ClimbableSurfaceSubsystem.h"
+#include "ClimbingMassSubsystem.h"
+#include "ClimbingSystem.h"
+#include "Components/CapsuleComponent.h"
+#include "Dom/JsonObject.h"
+#include "Engine/World.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include <atomic>
+
+namespace ClimbingBenchmark {
+	/**
+	 * 转发到原来的GMalloc，只是数一下分配的次数和字节数，计数分配的那一段替换GMalloc
+	 * 每次分配多一次原子操作，所以帧时间在它没装上的时候单独记录
+	 * 对象本身不释放，换回去之后还在调用它的线程照样转发
+	 */
+	class FAllocCounter : public FMalloc {
+	public:
+		static FAllocCounter& Get() {
+			static FAllocCounter Instance;
+			return Instance;
+		}
+
+		// GMalloc是编译期固定的类(比如某些主机平台)时装不上，返回false
+		bool Install() {
+#if PLATFORM_USES_FIXED_GMalloc_CLASS
+			return false;
+#else
+			if (GMalloc != this) {
+				FMalloc* Current = GMalloc;
+				if (!Current) {
+					return false;
+				}
+				// 别的线程随时可能在分配，Inner要在它们看到新的GMalloc之前写好，换的时候GMalloc被别人改了就不装
+				Inner = Current;
+				FPlatformMisc::MemoryBarrier();
+				if (FPlatformAtomics::InterlockedCompareExchangePointer((void**)&GMalloc, this, Current) != Current) {
+					return false;
+				}
+			}
+			return true;
+#endif
+		}
+
+		void Uninstall() {
+			if (GMalloc != this) {
+				return;
+			}
+			// 先等Worker上正在跑的任务结束，不会有分配走到一半时换回去；没有结束的其他线程继续用这个实例也没关系，它和Inner都一直有效
+			TFunction<void(ENamedThreads::Type CurrentThread)> Flush = [](ENamedThreads::Type CurrentThread) {};
+			FTaskGraphInterface::BroadcastSlow_OnlyUseForSpecialPurposes(FPlatformProcess::SupportsMultithreading(), false, Flush);
+			FPlatformAtomics::InterlockedExchangePtr((void**)&GMalloc, Inner);
+			FPlatformMisc::MemoryBarrier();
+		}
+
+		bool IsInstalled() const { return GMalloc == this; }
+		uint64 GetNumAllocs() const { return NumAllocs.load(std::memory_order_relaxed); }
+		uint64 GetNumBytes() const { return NumBytes.load(std::memory_order_relaxed); }
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment = DEFAULT_ALIGNMENT) override {
+			Record(Count);
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* TryMalloc(SIZE_T Count, uint32 Alignment = DEFAULT_ALIGNMENT) override {
+			Record(Count);
+			return Inner->TryMalloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment = DEFAULT_ALIGNMENT) override {
+			Record(Count);
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment = DEFAULT_ALIGNMENT) override {
+			Record(Count);
+			return Inner->TryRealloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override { Inner->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual void InitializeStatsMetadata() override { Inner->InitializeStatsMetadata(); }
+		virtual void UpdateStats() override { Inner->UpdateStats(); }
+		virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override { Inner->GetAllocatorStats(OutStats); }
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override { Inner->DumpAllocatorStats(Ar); }
+		virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+		virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+	private:
+		// Realloc到0是释放，不算分配
+		void Record(SIZE_T Size) {
+			if (Size > 0) {
+				NumAllocs.fetch_add(1, std::memory_order_relaxed);
+				NumBytes.fetch_add(Size, std::memory_order_relaxed);
+			}
+		}
+
+		FMalloc* Inner = nullptr;
+		std::atomic<uint64> NumAllocs{ 0 };
+		std::atomic<uint64> NumBytes{ 0 };
+	};
+
+	// 和基准比较的一项指标: 汇总JSON里Object对象下的Field字段，越小越好
+	struct FBaselineMetric {
+		const TCHAR* Object;
+		const TCHAR* Field;
+		double MinSlack;		// 基准值很小时的绝对容差，避免0和0.1这种差别就算退化
+	};
+
+	const FBaselineMetric BaselineMetrics[] = {
+		{ TEXT("FrameMs"), TEXT("Avg"), 0.1 },
+		{ TEXT("FrameMs"), TEXT("P95"), 0.2 },
+		{ TEXT("Traces"), TEXT("PhysicsTracesPerFrame"), 1.0 },
+		{ TEXT("Allocations"), TEXT("PerFrame"), 10.0 },
+		{ TEXT("Allocations"), TEXT("KBPerFrame"), 1.0 },
+	};
+
+	const TCHAR* AllocationsObject = TEXT("Allocations");
+}
+
+AClimbingBenchmarkGameMode::AClimbingBenchmarkGameMode() {
+	NumMassClimbers = 0;
+	WarmupSeconds = 2.f;
+	DurationSeconds = 30.f;
+	AllocDurationSeconds = 5.f;
+	BaselineFile = TEXT("Build/ClimbingBenchmarkBaseline.json");
+	RegressionTolerance = 0.15f;
+
+	FMemory::Memzero(TransitionCounts);
+	StartTime = 0.0;
+	LastFrameTime = 0.0;
+	LastCacheHits = 0;
+	LastPhysicsTraces = 0;
+	LastAsyncTraces = 0;
+	LastAllocs = 0;
+	LastAllocBytes = 0;
+	StartUsedPhysical = 0;
+	bRecording = false;
+	bCountingAllocs = false;
+	bAllocsCounted = false;
+	bFinished = false;
+}
+
+void AClimbingBenchmarkGameMode::ReadCommandLine(const TCHAR* CommandLine) {
+	FParse::Value(CommandLine, TEXT("ClimbingBenchmarkClimbers="), NumClimbers);
+	FParse::Value(CommandLine, TEXT("ClimbingBenchmarkWarmup="), WarmupSeconds);
+	FParse::Value(CommandLine, TEXT("ClimbingBenchmarkDuration="), DurationSeconds);
+	FParse::Value(CommandLine, TEXT("ClimbingBenchmarkAllocDuration="), AllocDurationSeconds);
+	FParse::Value(CommandLine, TEXT("ClimbingBenchmarkMassClimbers="), NumMassClimbers);
+	FParse::Value(CommandLine, TEXT("ClimbingBenchmarkBaseline="), BaselineFile);
+	FParse::Value(CommandLine, TEXT("ClimbingBenchmarkTolerance="), RegressionTolerance);
+	NumMassClimbers = FMath::Max(NumMassClimbers, 0);
+	RegressionTolerance = FMath::Max(RegressionTolerance, 0.f);
+	AllocDurationSeconds = FMath::Max(AllocDurationSeconds, 0.f);
+}
+
+void AClimbingBenchmarkGameMode::StartPlay() {
+	Super::StartPlay();
+
+	SpawnClimbers();
+	SpawnMassClimbers();
+	StartTime = FPlatformTime::Seconds();
+	LastFrameTime = StartTime;
+
+	UE_LOG(LogClimbing, Display, TEXT("Climbing benchmark: %d climbers, %d mass climbers, %.1fs warmup, %.1fs measured, %.1fs counting allocations"),
+		Climbers.Num(), NumMassClimbers, WarmupSeconds, DurationSeconds, AllocDurationSeconds);
+}
+
+void AClimbingBenchmarkGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+	// 提前结束(比如在PIE里手动停止)时也把已经记录的数据写出去
+	if (bRecording && !bFinished) {
+		WriteResults();
+		bFinished = true;
+	}
+	ClimbingBenchmark::FAllocCounter::Get().Uninstall();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AClimbingBenchmarkGameMode::OnClimberSpawned(FScriptedClimber& Climber) {
+	Climber.Character->OnCharacterMovementModeChanged.AddUObject(this, &AClimbingBenchmarkGameMode::OnCharacterMovementModeChanged);
+}
+
+void AClimbingBenchmarkGameMode::SpawnMassClimbers() {
+	UClimbingMassSubsystem* MassSubsystem = GetWorld()->GetSubsystem<UClimbingMassSubsystem>();
+	if (NumMassClimbers <= 0 || !MassSubsystem) {
+		return;
+	}
+
+	const AClimbingSystemCharacter* ClimberCDO = ClimberClass->GetDefaultObject<AClimbingSystemCharacter>();
+	const float HalfHeight = ClimberCDO->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+	const float WallOffset = ClimberCDO->GetWallDistance() + ClimberCDO->GetWallDistanceOffset();
+	const FVector Forward = Course->GetLaneForward();
+	const FVector Right = FVector::CrossProduct(FVector::UpVector, Forward);
+
+	// 在每面墙的正面随机分布，高度在退出检测的范围之上、Mantle的高度之下
+	const float MinZ = ClimberCDO->GetExitClimbingDetection() + 10.f;
+	const float MaxZ = FMath::Max(CourseSettings.WallHeight - HalfHeight, MinZ);
+	const float HalfWidth = FMath::Max(CourseSettings.WallWidth * 0.5f - ClimberCDO->GetCapsuleComponent()->GetScaledCapsuleRadius(), 0.f);
+	FRandomStream Random(NumMassClimbers);
+
+	TArray<FClimbingMassSpawnRequest> Requests;
+	Requests.SetNum(NumMassClimbers);
+	for (int32 Index = 0; Index < NumMassClimbers; ++Index) {
+		const FVector WallFront = Course->GetLaneStart(Index % Course->GetNumLanes()) + Forward * (Course->GetRunUpLength() - WallOffset);
+		Requests[Index].Location = WallFront + Right * Random.FRandRange(-HalfWidth, HalfWidth) + FVector::UpVector * Random.FRandRange(MinZ, MaxZ);
+		Requests[Index].WallNormal = -Forward;
+	}
+	MassSubsystem->SpawnClimbers(Requests);
+}
+
+void AClimbingBenchmarkGameMode::Tick(float DeltaSeconds) {
+	Super::Tick(DeltaSeconds);
+
+	if (bFinished) {
+		return;
+	}
+
+	UpdateClimbers(DeltaSeconds);
+
+	const double Now = FPlatformTime::Seconds();
+	const double Elapsed = Now - StartTime;
+	if (!bRecording) {
+		if (Elapsed >= WarmupSeconds) {
+			BeginRecording();
+		}
+	} else {
+		RecordFrame(DeltaSeconds);
+	}
+	LastFrameTime = Now;
+
+	if (bRecording && !bCountingAllocs && Elapsed >= WarmupSeconds + DurationSeconds) {
+		// 帧时间记录完了，换上计数的代理单独记录一段分配，装不上的话直接结束
+		BeginCountingAllocs();
+		if (!bCountingAllocs) {
+			FinishRecording();
+		}
+	} else if (bCountingAllocs && Elapsed >= WarmupSeconds + DurationSeconds + AllocDurationSeconds) {
+		FinishRecording();
+	}
+}
+
+void AClimbingBenchmarkGameMode::BeginRecording() {
+	// 预热结束，清掉之前的计数开始记录
+	const UClimbableSurfaceSubsystem* SurfaceSubsystem = GetWorld()->GetSubsystem<UClimbableSurfaceSubsystem>();
+	LastCacheHits = SurfaceSubsystem ? SurfaceSubsystem->GetNumCacheHits() : 0;
+	LastPhysicsTraces = SurfaceSubsystem ? SurfaceSubsystem->GetNumPhysicsTraces() : 0;
+	LastAsyncTraces = SurfaceSubsystem ? SurfaceSubsystem->GetNumAsyncTraces() : 0;
+	StartUsedPhysical = FPlatformMemory::GetStats().UsedPhysical;
+	FMemory::Memzero(TransitionCounts);
+	NumLaps = 0;
+	NumStuckResets = 0;
+	Samples.Reserve(FMath::CeilToInt(DurationSeconds * 120.f));
+	bRecording = true;
+}
+
+void AClimbingBenchmarkGameMode::BeginCountingAllocs() {
+	if (AllocDurationSeconds <= 0.f) {
+		Warnings.Add(TEXT("Allocation counting is disabled (AllocDurationSeconds is 0)"));
+		return;
+	}
+
+	ClimbingBenchmark::FAllocCounter& AllocCounter = ClimbingBenchmark::FAllocCounter::Get();
+	if (!AllocCounter.Install()) {
+		Warnings.Add(TEXT("Allocations were not counted: GMalloc can't be replaced on this platform, use -trace=memory and Insights instead"));
+		return;
+	}
+
+	bAllocsCounted = true;
+	bCountingAllocs = true;
+	LastAllocs = AllocCounter.GetNumAllocs();
+	LastAllocBytes = AllocCounter.GetNumBytes();
+	AllocSamples.Reserve(FMath::CeilToInt(AllocDurationSeconds * 120.f));
+}
+
+void AClimbingBenchmarkGameMode::FinishRecording() {
+	ClimbingBenchmark::FAllocCounter::Get().Uninstall();
+	bCountingAllocs = false;
+	WriteResults();
+	bFinished = true;
+	if (bQuitWhenFinished) {
+		// 退化时用非0的返回值退出，CI直接看进程的返回值
+		FPlatformMisc::RequestExitWithStatus(false, Regressions.Num() > 0 ? 1 : 0);
+	}
+}
+
+void AClimbingBenchmarkGameMode::OnCharacterMovementModeChanged(AClimbingSystemCharacter* Character, ECharacterMovementMode PreviousMode, ECharacterMovementMode NewMode) {
+	if (bRecording && !bFinished) {
+		++TransitionCounts[PreviousMode][NewMode];
+	}
+}
+
+void AClimbingBenchmarkGameMode::RecordFrame(float DeltaSeconds) {
+	const double Now = FPlatformTime::Seconds();
+	const UClimbableSurfaceSubsystem* SurfaceSubsystem = GetWorld()->GetSubsystem<UClimbableSurfaceSubsystem>();
+	const uint64 CacheHits = SurfaceSubsystem ? SurfaceSubsystem->GetNumCacheHits() : 0;
+	const uint64 PhysicsTraces = SurfaceSubsystem ? SurfaceSubsystem->GetNumPhysicsTraces() : 0;
+	const uint64 AsyncTraces = SurfaceSubsystem ? SurfaceSubsystem->GetNumAsyncTraces() : 0;
+
+	FFrameSample& Sample = (bCountingAllocs ? AllocSamples : Samples).AddDefaulted_GetRef();
+	Sample.Time = Now - StartTime;
+	Sample.FrameMs = float((Now - LastFrameTime) * 1000.0);
+	Sample.DeltaSeconds = DeltaSeconds;
+	Sample.CacheHits = uint32(CacheHits - LastCacheHits);
+	Sample.PhysicsTraces = uint32(PhysicsTraces - LastPhysicsTraces);
+	Sample.AsyncTraces = uint32(AsyncTraces - LastAsyncTraces);
+	Sample.UsedPhysicalMB = float(double(FPlatformMemory::GetStats().UsedPhysical) / (1024.0 * 1024.0));
+	Sample.Allocs = 0;
+	Sample.AllocKB = 0.f;
+	if (bCountingAllocs) {
+		const ClimbingBenchmark::FAllocCounter& AllocCounter = ClimbingBenchmark::FAllocCounter::Get();
+		const uint64 Allocs = AllocCounter.GetNumAllocs();
+		const uint64 AllocBytes = AllocCounter.GetNumBytes();
+		Sample.Allocs = uint32(Allocs - LastAllocs);
+		Sample.AllocKB = float(double(AllocBytes - LastAllocBytes) / 1024.0);
+		LastAllocs = Allocs;
+		LastAllocBytes = AllocBytes;
+	}
+	FMemory::Memzero(Sample.NumPerMode);
+	for (const FScriptedClimber& Climber : Climbers) {
+		if (const AClimbingSystemCharacter* Character = Climber.Character.Get()) {
+			++Sample.NumPerMode[Character->GetCharacterMovementMode()];
+		}
+	}
+
+	LastCacheHits = CacheHits;
+	LastPhysicsTraces = PhysicsTraces;
+	LastAsyncTraces = AsyncTraces;
+}
+
+void AClimbingBenchmarkGameMode::WriteResults() {
+	if (Samples.Num() == 0) {
+		UE_LOG(LogClimbing, Warning, TEXT("Climbing benchmark finished without any recorded frames"));
+		Regressions.Add(TEXT("No frames were recorded"));
+		return;
+	}
+
+	const FString BaseName = FPaths::ProfilingDir() / TEXT("Climbing") / FString::Printf(TEXT("ClimbingBenchmark-%d-%s"), Climbers.Num(), *FDateTime::Now().ToString());
+
+	// 1. 每帧的数据，Phase是0的帧记录帧时间，1的帧计数内存分配
+	FString Csv = TEXT("Phase,Time,FrameMs,DeltaSeconds,CacheHits,PhysicsTraces,AsyncTraces,Allocs,AllocKB,UsedPhysicalMB,Walking,Climbing,Jumping\n");
+	for (int32 Phase = 0; Phase < 2; ++Phase) {
+		for (const FFrameSample& Sample : Phase == 0 ? Samples : AllocSamples) {
+			Csv += FString::Printf(TEXT("%d,%.4f,%.3f,%.4f,%u,%u,%u,%u,%.1f,%.1f,%u,%u,%u\n"),
+				Phase, Sample.Time, Sample.FrameMs, Sample.DeltaSeconds, Sample.CacheHits, Sample.PhysicsTraces, Sample.AsyncTraces, Sample.Allocs, Sample.AllocKB, Sample.UsedPhysicalMB,
+				Sample.NumPerMode[Walking], Sample.NumPerMode[Climbing], Sample.NumPerMode[Jumping]);
+		}
+	}
+
+	// 2. 汇总
+	TArray<float> FrameMs;
+	FrameMs.Reserve(Samples.Num());
+	uint64 TotalCacheHits = 0, TotalPhysicsTraces = 0, TotalAsyncTraces = 0;
+	float PeakUsedPhysicalMB = 0.f;
+	for (const FFrameSample& Sample : Samples) {
+		FrameMs.Add(Sample.FrameMs);
+		TotalCacheHits += Sample.CacheHits;
+		TotalPhysicsTraces += Sample.PhysicsTraces;
+		TotalAsyncTraces += Sample.AsyncTraces;
+		PeakUsedPhysicalMB = FMath::Max(PeakUsedPhysicalMB, Sample.UsedPhysicalMB);
+	}
+	FrameMs.Sort();
+
+	TArray<float> FrameAllocs;
+	FrameAllocs.Reserve(AllocSamples.Num());
+	uint64 TotalAllocs = 0;
+	double TotalAllocKB = 0.0;
+	for (const FFrameSample& Sample : AllocSamples) {
+		FrameAllocs.Add(float(Sample.Allocs));
+		TotalAllocs += Sample.Allocs;
+		TotalAllocKB += Sample.AllocKB;
+	}
+	FrameAllocs.Sort();
+	const double NumAllocFrames = double(FMath::Max(AllocSamples.Num(), 1));
+
+	double SumFrameMs = 0.0;
+	for (const float Ms : FrameMs) {
+		SumFrameMs += Ms;
+	}
+	const double NumFrames = double(Samples.Num());
+
+	TSharedRef<FJsonObject> Summary = MakeShared<FJsonObject>();
+	Summary->SetNumberField(TEXT("Climbers"), Climbers.Num());
+	Summary->SetNumberField(TEXT("MassClimbers"), NumMassClimbers);
+	Summary->SetNumberField(TEXT("Frames"), Samples.Num());
+	Summary->SetNumberField(TEXT("DurationSeconds"), Samples.Last().Time - Samples[0].Time);
+
+	TSharedRef<FJsonObject> FrameTime = MakeShared<FJsonObject>();
+	FrameTime->SetNumberField(TEXT("Avg"), SumFrameMs / NumFrames);
+	FrameTime->SetNumberField(TEXT("P50"), Percentile(FrameMs, 50.f));
+	FrameTime->SetNumberField(TEXT("P95"), Percentile(FrameMs, 95.f));
+	FrameTime->SetNumberField(TEXT("P99"), Percentile(FrameMs, 99.f));
+	FrameTime->SetNumberField(TEXT("Max"), FrameMs.Last());
+	Summary->SetObjectField(TEXT("FrameMs"), FrameTime);
+
+	TSharedRef<FJsonObject> Traces = MakeShared<FJsonObject>();
+	Traces->SetNumberField(TEXT("CacheHitsPerFrame"), double(TotalCacheHits) / NumFrames);
+	Traces->SetNumberField(TEXT("PhysicsTracesPerFrame"), double(TotalPhysicsTraces) / NumFrames);
+	Traces->SetNumberField(TEXT("AsyncTracesPerFrame"), double(TotalAsyncTraces) / NumFrames);
+	Summary->SetObjectField(TEXT("Traces"), Traces);
+
+	// 只在计数的那一段GMalloc换成了代理，包括所有线程的分配，不只是攀爬代码
+	// 没有计数时只写Counted=false，不写0，免得被当成没有分配；每次分配的调用栈需要-trace=memory用Insights看
+	TSharedRef<FJsonObject> Allocations = MakeShared<FJsonObject>();
+	Allocations->SetBoolField(TEXT("Counted"), bAllocsCounted);
+	if (bAllocsCounted && AllocSamples.Num() > 0) {
+		Allocations->SetNumberField(TEXT("Frames"), AllocSamples.Num());
+		Allocations->SetNumberField(TEXT("Total"), double(TotalAllocs));
+		Allocations->SetNumberField(TEXT("PerFrame"), double(TotalAllocs) / NumAllocFrames);
+		Allocations->SetNumberField(TEXT("P95PerFrame"), Percentile(FrameAllocs, 95.f));
+		Allocations->SetNumberField(TEXT("KBPerFrame"), TotalAllocKB / NumAllocFrames);
+	}
+	Summary->SetObjectField(ClimbingBenchmark::AllocationsObject, Allocations);
+
+	// 整个进程的物理内存占用，看有没有持续增长
+	TSharedRef<FJsonObject> Memory = MakeShared<FJsonObject>();
+	Memory->SetNumberField(TEXT("StartUsedPhysicalMB"), double(StartUsedPhysical) / (1024.0 * 1024.0));
+	Memory->SetNumberField(TEXT("EndUsedPhysicalMB"), Samples.Last().UsedPhysicalMB);
+	Memory->SetNumberField(TEXT("PeakUsedPhysicalMB"), PeakUsedPhysicalMB);
+	Summary->SetObjectField(TEXT("Memory"), Memory);
+
+	const UEnum* ModeEnum = StaticEnum<ECharacterMovementMode>();
+	TSharedRef<FJsonObject> Transitions = MakeShared<FJsonObject>();
+	for (int32 From = 0; From < 3; ++From) {
+		for (int32 To = 0; To < 3; ++To) {
+			if (TransitionCounts[From][To] > 0) {
+				Transitions->SetNumberField(ModeEnum->GetNameStringByValue(From) + TEXT("->") + ModeEnum->GetNameStringByValue(To), TransitionCounts[From][To]);
+			}
+		}
+	}
+	Summary->SetObjectField(TEXT("Transitions"), Transitions);
+	Summary->SetNumberField(TEXT("Laps"), NumLaps);
+	Summary->SetNumberField(TEXT("StuckResets"), NumStuckResets);
+
+	CheckBaseline(*Summary);
+	for (const FString& Warning : Warnings) {
+		UE_LOG(LogClimbing, Warning, TEXT("Climbing benchmark: %s"), *Warning);
+	}
+	for (const FString& Regression : Regressions) {
+		UE_LOG(LogClimbing, Error, TEXT("Climbing benchmark: %s"), *Regression);
+	}
+	Summary->SetNumberField(TEXT("Regressions"), Regressions.Num());
+
+	FString Json;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Summary, Writer);
+
+	const bool bWroteCsv = FFileHelper::SaveStringToFile(Csv, *(BaseName + TEXT(".csv")));
+	const bool bWroteJson = FFileHelper::SaveStringToFile(Json, *(BaseName + TEXT(".json")));
+	if (!bWroteCsv || !bWroteJson) {
+		UE_LOG(LogClimbing, Error, TEXT("Failed to write climbing benchmark results to '%s'"), *BaseName);
+		return;
+	}
+
+	UE_LOG(LogClimbing, Display, TEXT("Climbing benchmark: %d frames, avg %.2fms, p95 %.2fms, %s allocs/frame, %d laps, results in '%s'"),
+		Samples.Num(), SumFrameMs / NumFrames, Percentile(FrameMs, 95.f), bAllocsCounted ? *FString::SanitizeFloat(double(TotalAllocs) / NumAllocFrames, 1) : TEXT("uncounted"), NumLaps, *BaseName);
+}
+
+void AClimbingBenchmarkGameMode::CheckBaseline(const FJsonObject& Summary) {
+	Regressions.Reset();
+	if (NumLaps == 0) {
+		Regressions.Add(TEXT("No climber finished a lap"));
+	}
+
+	const FString Filename = FPaths::IsRelative(BaselineFile) ? FPaths::ProjectDir() / BaselineFile : BaselineFile;
+	FString BaselineJson;
+	if (BaselineFile.IsEmpty() || !FFileHelper::LoadFileToString(BaselineJson, *Filename)) {
+		UE_LOG(LogClimbing, Display, TEXT("Climbing benchmark: no baseline at '%s', skipping the regression check"), *Filename);
+		return;
+	}
+
+	TSharedPtr<FJsonObject> Baseline;
+	if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(BaselineJson), Baseline) || !Baseline.IsValid()) {
+		Regressions.Add(FString::Printf(TEXT("Baseline '%s' is not valid JSON"), *Filename));
+		return;
+	}
+
+	// 角色数量不同的结果没法比
+	double BaselineClimbers = 0.0;
+	if (!Baseline->TryGetNumberField(TEXT("Climbers"), BaselineClimbers) || int32(BaselineClimbers) != Climbers.Num()) {
+		UE_LOG(LogClimbing, Warning, TEXT("Climbing benchmark: baseline '%s' was recorded with %d climbers, this run has %d, skipping the regression check"),
+			*Filename, int32(BaselineClimbers), Climbers.Num());
+		return;
+	}
+
+	// 分配次数两边都数了才比较；基准数了这次没数算退化，不能因为没数就通过
+	const TSharedPtr<FJsonObject>* BaselineAllocations = nullptr;
+	bool bBaselineAllocsCounted = false;
+	if (Baseline->TryGetObjectField(ClimbingBenchmark::AllocationsObject, BaselineAllocations)) {
+		(*BaselineAllocations)->TryGetBoolField(TEXT("Counted"), bBaselineAllocsCounted);
+	}
+	if (bBaselineAllocsCounted && !bAllocsCounted) {
+		Regressions.Add(FString::Printf(TEXT("Baseline '%s' has allocation counts but this run could not count allocations"), *Filename));
+	}
+
+	for (const ClimbingBenchmark::FBaselineMetric& Metric : ClimbingBenchmark::BaselineMetrics) {
+		if (FCString::Strcmp(Metric.Object, ClimbingBenchmark::AllocationsObject) == 0 && !(bBaselineAllocsCounted && bAllocsCounted)) {
+			continue;
+		}
+
+		const TSharedPtr<FJsonObject>* BaselineObject = nullptr;
+		const TSharedPtr<FJsonObject>* CurrentObject = nullptr;
+		double BaselineValue = 0.0, CurrentValue = 0.0;
+		if (!Baseline->TryGetObjectField(Metric.Object, BaselineObject) || !(*BaselineObject)->TryGetNumberField(Metric.Field, BaselineValue)
+			|| !Summary.TryGetObjectField(Metric.Object, CurrentObject) || !(*CurrentObject)->TryGetNumberField(Metric.Field, CurrentValue)) {
+			continue;
+		}
+
+		const double Limit = BaselineValue + FMath::Max(BaselineValue * RegressionTolerance, Metric.MinSlack);
+		if (CurrentValue > Limit) {
+			Regressions.Add(FString::Printf(TEXT("%s.%s regressed: %.3f vs baseline %.3f (limit %.3f)"), Metric.Object, Metric.Field, CurrentValue, BaselineValue, Limit));
+		}
+	}
+
+	if (Regressions.Num() == 0) {
+		UE_LOG(LogClimbing, Display, TEXT("Climbing benchmark: within %.0f%% of baseline '%s'"), RegressionTolerance * 100.f, *Filename);
+	}
+}
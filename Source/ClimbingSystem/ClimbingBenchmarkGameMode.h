@@ -0,0 +1,113 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ClimbingScriptedGameMode.h"
+#include "ClimbingBenchmarkGameMode.generated.h"
+
+class FJsonObject;
+
+/**
+ * 攀爬的性能基准测试，可以在Linux上用-nullrhi无头运行:
+ *   ClimbingSystem <AnyMap>?game=/Script/ClimbingSystem.ClimbingBenchmarkGameMode -nullrhi -nosound -unattended -benchmark -fps=60
+ *     [-ClimbingBenchmarkClimbers=64 -ClimbingBenchmarkWarmup=2 -ClimbingBenchmarkDuration=30 -ClimbingBenchmarkAllocDuration=5 -ClimbingBenchmarkMassClimbers=2000]
+ *     [-ClimbingBenchmarkBaseline=Build/ClimbingBenchmarkBaseline.json -ClimbingBenchmarkTolerance=0.15]
+ *
+ * 场地和角色的脚本见AClimbingScriptedGameMode，这里的角色总是笔直地走向墙、一直往上爬到Mantle
+ * 记录分两段: 先不做任何插桩记录帧时间和检测次数，再把GMalloc换成计数的代理单独记录一段内存分配，代理的开销不算进帧时间
+ * 平台不允许替换GMalloc时跳过第二段并给出警告，基准里有分配次数的话算作退化，不会因为没数就通过
+ * 结束后把每帧的数据写到Saved/Profiling/Climbing/下的CSV，汇总写到同名的JSON，然后退出
+ * 有基准JSON(之前某次的汇总)时和它比较，帧时间、检测次数或者内存分配次数超出容差就算退化，进程以返回值1退出
+ * 自动化测试ClimbingSystem.Benchmark.NoRegression用同样的比较
+ */
+UCLASS(config=Game)
+class AClimbingBenchmarkGameMode : public AClimbingScriptedGameMode
+{
+	GENERATED_BODY()
+
+public:
+	AClimbingBenchmarkGameMode();
+
+	virtual void StartPlay() override;
+	virtual void Tick(float DeltaSeconds) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	bool IsFinished() const { return bFinished; }
+	uint32 GetNumLaps() const { return NumLaps; }
+	void SetQuitWhenFinished(bool bQuit) { bQuitWhenFinished = bQuit; }
+
+	// 和基准比较时超出容差的指标，每项一句说明，没有基准时为空
+	const TArray<FString>& GetRegressions() const { return Regressions; }
+
+	// 不算退化但是结果不完整的地方，比如内存分配没有计数
+	const TArray<FString>& GetWarnings() const { return Warnings; }
+
+protected:
+	UPROPERTY(EditAnywhere, Config, Category = Benchmark, meta = (ClampMin = "0"))
+	int32 NumMassClimbers;			// 额外在墙上生成的Mass攀爬者，平均分到每条赛道的墙上
+
+	UPROPERTY(EditAnywhere, Config, Category = Benchmark, meta = (ClampMin = "0", ForceUnits = "s"))
+	float WarmupSeconds;			// 这段时间内不记录数据
+
+	UPROPERTY(EditAnywhere, Config, Category = Benchmark, meta = (ClampMin = "0", ForceUnits = "s"))
+	float DurationSeconds;			// 记录帧时间的时长
+
+	UPROPERTY(EditAnywhere, Config, Category = Benchmark, meta = (ClampMin = "0", ForceUnits = "s"))
+	float AllocDurationSeconds;		// 帧时间记录完之后单独计数内存分配的时长，0表示不计数
+
+	UPROPERTY(EditAnywhere, Config, Category = Benchmark)
+	FString BaselineFile;			// 相对于项目目录，文件不存在时跳过比较
+
+	UPROPERTY(EditAnywhere, Config, Category = Benchmark, meta = (ClampMin = "0"))
+	float RegressionTolerance;		// 允许比基准差的比例
+
+	virtual void ReadCommandLine(const TCHAR* CommandLine) override;
+	virtual void OnClimberSpawned(FScriptedClimber& Climber) override;
+
+private:
+	struct FFrameSample {
+		double Time;
+		float FrameMs;
+		float DeltaSeconds;
+		uint32 CacheHits;
+		uint32 PhysicsTraces;
+		uint32 AsyncTraces;
+		float UsedPhysicalMB;			// 整个进程的物理内存，不是分配次数
+		uint32 Allocs;					// 这一帧所有线程的Malloc/Realloc次数，只在计数分配的那一段有
+		float AllocKB;					// 这一帧申请的字节数
+		uint16 NumPerMode[3];
+	};
+
+	void SpawnMassClimbers();
+	void BeginRecording();
+	void BeginCountingAllocs();
+	void FinishRecording();
+	void RecordFrame(float DeltaSeconds);
+	void WriteResults();
+	void CheckBaseline(const FJsonObject& Summary);
+
+	void OnCharacterMovementModeChanged(AClimbingSystemCharacter* Character, ECharacterMovementMode PreviousMode, ECharacterMovementMode NewMode);
+
+	TArray<FFrameSample> Samples;			// 记录帧时间的那一段
+	TArray<FFrameSample> AllocSamples;		// 计数内存分配的那一段，帧时间受代理影响，不参与汇总
+
+	// 各状态之间的切换次数，[之前的状态][新的状态]
+	uint32 TransitionCounts[3][3];
+
+	double StartTime;
+	double LastFrameTime;
+	uint64 LastCacheHits;
+	uint64 LastPhysicsTraces;
+	uint64 LastAsyncTraces;
+	uint64 LastAllocs;
+	uint64 LastAllocBytes;
+	uint64 StartUsedPhysical;
+	bool bRecording;
+	bool bCountingAllocs;
+	bool bAllocsCounted;		// GMalloc成功换成了计数的代理
+	bool bFinished;
+
+	TArray<FString> Regressions;
+	TArray<FString> Warnings;
+};
@@ -0,0 +1,224 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingCrowdSubsystem.h"
+#include "Async/ParallelFor.h"
+#include "ClimbableSurfaceSubsystem.h"
+#include "ClimbingMathKernels.h"
+#include "ClimbingMovementComponent.h"
+#include "ClimbingStats.h"
+#include "ClimbingSystem.h"
+#include "ClimbingSystemCharacter.h"
+#include "Engine/World.h"
+
+static TAutoConsoleVariable<int32> CVarClimbingCrowd(
+	TEXT("Climbing.Crowd"),
+	1,
+	TEXT("哪些攀爬中的角色交给UClimbingCrowdSubsystem批量处理\n")
+	TEXT("0: 不使用，每个角色自己检测\n")
+	TEXT("1: 只处理AI控制的角色 (默认)\n")
+	TEXT("2: 所有角色"),
+	ECVF_Default);
+
+void UClimbingCrowdSubsystem::RegisterClimber(AClimbingSystemCharacter* Climber) {
+	Climbers.AddUnique(Climber);
+}
+
+void UClimbingCrowdSubsystem::UnregisterClimber(AClimbingSystemCharacter* Climber) {
+	Climbers.RemoveSwap(Climber);
+	Climber->SetManagedByClimbingCrowd(false);
+}
+
+bool UClimbingCrowdSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UClimbingCrowdSubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UClimbingCrowdSubsystem, STATGROUP_Tickables);
+}
+
+void UClimbingCrowdSubsystem::Tick(float DeltaTime) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingCrowdTick);
+	Super::Tick(DeltaTime);
+
+	ResolvePendingProbes();
+	if (ActiveClimbers.Num() > 0) {
+		EvaluateProbes();
+		WriteBackResults();
+	}
+	SubmitProbes();
+}
+
+void UClimbingCrowdSubsystem::ResolvePendingProbes() {
+	ActiveClimbers.Reset();
+	SurfaceProbed.Reset();
+	SurfaceHits.Reset();
+	FloorHits.Reset();
+	HitLocations.Reset();
+	for (TArray<float>* Array : { &NormalX, &NormalY, &NormalZ, &ActorUpZ, &SnapDistances }) {
+		Array->Reset();
+	}
+	HitComponents.Reset();
+
+	const UWorld* World = GetWorld();
+	FHitResult Hit;
+	for (const FPendingClimber& Pending : PendingClimbers) {
+		// 提交之后退出了攀爬、进了过渡动作或者不再由这里管理的，结果丢掉
+		AClimbingSystemCharacter* Climber = Pending.Climber.Get();
+		if (!Climber || !Climber->IsManagedByClimbingCrowd() || !Climber->IsClimbing()) {
+			continue;
+		}
+		UClimbingMovementComponent* ClimbingMovement = Climber->GetClimbingMovement();
+		if (ClimbingMovement->IsInClimbTransition()) {
+			continue;
+		}
+
+		// 格子的结果交回给角色自己的Sampler，网格在这期间重建过的话Sampler自己会丢掉
+		bool bHit = false;
+		for (int32 ProbeIndex = Pending.FirstProbe; ProbeIndex < Pending.FirstProbe + Pending.NumProbes; ++ProbeIndex) {
+			const FPendingProbe& Probe = PendingProbes[ProbeIndex];
+			if (UClimbableSurfaceSubsystem::ResolveAsyncLineTraceClimbing(World, Probe.Trace, Hit, bHit)) {
+				ClimbingMovement->ApplyDeferredClimbSurfaceProbe(Probe.Request, bHit ? &Hit : nullptr);
+			}
+		}
+
+		bool bFloorHit = false;
+		if (!UClimbableSurfaceSubsystem::ResolveAsyncLineTraceClimbing(World, Pending.FloorTrace, Hit, bFloorHit)) {
+			bFloorHit = false;
+		}
+
+		// 墙面检测没到期的角色只做退出检测，墙面沿用它自己缓存的结果
+		FVector Location = FVector::ZeroVector;
+		FVector Normal = FVector::ZeroVector;
+		const UPrimitiveComponent* Component = nullptr;
+		const bool bSurfaceHit = Pending.bProbedSurface && ClimbingMovement->FinishDeferredClimbSurfaceSample(Location, Normal, Component);
+
+		ActiveClimbers.Add(Climber);
+		SurfaceProbed.Add(Pending.bProbedSurface);
+		SurfaceHits.Add(bSurfaceHit);
+		FloorHits.Add(bFloorHit);
+		HitLocations.Add(Location);
+		NormalX.Add(Normal.X);
+		NormalY.Add(Normal.Y);
+		NormalZ.Add(Normal.Z);
+		HitComponents.Add(Component);
+		ActorUpZ.Add(Climber->GetActorUpVector().Z);
+		SnapDistances.Add(ClimbingMovement->ClimbWallDistance);
+	}
+
+	PendingClimbers.Reset();
+	PendingProbes.Reset();
+}
+
+void UClimbingCrowdSubsystem::EvaluateProbes() {
+	const int32 NumClimbers = ActiveClimbers.Num();
+	for (TArray<float>* Array : { &RightX, &RightY, &RightZ, &UpX, &UpY, &UpZ }) {
+		Array->SetNumUninitialized(NumClimbers);
+	}
+	SnapTargets.SetNumUninitialized(NumClimbers);
+	TargetRotations.SetNumUninitialized(NumClimbers);
+	ShouldExit.SetNumUninitialized(NumClimbers);
+
+	// 这里只有纯计算，不访问任何UObject，按块交给ClimbingMath的批量函数
+	// 贴墙目标是位置，直接用double算，不经过float的SoA
+	constexpr int32 BatchSize = 64;
+	const int32 NumBatches = FMath::DivideAndRoundUp(NumClimbers, BatchSize);
+	ParallelFor(TEXT("ClimbingCrowd.Evaluate"), NumBatches, 1, [this, NumClimbers](int32 BatchIndex) {
+		const int32 First = BatchIndex * BatchSize;
+		const int32 Count = FMath::Min(BatchSize, NumClimbers - First);
+
+		ClimbingMath::TangentBasisBatch(
+			&NormalX[First], &NormalY[First], &NormalZ[First],
+			&RightX[First], &RightY[First], &RightZ[First],
+			&UpX[First], &UpY[First], &UpZ[First], Count);
+
+		// 和DetectShouldExitClimbing一样: 身体倾斜超过30度，或者脚下有地面
+		ClimbingMath::ExitTiltBatch(&ActorUpZ[First], ClimbingMath::ExitTiltCos, &ShouldExit[First], Count);
+		for (int32 Index = First; Index < First + Count; ++Index) {
+			const FVector Normal(NormalX[Index], NormalY[Index], NormalZ[Index]);
+			ShouldExit[Index] |= FloorHits[Index];
+			SnapTargets[Index] = HitLocations[Index] + Normal * SnapDistances[Index];
+			TargetRotations[Index] = FRotationMatrix::MakeFromX(-Normal).Rotator();
+		}
+	});
+}
+
+void UClimbingCrowdSubsystem::WriteBackResults() {
+	for (int32 Index = 0; Index < ActiveClimbers.Num(); ++Index) {
+		AClimbingSystemCharacter* Climber = ActiveClimbers[Index];
+		if (ShouldExit[Index]) {
+			Climber->ExitClimbing();
+			continue;
+		}
+		if (!SurfaceProbed[Index]) {
+			continue;
+		}
+
+		FClimbSurfaceSample Sample;
+		Sample.bValid = SurfaceHits[Index] != 0;
+		if (Sample.bValid) {
+			Sample.Location = HitLocations[Index];
+			Sample.Normal = FVector(NormalX[Index], NormalY[Index], NormalZ[Index]);
+			Sample.RightTangent = FVector(RightX[Index], RightY[Index], RightZ[Index]);
+			Sample.UpTangent = FVector(UpX[Index], UpY[Index], UpZ[Index]);
+			Sample.SnapTarget = SnapTargets[Index];
+			Sample.Rotation = TargetRotations[Index];
+			Sample.Component = HitComponents[Index];
+		}
+		Climber->GetClimbingMovement()->SetPrecomputedClimbSurface(Sample);
+	}
+}
+
+void UClimbingCrowdSubsystem::SubmitProbes() {
+	const int32 CrowdMode = CVarClimbingCrowd.GetValueOnGameThread();
+	UWorld* World = GetWorld();
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(ClimbingCrowd), false);
+
+	for (int32 Index = Climbers.Num() - 1; Index >= 0; --Index) {
+		AClimbingSystemCharacter* Climber = Climbers[Index].Get();
+		if (!Climber) {
+			Climbers.RemoveAtSwap(Index);
+			continue;
+		}
+
+		const bool bManaged = CrowdMode == 2 || (CrowdMode == 1 && !Climber->IsPlayerControlled());
+		Climber->SetManagedByClimbingCrowd(bManaged);
+		if (!bManaged || !Climber->IsClimbing()) {
+			continue;
+		}
+
+		// 模拟端不跑PhysClimbing，墙面来自同步的FClimbingNetState
+		if (Climber->GetLocalRole() == ROLE_SimulatedProxy) {
+			continue;
+		}
+
+		// Enter和Mantle的过渡中不需要墙面，也不做退出检测
+		UClimbingMovementComponent* ClimbingMovement = Climber->GetClimbingMovement();
+		if (ClimbingMovement->IsInClimbTransition()) {
+			continue;
+		}
+
+		Params.ClearIgnoredActors();
+		Params.AddIgnoredActor(Climber);
+
+		// 所有角色的检测在同一帧连续提交，引擎会把它们放在同一批里处理；大部分墙面检测会被表面缓存直接挡掉
+		FPendingClimber& Pending = PendingClimbers.AddDefaulted_GetRef();
+		Pending.Climber = Climber;
+		Pending.FirstProbe = PendingProbes.Num();
+
+		// 按LOD降低了检测频率的角色，这一帧沿用自己缓存的墙面，只提交下面的地面检测
+		ProbeRequests.Reset();
+		Pending.bProbedSurface = ClimbingMovement->IsClimbSurfaceProbeDue();
+		if (Pending.bProbedSurface) {
+			ClimbingMovement->BeginDeferredClimbSurfaceSample(ProbeRequests);
+		}
+		for (const FClimbSurfaceSampler::FProbeRequest& Request : ProbeRequests) {
+			FPendingProbe& Probe = PendingProbes.AddDefaulted_GetRef();
+			Probe.Request = Request;
+			UClimbableSurfaceSubsystem::AsyncLineTraceClimbing(World, Probe.Trace, Request.Start, Request.End, ECC_Climbable, Params);
+		}
+		Pending.NumProbes = ProbeRequests.Num();
+
+		const FVector Location = Climber->GetActorLocation();
+		UClimbableSurfaceSubsystem::AsyncLineTraceClimbing(World, Pending.FloorTrace, Location, Location - Climber->GetActorUpVector() * Climber->GetExitClimbingDetection(), ECC_Visibility, Params);
+	}
+}
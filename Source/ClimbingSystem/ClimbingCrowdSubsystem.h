@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ClimbableSurfaceSubsystem.h"
+#include "ClimbingSurfaceSampler.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ClimbingCrowdSubsystem.generated.h"
+
+class AClimbingSystemCharacter;
+class UPrimitiveComponent;
+
+/**
+ * 把所有正在攀爬的角色的检测集中到一起批量处理
+ * 1. 上一帧提交的异步检测这一帧取回来，交给每个角色自己的FClimbSurfaceSampler拟合墙面
+ * 2. 切线、退出角度这些纯计算放到ParallelFor里
+ * 3. 一次性把结果写回给每个角色，下一帧的PhysClimbing直接使用
+ * 4. 收集这一帧要做的检测(墙面模板里要更新的格子和向下的地面检测)，作为一批异步检测一起提交
+ *    按LOD降低了检测频率的角色只在到期的帧检测墙面，地面检测和倾斜判断每帧都做，角色自己不再做退出检测
+ * 检测在提交的下一帧才用，所以墙面比角色自己检测晚一帧；位置都用FVector，只有法线这种方向量用float的SoA
+ */
+UCLASS()
+class UClimbingCrowdSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	void RegisterClimber(AClimbingSystemCharacter* Climber);
+	void UnregisterClimber(AClimbingSystemCharacter* Climber);
+
+	int32 GetNumRegisteredClimbers() const { return Climbers.Num(); }
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void ResolvePendingProbes();
+	void EvaluateProbes();
+	void WriteBackResults();
+	void SubmitProbes();
+
+	TArray<TWeakObjectPtr<AClimbingSystemCharacter>> Climbers;
+
+	// 上一帧提交的检测，一个角色一个地面检测，加上若干个墙面模板的格子
+	struct FPendingClimber {
+		TWeakObjectPtr<AClimbingSystemCharacter> Climber;
+		FClimbingAsyncTrace FloorTrace;
+		bool bProbedSurface = false;		// 这一帧墙面检测到期，提交了墙面模板的格子
+		int32 FirstProbe = 0;
+		int32 NumProbes = 0;
+	};
+	struct FPendingProbe {
+		FClimbSurfaceSampler::FProbeRequest Request;
+		FClimbingAsyncTrace Trace;
+	};
+	TArray<FPendingClimber> PendingClimbers;
+	TArray<FPendingProbe> PendingProbes;
+	TArray<FClimbSurfaceSampler::FProbeRequest> ProbeRequests;
+
+	// 本帧拿到检测结果的角色，下面的数组都和它一一对应
+	TArray<AClimbingSystemCharacter*> ActiveClimbers;
+
+	// 检测结果
+	TArray<uint8> SurfaceProbed;
+	TArray<uint8> SurfaceHits;
+	TArray<uint8> FloorHits;
+	TArray<FVector> HitLocations;
+	TArray<float> NormalX, NormalY, NormalZ;
+	TArray<TWeakObjectPtr<const UPrimitiveComponent>> HitComponents;
+	TArray<float> ActorUpZ;
+	TArray<float> SnapDistances;
+
+	// 计算的结果
+	TArray<float> RightX, RightY, RightZ;
+	TArray<float> UpX, UpY, UpZ;
+	TArray<FVector> SnapTargets;
+	TArray<FRotator> TargetRotations;
+	TArray<uint8> ShouldExit;
+};
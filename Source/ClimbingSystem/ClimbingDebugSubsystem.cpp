@@ -0,0 +1,133 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingDebugSubsystem.h"
+#include "DrawDebugHelpers.h"
+#include "Engine/World.h"
+
+#if ENABLE_DRAW_DEBUG
+
+static TAutoConsoleVariable<int32> CVarClimbingDebug(
+	TEXT("Climbing.Debug"),
+	0,
+	TEXT("画出攀爬的检测线、命中点、墙面切线和Mantle目标\n")
+	TEXT("0: 关闭 (默认)\n")
+	TEXT("1: 打开"),
+	ECVF_Cheat);
+
+static TAutoConsoleVariable<float> CVarClimbingDebugDuration(
+	TEXT("Climbing.Debug.Duration"),
+	0.5f,
+	TEXT("记录下来的调试图元保留多少秒"),
+	ECVF_Cheat);
+
+bool UClimbingDebugSubsystem::IsEnabled() {
+	return CVarClimbingDebug.GetValueOnGameThread() != 0;
+}
+
+void UClimbingDebugSubsystem::RecordProbe(const UWorld* World, const FVector& Start, const FVector& End, const FHitResult* Hit) {
+	if (!IsEnabled()) {
+		return;
+	}
+	if (UClimbingDebugSubsystem* Subsystem = World ? World->GetSubsystem<UClimbingDebugSubsystem>() : nullptr) {
+		const bool bHit = Hit && Hit->bBlockingHit;
+		Subsystem->AddPrimitive({ bHit ? EPrimitiveType::ProbeHit : EPrimitiveType::Probe, Start, bHit ? Hit->ImpactPoint : End, End, bHit ? Hit->ImpactNormal : FVector::ZeroVector, World->GetTimeSeconds() });
+	}
+}
+
+void UClimbingDebugSubsystem::RecordSurface(const UWorld* World, const FVector& Location, const FVector& Normal, const FVector& Right, const FVector& Up) {
+	if (!IsEnabled()) {
+		return;
+	}
+	if (UClimbingDebugSubsystem* Subsystem = World ? World->GetSubsystem<UClimbingDebugSubsystem>() : nullptr) {
+		Subsystem->AddPrimitive({ EPrimitiveType::Surface, Location, Normal, Right, Up, World->GetTimeSeconds() });
+	}
+}
+
+void UClimbingDebugSubsystem::RecordMantleTarget(const UWorld* World, const FVector& Location) {
+	if (!IsEnabled()) {
+		return;
+	}
+	if (UClimbingDebugSubsystem* Subsystem = World ? World->GetSubsystem<UClimbingDebugSubsystem>() : nullptr) {
+		Subsystem->AddPrimitive({ EPrimitiveType::MantleTarget, Location, FVector::ZeroVector, FVector::ZeroVector, FVector::ZeroVector, World->GetTimeSeconds() });
+	}
+}
+
+#endif
+
+bool UClimbingDebugSubsystem::ShouldCreateSubsystem(UObject* Outer) const {
+#if ENABLE_DRAW_DEBUG
+	return Super::ShouldCreateSubsystem(Outer);
+#else
+	return false;
+#endif
+}
+
+void UClimbingDebugSubsystem::Initialize(FSubsystemCollectionBase& Collection) {
+	Super::Initialize(Collection);
+
+	// 一次分配好，之后记录时不会再分配内存
+	Primitives.Reserve(Capacity);
+	NextIndex = 0;
+}
+
+bool UClimbingDebugSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UClimbingDebugSubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UClimbingDebugSubsystem, STATGROUP_Tickables);
+}
+
+void UClimbingDebugSubsystem::AddPrimitive(const FPrimitive& Primitive) {
+	if (Primitives.Num() < Capacity) {
+		Primitives.Add(Primitive);
+	} else {
+		Primitives[NextIndex] = Primitive;
+	}
+	NextIndex = (NextIndex + 1) % Capacity;
+}
+
+void UClimbingDebugSubsystem::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+
+#if ENABLE_DRAW_DEBUG
+	if (Primitives.Num() == 0) {
+		return;
+	}
+	if (!IsEnabled()) {
+		Primitives.Reset();
+		NextIndex = 0;
+		return;
+	}
+
+	const UWorld* World = GetWorld();
+	const double MinTime = World->GetTimeSeconds() - CVarClimbingDebugDuration.GetValueOnGameThread();
+
+	// 所有图元只画一帧，下一帧根据保留时间重新画
+	for (const FPrimitive& Primitive : Primitives) {
+		if (Primitive.WorldTime < MinTime) {
+			continue;
+		}
+
+		switch (Primitive.Type) {
+		case EPrimitiveType::Probe:
+			DrawDebugLine(World, Primitive.A, Primitive.B, FColor::Red);
+			break;
+		case EPrimitiveType::ProbeHit:
+			DrawDebugLine(World, Primitive.A, Primitive.B, FColor::Green);
+			DrawDebugLine(World, Primitive.B, Primitive.C, FColor::Red);
+			DrawDebugPoint(World, Primitive.B, 8.f, FColor::Green);
+			DrawDebugLine(World, Primitive.B, Primitive.B + Primitive.D * 20.f, FColor::Yellow);
+			break;
+		case EPrimitiveType::Surface:
+			DrawDebugDirectionalArrow(World, Primitive.A, Primitive.A + Primitive.B * 40.f, 10.f, FColor::Yellow);
+			DrawDebugDirectionalArrow(World, Primitive.A, Primitive.A + Primitive.C * 40.f, 10.f, FColor::Red);
+			DrawDebugDirectionalArrow(World, Primitive.A, Primitive.A + Primitive.D * 40.f, 10.f, FColor::Blue);
+			break;
+		case EPrimitiveType::MantleTarget:
+			DrawDebugSphere(World, Primitive.A, 15.f, 8, FColor::Cyan);
+			break;
+		}
+	}
+#endif
+}
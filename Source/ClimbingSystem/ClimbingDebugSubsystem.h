@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "EngineDefines.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ClimbingDebugSubsystem.generated.h"
+
+/**
+ * 攀爬的调试可视化: 检测线、命中点、墙面切线和Mantle目标记录到一个固定容量的环形缓冲里，每帧用DrawDebugHelpers画出来
+ * Climbing.Debug为0时记录函数只读一次CVar就返回，Shipping(没有ENABLE_DRAW_DEBUG)下记录的宏直接为空，Subsystem也不会创建
+ */
+UCLASS()
+class UClimbingDebugSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+#if ENABLE_DRAW_DEBUG
+	static bool IsEnabled();
+
+	// 一条检测线，Hit为空或者没有命中时整条画成红色
+	static void RecordProbe(const UWorld* World, const FVector& Start, const FVector& End, const FHitResult* Hit);
+
+	// 攀爬时使用的墙面: 位置、法线和两条切线
+	static void RecordSurface(const UWorld* World, const FVector& Location, const FVector& Normal, const FVector& Right, const FVector& Up);
+
+	static void RecordMantleTarget(const UWorld* World, const FVector& Location);
+#endif
+
+	// USubsystem interface
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	enum class EPrimitiveType : uint8 {
+		Probe,
+		ProbeHit,
+		Surface,
+		MantleTarget,
+	};
+
+	struct FPrimitive {
+		EPrimitiveType Type;
+		FVector A;			// Probe: 起点和终点(命中时B是命中点)，Surface: 位置和法线，MantleTarget: 位置
+		FVector B;
+		FVector C;			// Surface: 向右和向上的切线，ProbeHit: 检测线的终点
+		FVector D;
+		double WorldTime;
+	};
+
+	void AddPrimitive(const FPrimitive& Primitive);
+
+	static constexpr int32 Capacity = 2048;
+	TArray<FPrimitive> Primitives;		// 环形缓冲，满了之后覆盖最旧的
+	int32 NextIndex = 0;
+};
+
+#if ENABLE_DRAW_DEBUG
+	#define CLIMBING_DEBUG_PROBE(World, Start, End, Hit) UClimbingDebugSubsystem::RecordProbe(World, Start, End, Hit)
+	#define CLIMBING_DEBUG_SURFACE(World, Location, Normal, Right, Up) UClimbingDebugSubsystem::RecordSurface(World, Location, Normal, Right, Up)
+	#define CLIMBING_DEBUG_MANTLE_TARGET(World, Location) UClimbingDebugSubsystem::RecordMantleTarget(World, Location)
+#else
+	#define CLIMBING_DEBUG_PROBE(World, Start, End, Hit)
+	#define CLIMBING_DEBUG_SURFACE(World, Location, Normal, Right, Up)
+	#define CLIMBING_DEBUG_MANTLE_TARGET(World, Location)
+#endif
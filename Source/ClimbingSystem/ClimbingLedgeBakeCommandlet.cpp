@@ -0,0 +1,171 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingLedgeBakeCommandlet.h"
+#include "ClimbableSurfaceSubsystem.h"
+#include "ClimbingLedgeGraph.h"
+#include "ClimbingSystem.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+#include "UObject/SavePackage.h"
+
+UClimbingLedgeBakeCommandlet::UClimbingLedgeBakeCommandlet() {
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UClimbingLedgeBakeCommandlet::Main(const FString& Params) {
+#if WITH_EDITOR
+	FString Maps;
+	if (!FParse::Value(*Params, TEXT("Map="), Maps, false)) {
+		UE_LOG(LogClimbing, Error, TEXT("Usage: -run=ClimbingLedgeBake -Map=/Game/Path/To/Map[,/Game/Path/To/OtherMap]"));
+		return 1;
+	}
+
+	// 默认值和CheckMantle保持一致
+	float StandInset = 50.f;
+	float CapsuleHalfHeight = 96.f;
+	float CellSize = 400.f;
+	FParse::Value(*Params, TEXT("StandInset="), StandInset);
+	FParse::Value(*Params, TEXT("CapsuleHalfHeight="), CapsuleHalfHeight);
+	FParse::Value(*Params, TEXT("CellSize="), CellSize);
+
+	TArray<FString> MapPackageNames;
+	Maps.ParseIntoArray(MapPackageNames, TEXT(","));
+
+	int32 Result = 0;
+	for (const FString& MapPackageName : MapPackageNames) {
+		if (!BakeMap(MapPackageName, StandInset, CapsuleHalfHeight, CellSize)) {
+			Result = 1;
+		}
+	}
+	return Result;
+#else
+	UE_LOG(LogClimbing, Error, TEXT("ClimbingLedgeBake can only run in an editor build"));
+	return 1;
+#endif
+}
+
+#if WITH_EDITOR
+bool UClimbingLedgeBakeCommandlet::BakeMap(const FString& MapPackageName, float StandInset, float CapsuleHalfHeight, float CellSize) {
+	UPackage* MapPackage = LoadPackage(nullptr, *MapPackageName, LOAD_None);
+	UWorld* World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+	if (!World || !World->PersistentLevel) {
+		UE_LOG(LogClimbing, Error, TEXT("Failed to load map '%s'"), *MapPackageName);
+		return false;
+	}
+
+	// 1. 收集所有静态几何体的Box，World没有初始化，需要自己更新一下组件的变换
+	TArray<FClimbableBox> Boxes;
+	for (AActor* Actor : World->PersistentLevel->Actors) {
+		if (!Actor) {
+			continue;
+		}
+		if (USceneComponent* RootComponent = Actor->GetRootComponent()) {
+			RootComponent->UpdateComponentToWorld();
+		}
+		Actor->ForEachComponent<UPrimitiveComponent>(false, [&Boxes](UPrimitiveComponent* Component) {
+			if (Component->Mobility == EComponentMobility::Static) {
+				UClimbableSurfaceSubsystem::GatherClimbableBoxes(Component, Component->GetComponentTransform(), Boxes);
+			}
+		});
+	}
+
+	// 2. 顶面能站人的Box，它的四条顶边都是候选的Ledge
+	const float WalkableFloorZ = GetDefault<UCharacterMovementComponent>()->GetWalkableFloorZ();
+	TArray<FClimbingLedgeSegment> Segments;
+	for (int32 BoxIndex = 0; BoxIndex < Boxes.Num(); ++BoxIndex) {
+		const FClimbableBox& Box = Boxes[BoxIndex];
+
+		int32 UpAxis = INDEX_NONE;
+		for (int32 Axis = 0; Axis < 3; ++Axis) {
+			if (FMath::Abs(Box.Axes[Axis].Z) >= WalkableFloorZ) {
+				UpAxis = Axis;
+				break;
+			}
+		}
+		if (UpAxis == INDEX_NONE) {
+			continue;
+		}
+
+		const FVector Up = Box.Axes[UpAxis] * FMath::Sign(Box.Axes[UpAxis].Z);
+		const FVector TopCenter = Box.Center + Up * Box.HalfExtents[UpAxis];
+
+		for (int32 WallAxis = 0; WallAxis < 3; ++WallAxis) {
+			if (WallAxis == UpAxis) {
+				continue;
+			}
+			const int32 EdgeAxis = 3 - UpAxis - WallAxis;
+
+			for (const double Sign : { 1.0, -1.0 }) {
+				const FVector WallNormal = Box.Axes[WallAxis] * Sign;
+				const FVector EdgeCenter = TopCenter + WallNormal * Box.HalfExtents[WallAxis];
+				const FVector EdgeExtent = Box.Axes[EdgeAxis] * Box.HalfExtents[EdgeAxis];
+
+				FClimbingLedgeSegment Segment;
+				Segment.Start = FVector3f(EdgeCenter - EdgeExtent);
+				Segment.End = FVector3f(EdgeCenter + EdgeExtent);
+				Segment.WallNormal = FVector3f(WallNormal.GetSafeNormal2D());
+				Segment.StandInset = FMath::Min(StandInset, float(Box.HalfExtents[WallAxis]));
+
+				// 3. 站立点上方被挡住，或者墙面紧贴着别的Box(不是露在外面的墙)，就不是能用的Ledge
+				const FVector StandPoint = Segment.GetStandTarget(EdgeCenter);
+				const FVector ProbePoints[] = {
+					StandPoint + Up * 5.f,
+					StandPoint + Up * CapsuleHalfHeight,
+					EdgeCenter + WallNormal * 5.f - Up * 5.f,
+				};
+
+				bool bBlocked = false;
+				for (int32 OtherIndex = 0; OtherIndex < Boxes.Num() && !bBlocked; ++OtherIndex) {
+					if (OtherIndex == BoxIndex) {
+						continue;
+					}
+					for (const FVector& ProbePoint : ProbePoints) {
+						if (Boxes[OtherIndex].ContainsPoint(ProbePoint)) {
+							bBlocked = true;
+							break;
+						}
+					}
+				}
+
+				if (!bBlocked) {
+					Segments.Add(Segment);
+				}
+			}
+		}
+	}
+
+	// 4. 保存到和地图对应的包里
+	const FString GraphPackageName = UClimbingLedgeGraph::GetPackageNameForMap(MapPackageName);
+	UPackage* GraphPackage = CreatePackage(*GraphPackageName);
+	GraphPackage->FullyLoad();
+
+	const FName GraphName(*FPackageName::GetShortName(GraphPackageName));
+	UClimbingLedgeGraph* Graph = FindObject<UClimbingLedgeGraph>(GraphPackage, *GraphName.ToString());
+	if (!Graph) {
+		Graph = NewObject<UClimbingLedgeGraph>(GraphPackage, GraphName, RF_Public | RF_Standalone);
+	}
+
+	const int32 NumSegments = Segments.Num();
+	Graph->Build(MoveTemp(Segments), CellSize);
+	Graph->MarkPackageDirty();
+
+	const FString Filename = FPackageName::LongPackageNameToFilename(GraphPackageName, FPackageName::GetAssetPackageExtension());
+	FSavePackageArgs SaveArgs;
+	SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+	if (!UPackage::SavePackage(GraphPackage, Graph, *Filename, SaveArgs)) {
+		UE_LOG(LogClimbing, Error, TEXT("Failed to save ledge graph '%s'"), *Filename);
+		return false;
+	}
+
+	UE_LOG(LogClimbing, Display, TEXT("Baked %d ledge segments from %d boxes in '%s' to '%s'"), NumSegments, Boxes.Num(), *MapPackageName, *GraphPackageName);
+	return true;
+}
+#endif
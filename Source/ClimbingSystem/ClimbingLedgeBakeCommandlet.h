@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ClimbingLedgeBakeCommandlet.generated.h"
+
+/**
+ * 离线扫描地图里的静态几何体，把能Mantle上去的墙顶边缘烘焙成UClimbingLedgeGraph
+ * 用法: UnrealEditor-Cmd ClimbingSystem.uproject -run=ClimbingLedgeBake -Map=/Game/ThirdPerson/Maps/ThirdPersonMap[,...]
+ * 可选参数: -StandInset=50 -CapsuleHalfHeight=96 -CellSize=400
+ */
+UCLASS()
+class UClimbingLedgeBakeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UClimbingLedgeBakeCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	bool BakeMap(const FString& MapPackageName, float StandInset, float CapsuleHalfHeight, float CellSize);
+};
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingLedgeGraph.h"
+#include "Algo/BinarySearch.h"
+#include "Misc/PackageName.h"
+
+UClimbingLedgeGraph::UClimbingLedgeGraph() {
+	CellSize = 400.f;
+}
+
+bool UClimbingLedgeGraph::FindMantleTarget(const FVector& Location, const FVector& Forward2D, float Reach, float MaxHeight, FVector& OutTarget, bool& bOutCovered) const {
+	const int32 MinX = GetCellCoord(Location.X - Reach);
+	const int32 MaxX = GetCellCoord(Location.X + Reach);
+	const int32 MinY = GetCellCoord(Location.Y - Reach);
+	const int32 MaxY = GetCellCoord(Location.Y + Reach);
+
+	double BestDistance = Reach;
+	bool bFound = false;
+	bOutCovered = false;
+
+	for (int32 X = MinX; X <= MaxX; ++X) {
+		for (int32 Y = MinY; Y <= MaxY; ++Y) {
+			const int32 BucketIndex = Algo::BinarySearchBy(Buckets, MakeCellKey(X, Y), &FClimbingLedgeBucket::CellKey);
+			if (BucketIndex == INDEX_NONE) {
+				continue;
+			}
+
+			const FClimbingLedgeBucket& Bucket = Buckets[BucketIndex];
+			for (int32 Index = Bucket.FirstIndex; Index < Bucket.FirstIndex + Bucket.NumIndices; ++Index) {
+				const FClimbingLedgeSegment& Segment = Segments[BucketSegmentIndices[Index]];
+
+				// 墙面要正对着角色
+				if (FVector::DotProduct(FVector(Segment.WallNormal), Forward2D) > -0.5) {
+					continue;
+				}
+
+				const FVector PointOnEdge = FMath::ClosestPointOnSegment(Location, FVector(Segment.Start), FVector(Segment.End));
+				const double Distance = FVector::Dist2D(Location, PointOnEdge);
+				if (Distance > Reach) {
+					continue;
+				}
+				bOutCovered = true;
+
+				// 顶边要比角色高，但不能超过向下检测能够到的高度
+				const double Height = PointOnEdge.Z - Location.Z;
+				if (Height <= 0.0 || Height > MaxHeight || Distance > BestDistance) {
+					continue;
+				}
+
+				BestDistance = Distance;
+				OutTarget = Segment.GetStandTarget(PointOnEdge);
+				bFound = true;
+			}
+		}
+	}
+
+	return bFound;
+}
+
+void UClimbingLedgeGraph::Build(TArray<FClimbingLedgeSegment>&& InSegments, float InCellSize) {
+	CellSize = InCellSize;
+	Segments = MoveTemp(InSegments);
+
+	// 每个Segment放进它覆盖到的所有格子
+	TMap<int64, TArray<int32>> CellSegments;
+	for (int32 SegmentIndex = 0; SegmentIndex < Segments.Num(); ++SegmentIndex) {
+		const FClimbingLedgeSegment& Segment = Segments[SegmentIndex];
+		const int32 MinX = GetCellCoord(FMath::Min(Segment.Start.X, Segment.End.X));
+		const int32 MaxX = GetCellCoord(FMath::Max(Segment.Start.X, Segment.End.X));
+		const int32 MinY = GetCellCoord(FMath::Min(Segment.Start.Y, Segment.End.Y));
+		const int32 MaxY = GetCellCoord(FMath::Max(Segment.Start.Y, Segment.End.Y));
+		for (int32 X = MinX; X <= MaxX; ++X) {
+			for (int32 Y = MinY; Y <= MaxY; ++Y) {
+				CellSegments.FindOrAdd(MakeCellKey(X, Y)).Add(SegmentIndex);
+			}
+		}
+	}
+	CellSegments.KeySort(TLess<int64>());
+
+	Buckets.Reset(CellSegments.Num());
+	BucketSegmentIndices.Reset();
+	for (const TPair<int64, TArray<int32>>& Pair : CellSegments) {
+		FClimbingLedgeBucket& Bucket = Buckets.AddDefaulted_GetRef();
+		Bucket.CellKey = Pair.Key;
+		Bucket.FirstIndex = BucketSegmentIndices.Num();
+		Bucket.NumIndices = Pair.Value.Num();
+		BucketSegmentIndices.Append(Pair.Value);
+	}
+}
+
+FString UClimbingLedgeGraph::GetPackageNameForMap(const FString& MapPackageName) {
+	// 在LedgeGraphs下建和地图一样的目录，不同目录下的同名地图不会共用一份数据；/Game以外(插件)的地图保留挂载点的名字
+	FString MapPath = FPackageName::GetLongPackagePath(MapPackageName);
+	if (MapPath == TEXT("/Game")) {
+		MapPath.Reset();
+	} else if (MapPath.StartsWith(TEXT("/Game/"))) {
+		MapPath.RightChopInline(5);
+	}
+	return FString::Printf(TEXT("/Game/Climbing/LedgeGraphs%s/LG_%s"), *MapPath, *FPackageName::GetShortName(MapPackageName));
+}
+
+void UClimbingLedgeGraph::Serialize(FArchive& Ar) {
+	Super::Serialize(Ar);
+
+	// 都是POD数组，整块读写
+	Segments.BulkSerialize(Ar);
+	Buckets.BulkSerialize(Ar);
+	BucketSegmentIndices.BulkSerialize(Ar);
+}
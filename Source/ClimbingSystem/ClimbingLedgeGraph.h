@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "ClimbingLedgeGraph.generated.h"
+
+/** 一段能Mantle上去的墙顶边缘，由ClimbingLedgeBake commandlet离线生成 */
+struct FClimbingLedgeSegment {
+	FVector3f Start;			// 顶边的两个端点
+	FVector3f End;
+	FVector3f WallNormal;		// 墙面朝外的水平法线
+	float StandInset;			// 站立点从顶边往墙里缩进的距离
+
+	FVector GetStandTarget(const FVector& PointOnEdge) const {
+		return PointOnEdge - FVector(WallNormal) * StandInset;
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FClimbingLedgeSegment& Segment) {
+		Ar << Segment.Start << Segment.End << Segment.WallNormal << Segment.StandInset;
+		return Ar;
+	}
+};
+
+template<> struct TCanBulkSerialize<FClimbingLedgeSegment> { enum { Value = true }; };
+
+/** 水平方向上的一个格子，指向BucketSegmentIndices里的一段 */
+struct FClimbingLedgeBucket {
+	int64 CellKey;
+	int32 FirstIndex;
+	int32 NumIndices;
+
+	friend FArchive& operator<<(FArchive& Ar, FClimbingLedgeBucket& Bucket) {
+		Ar << Bucket.CellKey << Bucket.FirstIndex << Bucket.NumIndices;
+		return Ar;
+	}
+};
+
+template<> struct TCanBulkSerialize<FClimbingLedgeBucket> { enum { Value = true }; };
+
+/**
+ * 烘焙好的关卡Ledge数据，运行时用来代替CheckMantle里的两次LineTrace
+ * 数据全部是POD数组，按格子排好序，加载时整块读入，不需要再做任何处理
+ */
+UCLASS()
+class UClimbingLedgeGraph : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UClimbingLedgeGraph();
+
+	/**
+	 * 查找角色面前能Mantle上去的Ledge
+	 * @param Location 角色的位置
+	 * @param Forward2D 角色水平方向的朝向
+	 * @param Reach 水平方向上离顶边的最大距离
+	 * @param MaxHeight 顶边最多比角色高多少
+	 * @param OutTarget 能Mantle时返回站立的位置
+	 * @param bOutCovered 范围内有正对着角色的烘焙过的墙时为true；为false时说明这里的几何体没有烘焙(流式子关卡、运行时生成的)，调用方应该退回LineTrace
+	 */
+	bool FindMantleTarget(const FVector& Location, const FVector& Forward2D, float Reach, float MaxHeight, FVector& OutTarget, bool& bOutCovered) const;
+
+	// 烘焙时调用，把Segment按格子分好桶
+	void Build(TArray<FClimbingLedgeSegment>&& InSegments, float InCellSize);
+
+	int32 GetNumSegments() const { return Segments.Num(); }
+
+	// 某张地图对应的Ledge数据的包名，/Game/A/Arena对应/Game/Climbing/LedgeGraphs/A/LG_Arena
+	static FString GetPackageNameForMap(const FString& MapPackageName);
+
+	virtual void Serialize(FArchive& Ar) override;
+
+private:
+	static int64 MakeCellKey(int32 X, int32 Y) { return (int64(X) << 32) | int64(uint32(Y)); }
+	int32 GetCellCoord(double Value) const { return FMath::FloorToInt32(Value / CellSize); }
+
+	UPROPERTY(VisibleAnywhere, Category = Ledge)
+	float CellSize;
+
+	TArray<FClimbingLedgeSegment> Segments;
+	TArray<FClimbingLedgeBucket> Buckets;			// 按CellKey排序
+	TArray<int32> BucketSegmentIndices;
+};
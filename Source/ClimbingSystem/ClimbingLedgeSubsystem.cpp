@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingLedgeSubsystem.h"
+#include "ClimbingLedgeGraph.h"
+#include "ClimbingSystem.h"
+#include "Engine/World.h"
+#include "Misc/PackageName.h"
+
+static TAutoConsoleVariable<int32> CVarClimbingLedgeGraph(
+	TEXT("Climbing.LedgeGraph"),
+	1,
+	TEXT("是否使用烘焙好的Ledge数据判断能否Mantle\n")
+	TEXT("0: 每次都做LineTrace\n")
+	TEXT("1: 有烘焙数据时查表 (默认)"),
+	ECVF_Default);
+
+void UClimbingLedgeSubsystem::OnWorldBeginPlay(UWorld& InWorld) {
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (CVarClimbingLedgeGraph.GetValueOnGameThread() == 0) {
+		return;
+	}
+
+	const FString MapPackageName = UWorld::RemovePIEPrefix(InWorld.GetOutermost()->GetName());
+	const FString GraphPackageName = UClimbingLedgeGraph::GetPackageNameForMap(MapPackageName);
+	if (!FPackageName::DoesPackageExist(GraphPackageName)) {
+		UE_LOG(LogClimbing, Log, TEXT("No ledge graph baked for '%s', mantle checks will use line traces"), *MapPackageName);
+		return;
+	}
+
+	const FString ObjectPath = GraphPackageName + TEXT(".") + FPackageName::GetShortName(GraphPackageName);
+	LedgeGraph = LoadObject<UClimbingLedgeGraph>(nullptr, *ObjectPath);
+	if (LedgeGraph) {
+		UE_LOG(LogClimbing, Log, TEXT("Loaded ledge graph '%s' with %d segments"), *ObjectPath, LedgeGraph->GetNumSegments());
+	}
+}
+
+bool UClimbingLedgeSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ClimbingLedgeSubsystem.generated.h"
+
+class UClimbingLedgeGraph;
+
+/**
+ * 关卡开始时加载这张地图烘焙好的Ledge数据，没有烘焙过的地图GetLedgeGraph返回空，继续走LineTrace
+ * 烘焙只覆盖PersistentLevel，查表时附近没有烘焙过的墙也退回LineTrace
+ */
+UCLASS()
+class UClimbingLedgeSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	const UClimbingLedgeGraph* GetLedgeGraph() const { return LedgeGraph; }
+
+	// UWorldSubsystem interface
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	UPROPERTY(Transient)
+	TObjectPtr<UClimbingLedgeGraph> LedgeGraph;
+};
@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingLimbIKComponent.h"
+#include "ClimbableSurfaceSubsystem.h"
+#include "ClimbingMovementComponent.h"
+#include "ClimbingSignificanceSubsystem.h"
+#include "ClimbingStats.h"
+#include "ClimbingSystem.h"
+#include "Engine/World.h"
+
+static TAutoConsoleVariable<int32> CVarClimbingLimbIKTracesPerFrame(
+	TEXT("Climbing.LimbIK.TracesPerFrame"),
+	1,
+	TEXT("每个角色每帧最多给几个肢体提交检测，其余的肢体外推上一次的接触点，0表示只外推"),
+	ECVF_Default);
+
+UClimbingLimbIKComponent::UClimbingLimbIKComponent() {
+	// 要用移动之后的位置，只在攀爬时打开
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	PrimaryComponentTick.TickGroup = TG_PostPhysics;
+
+	HandOffset = FVector2D(25.f, 55.f);
+	FootOffset = FVector2D(15.f, -75.f);
+	LimbReach = 30.f;
+	MaxContactDrift = 40.f;
+	ContactInterpSpeed = 15.f;
+}
+
+void UClimbingLimbIKComponent::BeginPlay() {
+	Super::BeginPlay();
+
+	// 纯表现，专用服务器上没有人看
+	ClimbingCharacter = Cast<AClimbingSystemCharacter>(GetOwner());
+	if (!ClimbingCharacter || GetNetMode() == NM_DedicatedServer) {
+		return;
+	}
+
+	LimbTraceDelegate.BindUObject(this, &UClimbingLimbIKComponent::OnLimbTraceDone);
+	MovementModeChangedHandle = ClimbingCharacter->OnCharacterMovementModeChanged.AddUObject(this, &UClimbingLimbIKComponent::OnCharacterMovementModeChanged);
+}
+
+void UClimbingLimbIKComponent::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+	if (ClimbingCharacter) {
+		ClimbingCharacter->OnCharacterMovementModeChanged.Remove(MovementModeChangedHandle);
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
+const FClimbingLimbContact& UClimbingLimbIKComponent::GetLimbContact(EClimbingLimb Limb) const {
+	return const_cast<UClimbingLimbIKComponent*>(this)->GetContact((int32)Limb);
+}
+
+FClimbingLimbContact& UClimbingLimbIKComponent::GetContact(int32 LimbIndex) {
+	switch ((EClimbingLimb)LimbIndex) {
+	case EClimbingLimb::LeftHand:	return LeftHandContact;
+	case EClimbingLimb::RightHand:	return RightHandContact;
+	case EClimbingLimb::LeftFoot:	return LeftFootContact;
+	default:						return RightFootContact;
+	}
+}
+
+void UClimbingLimbIKComponent::OnCharacterMovementModeChanged(AClimbingSystemCharacter* Character, ECharacterMovementMode PreviousMode, ECharacterMovementMode NewMode) {
+	const bool bClimbing = NewMode == Climbing;
+	SetComponentTickEnabled(bClimbing);
+	if (!bClimbing) {
+		ResetContacts();
+	}
+}
+
+void UClimbingLimbIKComponent::ResetContacts() {
+	for (int32 LimbIndex = 0; LimbIndex < (int32)EClimbingLimb::Num; ++LimbIndex) {
+		Limbs[LimbIndex] = FLimbState();
+		GetContact(LimbIndex) = FClimbingLimbContact();
+	}
+	NextLimbToTrace = 0;
+}
+
+void UClimbingLimbIKComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingLimbIK);
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	const UClimbingMovementComponent* ClimbingMovement = ClimbingCharacter->GetClimbingMovement();
+	if (!ClimbingMovement->HasClimbSurface()) {
+		return;
+	}
+
+	// 切线没有归一化，法线接近竖直时水平切线会很短
+	const FVector WallNormal = ClimbingMovement->GetClimbSurfaceNormal();
+	const FVector WallRight = ClimbingMovement->GetClimbSurfaceRight().GetSafeNormal();
+	const FVector WallUp = ClimbingMovement->GetClimbSurfaceUp().GetSafeNormal();
+
+	// 1. 按预算轮流给肢体提交检测，Mantle和Enter的过渡中手脚在动画里，不检测；远处的角色只外推
+	int32 NumTraces = FMath::Clamp(CVarClimbingLimbIKTracesPerFrame.GetValueOnGameThread(), 0, (int32)EClimbingLimb::Num);
+	if (ClimbingMovement->IsInClimbTransition() || ClimbingCharacter->GetClimbingSignificance() == EClimbingSignificance::Low) {
+		NumTraces = 0;
+	}
+	for (int32 Submitted = 0; Submitted < NumTraces; ++Submitted) {
+		const int32 LimbIndex = NextLimbToTrace;
+		NextLimbToTrace = (NextLimbToTrace + 1) % (int32)EClimbingLimb::Num;
+
+		// 上一次的检测还没回来时这一帧的预算就不用了
+		if (!Limbs[LimbIndex].TraceHandle.IsValid()) {
+			SubmitLimbTrace(LimbIndex, GetLimbAnchor(LimbIndex, WallRight, WallUp), WallNormal);
+		}
+	}
+
+	// 2. 所有肢体的接触点跟着角色沿墙面外推，再插值过去
+	for (int32 LimbIndex = 0; LimbIndex < (int32)EClimbingLimb::Num; ++LimbIndex) {
+		FLimbState& Limb = Limbs[LimbIndex];
+		FClimbingLimbContact& Contact = GetContact(LimbIndex);
+		const FVector Anchor = GetLimbAnchor(LimbIndex, WallRight, WallUp);
+
+		bool bHasTarget = false;
+		FVector TargetLocation = Contact.Location;
+		if (Limb.bHasContact) {
+			const FVector Moved = FVector::VectorPlaneProject(Anchor - Limb.AnchorAtHit, Limb.HitNormal);
+			TargetLocation = Limb.HitLocation + Moved;
+
+			// 离开检测时的位置太远，外推的结果已经不可信了
+			const FVector Drift = FVector::VectorPlaneProject(TargetLocation - Anchor, WallNormal);
+			bHasTarget = Drift.SizeSquared() <= FMath::Square(MaxContactDrift);
+		}
+
+		if (bHasTarget) {
+			Contact.Location = Contact.Alpha > 0.f ? FMath::VInterpTo(Contact.Location, TargetLocation, DeltaTime, ContactInterpSpeed) : TargetLocation;
+			Contact.Normal = Contact.Alpha > 0.f ? FMath::VInterpNormalRotationTo(Contact.Normal, Limb.HitNormal, DeltaTime, ContactInterpSpeed * 90.f) : Limb.HitNormal;
+			Contact.GripType = Limb.HitGripType;
+		}
+		Contact.Alpha = FMath::FInterpTo(Contact.Alpha, bHasTarget ? 1.f : 0.f, DeltaTime, ContactInterpSpeed);
+	}
+}
+
+FVector UClimbingLimbIKComponent::GetLimbAnchor(int32 LimbIndex, const FVector& WallRight, const FVector& WallUp) const {
+	const bool bHand = LimbIndex == (int32)EClimbingLimb::LeftHand || LimbIndex == (int32)EClimbingLimb::RightHand;
+	const bool bLeft = LimbIndex == (int32)EClimbingLimb::LeftHand || LimbIndex == (int32)EClimbingLimb::LeftFoot;
+	const FVector2D& Offset = bHand ? HandOffset : FootOffset;
+	return ClimbingCharacter->GetActorLocation() + WallRight * (bLeft ? -Offset.X : Offset.X) + WallUp * Offset.Y;
+}
+
+void UClimbingLimbIKComponent::SubmitLimbTrace(int32 LimbIndex, const FVector& Anchor, const FVector& WallNormal) {
+	// 从胶囊体的深度出发，越过墙面LimbReach
+	const float Length = ClimbingCharacter->GetClimbingMovement()->ClimbWallDistance + LimbReach;
+	const FVector End = Anchor - WallNormal * Length;
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(ClimbingLimbIK), false, ClimbingCharacter);
+	FLimbState& Limb = Limbs[LimbIndex];
+	Limb.TraceHandle = GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, Anchor, End, ECC_Climbable, Params, FCollisionResponseParams::DefaultResponseParam, &LimbTraceDelegate);
+	Limb.PendingAnchor = Anchor;
+	UClimbableSurfaceSubsystem::CountAsyncTraces(GetWorld(), 1);
+}
+
+void UClimbingLimbIKComponent::OnLimbTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum) {
+	for (FLimbState& Limb : Limbs) {
+		if (Limb.TraceHandle != TraceHandle) {
+			continue;
+		}
+		Limb.TraceHandle.Invalidate();
+
+		// 打到的是顶面或者天花板这种和墙面差太多的面时不算接触点，保留之前的接触点继续外推
+		const FHitResult* Hit = TraceDatum.OutHits.Num() > 0 ? &TraceDatum.OutHits[0] : nullptr;
+		const FVector TraceDirection = (TraceDatum.End - TraceDatum.Start).GetSafeNormal();
+		if (Hit && Hit->bBlockingHit && FVector::DotProduct(Hit->ImpactNormal, -TraceDirection) >= 0.5f) {
+			Limb.bHasContact = true;
+			Limb.HitLocation = Hit->ImpactPoint;
+			Limb.HitNormal = Hit->ImpactNormal;
+			Limb.HitGripType = UClimbableSurfaceComponent::GetGripType(Hit->GetComponent());
+			Limb.AnchorAtHit = Limb.PendingAnchor;
+		} else if (!Hit || !Hit->bBlockingHit) {
+			Limb.bHasContact = false;
+		}
+		return;
+	}
+}
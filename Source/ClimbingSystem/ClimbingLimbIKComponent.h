@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "WorldCollision.h"
+#include "ClimbableSurfaceComponent.h"
+#include "ClimbingSystemCharacter.h"
+#include "ClimbingLimbIKComponent.generated.h"
+
+UENUM(BlueprintType)
+enum class EClimbingLimb : uint8 {
+	LeftHand,
+	RightHand,
+	LeftFoot,
+	RightFoot,
+	Num UMETA(Hidden),
+};
+
+/** 一只手或脚在墙上的接触点，给AnimInstance做IK用 */
+USTRUCT(BlueprintType)
+struct FClimbingLimbContact {
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = Climbing)
+	FVector Location = FVector::ZeroVector;		// 世界空间下的接触点
+
+	UPROPERTY(BlueprintReadOnly, Category = Climbing)
+	FVector Normal = FVector::ZeroVector;		// 接触点的墙面法线
+
+	UPROPERTY(BlueprintReadOnly, Category = Climbing)
+	float Alpha = 0.f;							// IK的权重，找到接触点时淡入，找不到时淡出
+
+	UPROPERTY(BlueprintReadOnly, Category = Climbing)
+	EClimbGripType GripType = EClimbGripType::Rock;	// 接触点所在墙面的抓握方式，用来选手型
+};
+
+/**
+ * 攀爬时给四肢找墙上的接触点
+ * 每帧最多给TracesPerFrame个肢体提交异步检测(默认一个，轮流来)，其他肢体用上一次的接触点沿墙面外推
+ * 检测沿着当前墙面法线的反方向，每个肢体用自己命中点的法线，不平的墙面上手脚也能贴在各自的凸起上
+ * 只在攀爬时Tick，专用服务器上不工作
+ */
+UCLASS(ClassGroup = (Climbing), meta = (BlueprintSpawnableComponent))
+class UClimbingLimbIKComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UClimbingLimbIKComponent();
+
+	UFUNCTION(BlueprintPure, Category = Climbing)
+	const FClimbingLimbContact& GetLimbContact(EClimbingLimb Limb) const;
+
+	// 四个肢体分开放，AnimBP在工作线程上可以直接用属性访问读取
+	UPROPERTY(BlueprintReadOnly, Category = Climbing)
+	FClimbingLimbContact LeftHandContact;
+
+	UPROPERTY(BlueprintReadOnly, Category = Climbing)
+	FClimbingLimbContact RightHandContact;
+
+	UPROPERTY(BlueprintReadOnly, Category = Climbing)
+	FClimbingLimbContact LeftFootContact;
+
+	UPROPERTY(BlueprintReadOnly, Category = Climbing)
+	FClimbingLimbContact RightFootContact;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Climbing)
+	FVector2D HandOffset;			// 手相对胶囊体中心的位置，X是向右，Y是向上，左手取X的相反数
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Climbing)
+	FVector2D FootOffset;			// 脚相对胶囊体中心的位置
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Climbing, meta = (ClampMin = "0"))
+	float LimbReach;				// 检测线越过墙面多远，墙面凹进去超过这个距离时手脚就够不着了
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Climbing, meta = (ClampMin = "0"))
+	float MaxContactDrift;			// 外推出来的接触点离肢体的理想位置超过这个距离时放弃这个接触点
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Climbing, meta = (ClampMin = "0"))
+	float ContactInterpSpeed;		// 接触点和权重的插值速度，避免新的检测结果回来时跳一下
+
+	// UActorComponent interface
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	struct FLimbState {
+		FTraceHandle TraceHandle;
+		bool bHasContact = false;
+		FVector HitLocation = FVector::ZeroVector;
+		FVector HitNormal = FVector::ZeroVector;
+		EClimbGripType HitGripType = EClimbGripType::Rock;
+		FVector AnchorAtHit = FVector::ZeroVector;		// 检测时肢体的理想位置，外推时用它算角色移动了多少
+		FVector PendingAnchor = FVector::ZeroVector;	// 还没回来的检测提交时的理想位置
+	};
+
+	FVector GetLimbAnchor(int32 LimbIndex, const FVector& WallRight, const FVector& WallUp) const;
+	void SubmitLimbTrace(int32 LimbIndex, const FVector& Anchor, const FVector& WallNormal);
+	void OnLimbTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum);
+	void OnCharacterMovementModeChanged(AClimbingSystemCharacter* Character, ECharacterMovementMode PreviousMode, ECharacterMovementMode NewMode);
+	void ResetContacts();
+
+	FClimbingLimbContact& GetContact(int32 LimbIndex);
+
+	UPROPERTY(Transient)
+	TObjectPtr<AClimbingSystemCharacter> ClimbingCharacter;
+
+	FLimbState Limbs[(int32)EClimbingLimb::Num];
+	int32 NextLimbToTrace = 0;
+
+	FTraceDelegate LimbTraceDelegate;
+	FDelegateHandle MovementModeChangedHandle;
+};
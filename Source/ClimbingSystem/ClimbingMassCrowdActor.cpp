@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingMassCrowdActor.h"
+#include "ClimbingMathKernels.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Net/UnrealNetwork.h"
+#include "UObject/ConstructorHelpers.h"
+
+//////////////////////////////////////////////////////////////////////////
+// FClimbingMassCrowdItem
+
+FTransform FClimbingMassCrowdItem::GetTransform(const FVector& Scale) const {
+	FVector Forward;
+	ClimbingMath::DecodeOctahedral8(ForwardU, ForwardV, Forward.X, Forward.Y, Forward.Z);
+	return FTransform(FRotationMatrix::MakeFromX(Forward).ToQuat(), Location, Scale);
+}
+
+void FClimbingMassCrowdItem::PostReplicatedAdd(const FClimbingMassCrowdArray& InArraySerializer) {
+	// 新出现的攀爬者直接放到同步下来的位置，不从原点插值过来
+	if (InArraySerializer.Owner) {
+		InArraySerializer.Owner->DisplayTransforms.Add(ReplicationID, GetTransform(InArraySerializer.Owner->InstanceScale));
+	}
+}
+
+void FClimbingMassCrowdItem::PreReplicatedRemove(const FClimbingMassCrowdArray& InArraySerializer) {
+	if (InArraySerializer.Owner) {
+		InArraySerializer.Owner->DisplayTransforms.Remove(ReplicationID);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// AClimbingMassCrowdActor
+
+AClimbingMassCrowdActor::AClimbingMassCrowdActor() {
+	PrimaryActorTick.bCanEverTick = true;
+
+	bReplicates = true;
+	bAlwaysRelevant = true;			// 攀爬者分布在整个关卡里，按Actor的位置做相关性没有意义
+	NetUpdateFrequency = 10.f;		// 客户端插值，背景攀爬者不需要更高的频率
+	SetReplicatingMovement(false);
+
+	Instances = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("Instances"));
+	Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Instances->SetCanEverAffectNavigation(false);
+	Instances->SetCastShadow(false);
+	RootComponent = Instances;
+
+	static ConstructorHelpers::FObjectFinder<UStaticMesh> CylinderMeshFinder(TEXT("/Engine/BasicShapes/Cylinder.Cylinder"));
+	Instances->SetStaticMesh(CylinderMeshFinder.Object);
+
+	// 客户端收到第一次同步时还没有PostInitializeComponents，在这里就要设置好
+	Climbers.Owner = this;
+
+	DisplayInterpSpeed = 10.f;
+	InstanceScale = FVector(0.84f, 0.84f, 1.92f);	// 默认胶囊体半径42、半高96，Cylinder是100x100x100
+}
+
+void AClimbingMassCrowdActor::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const {
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(AClimbingMassCrowdActor, InstanceScale);
+	DOREPLIFETIME(AClimbingMassCrowdActor, Climbers);
+}
+
+void AClimbingMassCrowdActor::SetClimberExtent(float Radius, float HalfHeight) {
+	InstanceScale = FVector(Radius * 2.f, Radius * 2.f, HalfHeight * 2.f) / 100.f;
+}
+
+void AClimbingMassCrowdActor::SetClimbers(TConstArrayView<FClimbingMassCrowdEntry> Entries) {
+	const uint32 Frame = uint32(GFrameCounter);
+
+	// 1. 更新或者加入这一帧的攀爬者，只有量化之后有变化的才标脏
+	for (const FClimbingMassCrowdEntry& Entry : Entries) {
+		FClimbingMassCrowdItem* Item = nullptr;
+		bool bDirty = false;
+		if (const int32* ItemIndex = ItemIndices.Find(Entry.EntityKey)) {
+			Item = &Climbers.Items[*ItemIndex];
+		} else {
+			ItemIndices.Add(Entry.EntityKey, Climbers.Items.Num());
+			Item = &Climbers.Items.AddDefaulted_GetRef();
+			Item->EntityKey = Entry.EntityKey;
+			bDirty = true;
+		}
+		Item->LastSeenFrame = Frame;
+
+		uint8 ForwardU, ForwardV;
+		ClimbingMath::EncodeOctahedral8(Entry.Forward.X, Entry.Forward.Y, Entry.Forward.Z, ForwardU, ForwardV);
+		if (bDirty || !Entry.Location.Equals(Item->Location, 1.0) || ForwardU != Item->ForwardU || ForwardV != Item->ForwardV || Entry.State != Item->State) {
+			Item->Location = Entry.Location;
+			Item->ForwardU = ForwardU;
+			Item->ForwardV = ForwardV;
+			Item->State = Entry.State;
+			Climbers.MarkItemDirty(*Item);
+		}
+	}
+
+	// 2. 这一帧没出现的(被换成Actor或者掉出世界销毁了)移除
+	bool bRemoved = false;
+	for (int32 Index = Climbers.Items.Num() - 1; Index >= 0; --Index) {
+		if (Climbers.Items[Index].LastSeenFrame == Frame) {
+			continue;
+		}
+		ItemIndices.Remove(Climbers.Items[Index].EntityKey);
+		Climbers.Items.RemoveAtSwap(Index);
+		if (Climbers.Items.IsValidIndex(Index)) {
+			ItemIndices.Add(Climbers.Items[Index].EntityKey, Index);
+		}
+		bRemoved = true;
+	}
+	if (bRemoved) {
+		Climbers.MarkArrayDirty();
+	}
+
+	// 3. 服务器本地也要看的时候直接用Entity的精确位置，不用等同步
+	if (GetNetMode() != NM_DedicatedServer) {
+		InstanceTransforms.Reset(Entries.Num());
+		for (const FClimbingMassCrowdEntry& Entry : Entries) {
+			InstanceTransforms.Emplace(FRotationMatrix::MakeFromX(Entry.Forward).ToQuat(), Entry.Location, InstanceScale);
+		}
+		UpdateInstances(InstanceTransforms);
+	}
+}
+
+void AClimbingMassCrowdActor::Tick(float DeltaSeconds) {
+	Super::Tick(DeltaSeconds);
+
+	// 服务器和单机由SetClimbers直接更新
+	if (GetLocalRole() == ROLE_Authority) {
+		return;
+	}
+
+	InstanceTransforms.Reset(Climbers.Items.Num());
+	const float Alpha = FMath::Clamp(DeltaSeconds * DisplayInterpSpeed, 0.f, 1.f);
+	for (const FClimbingMassCrowdItem& Item : Climbers.Items) {
+		const FTransform Target = Item.GetTransform(InstanceScale);
+		FTransform& Display = DisplayTransforms.FindOrAdd(Item.ReplicationID, Target);
+		Display.SetLocation(FMath::Lerp(Display.GetLocation(), Target.GetLocation(), Alpha));
+		Display.SetRotation(FQuat::Slerp(Display.GetRotation(), Target.GetRotation(), Alpha));
+		Display.SetScale3D(InstanceScale);
+		InstanceTransforms.Add(Display);
+	}
+	UpdateInstances(InstanceTransforms);
+}
+
+void AClimbingMassCrowdActor::UpdateInstances(const TArray<FTransform>& Transforms) {
+	// 数量不变的时候整批更新，数量变了才重建
+	if (Instances->GetInstanceCount() != Transforms.Num()) {
+		Instances->ClearInstances();
+		Instances->AddInstances(Transforms, false, true);
+		return;
+	}
+	if (Transforms.Num() > 0) {
+		Instances->BatchUpdateInstancesTransforms(0, Transforms, true, true, true);
+	}
+}
@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "ClimbingMassCrowdActor.generated.h"
+
+class AClimbingMassCrowdActor;
+class UInstancedStaticMeshComponent;
+class UStaticMesh;
+
+/** UClimbingMassRepresentationProcessor每帧交给UClimbingMassSubsystem的一个攀爬者 */
+struct FClimbingMassCrowdEntry {
+	uint64 EntityKey = 0;		// FMassEntityHandle::AsNumber()
+	FVector Location = FVector::ZeroVector;
+	FVector Forward = FVector::ForwardVector;
+	uint8 State = 0;			// EClimbingMassCrowdState
+};
+
+enum EClimbingMassCrowdState : uint8 {
+	ClimbingMassCrowd_Climbing,
+	ClimbingMassCrowd_Mantling,
+	ClimbingMassCrowd_Grounded,
+};
+
+/**
+ * 同步给客户端的一个攀爬者: 位置精确到1cm，朝向和FClimbingNetState的墙面法线一样用八面体编码的2个字节
+ * 位置变化不到1cm、朝向编码没变的时候不会被标脏，站着不动的攀爬者不占带宽
+ */
+USTRUCT()
+struct FClimbingMassCrowdItem : public FFastArraySerializerItem {
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector_NetQuantize Location;
+
+	UPROPERTY()
+	uint8 State = 0;
+
+	UPROPERTY()
+	uint8 ForwardU = 128;
+
+	UPROPERTY()
+	uint8 ForwardV = 128;
+
+	UPROPERTY(NotReplicated)
+	uint64 EntityKey = 0;		// 只在服务器上用来找到对应的Entity
+
+	UPROPERTY(NotReplicated)
+	uint32 LastSeenFrame = 0;
+
+	FTransform GetTransform(const FVector& Scale) const;
+
+	void PostReplicatedAdd(const struct FClimbingMassCrowdArray& InArraySerializer);
+	void PreReplicatedRemove(const struct FClimbingMassCrowdArray& InArraySerializer);
+};
+
+USTRUCT()
+struct FClimbingMassCrowdArray : public FFastArraySerializer {
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FClimbingMassCrowdItem> Items;
+
+	AClimbingMassCrowdActor* Owner = nullptr;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms) {
+		return FFastArraySerializer::FastArrayDeltaSerialize<FClimbingMassCrowdItem, FClimbingMassCrowdArray>(Items, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FClimbingMassCrowdArray> : public TStructOpsTypeTraitsBase2<FClimbingMassCrowdArray> {
+	enum {
+		WithNetDeltaSerializer = true,
+	};
+};
+
+/**
+ * Mass攀爬者的显示和同步，每个World只有一个，由UClimbingMassSubsystem在服务器和单机上生成
+ * 所有攀爬者画成同一个ISM的实例，服务器上把Entity的位置写进Fast Array同步给客户端，客户端插值之后写进自己的ISM
+ * Dedicated Server上不更新ISM
+ */
+UCLASS(NotPlaceable)
+class AClimbingMassCrowdActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AClimbingMassCrowdActor();
+
+	// 胶囊体的尺寸，用来缩放ISM的实例
+	void SetClimberExtent(float Radius, float HalfHeight);
+
+	// 服务器和单机上每帧调用一次，Entries里没有的攀爬者会被移除
+	void SetClimbers(TConstArrayView<FClimbingMassCrowdEntry> Entries);
+
+	int32 GetNumClimbers() const { return Climbers.Items.Num(); }
+
+	virtual void Tick(float DeltaSeconds) override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+private:
+	friend struct FClimbingMassCrowdItem;
+
+	void UpdateInstances(const TArray<FTransform>& Transforms);
+
+	UPROPERTY(VisibleAnywhere, Category = Climbing)
+	UInstancedStaticMeshComponent* Instances;
+
+	UPROPERTY(EditDefaultsOnly, Category = Climbing)
+	float DisplayInterpSpeed;		// 客户端显示的位置追上同步下来的位置的速度
+
+	UPROPERTY(Replicated)
+	FVector InstanceScale;
+
+	UPROPERTY(Replicated)
+	FClimbingMassCrowdArray Climbers;
+
+	TMap<uint64, int32> ItemIndices;				// 服务器: EntityKey -> Climbers.Items的下标
+	TMap<int32, FTransform> DisplayTransforms;		// 客户端: ReplicationID -> 正在显示的位置
+	TArray<FTransform> InstanceTransforms;
+};
@@ -0,0 +1,134 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "ClimbingMassFragments.generated.h"
+
+// 用Mass表示的背景NPC攀爬者，状态用Tag区分，每个Processor只查询自己关心的状态
+
+/** 正在墙上爬 */
+USTRUCT()
+struct FClimbingMassClimbingTag : public FMassTag {
+	GENERATED_BODY()
+};
+
+/** 正在Mantle到Ledge上 */
+USTRUCT()
+struct FClimbingMassMantlingTag : public FMassTag {
+	GENERATED_BODY()
+};
+
+/** 已经退出攀爬(落地或者Mantle结束)，由UClimbingMassGroundProcessor在地面上往前走，碰到墙再开始爬 */
+USTRUCT()
+struct FClimbingMassGroundedTag : public FMassTag {
+	GENERATED_BODY()
+};
+
+/** 当前贴着的墙面 */
+USTRUCT()
+struct FClimbingMassSurfaceFragment : public FMassFragment {
+	GENERATED_BODY()
+
+	FVector Location = FVector::ZeroVector;
+	FVector Normal = FVector::BackwardVector;
+	FVector Right = FVector::ZeroVector;
+	FVector Up = FVector::ZeroVector;
+	bool bValid = false;
+};
+
+/** 攀爬方向的输入，X向右，Y向上，和AClimbingSystemCharacter::Move的输入一样 */
+USTRUCT()
+struct FClimbingMassInputFragment : public FMassFragment {
+	GENERATED_BODY()
+
+	FVector2D MoveInput = FVector2D(0.f, 1.f);
+};
+
+/** UClimbingMassProbeProcessor写入，UClimbingMassMovementProcessor读取的检测结果，检测是上一帧异步提交的 */
+USTRUCT()
+struct FClimbingMassProbeFragment : public FMassFragment {
+	GENERATED_BODY()
+
+	FVector HitLocation = FVector::ZeroVector;
+	FVector HitNormal = FVector::ZeroVector;
+	bool bSurfaceHit = false;
+	bool bFloorHit = false;		// 下方ExitClimbingDetection范围内有地面
+};
+
+/**
+ * UClimbingMassGroundProcessor上一帧异步提交的地面、前方墙面和上墙检测的结果
+ * 检测按Entity错开，没轮到的帧沿用bFalling继续走或者往下掉
+ */
+USTRUCT()
+struct FClimbingMassGroundProbeFragment : public FMassFragment {
+	GENERATED_BODY()
+
+	FVector WallLocation = FVector::ZeroVector;		// 上墙检测回来之后是要爬的墙面
+	FVector WallNormal = FVector::ZeroVector;
+	FVector MountLocation = FVector::ZeroVector;	// 上墙之后胶囊体中心的位置
+	double FloorZ = 0.0;
+	bool bResolved = false;			// 有还没用过的检测结果
+	bool bFloorHit = false;
+	bool bWallHit = false;			// 前面有走不上去的墙
+	bool bWallClimbable = false;
+	bool bFalling = false;
+	bool bMounting = false;			// 提交了上墙检测，结果回来之前原地不动
+	bool bMountHit = false;
+};
+
+/** Mantle的起点、终点(胶囊体中心)和进度 */
+USTRUCT()
+struct FClimbingMassMantleFragment : public FMassFragment {
+	GENERATED_BODY()
+
+	FVector StartLocation = FVector::ZeroVector;
+	FVector TargetLocation = FVector::ZeroVector;
+	float Elapsed = 0.f;
+};
+
+/**
+ * 所有攀爬者共用的规则，由UClimbingMassTrait从AClimbingSystemCharacter的默认值读出来
+ * 需要参与Hash区分不同的配置，所以都是UPROPERTY
+ */
+USTRUCT()
+struct FClimbingMassSettingsFragment : public FMassConstSharedFragment {
+	GENERATED_BODY()
+
+	UPROPERTY()
+	float WallDetectionLength = 75.f;
+
+	UPROPERTY()
+	float WallDistance = 45.f;			// WallDistance + WallDistanceOffset，贴墙时中心离墙面的距离
+
+	UPROPERTY()
+	float ExitClimbingDetection = 146.f;
+
+	UPROPERTY()
+	float ExitTiltCos = 0.86602540378f;	// cos(30°)
+
+	UPROPERTY()
+	float CapsuleHalfHeight = 96.f;
+
+	UPROPERTY()
+	float MaxClimbSpeed = 100.f;
+
+	UPROPERTY()
+	float ClimbSnapSpeed = 5.f;
+
+	UPROPERTY()
+	float WalkableFloorZ = 0.71f;
+
+	UPROPERTY()
+	float MantleDuration = 0.5f;
+
+	UPROPERTY()
+	float MaxWalkSpeed = 500.f;
+
+	UPROPERTY()
+	float MaxStepHeight = 45.f;
+
+	UPROPERTY()
+	float FallSpeed = 1000.f;			// 脚下没有地面时每秒往下掉多少，背景攀爬者不模拟加速度
+};
@@ -0,0 +1,612 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingMassProcessors.h"
+#include "ClimbableSurfaceSubsystem.h"
+#include "ClimbingLedgeGraph.h"
+#include "ClimbingLedgeSubsystem.h"
+#include "ClimbingMassFragments.h"
+#include "ClimbingMassSubsystem.h"
+#include "ClimbingMathKernels.h"
+#include "ClimbingStats.h"
+#include "ClimbingSystem.h"
+#include "Components/PrimitiveComponent.h"
+#include "GameFramework/WorldSettings.h"
+#include "MassCommonFragments.h"
+#include "MassExecutionContext.h"
+
+static TAutoConsoleVariable<int32> CVarClimbingMassMantleCheckStride(
+	TEXT("Climbing.Mass.MantleCheckStride"),
+	4,
+	TEXT("Mass攀爬者每隔多少帧做一次Mantle检测，按Entity错开"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarClimbingMassFloorCheckStride(
+	TEXT("Climbing.Mass.FloorCheckStride"),
+	4,
+	TEXT("Mass攀爬者每隔多少帧做一次向下的退出检测，按Entity错开"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarClimbingMassGroundCheckStride(
+	TEXT("Climbing.Mass.GroundCheckStride"),
+	2,
+	TEXT("地面上的Mass攀爬者每隔多少帧检测一次地面和前方的墙，按Entity错开，往下掉的每帧都检测"),
+	ECVF_Default);
+
+namespace ClimbingMass {
+	// 所有攀爬的Processor都在这个组里，只在服务器和单机上模拟
+	const FName ProcessorGroup = TEXT("Climbing");
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UClimbingMassProbeProcessor
+
+UClimbingMassProbeProcessor::UClimbingMassProbeProcessor() {
+	ExecutionFlags = int32(EProcessorExecutionFlags::Standalone | EProcessorExecutionFlags::Server);
+	ExecutionOrder.ExecuteInGroup = ClimbingMass::ProcessorGroup;
+	bRequiresGameThreadExecution = true;		// LineTraceClimbing的缓存和计数不是线程安全的
+}
+
+void UClimbingMassProbeProcessor::ConfigureQueries() {
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FClimbingMassSurfaceFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FClimbingMassProbeFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddConstSharedRequirement<FClimbingMassSettingsFragment>();
+	EntityQuery.AddTagRequirement<FClimbingMassClimbingTag>(EMassFragmentPresence::All);
+	EntityQuery.RegisterWithProcessor(*this);
+}
+
+void UClimbingMassProbeProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingMassProbe);
+
+	UWorld* World = Context.GetWorld();
+	const FCollisionQueryParams Params(SCENE_QUERY_STAT(ClimbingMassProbe), false);
+	const uint32 FloorStride = uint32(FMath::Max(CVarClimbingMassFloorCheckStride.GetValueOnGameThread(), 1));
+
+	// 1. 取回上一帧提交的检测，这一帧的Movement用；这期间退出了攀爬的也照样写，重新上墙时Ground会重置
+	FHitResult Hit;
+	for (const FPendingProbe& Pending : PendingProbes) {
+		FClimbingMassProbeFragment* Probe = EntityManager.IsEntityValid(Pending.Entity) ? EntityManager.GetFragmentDataPtr<FClimbingMassProbeFragment>(Pending.Entity) : nullptr;
+		if (!Probe) {
+			continue;
+		}
+
+		bool bHit = false;
+		if (UClimbableSurfaceSubsystem::ResolveAsyncLineTraceClimbing(World, Pending.SurfaceTrace, Hit, bHit)) {
+			Probe->bSurfaceHit = bHit;
+			if (bHit) {
+				Probe->HitLocation = Hit.ImpactPoint;
+				Probe->HitNormal = Hit.ImpactNormal;
+			}
+		}
+		// 没轮到向下检测的沿用上次的结果，检测到地面的当帧就退出攀爬了
+		if (Pending.bProbedFloor && UClimbableSurfaceSubsystem::ResolveAsyncLineTraceClimbing(World, Pending.FloorTrace, Hit, bHit)) {
+			Probe->bFloorHit = bHit;
+		}
+	}
+	PendingProbes.Reset();
+
+	// 2. 提交这一帧的检测
+	EntityQuery.ForEachEntityChunk(EntityManager, Context, [this, World, &Params, FloorStride](FMassExecutionContext& Context) {
+		const FClimbingMassSettingsFragment& Settings = Context.GetConstSharedFragment<FClimbingMassSettingsFragment>();
+		const TConstArrayView<FTransformFragment> Transforms = Context.GetFragmentView<FTransformFragment>();
+		const TConstArrayView<FClimbingMassSurfaceFragment> Surfaces = Context.GetFragmentView<FClimbingMassSurfaceFragment>();
+
+		// 和ClimbProbeLength一样是离墙距离再往前50
+		const float SurfaceProbeLength = Settings.WallDistance + 50.f;
+
+		for (int32 Index = 0; Index < Context.GetNumEntities(); ++Index) {
+			const FTransform& Transform = Transforms[Index].GetTransform();
+			const FVector Location = Transform.GetLocation();
+			FPendingProbe& Pending = PendingProbes.AddDefaulted_GetRef();
+			Pending.Entity = Context.GetEntity(Index);
+
+			// 沿上一次墙面法线的反方向检测，也就是角色面朝的方向
+			UClimbableSurfaceSubsystem::AsyncLineTraceClimbing(World, Pending.SurfaceTrace, Location, Location - Surfaces[Index].Normal * SurfaceProbeLength, ECC_Climbable, Params);
+
+			Pending.bProbedFloor = (uint32(Pending.Entity.Index) + uint32(GFrameCounter)) % FloorStride == 0;
+			if (Pending.bProbedFloor) {
+				const FVector FloorEnd = Location - Transform.GetRotation().GetUpVector() * Settings.ExitClimbingDetection;
+				UClimbableSurfaceSubsystem::AsyncLineTraceClimbing(World, Pending.FloorTrace, Location, FloorEnd, ECC_Visibility, Params);
+			}
+		}
+	});
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UClimbingMassMovementProcessor
+
+UClimbingMassMovementProcessor::UClimbingMassMovementProcessor() {
+	ExecutionFlags = int32(EProcessorExecutionFlags::Standalone | EProcessorExecutionFlags::Server);
+	ExecutionOrder.ExecuteInGroup = ClimbingMass::ProcessorGroup;
+	ExecutionOrder.ExecuteAfter.Add(UClimbingMassProbeProcessor::StaticClass()->GetFName());
+	bRequiresGameThreadExecution = false;
+}
+
+void UClimbingMassMovementProcessor::ConfigureQueries() {
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FClimbingMassSurfaceFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FClimbingMassProbeFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FClimbingMassInputFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddConstSharedRequirement<FClimbingMassSettingsFragment>();
+	EntityQuery.AddTagRequirement<FClimbingMassClimbingTag>(EMassFragmentPresence::All);
+	EntityQuery.RegisterWithProcessor(*this);
+}
+
+void UClimbingMassMovementProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingMassMovement);
+
+	EntityQuery.ForEachEntityChunk(EntityManager, Context, [this](FMassExecutionContext& Context) {
+		const int32 NumEntities = Context.GetNumEntities();
+		const float DeltaTime = Context.GetDeltaTimeSeconds();
+		const FClimbingMassSettingsFragment& Settings = Context.GetConstSharedFragment<FClimbingMassSettingsFragment>();
+		const TArrayView<FTransformFragment> Transforms = Context.GetMutableFragmentView<FTransformFragment>();
+		const TArrayView<FClimbingMassSurfaceFragment> Surfaces = Context.GetMutableFragmentView<FClimbingMassSurfaceFragment>();
+		const TConstArrayView<FClimbingMassProbeFragment> Probes = Context.GetFragmentView<FClimbingMassProbeFragment>();
+		const TConstArrayView<FClimbingMassInputFragment> Inputs = Context.GetFragmentView<FClimbingMassInputFragment>();
+
+		for (TArray<float>* Array : { &Px, &Py, &Pz, &Nx, &Ny, &Nz, &Rx, &Ry, &Rz, &Ux, &Uy, &Uz, &Sx, &Sy, &Sz, &Cx, &Cy, &Cz, &Tx, &Ty, &Tz, &SnapDistances, &ActorUpZ }) {
+			Array->SetNumUninitialized(NumEntities, false);
+		}
+		ShouldExit.SetNumUninitialized(NumEntities, false);
+
+		// 1. 检测结果拷到SoA，没检测到墙的沿用之前的墙面，后面不会移动它
+		// 位置都减掉Entity自己的位置再转成float，离原点再远也只剩下探测长度以内的偏移，不会丢LWC的精度
+		for (int32 Index = 0; Index < NumEntities; ++Index) {
+			const FClimbingMassProbeFragment& Probe = Probes[Index];
+			const FVector& Origin = Transforms[Index].GetTransform().GetLocation();
+			const FVector Location = (Probe.bSurfaceHit ? Probe.HitLocation : Surfaces[Index].Location) - Origin;
+			const FVector& Normal = Probe.bSurfaceHit ? Probe.HitNormal : Surfaces[Index].Normal;
+			Px[Index] = Location.X;
+			Py[Index] = Location.Y;
+			Pz[Index] = Location.Z;
+			Nx[Index] = Normal.X;
+			Ny[Index] = Normal.Y;
+			Nz[Index] = Normal.Z;
+			SnapDistances[Index] = Settings.WallDistance;
+			ActorUpZ[Index] = Transforms[Index].GetTransform().GetRotation().GetUpVector().Z;
+		}
+
+		// 2. 切线、退出角度和贴墙目标一次算完整个Chunk
+		ClimbingMath::TangentBasisBatch(Nx.GetData(), Ny.GetData(), Nz.GetData(), Rx.GetData(), Ry.GetData(), Rz.GetData(), Ux.GetData(), Uy.GetData(), Uz.GetData(), NumEntities);
+		ClimbingMath::ExitTiltBatch(ActorUpZ.GetData(), Settings.ExitTiltCos, ShouldExit.GetData(), NumEntities);
+		ClimbingMath::SnapTargetBatch(Px.GetData(), Py.GetData(), Pz.GetData(), Nx.GetData(), Ny.GetData(), Nz.GetData(), SnapDistances.GetData(), Sx.GetData(), Sy.GetData(), Sz.GetData(), NumEntities);
+
+		// 3. 沿切线移动，贴墙目标只取法线方向上的分量，和PhysClimbing一样切线方向完全由速度决定
+		for (int32 Index = 0; Index < NumEntities; ++Index) {
+			const FVector Normal(Nx[Index], Ny[Index], Nz[Index]);
+			const FVector Right(Rx[Index], Ry[Index], Rz[Index]);
+			const FVector Up(Ux[Index], Uy[Index], Uz[Index]);
+			const FVector2D& Input = Inputs[Index].MoveInput;
+			const FVector Velocity = (-Right * Input.X + Up * Input.Y).GetClampedToMaxSize(1.f) * Settings.MaxClimbSpeed;
+
+			const FVector Current = Probes[Index].bSurfaceHit ? Velocity * DeltaTime : FVector::ZeroVector;
+			const FVector Target = Current + Normal * FVector::DotProduct(FVector(Sx[Index], Sy[Index], Sz[Index]) - Current, Normal);
+			Cx[Index] = Current.X;
+			Cy[Index] = Current.Y;
+			Cz[Index] = Current.Z;
+			Tx[Index] = Target.X;
+			Ty[Index] = Target.Y;
+			Tz[Index] = Target.Z;
+		}
+		const float Alpha = float(ClimbingMath::InterpAlpha(DeltaTime, Settings.ClimbSnapSpeed));
+		ClimbingMath::InterpToBatch(Cx.GetData(), Cy.GetData(), Cz.GetData(), Tx.GetData(), Ty.GetData(), Tz.GetData(), Alpha, NumEntities);
+
+		// 4. 写回，落地或者倾斜太大的退出攀爬
+		for (int32 Index = 0; Index < NumEntities; ++Index) {
+			const FClimbingMassProbeFragment& Probe = Probes[Index];
+			FClimbingMassSurfaceFragment& Surface = Surfaces[Index];
+			FTransform& Transform = Transforms[Index].GetMutableTransform();
+			if (Probe.bFloorHit || ShouldExit[Index]) {
+				// 和ExitClimbing一样只保留Yaw，背对墙面走开，不然Ground马上又会撞回这面墙
+				const FVector Away = Surface.Normal.GetSafeNormal2D();
+				const float Yaw = Away.IsNearlyZero() ? Transform.Rotator().Yaw : Away.Rotation().Yaw;
+				Transform.SetRotation(FRotator(0.f, Yaw, 0.f).Quaternion());
+				Context.Defer().SwapTags<FClimbingMassClimbingTag, FClimbingMassGroundedTag>(Context.GetEntity(Index));
+				continue;
+			}
+
+			Surface.bValid = Probe.bSurfaceHit;
+			if (!Surface.bValid) {
+				// 前面没有墙的时候原地不动
+				continue;
+			}
+			const FVector Origin = Transform.GetLocation();
+			Surface.Location = Origin + FVector(Px[Index], Py[Index], Pz[Index]);
+			Surface.Normal = FVector(Nx[Index], Ny[Index], Nz[Index]);
+			Surface.Right = FVector(Rx[Index], Ry[Index], Rz[Index]);
+			Surface.Up = FVector(Ux[Index], Uy[Index], Uz[Index]);
+
+			const FQuat DesiredRotation = FRotationMatrix::MakeFromX(-Surface.Normal).ToQuat();
+			Transform.SetLocation(Origin + FVector(Cx[Index], Cy[Index], Cz[Index]));
+			Transform.SetRotation(FQuat::Slerp(Transform.GetRotation(), DesiredRotation, Alpha));
+		}
+	});
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UClimbingMassMantleProcessor
+
+UClimbingMassMantleProcessor::UClimbingMassMantleProcessor() {
+	ExecutionFlags = int32(EProcessorExecutionFlags::Standalone | EProcessorExecutionFlags::Server);
+	ExecutionOrder.ExecuteInGroup = ClimbingMass::ProcessorGroup;
+	ExecutionOrder.ExecuteAfter.Add(UClimbingMassMovementProcessor::StaticClass()->GetFName());
+	bRequiresGameThreadExecution = true;
+}
+
+void UClimbingMassMantleProcessor::ConfigureQueries() {
+	ClimbingQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	ClimbingQuery.AddRequirement<FClimbingMassSurfaceFragment>(EMassFragmentAccess::ReadOnly);
+	ClimbingQuery.AddRequirement<FClimbingMassInputFragment>(EMassFragmentAccess::ReadOnly);
+	ClimbingQuery.AddRequirement<FClimbingMassMantleFragment>(EMassFragmentAccess::ReadWrite);
+	ClimbingQuery.AddConstSharedRequirement<FClimbingMassSettingsFragment>();
+	ClimbingQuery.AddTagRequirement<FClimbingMassClimbingTag>(EMassFragmentPresence::All);
+	ClimbingQuery.RegisterWithProcessor(*this);
+
+	MantlingQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
+	MantlingQuery.AddRequirement<FClimbingMassMantleFragment>(EMassFragmentAccess::ReadWrite);
+	MantlingQuery.AddConstSharedRequirement<FClimbingMassSettingsFragment>();
+	MantlingQuery.AddTagRequirement<FClimbingMassMantlingTag>(EMassFragmentPresence::All);
+	MantlingQuery.RegisterWithProcessor(*this);
+}
+
+void UClimbingMassMantleProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingMassMantle);
+
+	const UWorld* World = Context.GetWorld();
+	const FCollisionQueryParams Params(SCENE_QUERY_STAT(ClimbingMassMantle), false);
+	const UClimbingLedgeSubsystem* LedgeSubsystem = World->GetSubsystem<UClimbingLedgeSubsystem>();
+	const UClimbingLedgeGraph* LedgeGraph = LedgeSubsystem ? LedgeSubsystem->GetLedgeGraph() : nullptr;
+	const uint32 Stride = uint32(FMath::Max(CVarClimbingMassMantleCheckStride.GetValueOnGameThread(), 1));
+
+	// 1. 向上爬并且轮到检测的攀爬者，做和CheckMantle一样的检测
+	ClimbingQuery.ForEachEntityChunk(EntityManager, Context, [World, &Params, LedgeGraph, Stride](FMassExecutionContext& Context) {
+		const FClimbingMassSettingsFragment& Settings = Context.GetConstSharedFragment<FClimbingMassSettingsFragment>();
+		const TConstArrayView<FTransformFragment> Transforms = Context.GetFragmentView<FTransformFragment>();
+		const TConstArrayView<FClimbingMassSurfaceFragment> Surfaces = Context.GetFragmentView<FClimbingMassSurfaceFragment>();
+		const TConstArrayView<FClimbingMassInputFragment> Inputs = Context.GetFragmentView<FClimbingMassInputFragment>();
+		const TArrayView<FClimbingMassMantleFragment> Mantles = Context.GetMutableFragmentView<FClimbingMassMantleFragment>();
+
+		for (int32 Index = 0; Index < Context.GetNumEntities(); ++Index) {
+			const FMassEntityHandle Entity = Context.GetEntity(Index);
+			if (Inputs[Index].MoveInput.Y <= 0.f || !Surfaces[Index].bValid || (uint32(Entity.Index) + uint32(GFrameCounter)) % Stride != 0) {
+				continue;
+			}
+
+			const FVector Location = Transforms[Index].GetTransform().GetLocation();
+			const FVector Forward2D = (-Surfaces[Index].Normal).GetSafeNormal2D();
+			FVector TargetLocation;
+			bool bCanMantle = false;
+			bool bCovered = false;
+			if (LedgeGraph) {
+				bCanMantle = LedgeGraph->FindMantleTarget(Location, Forward2D, Settings.WallDetectionLength, Settings.CapsuleHalfHeight, TargetLocation, bCovered);
+			}
+			if (!bCovered) {
+				FHitResult WallHit;
+				if (UClimbableSurfaceSubsystem::LineTraceClimbing(World, WallHit, Location, Location + Forward2D * Settings.WallDetectionLength, ECC_Climbable, Params)) {
+					const FVector Start = WallHit.ImpactPoint - WallHit.ImpactNormal * 50.f + FVector::UpVector * Settings.CapsuleHalfHeight;
+					const FVector End = Start + FVector::DownVector * Settings.CapsuleHalfHeight * 2.f;
+					FHitResult LedgeHit;
+					if (UClimbableSurfaceSubsystem::LineTraceClimbing(World, LedgeHit, Start, End, ECC_Climbable, Params)) {
+						bCanMantle = LedgeHit.ImpactNormal.Z >= Settings.WalkableFloorZ;
+						TargetLocation = LedgeHit.ImpactPoint;
+					}
+				}
+			}
+
+			if (bCanMantle) {
+				FClimbingMassMantleFragment& Mantle = Mantles[Index];
+				Mantle.StartLocation = Location;
+				Mantle.TargetLocation = TargetLocation + FVector(0.f, 0.f, Settings.CapsuleHalfHeight);
+				Mantle.Elapsed = 0.f;
+				Context.Defer().SwapTags<FClimbingMassClimbingTag, FClimbingMassMantlingTag>(Entity);
+			}
+		}
+	});
+
+	// 2. 和UClimbingMovementComponent的Mantle一样，前一半时间沿墙升到Ledge上方，后一半平移到站立的位置
+	MantlingQuery.ForEachEntityChunk(EntityManager, Context, [](FMassExecutionContext& Context) {
+		const float DeltaTime = Context.GetDeltaTimeSeconds();
+		const FClimbingMassSettingsFragment& Settings = Context.GetConstSharedFragment<FClimbingMassSettingsFragment>();
+		const TArrayView<FTransformFragment> Transforms = Context.GetMutableFragmentView<FTransformFragment>();
+		const TArrayView<FClimbingMassMantleFragment> Mantles = Context.GetMutableFragmentView<FClimbingMassMantleFragment>();
+
+		for (int32 Index = 0; Index < Context.GetNumEntities(); ++Index) {
+			FClimbingMassMantleFragment& Mantle = Mantles[Index];
+			Mantle.Elapsed += DeltaTime;
+			const float Alpha = FMath::Clamp(Mantle.Elapsed / FMath::Max(Settings.MantleDuration, UE_KINDA_SMALL_NUMBER), 0.f, 1.f);
+
+			FVector RiseLocation = Mantle.StartLocation;
+			RiseLocation.Z = FMath::Max(RiseLocation.Z, Mantle.TargetLocation.Z + 5.f);
+			const FVector Location = Alpha < 0.5f
+				? FMath::Lerp(Mantle.StartLocation, RiseLocation, Alpha * 2.f)
+				: FMath::Lerp(RiseLocation, Mantle.TargetLocation, Alpha * 2.f - 1.f);
+
+			FTransform& Transform = Transforms[Index].GetMutableTransform();
+			Transform.SetLocation(Location);
+			if (Alpha >= 1.f) {
+				// 和退出攀爬时一样只保留Yaw
+				Transform.SetRotation(FRotator(0.f, Transform.Rotator().Yaw, 0.f).Quaternion());
+				Context.Defer().SwapTags<FClimbingMassMantlingTag, FClimbingMassGroundedTag>(Context.GetEntity(Index));
+			}
+		}
+	});
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UClimbingMassPromotionProcessor
+
+UClimbingMassPromotionProcessor::UClimbingMassPromotionProcessor() {
+	ExecutionFlags = int32(EProcessorExecutionFlags::Standalone | EProcessorExecutionFlags::Server);
+	ExecutionOrder.ExecuteInGroup = ClimbingMass::ProcessorGroup;
+	ExecutionOrder.ExecuteAfter.Add(UClimbingMassMantleProcessor::StaticClass()->GetFName());
+	bRequiresGameThreadExecution = true;		// 要生成Actor
+}
+
+void UClimbingMassPromotionProcessor::ConfigureQueries() {
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FClimbingMassSurfaceFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FClimbingMassInputFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddTagRequirement<FClimbingMassClimbingTag>(EMassFragmentPresence::All);
+	EntityQuery.RegisterWithProcessor(*this);
+}
+
+void UClimbingMassPromotionProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingMassPromotion);
+
+	UClimbingMassSubsystem* MassSubsystem = Context.GetWorld()->GetSubsystem<UClimbingMassSubsystem>();
+	if (!MassSubsystem) {
+		return;
+	}
+
+	TArray<FVector, TInlineAllocator<4>> PlayerLocations;
+	UClimbingMassSubsystem::GatherPlayerLocations(Context.GetWorld(), PlayerLocations);
+	if (PlayerLocations.Num() == 0) {
+		return;
+	}
+
+	struct FPromotion {
+		FMassEntityHandle Entity;
+		FVector Location;
+		FVector Normal;
+		FVector2D MoveInput;
+	};
+	TArray<FPromotion, TInlineAllocator<8>> Promotions;
+	const int32 MaxPromotions = UClimbingMassSubsystem::GetMaxPromotionsPerFrame();
+	const double PromoteDistanceSquared = FMath::Square(UClimbingMassSubsystem::GetPromoteDistance());
+
+	// 先收集，跑完查询之后再生成Actor
+	EntityQuery.ForEachEntityChunk(EntityManager, Context, [&](FMassExecutionContext& Context) {
+		const TConstArrayView<FTransformFragment> Transforms = Context.GetFragmentView<FTransformFragment>();
+		const TConstArrayView<FClimbingMassSurfaceFragment> Surfaces = Context.GetFragmentView<FClimbingMassSurfaceFragment>();
+		const TConstArrayView<FClimbingMassInputFragment> Inputs = Context.GetFragmentView<FClimbingMassInputFragment>();
+
+		for (int32 Index = 0; Index < Context.GetNumEntities() && Promotions.Num() < MaxPromotions; ++Index) {
+			if (!Surfaces[Index].bValid) {
+				continue;
+			}
+
+			const FVector Location = Transforms[Index].GetTransform().GetLocation();
+			for (const FVector& PlayerLocation : PlayerLocations) {
+				if (FVector::DistSquared(Location, PlayerLocation) <= PromoteDistanceSquared) {
+					Promotions.Add({ Context.GetEntity(Index), Location, Surfaces[Index].Normal, Inputs[Index].MoveInput });
+					break;
+				}
+			}
+		}
+	});
+
+	for (const FPromotion& Promotion : Promotions) {
+		if (MassSubsystem->PromoteToActor(Promotion.Location, Promotion.Normal, Promotion.MoveInput)) {
+			Context.Defer().DestroyEntity(Promotion.Entity);
+		}
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// UClimbingMassGroundProcessor
+
+UClimbingMassGroundProcessor::UClimbingMassGroundProcessor() {
+	ExecutionFlags = int32(EProcessorExecutionFlags::Standalone | EProcessorExecutionFlags::Server);
+	ExecutionOrder.ExecuteInGroup = ClimbingMass::ProcessorGroup;
+	ExecutionOrder.ExecuteAfter.Add(UClimbingMassPromotionProcessor::StaticClass()->GetFName());
+	bRequiresGameThreadExecution = true;
+}
+
+void UClimbingMassGroundProcessor::ConfigureQueries() {
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FClimbingMassSurfaceFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FClimbingMassInputFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FClimbingMassProbeFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FClimbingMassGroundProbeFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddConstSharedRequirement<FClimbingMassSettingsFragment>();
+	EntityQuery.AddTagRequirement<FClimbingMassGroundedTag>(EMassFragmentPresence::All);
+	EntityQuery.RegisterWithProcessor(*this);
+}
+
+void UClimbingMassGroundProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingMassGround);
+
+	UWorld* World = Context.GetWorld();
+	const FCollisionQueryParams Params(SCENE_QUERY_STAT(ClimbingMassGround), false);
+	const AWorldSettings* WorldSettings = World->GetWorldSettings();
+	const double KillZ = WorldSettings ? WorldSettings->KillZ : -UE_OLD_WORLD_MAX;
+	const uint32 Stride = uint32(FMath::Max(CVarClimbingMassGroundCheckStride.GetValueOnGameThread(), 1));
+
+	// 1. 取回上一帧提交的检测，提交之后Entity一直留在地面上，只可能被销毁
+	FHitResult Hit;
+	for (const FPendingGroundProbe& Pending : PendingGroundProbes) {
+		FClimbingMassGroundProbeFragment* Ground = EntityManager.IsEntityValid(Pending.Entity) ? EntityManager.GetFragmentDataPtr<FClimbingMassGroundProbeFragment>(Pending.Entity) : nullptr;
+		bool bFloorHit = false;
+		if (!Ground || !UClimbableSurfaceSubsystem::ResolveAsyncLineTraceClimbing(World, Pending.FloorTrace, Hit, bFloorHit)) {
+			// 结果没回来就等下一次检测
+			continue;
+		}
+		const FClimbingMassSettingsFragment& Settings = EntityManager.GetConstSharedFragmentDataChecked<FClimbingMassSettingsFragment>(Pending.Entity);
+		Ground->bResolved = true;
+		Ground->bFloorHit = bFloorHit && Hit.ImpactNormal.Z >= Settings.WalkableFloorZ;
+		Ground->FloorZ = Hit.ImpactPoint.Z;
+
+		bool bWallHit = false;
+		Ground->bWallHit = UClimbableSurfaceSubsystem::ResolveAsyncLineTraceClimbing(World, Pending.WallTrace, Hit, bWallHit) && bWallHit
+			&& FMath::Abs(Hit.ImpactNormal.Z) < Settings.WalkableFloorZ;
+		if (Ground->bWallHit) {
+			const UPrimitiveComponent* WallComponent = Hit.GetComponent();
+			Ground->WallLocation = Hit.ImpactPoint;
+			Ground->WallNormal = Hit.ImpactNormal;
+			Ground->bWallClimbable = WallComponent && WallComponent->GetCollisionResponseToChannel(ECC_Climbable) == ECR_Block;
+		}
+	}
+	PendingGroundProbes.Reset();
+
+	for (const FPendingMountProbe& Pending : PendingMountProbes) {
+		FClimbingMassGroundProbeFragment* Ground = EntityManager.IsEntityValid(Pending.Entity) ? EntityManager.GetFragmentDataPtr<FClimbingMassGroundProbeFragment>(Pending.Entity) : nullptr;
+		if (!Ground) {
+			continue;
+		}
+		// 结果丢了当成没打到，不然会一直站在原地等
+		bool bHit = false;
+		Ground->bResolved = true;
+		Ground->bMountHit = UClimbableSurfaceSubsystem::ResolveAsyncLineTraceClimbing(World, Pending.Trace, Hit, bHit) && bHit;
+		if (Ground->bMountHit) {
+			Ground->WallLocation = Hit.ImpactPoint;
+			Ground->WallNormal = Hit.ImpactNormal;
+			Ground->MountLocation = Pending.MountLocation;
+		}
+	}
+	PendingMountProbes.Reset();
+
+	// 2. 按检测结果走、往下掉或者上墙，再提交这一帧的检测
+	EntityQuery.ForEachEntityChunk(EntityManager, Context, [this, World, &Params, KillZ, Stride](FMassExecutionContext& Context) {
+		const float DeltaTime = Context.GetDeltaTimeSeconds();
+		const FClimbingMassSettingsFragment& Settings = Context.GetConstSharedFragment<FClimbingMassSettingsFragment>();
+		const TArrayView<FTransformFragment> Transforms = Context.GetMutableFragmentView<FTransformFragment>();
+		const TArrayView<FClimbingMassSurfaceFragment> Surfaces = Context.GetMutableFragmentView<FClimbingMassSurfaceFragment>();
+		const TConstArrayView<FClimbingMassInputFragment> Inputs = Context.GetFragmentView<FClimbingMassInputFragment>();
+		const TArrayView<FClimbingMassProbeFragment> Probes = Context.GetMutableFragmentView<FClimbingMassProbeFragment>();
+		const TArrayView<FClimbingMassGroundProbeFragment> GroundProbes = Context.GetMutableFragmentView<FClimbingMassGroundProbeFragment>();
+
+		for (int32 Index = 0; Index < Context.GetNumEntities(); ++Index) {
+			const FMassEntityHandle Entity = Context.GetEntity(Index);
+			FClimbingMassGroundProbeFragment& Ground = GroundProbes[Index];
+			FTransform& Transform = Transforms[Index].GetMutableTransform();
+			FVector Location = Transform.GetLocation();
+
+			if (Ground.bMounting) {
+				if (!Ground.bResolved) {
+					// 等上墙检测的结果，不往墙里走
+					continue;
+				}
+				Ground.bMounting = false;
+				Ground.bResolved = false;
+				if (Ground.bMountHit) {
+					// 相当于跳上墙，Probe里上次攀爬留下的结果换成这面墙，不然下一帧Movement会用旧的结果
+					FClimbingMassSurfaceFragment& Surface = Surfaces[Index];
+					Surface.Location = Ground.WallLocation;
+					Surface.Normal = Ground.WallNormal;
+					Surface.bValid = true;
+					FClimbingMassProbeFragment& Probe = Probes[Index];
+					Probe.HitLocation = Ground.WallLocation;
+					Probe.HitNormal = Ground.WallNormal;
+					Probe.bSurfaceHit = true;
+					Probe.bFloorHit = false;
+					Transform.SetLocation(Ground.MountLocation);
+					Transform.SetRotation(FRotationMatrix::MakeFromX(-Ground.WallNormal).ToQuat());
+					Context.Defer().SwapTags<FClimbingMassGroundedTag, FClimbingMassClimbingTag>(Entity);
+					continue;
+				}
+
+				// 墙太矮，转身往回走
+				Transform.SetRotation(FRotator(0.f, Transform.Rotator().Yaw + 180.f, 0.f).Quaternion());
+			} else if (Ground.bResolved) {
+				// 1. 和Walking一样贴着地面走，MaxStepHeight以内的台阶直接踩上去；脚下没有地面就往下掉
+				Ground.bResolved = false;
+				Ground.bFalling = !Ground.bFloorHit;
+				if (Ground.bFloorHit) {
+					Location.Z = Ground.FloorZ + Settings.CapsuleHalfHeight;
+
+					// 2. 前面有墙: 能爬的墙并且还想往上爬就上墙，否则掉头
+					if (Ground.bWallHit) {
+						Transform.SetLocation(Location);
+						if (Inputs[Index].MoveInput.Y > 0.f && Ground.bWallClimbable) {
+							// 直接抬到ExitClimbingDetection以上，不然Probe的向下检测又会把它放回地面；先确认那个高度上还有墙
+							FPendingMountProbe& Pending = PendingMountProbes.AddDefaulted_GetRef();
+							Pending.Entity = Entity;
+							Pending.MountLocation = Ground.WallLocation + Ground.WallNormal * Settings.WallDistance;
+							Pending.MountLocation.Z = Ground.FloorZ + Settings.ExitClimbingDetection + 10.f;
+							UClimbableSurfaceSubsystem::AsyncLineTraceClimbing(World, Pending.Trace, Pending.MountLocation, Pending.MountLocation - Ground.WallNormal * (Settings.WallDistance + 50.f), ECC_Climbable, Params);
+							Ground.bMounting = true;
+							continue;
+						}
+						Transform.SetRotation(FRotator(0.f, Transform.Rotator().Yaw + 180.f, 0.f).Quaternion());
+					}
+				}
+			}
+
+			// 3. 没轮到检测的帧按上次的结果走或者往下掉，掉出世界和Actor一样销毁
+			const FVector Forward = Transform.GetRotation().GetForwardVector().GetSafeNormal2D();
+			if (Ground.bFalling) {
+				Location.Z -= Settings.FallSpeed * DeltaTime;
+				if (Location.Z < KillZ) {
+					Context.Defer().DestroyEntity(Entity);
+					continue;
+				}
+			} else {
+				Location += Forward * Settings.MaxWalkSpeed * DeltaTime;
+			}
+			Transform.SetLocation(Location);
+
+			// 4. 提交检测，下一帧才用；往下掉的每帧都检测，不然落地太晚会穿过地面
+			if (Ground.bFalling || (uint32(Entity.Index) + uint32(GFrameCounter)) % Stride == 0) {
+				FPendingGroundProbe& Pending = PendingGroundProbes.AddDefaulted_GetRef();
+				Pending.Entity = Entity;
+				const FVector FloorEnd = Location - FVector(0.f, 0.f, Settings.CapsuleHalfHeight + Settings.MaxStepHeight);
+				UClimbableSurfaceSubsystem::AsyncLineTraceClimbing(World, Pending.FloorTrace, Location, FloorEnd, ECC_Visibility, Params);
+				UClimbableSurfaceSubsystem::AsyncLineTraceClimbing(World, Pending.WallTrace, Location, Location + Forward * Settings.WallDetectionLength, ECC_Visibility, Params);
+			}
+		}
+	});
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UClimbingMassRepresentationProcessor
+
+UClimbingMassRepresentationProcessor::UClimbingMassRepresentationProcessor() {
+	ExecutionFlags = int32(EProcessorExecutionFlags::Standalone | EProcessorExecutionFlags::Server);
+	ExecutionOrder.ExecuteInGroup = ClimbingMass::ProcessorGroup;
+	ExecutionOrder.ExecuteAfter.Add(UClimbingMassGroundProcessor::StaticClass()->GetFName());
+	bRequiresGameThreadExecution = true;		// 要写进AClimbingMassCrowdActor
+}
+
+void UClimbingMassRepresentationProcessor::ConfigureQueries() {
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddTagRequirement<FClimbingMassClimbingTag>(EMassFragmentPresence::Any);
+	EntityQuery.AddTagRequirement<FClimbingMassMantlingTag>(EMassFragmentPresence::Any);
+	EntityQuery.AddTagRequirement<FClimbingMassGroundedTag>(EMassFragmentPresence::Any);
+	EntityQuery.RegisterWithProcessor(*this);
+}
+
+void UClimbingMassRepresentationProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingMassRepresentation);
+
+	UClimbingMassSubsystem* MassSubsystem = Context.GetWorld()->GetSubsystem<UClimbingMassSubsystem>();
+	if (!MassSubsystem) {
+		return;
+	}
+
+	Entries.Reset();
+	EntityQuery.ForEachEntityChunk(EntityManager, Context, [this](FMassExecutionContext& Context) {
+		// 状态是Tag，同一个Chunk里都一样
+		const uint8 State = Context.DoesArchetypeHaveTag<FClimbingMassClimbingTag>() ? ClimbingMassCrowd_Climbing
+			: Context.DoesArchetypeHaveTag<FClimbingMassMantlingTag>() ? ClimbingMassCrowd_Mantling
+			: ClimbingMassCrowd_Grounded;
+		const TConstArrayView<FTransformFragment> Transforms = Context.GetFragmentView<FTransformFragment>();
+
+		for (int32 Index = 0; Index < Context.GetNumEntities(); ++Index) {
+			const FTransform& Transform = Transforms[Index].GetTransform();
+			Entries.Add({ Context.GetEntity(Index).AsNumber(), Transform.GetLocation(), Transform.GetRotation().GetForwardVector(), State });
+		}
+	});
+
+	MassSubsystem->UpdateRepresentation(Entries);
+}
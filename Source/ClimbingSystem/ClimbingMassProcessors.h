@@ -0,0 +1,168 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+#include "MassEntityQuery.h"
+#include "ClimbableSurfaceSubsystem.h"
+#include "ClimbingMassCrowdActor.h"
+#include "ClimbingMassProcessors.generated.h"
+
+/**
+ * Mass攀爬者每帧的处理顺序: Probe -> Movement -> Mantle -> Promotion -> Ground -> Representation
+ * 场景查询只能在GameThread上做，纯计算的Movement可以放到Worker上
+ */
+
+/**
+ * 对每个攀爬者做和PhysClimbing一样的墙面检测，以及和DetectShouldExitClimbing一样的向下检测
+ * 检测都是异步提交的，下一帧先取回结果写进FClimbingMassProbeFragment再提交新的；向下检测每FloorCheckStride帧一次，按Entity错开
+ */
+UCLASS()
+class UClimbingMassProbeProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UClimbingMassProbeProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+private:
+	FMassEntityQuery EntityQuery;
+
+	struct FPendingProbe {
+		FMassEntityHandle Entity;
+		FClimbingAsyncTrace SurfaceTrace;
+		FClimbingAsyncTrace FloorTrace;
+		bool bProbedFloor = false;
+	};
+	TArray<FPendingProbe> PendingProbes;
+};
+
+/**
+ * 按Chunk把检测结果拷到SoA数组里，用ClimbingMath的批量函数算切线、退出角度和贴墙目标，再沿墙面切线移动
+ * SoA里的位置都是相对Entity自己位置的偏移，float够用
+ * 落地或者倾斜超过30°的攀爬者切到Grounded
+ */
+UCLASS()
+class UClimbingMassMovementProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UClimbingMassMovementProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+private:
+	FMassEntityQuery EntityQuery;
+
+	// 每个Chunk复用的SoA数组
+	TArray<float> Px, Py, Pz;
+	TArray<float> Nx, Ny, Nz;
+	TArray<float> Rx, Ry, Rz;
+	TArray<float> Ux, Uy, Uz;
+	TArray<float> Sx, Sy, Sz;
+	TArray<float> Cx, Cy, Cz;
+	TArray<float> Tx, Ty, Tz;
+	TArray<float> SnapDistances;
+	TArray<float> ActorUpZ;
+	TArray<uint8> ShouldExit;
+};
+
+/**
+ * 向上爬的攀爬者做和CheckMantle一样的检测，能站上去时切到Mantling
+ * 检测按Entity错开，每个攀爬者每MantleCheckStride帧检测一次
+ */
+UCLASS()
+class UClimbingMassMantleProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UClimbingMassMantleProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+private:
+	FMassEntityQuery ClimbingQuery;
+	FMassEntityQuery MantlingQuery;
+};
+
+/** 离玩家足够近的攀爬者换成完整的AClimbingSystemCharacter，由UClimbingMassSubsystem接管 */
+UCLASS()
+class UClimbingMassPromotionProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UClimbingMassPromotionProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+private:
+	FMassEntityQuery EntityQuery;
+};
+
+/**
+ * 退出攀爬(落地或者Mantle结束)的攀爬者在地面上按MaxWalkSpeed往前走，能爬的墙并且还想往上爬时重新上墙
+ * 背景攀爬者不做完整的Walking，只贴着地面走、跨台阶和往下掉
+ * 地面和墙面检测异步提交，每GroundCheckStride帧一次，按Entity错开；往下掉的每帧都检测
+ */
+UCLASS()
+class UClimbingMassGroundProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UClimbingMassGroundProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+private:
+	FMassEntityQuery EntityQuery;
+
+	struct FPendingGroundProbe {
+		FMassEntityHandle Entity;
+		FClimbingAsyncTrace FloorTrace;
+		FClimbingAsyncTrace WallTrace;
+	};
+	TArray<FPendingGroundProbe> PendingGroundProbes;
+
+	struct FPendingMountProbe {
+		FMassEntityHandle Entity;
+		FVector MountLocation;
+		FClimbingAsyncTrace Trace;
+	};
+	TArray<FPendingMountProbe> PendingMountProbes;
+};
+
+/** 把所有攀爬者的位置交给UClimbingMassSubsystem，由AClimbingMassCrowdActor画出来并同步给客户端 */
+UCLASS()
+class UClimbingMassRepresentationProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UClimbingMassRepresentationProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+private:
+	FMassEntityQuery EntityQuery;
+
+	TArray<FClimbingMassCrowdEntry> Entries;
+};
@@ -0,0 +1,240 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingMassSubsystem.h"
+#include "ClimbingMassCrowdActor.h"
+#include "ClimbingMassFragments.h"
+#include "ClimbingMassTrait.h"
+#include "ClimbingMovementComponent.h"
+#include "ClimbingSystem.h"
+#include "ClimbingSystemCharacter.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "MassCommonFragments.h"
+#include "MassEntityUtils.h"
+#include "MassSpawnerSubsystem.h"
+
+static TAutoConsoleVariable<float> CVarClimbingMassPromoteDistance(
+	TEXT("Climbing.Mass.PromoteDistance"),
+	1500.f,
+	TEXT("Mass攀爬者离玩家在这个距离内时换成完整的AClimbingSystemCharacter"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarClimbingMassDemoteDistance(
+	TEXT("Climbing.Mass.DemoteDistance"),
+	2500.f,
+	TEXT("换出来的Actor离所有玩家都超过这个距离时换回Mass Entity，要比PromoteDistance大，避免来回切换"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarClimbingMassMaxPromotionsPerFrame(
+	TEXT("Climbing.Mass.MaxPromotionsPerFrame"),
+	4,
+	TEXT("每帧最多生成多少个Actor，避免一大群攀爬者同时进入范围时卡一帧"),
+	ECVF_Default);
+
+UClimbingMassSubsystem::UClimbingMassSubsystem() {
+	ClimberClass = TSoftClassPtr<AClimbingSystemCharacter>(FSoftObjectPath(TEXT("/Game/ThirdPerson/Blueprints/BP_ThirdPersonCharacter.BP_ThirdPersonCharacter_C")));
+	CrowdActor = nullptr;
+}
+
+void UClimbingMassSubsystem::Initialize(FSubsystemCollectionBase& Collection) {
+	Super::Initialize(Collection);
+	Collection.InitializeDependency<UMassSpawnerSubsystem>();
+}
+
+void UClimbingMassSubsystem::Deinitialize() {
+	if (ClimberClassHandle.IsValid()) {
+		ClimberClassHandle->CancelHandle();
+		ClimberClassHandle.Reset();
+	}
+	PendingSpawnRequests.Reset();
+
+	Super::Deinitialize();
+}
+
+void UClimbingMassSubsystem::OnWorldBeginPlay(UWorld& InWorld) {
+	Super::OnWorldBeginPlay(InWorld);
+
+	// 客户端不模拟Mass，也就不需要攀爬者的类；这时候网络模式已经确定了
+	if (InWorld.GetNetMode() == NM_Client) {
+		return;
+	}
+
+	if (ClimberClass.IsNull() || ClimberClass.Get()) {
+		OnClimberClassLoaded();
+		return;
+	}
+	ClimberClassHandle = StreamableManager.RequestAsyncLoad(ClimberClass.ToSoftObjectPath(),
+		FStreamableDelegate::CreateUObject(this, &UClimbingMassSubsystem::OnClimberClassLoaded), FStreamableManager::AsyncLoadHighPriority);
+	if (!ClimberClassHandle.IsValid()) {
+		OnClimberClassLoaded();
+	}
+}
+
+void UClimbingMassSubsystem::OnClimberClassLoaded() {
+	ClimberClassHandle.Reset();
+	LoadedClimberClass = ClimberClass.Get();
+	if (!LoadedClimberClass) {
+		if (!ClimberClass.IsNull()) {
+			UE_LOG(LogClimbing, Warning, TEXT("Failed to load Mass climber class '%s', falling back to AClimbingSystemCharacter"), *ClimberClass.ToString());
+		}
+		LoadedClimberClass = AClimbingSystemCharacter::StaticClass();
+	}
+
+	// 不依赖资源，直接在代码里拼一个只有攀爬Trait的配置
+	UClimbingMassTrait* ClimbingTrait = NewObject<UClimbingMassTrait>(this);
+	ClimbingTrait->RulesClass = LoadedClimberClass;
+	EntityConfig.SetOwner(*this);
+	EntityConfig.AddTrait(*ClimbingTrait);
+
+	// 显示和同步所有Entity的Actor，客户端上由同步生成
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	CrowdActor = GetWorld()->SpawnActor<AClimbingMassCrowdActor>(SpawnParams);
+	if (CrowdActor) {
+		const UCapsuleComponent* Capsule = LoadedClimberClass->GetDefaultObject<AClimbingSystemCharacter>()->GetCapsuleComponent();
+		CrowdActor->SetClimberExtent(Capsule->GetScaledCapsuleRadius(), Capsule->GetScaledCapsuleHalfHeight());
+	}
+
+	const TArray<FClimbingMassSpawnRequest> Requests = MoveTemp(PendingSpawnRequests);
+	SpawnClimbers(Requests);
+}
+
+void UClimbingMassSubsystem::SpawnClimbers(TConstArrayView<FClimbingMassSpawnRequest> Requests) {
+	UWorld* World = GetWorld();
+	UMassSpawnerSubsystem* SpawnerSubsystem = World->GetSubsystem<UMassSpawnerSubsystem>();
+	if (!SpawnerSubsystem || Requests.Num() == 0 || World->GetNetMode() == NM_Client) {
+		return;
+	}
+
+	// 规则来自攀爬者的类，类还没加载好时先记下来
+	if (!LoadedClimberClass) {
+		PendingSpawnRequests.Append(Requests.GetData(), Requests.Num());
+		return;
+	}
+
+	const FMassEntityTemplate& EntityTemplate = EntityConfig.GetOrCreateEntityTemplate(*World);
+	TArray<FMassEntityHandle> Entities;
+	SpawnerSubsystem->SpawnEntities(EntityTemplate, Requests.Num(), Entities);
+
+	FMassEntityManager& EntityManager = UE::Mass::Utils::GetEntityManagerChecked(*World);
+	for (int32 Index = 0; Index < Entities.Num(); ++Index) {
+		const FClimbingMassSpawnRequest& Request = Requests[Index];
+		const FQuat Rotation = Request.bGrounded
+			? FRotator(0.f, (-Request.WallNormal).Rotation().Yaw, 0.f).Quaternion()
+			: FRotationMatrix::MakeFromX(-Request.WallNormal).ToQuat();
+		EntityManager.GetFragmentDataChecked<FTransformFragment>(Entities[Index]).SetTransform(FTransform(Rotation, Request.Location));
+		EntityManager.GetFragmentDataChecked<FClimbingMassSurfaceFragment>(Entities[Index]).Normal = Request.WallNormal;
+		EntityManager.GetFragmentDataChecked<FClimbingMassInputFragment>(Entities[Index]).MoveInput = Request.MoveInput;
+		if (Request.bGrounded) {
+			// 模板默认是在墙上的，这里不在处理过程中，直接换Tag
+			EntityManager.SwapTagsForEntity(Entities[Index], FClimbingMassClimbingTag::StaticStruct(), FClimbingMassGroundedTag::StaticStruct());
+		}
+	}
+}
+
+AClimbingSystemCharacter* UClimbingMassSubsystem::PromoteToActor(const FVector& Location, const FVector& WallNormal, const FVector2D& MoveInput) {
+	if (!LoadedClimberClass) {
+		return nullptr;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButDontSpawnIfColliding;
+	AClimbingSystemCharacter* Character = GetWorld()->SpawnActor<AClimbingSystemCharacter>(LoadedClimberClass, Location, FRotationMatrix::MakeFromX(-WallNormal).Rotator(), SpawnParams);
+	if (!Character) {
+		return nullptr;
+	}
+
+	Character->SpawnDefaultController();
+	Character->ScriptedEnterClimbing();
+	PromotedClimbers.Add({ Character, MoveInput });
+	return Character;
+}
+
+void UClimbingMassSubsystem::UpdateRepresentation(TConstArrayView<FClimbingMassCrowdEntry> Entries) {
+	if (CrowdActor) {
+		CrowdActor->SetClimbers(Entries);
+	}
+}
+
+float UClimbingMassSubsystem::GetPromoteDistance() {
+	return CVarClimbingMassPromoteDistance.GetValueOnGameThread();
+}
+
+float UClimbingMassSubsystem::GetDemoteDistance() {
+	return FMath::Max(CVarClimbingMassDemoteDistance.GetValueOnGameThread(), GetPromoteDistance());
+}
+
+int32 UClimbingMassSubsystem::GetMaxPromotionsPerFrame() {
+	return FMath::Max(CVarClimbingMassMaxPromotionsPerFrame.GetValueOnGameThread(), 0);
+}
+
+void UClimbingMassSubsystem::GatherPlayerLocations(const UWorld* World, TArray<FVector, TInlineAllocator<4>>& OutLocations) {
+	OutLocations.Reset();
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It) {
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController && PlayerController->GetPawn()) {
+			OutLocations.Add(PlayerController->GetPawn()->GetActorLocation());
+		}
+	}
+}
+
+bool UClimbingMassSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UClimbingMassSubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UClimbingMassSubsystem, STATGROUP_Tickables);
+}
+
+void UClimbingMassSubsystem::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+
+	if (PromotedClimbers.Num() == 0) {
+		return;
+	}
+
+	TArray<FVector, TInlineAllocator<4>> PlayerLocations;
+	GatherPlayerLocations(GetWorld(), PlayerLocations);
+	const double DemoteDistanceSquared = FMath::Square(GetDemoteDistance());
+
+	TArray<FClimbingMassSpawnRequest, TInlineAllocator<8>> Demotions;
+	for (int32 Index = PromotedClimbers.Num() - 1; Index >= 0; --Index) {
+		const FPromotedClimber& Promoted = PromotedClimbers[Index];
+		AClimbingSystemCharacter* Character = Promoted.Character.Get();
+		if (!Character) {
+			PromotedClimbers.RemoveAtSwap(Index);
+			continue;
+		}
+
+		const UClimbingMovementComponent* ClimbingMovement = Character->GetClimbingMovement();
+		bool bNearPlayer = false;
+		for (const FVector& PlayerLocation : PlayerLocations) {
+			if (FVector::DistSquared(Character->GetActorLocation(), PlayerLocation) <= DemoteDistanceSquared) {
+				bNearPlayer = true;
+				break;
+			}
+		}
+
+		// 过渡动作中不换回去，等贴好墙或者站稳再说；落地或者Mantle结束的换回地面上的Entity
+		const bool bClimbing = Character->IsClimbing();
+		const bool bCanDemote = bClimbing ? !ClimbingMovement->IsInClimbTransition() && ClimbingMovement->HasClimbSurface() : ClimbingMovement->IsMovingOnGround();
+		if (!bNearPlayer && bCanDemote) {
+			const FVector WallNormal = bClimbing ? ClimbingMovement->GetClimbSurfaceNormal() : -Character->GetActorForwardVector();
+			Demotions.Add({ Character->GetActorLocation(), WallNormal, Promoted.MoveInput, !bClimbing });
+			if (AController* Controller = Character->GetController()) {
+				Controller->Destroy();
+			}
+			Character->Destroy();
+			PromotedClimbers.RemoveAtSwap(Index);
+			continue;
+		}
+
+		// 地面上的Actor不再给输入，站着等玩家走远
+		if (bClimbing) {
+			Character->AddScriptedMoveInput(Promoted.MoveInput);
+		}
+	}
+
+	SpawnClimbers(Demotions);
+}
@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityConfigAsset.h"
+#include "Engine/StreamableManager.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ClimbingMassSubsystem.generated.h"
+
+class AClimbingMassCrowdActor;
+class AClimbingSystemCharacter;
+struct FClimbingMassCrowdEntry;
+
+/** 在Mass里生成一个攀爬者需要的数据 */
+struct FClimbingMassSpawnRequest {
+	FVector Location = FVector::ZeroVector;		// 贴墙时胶囊体中心的位置
+	FVector WallNormal = FVector::BackwardVector;
+	FVector2D MoveInput = FVector2D(0.f, 1.f);
+	bool bGrounded = false;		// 站在地面上，这时WallNormal是背后的方向
+};
+
+/**
+ * 背景NPC攀爬者的入口，远处的攀爬者是Mass Entity，离玩家近了由UClimbingMassPromotionProcessor换成完整的Actor
+ * 换出来的Actor由这里继续按原来的方向输入，离玩家远了(比Promote的距离再远一段，避免来回切换)再换回Entity
+ * Mass只在服务器和单机上模拟，ClimberClass也只在那里异步加载，加载好之前的生成请求先排队
+ * 所有Entity由AClimbingMassCrowdActor画成ISM并同步给客户端，客户端上这个Subsystem什么都不做
+ */
+UCLASS(config=Game)
+class UClimbingMassSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UClimbingMassSubsystem();
+
+	void SpawnClimbers(TConstArrayView<FClimbingMassSpawnRequest> Requests);
+
+	// 在Entity的位置生成一个正在攀爬的Actor，返回nullptr时Entity保持不变
+	AClimbingSystemCharacter* PromoteToActor(const FVector& Location, const FVector& WallNormal, const FVector2D& MoveInput);
+
+	int32 GetNumPromotedClimbers() const { return PromotedClimbers.Num(); }
+
+	// UClimbingMassRepresentationProcessor每帧调用，交给CrowdActor显示和同步
+	void UpdateRepresentation(TConstArrayView<FClimbingMassCrowdEntry> Entries);
+
+	static float GetPromoteDistance();
+	static float GetDemoteDistance();
+	static int32 GetMaxPromotionsPerFrame();
+
+	// 所有玩家控制的Pawn的位置
+	static void GatherPlayerLocations(const UWorld* World, TArray<FVector, TInlineAllocator<4>>& OutLocations);
+
+	// USubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// UWorldSubsystem interface
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	UPROPERTY(Config)
+	TSoftClassPtr<AClimbingSystemCharacter> ClimberClass;	// 换成Actor时用的类，同时也是Mass规则的来源
+
+private:
+	struct FPromotedClimber {
+		TWeakObjectPtr<AClimbingSystemCharacter> Character;
+		FVector2D MoveInput;
+	};
+
+	void OnClimberClassLoaded();
+
+	UPROPERTY(Transient)
+	TSubclassOf<AClimbingSystemCharacter> LoadedClimberClass;	// 加载好之前为空，Entity不会被换成Actor
+
+	FStreamableManager StreamableManager;
+	TSharedPtr<FStreamableHandle> ClimberClassHandle;
+	TArray<FClimbingMassSpawnRequest> PendingSpawnRequests;
+
+	UPROPERTY()
+	FMassEntityConfig EntityConfig;
+
+	UPROPERTY(Transient)
+	AClimbingMassCrowdActor* CrowdActor;
+
+	TArray<FPromotedClimber> PromotedClimbers;
+};
@@ -0,0 +1,43 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingMassTrait.h"
+#include "ClimbingMassFragments.h"
+#include "ClimbingMathKernels.h"
+#include "ClimbingMovementComponent.h"
+#include "ClimbingSystemCharacter.h"
+#include "Components/CapsuleComponent.h"
+#include "MassCommonFragments.h"
+#include "MassEntityTemplateRegistry.h"
+#include "MassEntityUtils.h"
+
+void UClimbingMassTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const {
+	BuildContext.AddFragment<FTransformFragment>();
+	BuildContext.AddFragment<FClimbingMassSurfaceFragment>();
+	BuildContext.AddFragment<FClimbingMassInputFragment>();
+	BuildContext.AddFragment<FClimbingMassProbeFragment>();
+	BuildContext.AddFragment<FClimbingMassGroundProbeFragment>();
+	BuildContext.AddFragment<FClimbingMassMantleFragment>();
+	BuildContext.AddTag<FClimbingMassClimbingTag>();
+
+	FClimbingMassSettingsFragment Settings;
+	Settings.ExitTiltCos = ClimbingMath::ExitTiltCos;
+	Settings.MantleDuration = MantleDuration;
+
+	const TSubclassOf<AClimbingSystemCharacter> Class = RulesClass ? RulesClass : TSubclassOf<AClimbingSystemCharacter>(AClimbingSystemCharacter::StaticClass());
+	if (const AClimbingSystemCharacter* CharacterCDO = Class->GetDefaultObject<AClimbingSystemCharacter>()) {
+		Settings.WallDetectionLength = CharacterCDO->GetWallDetectionLength();
+		Settings.WallDistance = CharacterCDO->GetWallDistance() + CharacterCDO->GetWallDistanceOffset();
+		Settings.ExitClimbingDetection = CharacterCDO->GetExitClimbingDetection();
+		Settings.CapsuleHalfHeight = CharacterCDO->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+
+		const UClimbingMovementComponent* ClimbingMovement = CharacterCDO->GetClimbingMovement();
+		Settings.MaxClimbSpeed = ClimbingMovement->MaxClimbSpeed;
+		Settings.ClimbSnapSpeed = ClimbingMovement->ClimbSnapSpeed;
+		Settings.WalkableFloorZ = ClimbingMovement->GetWalkableFloorZ();
+		Settings.MaxWalkSpeed = ClimbingMovement->MaxWalkSpeed;
+		Settings.MaxStepHeight = ClimbingMovement->MaxStepHeight;
+	}
+
+	FMassEntityManager& EntityManager = UE::Mass::Utils::GetEntityManagerChecked(World);
+	BuildContext.AddConstSharedFragment(EntityManager.GetOrCreateConstSharedFragment(Settings));
+}
@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTraitBase.h"
+#include "ClimbingMassTrait.generated.h"
+
+class AClimbingSystemCharacter;
+
+/**
+ * 给Entity加上攀爬用的Fragment和Tag，新生成的Entity直接处于攀爬状态
+ * 规则(检测长度、离墙距离、退出角度等)从RulesClass的默认值读取，和Actor版本保持一致
+ */
+UCLASS(meta = (DisplayName = "Climbing"))
+class UClimbingMassTrait : public UMassEntityTraitBase
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, Category = Climbing)
+	TSubclassOf<AClimbingSystemCharacter> RulesClass;
+
+	UPROPERTY(EditAnywhere, Category = Climbing, meta = (ClampMin = "0", ForceUnits = "s"))
+	float MantleDuration = 0.5f;
+
+protected:
+	virtual void BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const override;
+};
@@ -0,0 +1,222 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+// 攀爬用到的墙面数学，不依赖引擎，可以在普通的Linux环境下单独编译、测试和跑benchmark
+// 单个角色用标量版本(double)，批量处理用SoA的float数组，有SSE2的时候一次处理4个
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CLIMBING_MATH_SSE 1
+	#include <emmintrin.h>
+#else
+	#define CLIMBING_MATH_SSE 0
+#endif
+
+namespace ClimbingMath {
+
+// 身体和世界向上方向的夹角超过30°就退出攀爬，退出判断直接比较余弦值，不再算Acos
+constexpr float ExitTiltCos = 0.86602540378f;
+
+//////////////////////////////////////////////////////////////////////////
+// 标量版本
+
+// 墙面向右的切线: Cross(WorldUp, Normal)
+inline void RightTangent(double Nx, double Ny, double Nz, double& OutX, double& OutY, double& OutZ) {
+	(void)Nz;
+	OutX = -Ny;
+	OutY = Nx;
+	OutZ = 0.0;
+}
+
+// 墙面向上的切线: Cross(Normal, Cross(WorldUp, Normal))
+inline void UpTangent(double Nx, double Ny, double Nz, double& OutX, double& OutY, double& OutZ) {
+	OutX = -Nz * Nx;
+	OutY = -Nz * Ny;
+	OutZ = Nx * Nx + Ny * Ny;
+}
+
+// ActorUpZ就是Dot(ActorUp, WorldUp)，夹角大于等于阈值等价于余弦小于等于阈值的余弦
+inline bool ShouldExitByTilt(double ActorUpZ, double CosThreshold = ExitTiltCos) {
+	return ActorUpZ <= CosThreshold;
+}
+
+// 和FMath::VInterpTo相同的插值系数
+inline double InterpAlpha(double DeltaTime, double InterpSpeed) {
+	const double Alpha = DeltaTime * InterpSpeed;
+	return Alpha < 0.0 ? 0.0 : (Alpha > 1.0 ? 1.0 : Alpha);
+}
+
+// 把单位向量八面体编码成两个8位值，网络同步墙面法线用，误差大约在1°以内
+inline void EncodeOctahedral8(double X, double Y, double Z, uint8_t& OutU, uint8_t& OutV) {
+	const double InvL1 = 1.0 / (std::fabs(X) + std::fabs(Y) + std::fabs(Z) + 1e-12);
+	double U = X * InvL1;
+	double V = Y * InvL1;
+	if (Z < 0.0) {
+		const double FoldU = (1.0 - std::fabs(V)) * (U >= 0.0 ? 1.0 : -1.0);
+		const double FoldV = (1.0 - std::fabs(U)) * (V >= 0.0 ? 1.0 : -1.0);
+		U = FoldU;
+		V = FoldV;
+	}
+	OutU = static_cast<uint8_t>(std::lround((U * 0.5 + 0.5) * 255.0));
+	OutV = static_cast<uint8_t>(std::lround((V * 0.5 + 0.5) * 255.0));
+}
+
+inline void DecodeOctahedral8(uint8_t U8, uint8_t V8, double& OutX, double& OutY, double& OutZ) {
+	double U = U8 / 255.0 * 2.0 - 1.0;
+	double V = V8 / 255.0 * 2.0 - 1.0;
+	const double Z = 1.0 - std::fabs(U) - std::fabs(V);
+	if (Z < 0.0) {
+		const double FoldU = (1.0 - std::fabs(V)) * (U >= 0.0 ? 1.0 : -1.0);
+		const double FoldV = (1.0 - std::fabs(U)) * (V >= 0.0 ? 1.0 : -1.0);
+		U = FoldU;
+		V = FoldV;
+	}
+	const double InvLength = 1.0 / std::sqrt(U * U + V * V + Z * Z);
+	OutX = U * InvLength;
+	OutY = V * InvLength;
+	OutZ = Z * InvLength;
+}
+
+// 用最小二乘拟合平面 W = A * U + B * V + C，U/V是墙面内的坐标，W是离墙面的高度
+// 点少于3个或者全在一条线上时返回false
+inline bool FitPlaneLocal(const double* U, const double* V, const double* W, int32_t Count, double& OutA, double& OutB, double& OutC) {
+	if (Count < 3) {
+		return false;
+	}
+
+	// 先减去均值，正规方程就只剩下2x2
+	double MeanU = 0.0, MeanV = 0.0, MeanW = 0.0;
+	for (int32_t Index = 0; Index < Count; ++Index) {
+		MeanU += U[Index];
+		MeanV += V[Index];
+		MeanW += W[Index];
+	}
+	MeanU /= Count;
+	MeanV /= Count;
+	MeanW /= Count;
+
+	double SUU = 0.0, SUV = 0.0, SVV = 0.0, SUW = 0.0, SVW = 0.0;
+	for (int32_t Index = 0; Index < Count; ++Index) {
+		const double DU = U[Index] - MeanU;
+		const double DV = V[Index] - MeanV;
+		const double DW = W[Index] - MeanW;
+		SUU += DU * DU;
+		SUV += DU * DV;
+		SVV += DV * DV;
+		SUW += DU * DW;
+		SVW += DV * DW;
+	}
+
+	const double Det = SUU * SVV - SUV * SUV;
+	if (Det <= 1e-6 * (SUU * SVV + 1e-12)) {
+		return false;
+	}
+
+	OutA = (SUW * SVV - SVW * SUV) / Det;
+	OutB = (SVW * SUU - SUW * SUV) / Det;
+	OutC = MeanW - OutA * MeanU - OutB * MeanV;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// 批量版本，所有数组都是SoA，长度为Count
+
+/** 对一组法线计算向右和向上的切线 */
+inline void TangentBasisBatch(const float* Nx, const float* Ny, const float* Nz,
+                              float* Rx, float* Ry, float* Rz,
+                              float* Ux, float* Uy, float* Uz, int32_t Count) {
+	int32_t Index = 0;
+#if CLIMBING_MATH_SSE
+	const __m128 Zero = _mm_setzero_ps();
+	for (; Index + 4 <= Count; Index += 4) {
+		const __m128 X = _mm_loadu_ps(Nx + Index);
+		const __m128 Y = _mm_loadu_ps(Ny + Index);
+		const __m128 Z = _mm_loadu_ps(Nz + Index);
+		const __m128 NegZ = _mm_sub_ps(Zero, Z);
+
+		_mm_storeu_ps(Rx + Index, _mm_sub_ps(Zero, Y));
+		_mm_storeu_ps(Ry + Index, X);
+		_mm_storeu_ps(Rz + Index, Zero);
+
+		_mm_storeu_ps(Ux + Index, _mm_mul_ps(NegZ, X));
+		_mm_storeu_ps(Uy + Index, _mm_mul_ps(NegZ, Y));
+		_mm_storeu_ps(Uz + Index, _mm_add_ps(_mm_mul_ps(X, X), _mm_mul_ps(Y, Y)));
+	}
+#endif
+	for (; Index < Count; ++Index) {
+		Rx[Index] = -Ny[Index];
+		Ry[Index] = Nx[Index];
+		Rz[Index] = 0.f;
+		Ux[Index] = -Nz[Index] * Nx[Index];
+		Uy[Index] = -Nz[Index] * Ny[Index];
+		Uz[Index] = Nx[Index] * Nx[Index] + Ny[Index] * Ny[Index];
+	}
+}
+
+/** 对一组角色的ActorUp.Z做退出攀爬的倾斜判断，结果写成0/1 */
+inline void ExitTiltBatch(const float* ActorUpZ, float CosThreshold, uint8_t* OutExit, int32_t Count) {
+	int32_t Index = 0;
+#if CLIMBING_MATH_SSE
+	// 一次比较16个，比较结果的全1掩码右移成0/1之后压缩成16个字节一起写，不逐个字节拆movemask
+	const __m128 Threshold = _mm_set1_ps(CosThreshold);
+	for (; Index + 16 <= Count; Index += 16) {
+		const __m128i A = _mm_srli_epi32(_mm_castps_si128(_mm_cmple_ps(_mm_loadu_ps(ActorUpZ + Index + 0), Threshold)), 31);
+		const __m128i B = _mm_srli_epi32(_mm_castps_si128(_mm_cmple_ps(_mm_loadu_ps(ActorUpZ + Index + 4), Threshold)), 31);
+		const __m128i C = _mm_srli_epi32(_mm_castps_si128(_mm_cmple_ps(_mm_loadu_ps(ActorUpZ + Index + 8), Threshold)), 31);
+		const __m128i D = _mm_srli_epi32(_mm_castps_si128(_mm_cmple_ps(_mm_loadu_ps(ActorUpZ + Index + 12), Threshold)), 31);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(OutExit + Index), _mm_packus_epi16(_mm_packs_epi32(A, B), _mm_packs_epi32(C, D)));
+	}
+#endif
+	for (; Index < Count; ++Index) {
+		OutExit[Index] = ActorUpZ[Index] <= CosThreshold ? 1 : 0;
+	}
+}
+
+/** 贴墙的目标位置: 墙面上的点沿法线往外偏移Distance */
+inline void SnapTargetBatch(const float* Px, const float* Py, const float* Pz,
+                            const float* Nx, const float* Ny, const float* Nz,
+                            const float* Distance,
+                            float* OutX, float* OutY, float* OutZ, int32_t Count) {
+	int32_t Index = 0;
+#if CLIMBING_MATH_SSE
+	for (; Index + 4 <= Count; Index += 4) {
+		const __m128 D = _mm_loadu_ps(Distance + Index);
+		_mm_storeu_ps(OutX + Index, _mm_add_ps(_mm_loadu_ps(Px + Index), _mm_mul_ps(_mm_loadu_ps(Nx + Index), D)));
+		_mm_storeu_ps(OutY + Index, _mm_add_ps(_mm_loadu_ps(Py + Index), _mm_mul_ps(_mm_loadu_ps(Ny + Index), D)));
+		_mm_storeu_ps(OutZ + Index, _mm_add_ps(_mm_loadu_ps(Pz + Index), _mm_mul_ps(_mm_loadu_ps(Nz + Index), D)));
+	}
+#endif
+	for (; Index < Count; ++Index) {
+		OutX[Index] = Px[Index] + Nx[Index] * Distance[Index];
+		OutY[Index] = Py[Index] + Ny[Index] * Distance[Index];
+		OutZ[Index] = Pz[Index] + Nz[Index] * Distance[Index];
+	}
+}
+
+/** 一组位置同时向各自的目标插值，Alpha由InterpAlpha算出，所有元素共用 */
+inline void InterpToBatch(float* Cx, float* Cy, float* Cz,
+                          const float* Tx, const float* Ty, const float* Tz,
+                          float Alpha, int32_t Count) {
+	int32_t Index = 0;
+#if CLIMBING_MATH_SSE
+	const __m128 A = _mm_set1_ps(Alpha);
+	for (; Index + 4 <= Count; Index += 4) {
+		const __m128 X = _mm_loadu_ps(Cx + Index);
+		const __m128 Y = _mm_loadu_ps(Cy + Index);
+		const __m128 Z = _mm_loadu_ps(Cz + Index);
+		_mm_storeu_ps(Cx + Index, _mm_add_ps(X, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Tx + Index), X), A)));
+		_mm_storeu_ps(Cy + Index, _mm_add_ps(Y, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Ty + Index), Y), A)));
+		_mm_storeu_ps(Cz + Index, _mm_add_ps(Z, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Tz + Index), Z), A)));
+	}
+#endif
+	for (; Index < Count; ++Index) {
+		Cx[Index] += (Tx[Index] - Cx[Index]) * Alpha;
+		Cy[Index] += (Ty[Index] - Cy[Index]) * Alpha;
+		Cz[Index] += (Tz[Index] - Cz[Index]) * Alpha;
+	}
+}
+
+} // namespace ClimbingMath
@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingMontagePreloadSubsystem.h"
+#include "Animation/AnimMontage.h"
+#include "ClimbingSystem.h"
+#include "ClimbingSystemCharacter.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+
+static TAutoConsoleVariable<int32> CVarClimbingPreloadMontages(
+	TEXT("Climbing.PreloadMontages"),
+	1,
+	TEXT("攀爬过渡用的Montage的加载方式\n")
+	TEXT("0: 第一次播放时同步加载\n")
+	TEXT("1: 关卡开始和角色生成时异步预加载 (默认)"),
+	ECVF_Default);
+
+bool UClimbingMontagePreloadSubsystem::IsPreloadEnabled() {
+	return CVarClimbingPreloadMontages.GetValueOnGameThread() != 0;
+}
+
+void UClimbingMontagePreloadSubsystem::OnWorldBeginPlay(UWorld& InWorld) {
+	Super::OnWorldBeginPlay(InWorld);
+
+	// 默认Pawn在这之后才生成，提前把它的Montage放进加载队列
+	if (const AGameModeBase* GameMode = InWorld.GetAuthGameMode()) {
+		if (GameMode->DefaultPawnClass && GameMode->DefaultPawnClass->IsChildOf<AClimbingSystemCharacter>()) {
+			PreloadMontages(TSubclassOf<AClimbingSystemCharacter>(GameMode->DefaultPawnClass));
+		}
+	}
+}
+
+void UClimbingMontagePreloadSubsystem::Deinitialize() {
+	for (const TSharedPtr<FStreamableHandle>& Handle : PendingHandles) {
+		Handle->CancelHandle();
+	}
+	PendingHandles.Reset();
+	PooledMontages.Reset();
+
+	Super::Deinitialize();
+}
+
+bool UClimbingMontagePreloadSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UClimbingMontagePreloadSubsystem::PreloadMontages(AClimbingSystemCharacter* Character) {
+	if (!IsPreloadEnabled()) {
+		return;
+	}
+
+	TArray<FSoftObjectPath> Paths;
+	Character->GetClimbingMontagePaths(Paths);
+	RequestAsyncLoad(MoveTemp(Paths));
+}
+
+void UClimbingMontagePreloadSubsystem::PreloadMontages(TSubclassOf<AClimbingSystemCharacter> CharacterClass) {
+	if (!CharacterClass || !IsPreloadEnabled()) {
+		return;
+	}
+
+	TArray<FSoftObjectPath> Paths;
+	CharacterClass->GetDefaultObject<AClimbingSystemCharacter>()->GetClimbingMontagePaths(Paths);
+	RequestAsyncLoad(MoveTemp(Paths));
+}
+
+void UClimbingMontagePreloadSubsystem::RequestAsyncLoad(TArray<FSoftObjectPath>&& Paths) {
+	// 已经在内存里的直接放进池子，不用再走一次StreamableManager
+	for (int32 Index = Paths.Num() - 1; Index >= 0; --Index) {
+		if (UAnimMontage* Montage = Cast<UAnimMontage>(Paths[Index].ResolveObject())) {
+			PooledMontages.Add(Montage);
+			Paths.RemoveAtSwap(Index, 1, false);
+		}
+	}
+	if (Paths.Num() == 0) {
+		return;
+	}
+
+	// 同一个Montage被多个请求加载时，StreamableManager会合并到同一次加载里
+	TArray<FSoftObjectPath> RequestedPaths = Paths;
+	TSharedPtr<FStreamableHandle> Handle = StreamableManager.RequestAsyncLoad(MoveTemp(RequestedPaths),
+		FStreamableDelegate::CreateWeakLambda(this, [this, Paths = MoveTemp(Paths)]() {
+			OnMontagesLoaded(Paths);
+		}),
+		FStreamableManager::AsyncLoadHighPriority);
+	if (Handle.IsValid()) {
+		PendingHandles.Add(Handle);
+	}
+}
+
+void UClimbingMontagePreloadSubsystem::OnMontagesLoaded(const TArray<FSoftObjectPath>& Paths) {
+	for (const FSoftObjectPath& Path : Paths) {
+		if (UAnimMontage* Montage = Cast<UAnimMontage>(Path.ResolveObject())) {
+			PooledMontages.Add(Montage);
+		} else {
+			UE_LOG(LogClimbing, Warning, TEXT("Failed to preload climbing montage '%s'"), *Path.ToString());
+		}
+	}
+
+	PendingHandles.RemoveAll([](const TSharedPtr<FStreamableHandle>& Handle) {
+		return Handle->HasLoadCompleted() || Handle->WasCanceled();
+	});
+	UE_LOG(LogClimbing, Verbose, TEXT("Climbing montage pool: %d montages resident"), PooledMontages.Num());
+}
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/StreamableManager.h"
+#include "ClimbingMontagePreloadSubsystem.generated.h"
+
+class AClimbingSystemCharacter;
+class UAnimMontage;
+
+/**
+ * 攀爬过渡用的Montage是软引用，角色类加载时不会把它们一起加载进来
+ * 关卡开始时按默认Pawn类、角色生成时按角色自己的配置在后台异步加载，加载好的Montage在整个World里共享、常驻，
+ * 后面生成的同类角色直接拿到已经加载好的，第一次抓墙和Mantle时不会再同步加载
+ */
+UCLASS()
+class UClimbingMontagePreloadSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// 异步加载角色用到的所有Montage，过渡的时长不依赖Montage，所以不需要等加载完
+	void PreloadMontages(AClimbingSystemCharacter* Character);
+
+	// 只加载某个角色类默认配置的Montage，给还没生成角色的时候用
+	void PreloadMontages(TSubclassOf<AClimbingSystemCharacter> CharacterClass);
+
+	int32 GetNumPooledMontages() const { return PooledMontages.Num(); }
+
+	static bool IsPreloadEnabled();
+
+	// UWorldSubsystem interface
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	// 请求里还没在内存里的部分交给StreamableManager
+	void RequestAsyncLoad(TArray<FSoftObjectPath>&& Paths);
+	void OnMontagesLoaded(const TArray<FSoftObjectPath>& Paths);
+
+	FStreamableManager StreamableManager;
+
+	// 还在加载中的请求，加载完之后就不再需要了，Montage由PooledMontages持有
+	TArray<TSharedPtr<FStreamableHandle>> PendingHandles;
+
+	// 已经加载好的Montage，在World结束之前一直持有
+	UPROPERTY(Transient)
+	TSet<TObjectPtr<UAnimMontage>> PooledMontages;
+};
@@ -0,0 +1,907 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingMovementComponent.h"
+#include "ClimbableSurfaceSubsystem.h"
+#include "ClimbingDebugSubsystem.h"
+#include "ClimbingStats.h"
+#include "ClimbingMathKernels.h"
+#include "ClimbingSystem.h"
+#include "ClimbingSystemCharacter.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/NetDriver.h"
+#include "Engine/OverlapResult.h"
+#include "EngineUtils.h"
+#include "GameFramework/Character.h"
+
+static TAutoConsoleVariable<int32> CVarClimbingSurfaceSampler(
+	TEXT("Climbing.SurfaceSampler"),
+	1,
+	TEXT("攀爬中怎么检测墙面\n")
+	TEXT("0: 从角色中心向前一根检测线\n")
+	TEXT("1: 多根检测线拟合平面，跨帧复用检测结果 (默认)"),
+	ECVF_Default);
+
+static FAutoConsoleCommand ClimbingNetStatsCommand(
+	TEXT("Climbing.Net.Stats"),
+	TEXT("输出当前进程里每个World的攀爬角色数量、客户端收到的移动纠正次数和网络带宽，并清零纠正计数\n")
+	TEXT("配合PIE的单进程多客户端和Net PktLag/PktLoss使用"),
+	FConsoleCommandDelegate::CreateLambda([]() {
+		for (const FWorldContext& Context : GEngine->GetWorldContexts()) {
+			UWorld* World = Context.World();
+			if (!World || World->GetNetMode() == NM_Standalone) {
+				continue;
+			}
+
+			const FClimbingNetStats Stats = UClimbingMovementComponent::GatherNetStats(World, true);
+			UE_LOG(LogClimbing, Display, TEXT("%s (%s): %d climbers, %u corrections (%.2f per climber), in %.2f KB/s, out %.2f KB/s (%.3f / %.3f KB/s per climber)"),
+				*World->GetName(), World->GetNetMode() == NM_Client ? TEXT("Client") : TEXT("Server"),
+				Stats.NumClimbers, Stats.NumCorrections, double(Stats.NumCorrections) / FMath::Max(Stats.NumClimbers, 1),
+				Stats.InBytesPerSecond / 1024.0, Stats.OutBytesPerSecond / 1024.0, Stats.GetInBytesPerClimber() / 1024.0, Stats.GetOutBytesPerClimber() / 1024.0);
+		}
+	}));
+
+//////////////////////////////////////////////////////////////////////////
+// FClimbingNetState
+
+void FClimbingNetState::SetNormal(const FVector& Normal) {
+	ClimbingMath::EncodeOctahedral8(Normal.X, Normal.Y, Normal.Z, NormalU, NormalV);
+}
+
+FVector FClimbingNetState::GetNormal() const {
+	FVector Normal;
+	ClimbingMath::DecodeOctahedral8(NormalU, NormalV, Normal.X, Normal.Y, Normal.Z);
+	return Normal;
+}
+
+bool FClimbingNetState::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess) {
+	// 3种状态用2位就够了，只有攀爬时才需要墙面法线
+	Ar.SerializeBits(&Mode, 2);
+	if (Mode == Climbing) {
+		Ar << NormalU;
+		Ar << NormalV;
+	}
+	bOutSuccess = true;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FSavedMove_Climbing
+
+void FSavedMove_Climbing::Clear() {
+	Super::Clear();
+	bSavedWantsToClimb = false;
+	bSavedWantsToMantle = false;
+	bSavedWantsToLeap = false;
+	SavedClimbTransition = EClimbTransition::None;
+	SavedClimbTransitionSourceID = (uint16)ERootMotionSourceID::Invalid;
+	SavedMantleTargetLocation = FVector::ZeroVector;
+	SavedLeapTargetLocation = FVector::ZeroVector;
+	SavedLeapTargetRotation = FQuat::Identity;
+	SavedClimbStepAccumulator = 0.f;
+	SavedTimeSinceSurfaceProbe = 0.f;
+	SavedCachedSurface = FClimbSurfaceSample();
+	bSavedHasClimbSurface = false;
+	SavedSurfaceGridAnchor = FClimbSurfaceSampler::FGridAnchor();
+}
+
+uint8 FSavedMove_Climbing::GetCompressedFlags() const {
+	uint8 Flags = Super::GetCompressedFlags();
+	if (bSavedWantsToClimb) {
+		Flags |= FLAG_Custom_0;
+	}
+	if (bSavedWantsToMantle) {
+		Flags |= FLAG_Custom_1;
+	}
+	if (bSavedWantsToLeap) {
+		Flags |= FLAG_Custom_2;
+	}
+	return Flags;
+}
+
+bool FSavedMove_Climbing::CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const {
+	const FSavedMove_Climbing* NewClimbingMove = static_cast<const FSavedMove_Climbing*>(NewMove.Get());
+	if (bSavedWantsToClimb != NewClimbingMove->bSavedWantsToClimb
+		|| bSavedWantsToMantle != NewClimbingMove->bSavedWantsToMantle
+		|| bSavedWantsToLeap != NewClimbingMove->bSavedWantsToLeap
+		|| SavedClimbTransition != NewClimbingMove->SavedClimbTransition) {
+		return false;
+	}
+	return Super::CanCombineWith(NewMove, InCharacter, MaxDelta);
+}
+
+void FSavedMove_Climbing::SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData) {
+	Super::SetMoveFor(C, InDeltaTime, NewAccel, ClientData);
+	if (const UClimbingMovementComponent* ClimbingMovement = Cast<UClimbingMovementComponent>(C->GetCharacterMovement())) {
+		bSavedWantsToClimb = ClimbingMovement->WantsToClimb();
+		bSavedWantsToMantle = ClimbingMovement->WantsToMantle();
+		bSavedWantsToLeap = ClimbingMovement->WantsToLeap();
+		SavedClimbTransition = ClimbingMovement->ClimbTransition;
+		SavedClimbTransitionSourceID = ClimbingMovement->ClimbTransitionSourceID;
+		SavedMantleTargetLocation = ClimbingMovement->MantleTargetLocation;
+		SavedLeapTargetLocation = ClimbingMovement->LeapTargetLocation;
+		SavedLeapTargetRotation = ClimbingMovement->LeapTargetRotation;
+		SavedClimbStepAccumulator = ClimbingMovement->ClimbStepAccumulator;
+		SavedTimeSinceSurfaceProbe = ClimbingMovement->TimeSinceSurfaceProbe;
+		SavedCachedSurface = ClimbingMovement->CachedSurface;
+		bSavedHasClimbSurface = ClimbingMovement->bHasClimbSurface;
+		SavedSurfaceGridAnchor = ClimbingMovement->SurfaceSampler.GetGridAnchor();
+	}
+}
+
+void FSavedMove_Climbing::PrepMoveFor(ACharacter* C) {
+	Super::PrepMoveFor(C);
+	if (UClimbingMovementComponent* ClimbingMovement = Cast<UClimbingMovementComponent>(C->GetCharacterMovement())) {
+		ClimbingMovement->SetWantsToClimb(bSavedWantsToClimb);
+		ClimbingMovement->SetWantsToMantle(bSavedWantsToMantle);
+		ClimbingMovement->SetWantsToLeap(bSavedWantsToLeap);
+		ClimbingMovement->ClimbTransition = SavedClimbTransition;
+		ClimbingMovement->ClimbTransitionSourceID = SavedClimbTransitionSourceID;
+		ClimbingMovement->MantleTargetLocation = SavedMantleTargetLocation;
+		ClimbingMovement->LeapTargetLocation = SavedLeapTargetLocation;
+		ClimbingMovement->LeapTargetRotation = SavedLeapTargetRotation;
+		ClimbingMovement->ClimbStepAccumulator = SavedClimbStepAccumulator;
+		ClimbingMovement->TimeSinceSurfaceProbe = SavedTimeSinceSurfaceProbe;
+		ClimbingMovement->CachedSurface = SavedCachedSurface;
+		ClimbingMovement->bHasClimbSurface = bSavedHasClimbSurface;
+		ClimbingMovement->SurfaceSampler.RestoreGridAnchor(SavedSurfaceGridAnchor);
+	}
+}
+
+FNetworkPredictionData_Client_Climbing::FNetworkPredictionData_Client_Climbing(const UCharacterMovementComponent& ClientMovement)
+	: Super(ClientMovement) {
+}
+
+FSavedMovePtr FNetworkPredictionData_Client_Climbing::AllocateNewMove() {
+	return FSavedMovePtr(new FSavedMove_Climbing());
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UClimbingMovementComponent
+
+UClimbingMovementComponent::UClimbingMovementComponent() {
+	MaxClimbSpeed = 100.f;
+	BrakingDecelerationClimbing = 2048.f;
+	ClimbSnapSpeed = 5.f;
+	ClimbWallDistance = 45.f;
+	ClimbProbeLength = 92.f;
+	ClimbSurfaceProbeInterval = 0.f;
+	ClimbFixedTimeStep = 1.f / 60.f;
+	ClimbMaxFixedStepsPerMove = 10;
+	bInterpolateClimbMesh = true;
+	ClimbSurfaceSampleRadius = 1;
+	ClimbSurfaceSampleSpacing = 25.f;
+	ClimbSurfaceSampleMaxAge = 0.5f;
+	ClimbCornerWrapBlend = 0.5f;
+	ClimbEnterProbeLength = 150.f;
+	ClimbEnterDuration = 0.3f;
+	ClimbEnterFromGroundDuration = 0.3f;
+	ClimbEnterPathOffsetCurve = nullptr;
+	MantleRiseDuration = 0.3f;
+	MantleOverDuration = 0.2f;
+	MantleClearance = 5.f;
+	MantlePathOffsetCurve = nullptr;
+	LeapReach = 150.f;
+	LeapMinDistance = 50.f;
+	LeapNumSteps = 4;
+	LeapSpreadAngle = 25.f;
+	LeapMaxSurfaceAngle = 45.f;
+	LeapDuration = 0.35f;
+	LeapPathOffsetCurve = nullptr;
+
+	ClimbSurfaceNormal = FVector::ZeroVector;
+	ClimbSurfaceLocation = FVector::ZeroVector;
+	ClimbSurfaceRight = FVector::ZeroVector;
+	ClimbSurfaceUp = FVector::ZeroVector;
+	bHasClimbSurface = false;
+	PrecomputedSurfaceFrame = 0;
+	EnterSurfaceFrame = 0;
+	TimeSinceSurfaceProbe = 0.f;
+	ClimbStepAccumulator = 0.f;
+	ClimbPrevStepLocation = FVector::ZeroVector;
+	ClimbPrevStepRotation = FQuat::Identity;
+	bClimbMeshInterpolated = false;
+	bWantsToClimb = false;
+	bWantsToMantle = false;
+	bWantsToLeap = false;
+	NumClientCorrections = 0;
+
+	ClimbTransition = EClimbTransition::None;
+	ClimbTransitionSourceID = (uint16)ERootMotionSourceID::Invalid;
+	ClimbEnterFromMode = MOVE_None;
+	MantleTargetLocation = FVector::ZeroVector;
+	LeapTargetLocation = FVector::ZeroVector;
+	LeapTargetRotation = FQuat::Identity;
+	ClimbTransitionStartRotation = FQuat::Identity;
+	ClimbTransitionTargetRotation = FQuat::Identity;
+	for (TSharedPtr<FRootMotionSource_MoveToForce>& Source : ClimbTransitionSources) {
+		Source = MakeShared<FRootMotionSource_MoveToForce>();
+	}
+}
+
+void UClimbingMovementComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) {
+	// 在Super里生成这一帧的FSavedMove之前检测，退出和Mantle的意图跟这一帧的输入一起发给服务器
+	// 服务器和纠正后的回放不检测，只按收到/保存的意图在UpdateCharacterStateBeforeMovement里切换
+	if (IsClimbing() && !IsInClimbTransition() && CharacterOwner && CharacterOwner->IsLocallyControlled()) {
+		if (AClimbingSystemCharacter* ClimbingCharacter = Cast<AClimbingSystemCharacter>(CharacterOwner)) {
+			ClimbingCharacter->UpdateClimbingChecks(GetPendingInputVector());
+		}
+	}
+
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+}
+
+bool UClimbingMovementComponent::IsClimbing() const {
+	return MovementMode == MOVE_Custom && CustomMovementMode == CMOVE_Climbing && UpdatedComponent;
+}
+
+float UClimbingMovementComponent::GetMaxSpeed() const {
+	return IsClimbing() ? MaxClimbSpeed * GetClimbSurfaceSpeedScale() : Super::GetMaxSpeed();
+}
+
+float UClimbingMovementComponent::GetClimbSurfaceSpeedScale() const {
+	return bHasClimbSurface ? UClimbableSurfaceComponent::GetClimbSpeedScale(CachedSurface.Component.Get()) : 1.f;
+}
+
+EClimbGripType UClimbingMovementComponent::GetClimbGripType() const {
+	return UClimbableSurfaceComponent::GetGripType(bHasClimbSurface ? CachedSurface.Component.Get() : nullptr);
+}
+
+float UClimbingMovementComponent::GetMaxBrakingDeceleration() const {
+	return IsClimbing() ? BrakingDecelerationClimbing : Super::GetMaxBrakingDeceleration();
+}
+
+FNetworkPredictionData_Client* UClimbingMovementComponent::GetPredictionData_Client() const {
+	if (ClientPredictionData == nullptr) {
+		UClimbingMovementComponent* MutableThis = const_cast<UClimbingMovementComponent*>(this);
+		MutableThis->ClientPredictionData = new FNetworkPredictionData_Client_Climbing(*this);
+	}
+	return ClientPredictionData;
+}
+
+void UClimbingMovementComponent::UpdateFromCompressedFlags(uint8 Flags) {
+	Super::UpdateFromCompressedFlags(Flags);
+	bWantsToClimb = (Flags & FSavedMove_Character::FLAG_Custom_0) != 0;
+	bWantsToMantle = (Flags & FSavedMove_Character::FLAG_Custom_1) != 0;
+	bWantsToLeap = (Flags & FSavedMove_Character::FLAG_Custom_2) != 0;
+}
+
+void UClimbingMovementComponent::UpdateCharacterStateBeforeMovement(float DeltaSeconds) {
+	Super::UpdateCharacterStateBeforeMovement(DeltaSeconds);
+
+	// 本地在进入/退出攀爬时已经切换过模式了，这里让服务器和纠正后的回放得到一样的结果
+	if (bWantsToClimb && !IsClimbing()) {
+		SetMovementMode(MOVE_Custom, CMOVE_Climbing);
+	} else if (!bWantsToClimb && IsClimbing()) {
+		SetMovementMode(MOVE_Walking);
+	}
+
+	// 服务器上用自己的CheckMantle算目标，客户端本地已经在StartMantle里开始了
+	if (bWantsToMantle && IsClimbing() && !IsInClimbTransition()) {
+		FVector TargetLocation;
+		const AClimbingSystemCharacter* ClimbingCharacter = Cast<AClimbingSystemCharacter>(CharacterOwner);
+		if (ClimbingCharacter && ClimbingCharacter->CheckMantle(TargetLocation)) {
+			StartMantle(TargetLocation);
+		}
+	}
+
+	// Leap也一样，服务器按这次移动的加速度方向自己找落点
+	if (bWantsToLeap && IsClimbing() && !IsInClimbTransition()) {
+		StartLeap(Acceleration);
+	}
+}
+
+void UClimbingMovementComponent::UpdateCharacterStateAfterMovement(float DeltaSeconds) {
+	Super::UpdateCharacterStateAfterMovement(DeltaSeconds);
+
+	// 当前阶段的Source走完了就切到下一个阶段，回放时用的是FSavedMove里恢复的Source，所以按ID查
+	if (IsInClimbTransition()) {
+		const TSharedPtr<FRootMotionSource> Source = GetRootMotionSourceByID(ClimbTransitionSourceID);
+		if (!Source.IsValid() || Source->Status.HasFlag(ERootMotionSourceStatusFlags::Finished)) {
+			AdvanceClimbTransition();
+		}
+	}
+}
+
+bool UClimbingMovementComponent::StartMantle(const FVector& TargetLocation) {
+	if (!IsClimbing() || IsInClimbTransition()) {
+		return false;
+	}
+
+	bWantsToMantle = true;
+	MantleTargetLocation = TargetLocation;
+	SetClimbTransition(EClimbTransition::MantleRise);
+	return true;
+}
+
+bool UClimbingMovementComponent::StartLeap(const FVector& Direction) {
+	if (!IsClimbing() || IsInClimbTransition()) {
+		return false;
+	}
+
+	FClimbSurfaceSample Target;
+	if (!FindLeapTarget(Direction, Target)) {
+		return false;
+	}
+	INC_DWORD_STAT(STAT_ClimbingLeaps);
+
+	bWantsToLeap = true;
+	LeapTargetLocation = Target.SnapTarget;
+	LeapTargetRotation = Target.Rotation.Quaternion();
+	SetClimbTransition(EClimbTransition::Leap);
+	return true;
+}
+
+FVector UClimbingMovementComponent::GetInputAcceleration(const FVector& InputVector) const {
+	// 和ControlledCharacterMove一样约束、缩放，再和FSavedMove_Character::SetMoveFor一样取整，服务器回放时拿到的就是这个值
+	FVector Result = ScaleInputAcceleration(ConstrainInputAcceleration(InputVector));
+	Result.X = FMath::RoundToFloat(Result.X);
+	Result.Y = FMath::RoundToFloat(Result.Y);
+	Result.Z = FMath::RoundToFloat(Result.Z);
+	return Result;
+}
+
+bool UClimbingMovementComponent::FindLeapTarget(const FVector& Direction, FClimbSurfaceSample& OutSample) const {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingLeapQuery);
+
+	if (!bHasClimbSurface || LeapReach <= LeapMinDistance) {
+		return false;
+	}
+
+	// 1. 输入方向投影到墙面的切线上
+	const FVector& Normal = ClimbSurfaceNormal;
+	FVector2D LeapDirection(FVector::DotProduct(Direction, ClimbSurfaceRight), FVector::DotProduct(Direction, ClimbSurfaceUp));
+	LeapDirection = LeapDirection.IsNearlyZero() ? FVector2D(0.f, 1.f) : LeapDirection.GetSafeNormal();
+	const FVector ReachDirection = ClimbSurfaceRight * LeapDirection.X + ClimbSurfaceUp * LeapDirection.Y;
+
+	// 2. 所有候选点的检测线都在这个Box里: 沿跳跃方向LeapReach长，两侧按LeapSpreadAngle展开，前后覆盖从角色中心到检测线的末端
+	//    全由Box组成的组件直接和Box求交，其他会挡住Climbable通道的组件(凸包、球、复杂碰撞)退回到逐个组件的LineTraceComponent
+	const FVector Center = UpdatedComponent->GetComponentLocation();
+	const float ProbeLength = ClimbWallDistance + ClimbProbeLength;
+	const FVector QueryCenter = Center + ReachDirection * (LeapReach * 0.5f) + Normal * ((ClimbWallDistance - ClimbProbeLength) * 0.5f);
+	const FQuat QueryRotation = FRotationMatrix::MakeFromXZ(-Normal, ReachDirection).ToQuat();
+	const FVector QueryExtent(ProbeLength * 0.5f, LeapReach * FMath::Sin(FMath::DegreesToRadians(LeapSpreadAngle)) + 1.f, LeapReach * 0.5f + 1.f);
+
+	TArray<FOverlapResult> Overlaps;
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(ClimbLeap), false, CharacterOwner);
+	GetWorld()->OverlapMultiByChannel(Overlaps, QueryCenter, QueryRotation, ECC_Climbable, FCollisionShape::MakeBox(QueryExtent), Params);
+
+	TArray<FClimbableBox> Boxes;
+	TArray<const UPrimitiveComponent*, TInlineAllocator<16>> BoxComponents;
+	TArray<UPrimitiveComponent*, TInlineAllocator<8>> TraceComponents;
+	for (const FOverlapResult& Overlap : Overlaps) {
+		UPrimitiveComponent* Component = Overlap.GetComponent();
+		if (!Component || BoxComponents.Contains(Component) || TraceComponents.Contains(Component)) {
+			continue;
+		}
+		const int32 NumBoxes = Boxes.Num();
+		if (UClimbableSurfaceSubsystem::GatherClimbableBoxes(Component, Component->GetComponentTransform(), Boxes)) {
+			BoxComponents.SetNum(Boxes.Num());
+			for (int32 Index = NumBoxes; Index < Boxes.Num(); ++Index) {
+				BoxComponents[Index] = Component;
+			}
+		} else if (Component->GetCollisionResponseToChannel(ECC_Climbable) == ECR_Block) {
+			TraceComponents.Add(Component);
+		}
+	}
+	if (Boxes.Num() == 0 && TraceComponents.Num() == 0) {
+		return false;
+	}
+
+	// 3. 由远到近，每个距离取正前方和两侧各一个点，在上面的Box里沿墙面法线求交
+	//    越远、越接近输入方向的落点越好，落点的墙面和当前墙面夹角太大的不要
+	const float MinSurfaceDot = FMath::Cos(FMath::DegreesToRadians(LeapMaxSurfaceAngle));
+	const float SpreadCos = FMath::Cos(FMath::DegreesToRadians(LeapSpreadAngle));
+	float BestScore = 0.f;
+	OutSample.bValid = false;
+	for (int32 Step = LeapNumSteps; Step >= 1; --Step) {
+		const float Distance = FMath::Lerp(LeapMinDistance, LeapReach, float(Step) / float(LeapNumSteps));
+		for (const float Angle : { 0.f, LeapSpreadAngle, -LeapSpreadAngle }) {
+			const float Score = Distance * (Angle == 0.f ? 1.f : SpreadCos);
+			if (Score <= BestScore) {
+				continue;
+			}
+
+			const FVector2D CandidateDirection = LeapDirection.GetRotated(Angle);
+			const FVector Start = Center + (ClimbSurfaceRight * CandidateDirection.X + ClimbSurfaceUp * CandidateDirection.Y) * Distance + Normal * ClimbWallDistance;
+
+			double NearestDistance = ProbeLength;
+			const UPrimitiveComponent* NearestComponent = nullptr;
+			FVector NearestNormal = FVector::ZeroVector;
+			for (int32 Index = 0; Index < Boxes.Num(); ++Index) {
+				double HitDistance;
+				FVector HitNormal;
+				if (Boxes[Index].IntersectRay(Start, -Normal, NearestDistance, HitDistance, HitNormal)) {
+					NearestDistance = HitDistance;
+					NearestComponent = BoxComponents[Index];
+					NearestNormal = HitNormal;
+				}
+			}
+
+			// 只检测到Box上的交点为止，比它远的不可能更近
+			for (UPrimitiveComponent* Component : TraceComponents) {
+				FHitResult Hit;
+				if (Component->LineTraceComponent(Hit, Start, Start - Normal * NearestDistance, Params) && !Hit.bStartPenetrating) {
+					NearestDistance = Hit.Distance;
+					NearestComponent = Component;
+					NearestNormal = Hit.ImpactNormal;
+				}
+			}
+			if (!NearestComponent || FVector::DotProduct(NearestNormal, Normal) < MinSurfaceDot) {
+				continue;
+			}
+
+			MakeClimbSurfaceSample(Start - Normal * NearestDistance, NearestNormal, NearestComponent, OutSample);
+			BestScore = Score;
+		}
+	}
+	return OutSample.bValid;
+}
+
+void UClimbingMovementComponent::AdvanceClimbTransition() {
+	const EClimbTransition FinishedTransition = ClimbTransition;
+	switch (FinishedTransition) {
+	case EClimbTransition::MantleRise:
+		SetClimbTransition(EClimbTransition::MantleOver);
+		return;
+	case EClimbTransition::MantleOver:
+		// 站到Ledge上，退出攀爬，角色在OnMovementModeChanged里恢复朝向和状态
+		SetClimbTransition(EClimbTransition::None);
+		bWantsToMantle = false;
+		bWantsToClimb = false;
+		SetMovementMode(MOVE_Walking);
+		break;
+	case EClimbTransition::Leap:
+		// 落到了新的位置，模板里之前的检测结果都不能用了
+		SetClimbTransition(EClimbTransition::None);
+		bWantsToLeap = false;
+		SurfaceSampler.Reset();
+		break;
+	default:
+		SetClimbTransition(EClimbTransition::None);
+		break;
+	}
+
+	if (!bClientUpdating) {
+		OnClimbTransitionFinished.Broadcast(FinishedTransition);
+	}
+}
+
+void UClimbingMovementComponent::SetClimbTransition(EClimbTransition NewTransition) {
+	if (ClimbTransitionSourceID != (uint16)ERootMotionSourceID::Invalid) {
+		RemoveRootMotionSourceByID(ClimbTransitionSourceID);
+		ClimbTransitionSourceID = (uint16)ERootMotionSourceID::Invalid;
+	}
+	ClimbTransition = NewTransition;
+
+	const FQuat CurrentRotation = UpdatedComponent->GetComponentQuat();
+	ClimbTransitionStartRotation = CurrentRotation;
+	ClimbTransitionTargetRotation = CurrentRotation;
+
+	switch (NewTransition) {
+	case EClimbTransition::Enter: {
+		// 本地控制的一端用角色墙壁检测的结果，服务器和回放时没有这个结果，从胶囊体中心重新检测
+		FClimbSurfaceSample Sample;
+		if (!ConsumeClimbEnterSurface(Sample) && !DetectClimbSurface(Sample, ClimbEnterProbeLength)) {
+			// 没找到墙就直接交给PhysClimbing慢慢贴
+			ClimbTransition = EClimbTransition::None;
+			return;
+		}
+		// 两种检测的起点高度不一样，统一换成胶囊体中心在检测到的墙面上的投影，平的墙上两端算出来的目标一样
+		const FVector WallPoint = FVector::PointPlaneProject(UpdatedComponent->GetComponentLocation(), Sample.Location, Sample.Normal);
+		MakeClimbSurfaceSample(WallPoint, Sample.Normal, Sample.Component.Get(), Sample);
+		const float Duration = ClimbEnterFromMode == MOVE_Walking ? ClimbEnterFromGroundDuration : ClimbEnterDuration;
+		ClimbTransitionTargetRotation = Sample.Rotation.Quaternion();
+		ClimbTransitionSourceID = ApplyClimbTransitionSource(Sample.SnapTarget, Duration, ClimbEnterPathOffsetCurve, true);
+		break;
+	}
+	case EClimbTransition::MantleRise: {
+		const float HalfHeight = CharacterOwner->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+		FVector RiseTarget = UpdatedComponent->GetComponentLocation();
+		RiseTarget.Z = FMath::Max(RiseTarget.Z, MantleTargetLocation.Z + HalfHeight + MantleClearance);
+		ClimbTransitionSourceID = ApplyClimbTransitionSource(RiseTarget, MantleRiseDuration, nullptr, false);
+		break;
+	}
+	case EClimbTransition::MantleOver: {
+		const float HalfHeight = CharacterOwner->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+		ClimbTransitionSourceID = ApplyClimbTransitionSource(MantleTargetLocation + FVector(0.f, 0.f, HalfHeight), MantleOverDuration, MantlePathOffsetCurve, true);
+		break;
+	}
+	case EClimbTransition::Leap:
+		ClimbTransitionTargetRotation = LeapTargetRotation;
+		ClimbTransitionSourceID = ApplyClimbTransitionSource(LeapTargetLocation, LeapDuration, LeapPathOffsetCurve, true);
+		break;
+	default:
+		break;
+	}
+}
+
+uint16 UClimbingMovementComponent::ApplyClimbTransitionSource(const FVector& TargetLocation, float Duration, UCurveVector* PathOffsetCurve, bool bStopOnFinish) {
+	// 模拟端的位置来自服务器同步，不需要自己跑过渡
+	if (CharacterOwner->GetLocalRole() == ROLE_SimulatedProxy) {
+		return (uint16)ERootMotionSourceID::Invalid;
+	}
+
+	// 只有CurrentRootMotion已经不再引用的Source才能复用，正常情况下两个轮流用就够了
+	TSharedPtr<FRootMotionSource_MoveToForce> Source;
+	for (const TSharedPtr<FRootMotionSource_MoveToForce>& Candidate : ClimbTransitionSources) {
+		if (Candidate.GetSharedReferenceCount() == 1) {
+			Source = Candidate;
+			break;
+		}
+	}
+	if (!Source.IsValid()) {
+		UE_LOG(LogClimbing, Verbose, TEXT("'%s' all climb transition sources are in use, allocating a new one"), *GetNameSafe(CharacterOwner));
+		Source = MakeShared<FRootMotionSource_MoveToForce>();
+	}
+
+	*Source = FRootMotionSource_MoveToForce();
+	Source->InstanceName = TEXT("ClimbTransition");
+	Source->AccumulateMode = ERootMotionAccumulateMode::Override;
+	Source->Priority = 500;
+	Source->Duration = FMath::Max(Duration, UE_KINDA_SMALL_NUMBER);
+	Source->StartLocation = UpdatedComponent->GetComponentLocation();
+	Source->TargetLocation = TargetLocation;
+	Source->bRestrictSpeedToExpected = true;
+	Source->PathOffsetCurve = PathOffsetCurve;
+	if (bStopOnFinish) {
+		Source->FinishVelocityParams.Mode = ERootMotionFinishVelocityMode::SetVelocity;
+		Source->FinishVelocityParams.SetVelocity = FVector::ZeroVector;
+	}
+	return ApplyRootMotionSource(Source);
+}
+
+
+void UClimbingMovementComponent::OnClientCorrectionReceived(FNetworkPredictionData_Client_Character& ClientData, float TimeStamp, FVector NewLocation, FVector NewVelocity, UPrimitiveComponent* NewBase, FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode) {
+	Super::OnClientCorrectionReceived(ClientData, TimeStamp, NewLocation, NewVelocity, NewBase, NewBaseBoneName, bHasBase, bBaseRelativePosition, ServerMovementMode);
+	++NumClientCorrections;
+	// 墙面检测的网格不用丢掉，回放第一个FSavedMove时会换回当时的网格，拉回之后不在模板里的格子Update自己会丢掉
+}
+
+FClimbingNetStats UClimbingMovementComponent::GatherNetStats(UWorld* World, bool bResetCorrections) {
+	FClimbingNetStats Stats;
+	for (TActorIterator<AClimbingSystemCharacter> It(World); It; ++It) {
+		UClimbingMovementComponent* ClimbingMovement = It->GetClimbingMovement();
+		++Stats.NumClimbers;
+		Stats.NumCorrections += ClimbingMovement->GetNumClientCorrections();
+		if (bResetCorrections) {
+			ClimbingMovement->ResetNumClientCorrections();
+		}
+	}
+
+	if (const UNetDriver* NetDriver = World->GetNetDriver()) {
+		Stats.InBytesPerSecond = NetDriver->InBytesPerSecond;
+		Stats.OutBytesPerSecond = NetDriver->OutBytesPerSecond;
+	}
+	return Stats;
+}
+
+void UClimbingMovementComponent::SetReplicatedClimbSurface(const FVector& Normal) {
+	ClimbSurfaceNormal = Normal;
+	ClimbSurfaceRight = AClimbingSystemCharacter::GetRightVectorOfCurrentVector(Normal);
+	ClimbSurfaceUp = AClimbingSystemCharacter::GetUpVectorOfCurrentVector(Normal);
+	bHasClimbSurface = true;
+}
+
+void UClimbingMovementComponent::PhysClimbTransition(float deltaTime, int32 Iterations) {
+	// Enter和Leap阶段按Source的进度转向墙面，Mantle阶段保持朝向
+	float Alpha = 1.f;
+	if (const TSharedPtr<FRootMotionSource> Source = GetRootMotionSourceByID(ClimbTransitionSourceID)) {
+		Alpha = FMath::Clamp(Source->GetTime() / FMath::Max(Source->GetDuration(), UE_KINDA_SMALL_NUMBER), 0.f, 1.f);
+	}
+	const FQuat NewRotation = FQuat::Slerp(ClimbTransitionStartRotation, ClimbTransitionTargetRotation, Alpha);
+
+	float RemainingTime = deltaTime;
+	while (RemainingTime >= MIN_TICK_TIME && Iterations < MaxSimulationIterations) {
+		Iterations++;
+		const float TimeTick = GetSimulationTimeStep(RemainingTime, Iterations);
+		RemainingTime -= TimeTick;
+
+		RestorePreAdditiveRootMotionVelocity();
+		if (!CurrentRootMotion.HasOverrideVelocity()) {
+			Velocity = FVector::ZeroVector;
+		}
+		ApplyRootMotionToVelocity(TimeTick);
+
+		const FVector Delta = Velocity * TimeTick;
+		FHitResult Hit(1.f);
+		SafeMoveUpdatedComponent(Delta, NewRotation, true, Hit);
+		if (Hit.Time < 1.f) {
+			HandleImpact(Hit, TimeTick, Delta);
+			SlideAlongSurface(Delta, 1.f - Hit.Time, Hit.Normal, Hit, true);
+		}
+	}
+}
+
+void UClimbingMovementComponent::PhysCustom(float deltaTime, int32 Iterations) {
+	if (CustomMovementMode == CMOVE_Climbing) {
+		PhysClimbing(deltaTime, Iterations);
+	}
+
+	Super::PhysCustom(deltaTime, Iterations);
+}
+
+void UClimbingMovementComponent::OnMovementModeChanged(EMovementMode PreviousMovementMode, uint8 PreviousCustomMode) {
+	Super::OnMovementModeChanged(PreviousMovementMode, PreviousCustomMode);
+
+	if (IsClimbing()) {
+		// 刚进入攀爬，先贴墙
+		if (PreviousMovementMode != MOVE_Custom || PreviousCustomMode != CMOVE_Climbing) {
+			SurfaceSampler.Reset();
+			ClimbStepAccumulator = 0.f;
+			ClimbEnterFromMode = PreviousMovementMode;
+			SetClimbTransition(EClimbTransition::Enter);
+		}
+	} else {
+		bHasClimbSurface = false;
+		ClearClimbMeshInterpolation();
+		// 过渡中途离开攀爬(比如被纠正)，丢掉剩下的过渡
+		if (IsInClimbTransition()) {
+			SetClimbTransition(EClimbTransition::None);
+			bWantsToMantle = false;
+			bWantsToLeap = false;
+		}
+	}
+}
+
+FVector UClimbingMovementComponent::ConstrainInputAcceleration(const FVector& InputAcceleration) const {
+	// 默认实现只在飞行和游泳时保留Z方向的输入，攀爬时向上的输入也要保留
+	if (IsClimbing()) {
+		return InputAcceleration;
+	}
+	return Super::ConstrainInputAcceleration(InputAcceleration);
+}
+
+void UClimbingMovementComponent::PhysClimbing(float deltaTime, int32 Iterations) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingPhysClimbing);
+
+	if (deltaTime < MIN_TICK_TIME) {
+		return;
+	}
+
+	if (IsInClimbTransition()) {
+		// 过渡由Root Motion Source按实际时间驱动，结束后固定步长从头开始
+		ClimbStepAccumulator = 0.f;
+		ClearClimbMeshInterpolation();
+		PhysClimbTransition(deltaTime, Iterations);
+		return;
+	}
+
+	// 0. 固定步长: 不管每次移动的时间怎么切，同样长的总时间走出同样的步数，服务器低Tick和客户端高帧率的轨迹一致
+	//    一步都凑不够的时候连墙面都不用检测，只更新Mesh的插值
+	TimeSinceSurfaceProbe += deltaTime;
+	const bool bFixedStep = ClimbFixedTimeStep > 0.f;
+	int32 NumFixedSteps = 0;
+	if (bFixedStep) {
+		ClimbStepAccumulator += deltaTime;
+		NumFixedSteps = FMath::FloorToInt32(ClimbStepAccumulator / ClimbFixedTimeStep);
+		ClimbStepAccumulator -= NumFixedSteps * ClimbFixedTimeStep;
+		if (NumFixedSteps > ClimbMaxFixedStepsPerMove) {
+			NumFixedSteps = ClimbMaxFixedStepsPerMove;
+		}
+		if (NumFixedSteps == 0) {
+			UpdateClimbMeshInterpolation();
+			return;
+		}
+	}
+
+	// 1. 每个Tick最多检测一次墙面，所有子步共用这个结果，已经有批量算好的结果时直接用
+	//    按LOD降低检测频率时，中间的Tick沿用上一次的墙面，移动本身还是每个Tick积分，所以不会一顿一顿的
+	FClimbSurfaceSample Surface;
+	if (ConsumePrecomputedClimbSurface(Surface)) {
+		TimeSinceSurfaceProbe = 0.f;
+	} else if (IsClimbSurfaceProbeDue()) {
+		SampleClimbSurface(Surface, TimeSinceSurfaceProbe);
+		TimeSinceSurfaceProbe = 0.f;
+	} else {
+		Surface = CachedSurface;
+	}
+	CachedSurface = Surface;
+	bHasClimbSurface = Surface.bValid;
+	if (!bHasClimbSurface) {
+		// 前面没有墙的时候原地不动，和原来Move里Trace失败时不添加输入的表现一致
+		Velocity = FVector::ZeroVector;
+		return;
+	}
+	ClimbSurfaceNormal = Surface.Normal;
+	ClimbSurfaceLocation = Surface.Location;
+	ClimbSurfaceRight = Surface.RightTangent;
+	ClimbSurfaceUp = Surface.UpTangent;
+	CLIMBING_DEBUG_SURFACE(GetWorld(), ClimbSurfaceLocation, ClimbSurfaceNormal, ClimbSurfaceRight, ClimbSurfaceUp);
+
+	if (AClimbingSystemCharacter* ClimbingCharacter = Cast<AClimbingSystemCharacter>(CharacterOwner)) {
+		ClimbingCharacter->UpdateClimbingNetState();
+	}
+
+	// 只保留沿墙面切线方向的加速度
+	Acceleration = FVector::VectorPlaneProject(Acceleration, ClimbSurfaceNormal);
+
+	const FVector SnapTarget = Surface.SnapTarget;
+	const FRotator DesiredRotation = Surface.Rotation;
+
+	// 2. 按子步积分速度，每个子步只做一次带旋转的SafeMove
+	if (bFixedStep) {
+		for (int32 Step = 0; Step < NumFixedSteps; ++Step) {
+			ClimbPrevStepLocation = UpdatedComponent->GetComponentLocation();
+			ClimbPrevStepRotation = UpdatedComponent->GetComponentQuat();
+			ClimbStep(ClimbFixedTimeStep, SnapTarget, DesiredRotation);
+		}
+		UpdateClimbMeshInterpolation();
+		return;
+	}
+
+	float RemainingTime = deltaTime;
+	while (RemainingTime >= MIN_TICK_TIME && Iterations < MaxSimulationIterations) {
+		Iterations++;
+		const float TimeTick = GetSimulationTimeStep(RemainingTime, Iterations);
+		RemainingTime -= TimeTick;
+		ClimbStep(TimeTick, SnapTarget, DesiredRotation);
+	}
+}
+
+void UClimbingMovementComponent::ClimbStep(float TimeTick, const FVector& SnapTarget, const FRotator& DesiredRotation) {
+	RestorePreAdditiveRootMotionVelocity();
+	if (!HasAnimRootMotion() && !CurrentRootMotion.HasOverrideVelocity()) {
+		CalcVelocity(TimeTick, 0.f, false, GetMaxBrakingDeceleration());
+		Velocity = FVector::VectorPlaneProject(Velocity, ClimbSurfaceNormal);
+	}
+	ApplyRootMotionToVelocity(TimeTick);
+
+	// 贴墙只在法线方向上插值，切线方向完全由速度决定
+	const FVector OldLocation = UpdatedComponent->GetComponentLocation();
+	const FVector SnapDelta = (FMath::VInterpTo(OldLocation, SnapTarget, TimeTick, ClimbSnapSpeed) - OldLocation).ProjectOnToNormal(ClimbSurfaceNormal);
+	const FRotator NewRotation = FMath::RInterpTo(UpdatedComponent->GetComponentRotation(), DesiredRotation, TimeTick, ClimbSnapSpeed);
+
+	const FVector Delta = Velocity * TimeTick + SnapDelta;
+	FHitResult Hit(1.f);
+	SafeMoveUpdatedComponent(Delta, NewRotation, true, Hit);
+	if (Hit.Time < 1.f) {
+		HandleImpact(Hit, TimeTick, Delta);
+		SlideAlongSurface(Delta, 1.f - Hit.Time, Hit.Normal, Hit, true);
+	}
+}
+
+void UClimbingMovementComponent::UpdateClimbMeshInterpolation() {
+	// 只给本地看的角色插值，模拟端和服务器上的远端角色有引擎自己的网络平滑在改Mesh的位置
+	USkeletalMeshComponent* Mesh = CharacterOwner ? CharacterOwner->GetMesh() : nullptr;
+	if (!Mesh || !bInterpolateClimbMesh || ClimbFixedTimeStep <= 0.f || !CharacterOwner->IsLocallyControlled()) {
+		ClearClimbMeshInterpolation();
+		return;
+	}
+
+	// 胶囊体停在最后一步的位置，Mesh往回退到上一步和这一步之间剩余时间对应的位置
+	const float Alpha = FMath::Clamp(ClimbStepAccumulator / ClimbFixedTimeStep, 0.f, 1.f);
+	const FQuat CurrentRotation = UpdatedComponent->GetComponentQuat();
+	const FVector WorldOffset = (ClimbPrevStepLocation - UpdatedComponent->GetComponentLocation()) * (1.f - Alpha);
+	const FQuat VisualRotation = FQuat::Slerp(ClimbPrevStepRotation, CurrentRotation, Alpha);
+
+	const FVector RelativeOffset = CurrentRotation.UnrotateVector(WorldOffset);
+	const FQuat RelativeRotation = CurrentRotation.Inverse() * VisualRotation;
+	Mesh->SetRelativeLocationAndRotation(CharacterOwner->GetBaseTranslationOffset() + RelativeOffset, RelativeRotation * CharacterOwner->GetBaseRotationOffset());
+	bClimbMeshInterpolated = true;
+}
+
+void UClimbingMovementComponent::ClearClimbMeshInterpolation() {
+	if (!bClimbMeshInterpolated) {
+		return;
+	}
+	bClimbMeshInterpolated = false;
+	if (USkeletalMeshComponent* Mesh = CharacterOwner ? CharacterOwner->GetMesh() : nullptr) {
+		Mesh->SetRelativeLocationAndRotation(CharacterOwner->GetBaseTranslationOffset(), CharacterOwner->GetBaseRotationOffset());
+	}
+}
+
+bool UClimbingMovementComponent::IsClimbSurfaceProbeDue() const {
+	return ClimbSurfaceProbeInterval <= 0.f || !bHasClimbSurface || TimeSinceSurfaceProbe >= ClimbSurfaceProbeInterval;
+}
+
+void UClimbingMovementComponent::SetPrecomputedClimbSurface(const FClimbSurfaceSample& Sample) {
+	PrecomputedSurface = Sample;
+	PrecomputedSurfaceFrame = GFrameCounter;
+}
+
+void UClimbingMovementComponent::SetClimbEnterSurface(const FHitResult& WallHit) {
+	MakeClimbSurfaceSample(WallHit.ImpactPoint, WallHit.ImpactNormal, WallHit.GetComponent(), EnterSurface);
+	EnterSurfaceFrame = GFrameCounter;
+}
+
+bool UClimbingMovementComponent::DetectClimbSurface(FClimbSurfaceSample& OutSample, float ProbeLength) const {
+	const FVector Start = UpdatedComponent->GetComponentLocation();
+	const FVector End = Start + UpdatedComponent->GetForwardVector() * ProbeLength;
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(ClimbSurface), false, CharacterOwner);
+
+	FHitResult Hit;
+	OutSample.bValid = UClimbableSurfaceSubsystem::LineTraceClimbing(GetWorld(), Hit, Start, End, ECC_Climbable, Params);
+	if (OutSample.bValid) {
+		MakeClimbSurfaceSample(Hit.ImpactPoint, Hit.ImpactNormal, Hit.GetComponent(), OutSample);
+	}
+	return OutSample.bValid;
+}
+
+bool UClimbingMovementComponent::SampleClimbSurface(FClimbSurfaceSample& OutSample, float DeltaTime) {
+	if (CVarClimbingSurfaceSampler.GetValueOnGameThread() == 0) {
+		return DetectClimbSurface(OutSample, ClimbProbeLength);
+	}
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(ClimbSurface), false, CharacterOwner);
+	OutSample.bValid = SurfaceSampler.Update(GetWorld(), UpdatedComponent->GetComponentLocation(), UpdatedComponent->GetForwardVector(), ClimbProbeLength, DeltaTime, Params, GetSurfaceSamplerSettings());
+	if (!OutSample.bValid) {
+		return false;
+	}
+	MakeClimbSurfaceSample(SurfaceSampler.GetLocation(), WrapClimbSurfaceNormal(SurfaceSampler.GetNormal()), SurfaceSampler.GetComponent(), OutSample);
+	return true;
+}
+
+void UClimbingMovementComponent::BeginDeferredClimbSurfaceSample(TArray<FClimbSurfaceSampler::FProbeRequest>& OutRequests) {
+	SurfaceSampler.BeginDeferredUpdate(UpdatedComponent->GetComponentLocation(), UpdatedComponent->GetForwardVector(), ClimbProbeLength, TimeSinceSurfaceProbe, GetSurfaceSamplerSettings(), OutRequests);
+}
+
+void UClimbingMovementComponent::ApplyDeferredClimbSurfaceProbe(const FClimbSurfaceSampler::FProbeRequest& Request, const FHitResult* Hit) {
+	SurfaceSampler.ApplyProbeResult(Request, Hit);
+}
+
+bool UClimbingMovementComponent::FinishDeferredClimbSurfaceSample(FVector& OutLocation, FVector& OutNormal, const UPrimitiveComponent*& OutComponent) {
+	if (!SurfaceSampler.FinishDeferredUpdate(UpdatedComponent->GetComponentLocation(), GetSurfaceSamplerSettings())) {
+		return false;
+	}
+	OutLocation = SurfaceSampler.GetLocation();
+	OutNormal = WrapClimbSurfaceNormal(SurfaceSampler.GetNormal());
+	OutComponent = SurfaceSampler.GetComponent();
+	return true;
+}
+
+FClimbSurfaceSampler::FSettings UClimbingMovementComponent::GetSurfaceSamplerSettings() const {
+	FClimbSurfaceSampler::FSettings Settings;
+	Settings.Radius = CVarClimbingSurfaceSampler.GetValueOnGameThread() != 0 ? ClimbSurfaceSampleRadius : 0;
+	Settings.Spacing = ClimbSurfaceSampleSpacing;
+	Settings.MaxSampleAge = ClimbSurfaceSampleMaxAge;
+	return Settings;
+}
+
+FVector UClimbingMovementComponent::WrapClimbSurfaceNormal(const FVector& Normal) const {
+	// 往左右移动并且那一侧有墙角时，朝向提前往墙角另一面墙转，转过去之后模板按新的朝向重建网格，角色就绕到了另一面墙上
+	// 外角上没有检测到墙(墙到头了)的时候法线是零，不绕；上下两侧是悬挑和顶边，交给Mantle
+	const FVector Right = AClimbingSystemCharacter::GetRightVectorOfCurrentVector(Normal);
+	const double Lateral = FVector::DotProduct(Acceleration, Right);
+	if (ClimbCornerWrapBlend > 0.f && FMath::Abs(Lateral) > UE_KINDA_SMALL_NUMBER) {
+		const FClimbCornerInfo& Corner = GetClimbCorner(Lateral > 0.0 ? EClimbCornerSide::Right : EClimbCornerSide::Left);
+		if (Corner.Type != EClimbCornerType::None && !Corner.Normal.IsZero()) {
+			return FMath::Lerp(Normal, Corner.Normal, ClimbCornerWrapBlend).GetSafeNormal(UE_SMALL_NUMBER, Normal);
+		}
+	}
+	return Normal;
+}
+
+void UClimbingMovementComponent::MakeClimbSurfaceSample(const FVector& Location, const FVector& Normal, const UPrimitiveComponent* Component, FClimbSurfaceSample& OutSample) const {
+	OutSample.bValid = true;
+	OutSample.Component = Component;
+	OutSample.Location = Location;
+	OutSample.Normal = Normal;
+	OutSample.RightTangent = AClimbingSystemCharacter::GetRightVectorOfCurrentVector(Normal);
+	OutSample.UpTangent = AClimbingSystemCharacter::GetUpVectorOfCurrentVector(Normal);
+	OutSample.SnapTarget = Location + Normal * ClimbWallDistance;
+	OutSample.Rotation = FRotationMatrix::MakeFromX(-Normal).Rotator();
+}
+
+bool UClimbingMovementComponent::ConsumePrecomputedClimbSurface(FClimbSurfaceSample& OutSample) {
+	// 批量计算在帧末执行，所以上一帧算好的结果也可以用
+	if (PrecomputedSurfaceFrame == 0 || GFrameCounter - PrecomputedSurfaceFrame > 1) {
+		return false;
+	}
+
+	OutSample = PrecomputedSurface;
+	PrecomputedSurfaceFrame = 0;
+	return true;
+}
+
+bool UClimbingMovementComponent::ConsumeClimbEnterSurface(FClimbSurfaceSample& OutSample) {
+	// 检测和进入攀爬在同一帧，之后的回放和纠正都不再用它
+	if (EnterSurfaceFrame != GFrameCounter || bClientUpdating) {
+		return false;
+	}
+
+	OutSample = EnterSurface;
+	EnterSurfaceFrame = 0;
+	return true;
+}
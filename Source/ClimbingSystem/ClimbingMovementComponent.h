@@ -0,0 +1,401 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/RootMotionSource.h"
+#include "ClimbableSurfaceComponent.h"
+#include "ClimbingSurfaceSampler.h"
+#include "ClimbingMovementComponent.generated.h"
+
+class UCurveVector;
+
+UENUM(BlueprintType)
+enum ECustomMovementMode {
+	CMOVE_None = 0 UMETA(Hidden),
+	CMOVE_Climbing = 1,		// 攀爬模式，由PhysClimbing驱动
+};
+
+/**
+ * 攀爬过渡动作的状态机，每个阶段是一个FRootMotionSource_MoveToForce，阶段结束后在移动里切到下一个阶段
+ * Enter: 进入攀爬时贴到墙上并转向墙面
+ * MantleRise -> MantleOver: 先沿墙升到Ledge上方，再平移到Ledge上站立的位置
+ * Leap: 攀爬中跳到够得着的下一个抓点，并转向那里的墙面
+ */
+UENUM()
+enum class EClimbTransition : uint8 {
+	None,
+	Enter,
+	MantleRise,
+	MantleOver,
+	Leap,
+};
+
+// 一个过渡动作(Enter或者整个Mantle)结束时广播，回放纠正的时候不会广播
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnClimbTransitionFinished, EClimbTransition);
+
+/** 一次墙面检测的结果，以及由它算出来的贴墙目标 */
+struct FClimbSurfaceSample {
+	bool bValid = false;
+	FVector Location = FVector::ZeroVector;		// 墙面上的检测点
+	FVector Normal = FVector::ZeroVector;		// 墙面法线
+	FVector RightTangent = FVector::ZeroVector;	// 墙面向右和向上的切线
+	FVector UpTangent = FVector::ZeroVector;
+	FVector SnapTarget = FVector::ZeroVector;	// 角色贴墙时的目标位置
+	FRotator Rotation = FRotator::ZeroRotator;	// 角色面朝墙面时的目标朝向
+	TWeakObjectPtr<const UPrimitiveComponent> Component;	// 墙面所在的组件，是UClimbableSurfaceComponent时从它读攀爬参数
+};
+
+/**
+ * 同步给模拟端的攀爬状态，不在攀爬时只占2位，攀爬时再加上八面体编码的墙面法线(2个字节)
+ */
+USTRUCT()
+struct FClimbingNetState {
+	GENERATED_BODY()
+
+	uint8 Mode = 0;			// ECharacterMovementMode
+	uint8 NormalU = 128;
+	uint8 NormalV = 128;
+
+	void SetNormal(const FVector& Normal);
+	FVector GetNormal() const;
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+
+	bool operator==(const FClimbingNetState& Other) const {
+		return Mode == Other.Mode && NormalU == Other.NormalU && NormalV == Other.NormalV;
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FClimbingNetState> : public TStructOpsTypeTraitsBase2<FClimbingNetState> {
+	enum {
+		WithNetSerializer = true,
+		WithIdenticalViaEquality = true,
+	};
+};
+
+/** 一个World里攀爬角色的网络开销，Climbing.Net.Stats和网络测试都用它 */
+struct FClimbingNetStats {
+	int32 NumClimbers = 0;
+	uint32 NumCorrections = 0;		// 所有角色收到的移动纠正次数之和
+	double InBytesPerSecond = 0.0;	// NetDriver上一个统计周期的带宽
+	double OutBytesPerSecond = 0.0;
+
+	double GetInBytesPerClimber() const { return InBytesPerSecond / FMath::Max(NumClimbers, 1); }
+	double GetOutBytesPerClimber() const { return OutBytesPerSecond / FMath::Max(NumClimbers, 1); }
+};
+
+/** 在FSavedMove_Character的基础上记录攀爬的意图，回放和服务器模拟时用同样的输入 */
+class FSavedMove_Climbing : public FSavedMove_Character {
+	typedef FSavedMove_Character Super;
+
+public:
+	uint8 bSavedWantsToClimb : 1;
+	uint8 bSavedWantsToMantle : 1;
+	uint8 bSavedWantsToLeap : 1;
+
+	// 回放时恢复过渡状态机，Root Motion Source本身由FSavedMove_Character保存
+	EClimbTransition SavedClimbTransition;
+	uint16 SavedClimbTransitionSourceID;
+	FVector SavedMantleTargetLocation;
+	FVector SavedLeapTargetLocation;
+	FQuat SavedLeapTargetRotation;
+
+	// 固定步长没用完的时间，回放时从同一个相位开始，走出来的步数才和第一次模拟一致
+	float SavedClimbStepAccumulator;
+	float SavedTimeSinceSurfaceProbe;		// 同理，回放时在同一个Tick重新检测墙面
+
+	// 两次检测之间沿用的墙面，回放时和第一次模拟用同一面墙
+	FClimbSurfaceSample SavedCachedSurface;
+	bool bSavedHasClimbSurface;
+
+	// 墙面检测模板的网格，回放时从第一次模拟时的网格开始，复用的格子和第一次模拟一致
+	FClimbSurfaceSampler::FGridAnchor SavedSurfaceGridAnchor;
+
+	virtual void Clear() override;
+	virtual uint8 GetCompressedFlags() const override;
+	virtual bool CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const override;
+	virtual void SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData) override;
+	virtual void PrepMoveFor(ACharacter* C) override;
+};
+
+class FNetworkPredictionData_Client_Climbing : public FNetworkPredictionData_Client_Character {
+	typedef FNetworkPredictionData_Client_Character Super;
+
+public:
+	FNetworkPredictionData_Client_Climbing(const UCharacterMovementComponent& ClientMovement);
+
+	virtual FSavedMovePtr AllocateNewMove() override;
+};
+
+/**
+ * 带有原生攀爬模式(MOVE_Custom + CMOVE_Climbing)的CharacterMovementComponent
+ * 输入回调里只记录输入，贴墙、转向和速度积分都在PhysClimbing里每个Tick做一次
+ * 退出攀爬和Mantle的检测在TickComponent里本地移动之前做一次，决定的意图和这一帧的输入存进同一个FSavedMove
+ */
+UCLASS()
+class UClimbingMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	UClimbingMovementComponent();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing", meta = (ClampMin = "0", UIMin = "0", ForceUnits = "cm/s"))
+	float MaxClimbSpeed;				// 攀爬时的最大速度
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing", meta = (ClampMin = "0", UIMin = "0"))
+	float BrakingDecelerationClimbing;	// 攀爬时没有输入的减速度
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing", meta = (ClampMin = "0", UIMin = "0"))
+	float ClimbSnapSpeed;				// 贴墙和转向的插值速度
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing", meta = (ClampMin = "0", UIMin = "0"))
+	float ClimbWallDistance;			// 攀爬时角色中心离墙面的距离
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing", meta = (ClampMin = "0", UIMin = "0"))
+	float ClimbProbeLength;				// 每个Tick向前检测墙面的长度
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Fixed Step", meta = (ClampMin = "0", UIMin = "0", ForceUnits = "s"))
+	float ClimbFixedTimeStep;			// 攀爬按这个固定步长积分，多出来的时间留到下一次移动，0表示直接按每次移动的时间积分
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Fixed Step", meta = (ClampMin = "1", UIMin = "1"))
+	int32 ClimbMaxFixedStepsPerMove;	// 一次移动最多走几步，卡顿时超出的时间直接丢掉，避免越卡越慢
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Fixed Step")
+	bool bInterpolateClimbMesh;			// 本地控制的角色在两步之间插值Mesh的位置，高帧率下看起来不会一顿一顿的
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing", meta = (ClampMin = "0", UIMin = "0", ForceUnits = "s"))
+	float ClimbSurfaceProbeInterval;	// 两次墙面检测之间的最短间隔，中间的Tick沿用上一次的墙面，0表示每个Tick都检测
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Surface Sampling", meta = (ClampMin = "0", UIMin = "0", UIMax = "3"))
+	int32 ClimbSurfaceSampleRadius;		// 墙面检测模板的半径，模板是(2 * Radius + 1)^2根检测线，0就是只有中间一根
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Surface Sampling", meta = (ClampMin = "1", UIMin = "1"))
+	float ClimbSurfaceSampleSpacing;	// 模板里相邻两根检测线的间距
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Surface Sampling", meta = (ClampMin = "0", UIMin = "0", ForceUnits = "s"))
+	float ClimbSurfaceSampleMaxAge;		// 角色没移动时，一根检测线的结果最多沿用多久
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Surface Sampling", meta = (ClampMin = "0", ClampMax = "1", UIMin = "0", UIMax = "1"))
+	float ClimbCornerWrapBlend;			// 往模板左右两侧检测到的墙角移动时，朝向往墙角另一面墙的法线偏多少，0表示不绕墙角
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Transition", meta = (ClampMin = "0", UIMin = "0"))
+	float ClimbEnterProbeLength;		// 进入攀爬时找贴墙目标的检测长度，比ClimbProbeLength长，因为这时还没贴到墙上
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Transition", meta = (ClampMin = "0", UIMin = "0", ForceUnits = "s"))
+	float ClimbEnterDuration;			// 从Falling抓墙时贴墙的时间
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Transition", meta = (ClampMin = "0", UIMin = "0", ForceUnits = "s"))
+	float ClimbEnterFromGroundDuration;	// 从地面起跳抓墙时贴墙的时间，IdleToOnWallMontage按这个时长缩放播放
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Transition")
+	UCurveVector* ClimbEnterPathOffsetCurve;	// 可选，贴墙路径相对直线的偏移，横轴是0到1的进度
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Transition", meta = (ClampMin = "0", UIMin = "0", ForceUnits = "s"))
+	float MantleRiseDuration;			// Mantle时沿墙上升的时间，MantleMontage按这个时长缩放播放
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Transition", meta = (ClampMin = "0", UIMin = "0", ForceUnits = "s"))
+	float MantleOverDuration;			// Mantle时从墙边平移到Ledge上的时间
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Transition", meta = (ClampMin = "0", UIMin = "0"))
+	float MantleClearance;				// 上升阶段比站立位置额外高出的距离，避免平移时蹭到Ledge的边
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Transition")
+	UCurveVector* MantlePathOffsetCurve;	// 可选，平移到Ledge上时路径的偏移，横轴是0到1的进度
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Leap", meta = (ClampMin = "0", UIMin = "0"))
+	float LeapReach;					// 攀爬中起跳最远能够到的距离，沿墙面量
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Leap", meta = (ClampMin = "0", UIMin = "0"))
+	float LeapMinDistance;				// 比这个还近的抓点不值得跳，直接爬过去
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Leap", meta = (ClampMin = "1", UIMin = "1", UIMax = "8"))
+	int32 LeapNumSteps;					// 在LeapMinDistance和LeapReach之间取几个距离，每个距离3个方向
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Leap", meta = (ClampMin = "0", ClampMax = "90", ForceUnits = "deg"))
+	float LeapSpreadAngle;				// 两侧的候选方向偏离输入方向的角度
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Leap", meta = (ClampMin = "0", ClampMax = "90", ForceUnits = "deg"))
+	float LeapMaxSurfaceAngle;			// 落点的墙面和当前墙面的最大夹角
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Leap", meta = (ClampMin = "0", UIMin = "0", ForceUnits = "s"))
+	float LeapDuration;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Climbing|Leap")
+	UCurveVector* LeapPathOffsetCurve;		// 可选，跳跃路径相对直线的偏移，横轴是0到1的进度
+
+	FOnClimbTransitionFinished OnClimbTransitionFinished;
+
+	bool IsClimbing() const;
+
+	/**
+	 * 想要进入/保持攀爬，随移动一起压缩发给服务器(FLAG_Custom_0)
+	 * 服务器和客户端回放时在UpdateCharacterStateBeforeMovement里根据它切换移动模式
+	 */
+	void SetWantsToClimb(bool bInWantsToClimb) { bWantsToClimb = bInWantsToClimb; }
+	bool WantsToClimb() const { return bWantsToClimb; }
+
+	/**
+	 * 开始Mantle，TargetLocation是Ledge上站立的位置(脚底)
+	 * 本地立即开始，同时通过FLAG_Custom_1让服务器用自己的CheckMantle算出目标后开始同样的过渡
+	 * @return 当前不在攀爬或者已经在过渡中时返回false
+	 */
+	bool StartMantle(const FVector& TargetLocation);
+	void SetWantsToMantle(bool bInWantsToMantle) { bWantsToMantle = bInWantsToMantle; }
+	bool WantsToMantle() const { return bWantsToMantle; }
+
+	/**
+	 * 沿墙面往Direction方向跳到够得着的下一个抓点，Direction只取它在墙面切线上的分量，为零时往上跳
+	 * 本地立即开始，同时通过FLAG_Custom_2让服务器按这次移动的加速度方向自己找目标后开始同样的过渡
+	 * @return 当前不在攀爬、已经在过渡中或者范围内没有能落脚的墙面时返回false
+	 */
+	bool StartLeap(const FVector& Direction);
+
+	// 这一帧的输入向量变成的加速度，和这一帧FSavedMove里发给服务器的Acceleration完全相同，本地发起Leap时用它当方向
+	FVector GetInputAcceleration(const FVector& InputVector) const;
+
+	void SetWantsToLeap(bool bInWantsToLeap) { bWantsToLeap = bInWantsToLeap; }
+	bool WantsToLeap() const { return bWantsToLeap; }
+
+	/**
+	 * 在墙面的切线方向上取一组候选点，挑出最远的能落脚的一个
+	 * 整个范围只做一次Overlap拿到附近的组件，由Box组成的在Box上解析求交，其他形状的组件对候选点单独做LineTraceComponent
+	 */
+	bool FindLeapTarget(const FVector& Direction, FClimbSurfaceSample& OutSample) const;
+
+	EClimbTransition GetClimbTransition() const { return ClimbTransition; }
+	bool IsInClimbTransition() const { return ClimbTransition != EClimbTransition::None; }
+
+	// 模拟端收到同步的墙面法线时调用
+	void SetReplicatedClimbSurface(const FVector& Normal);
+
+	// 客户端收到的移动纠正次数
+	uint32 GetNumClientCorrections() const { return NumClientCorrections; }
+	void ResetNumClientCorrections() { NumClientCorrections = 0; }
+
+	// 统计World里所有攀爬角色的纠正次数和NetDriver的带宽，bResetCorrections时顺便清零纠正计数
+	static FClimbingNetStats GatherNetStats(UWorld* World, bool bResetCorrections);
+
+	// 最近一次检测到的墙面，没有检测到墙时HasClimbSurface返回false
+	bool HasClimbSurface() const { return bHasClimbSurface; }
+	const FVector& GetClimbSurfaceNormal() const { return ClimbSurfaceNormal; }
+	const FVector& GetClimbSurfaceLocation() const { return ClimbSurfaceLocation; }
+	const FVector& GetClimbSurfaceRight() const { return ClimbSurfaceRight; }
+	const FVector& GetClimbSurfaceUp() const { return ClimbSurfaceUp; }
+
+	// 当前墙面上的攀爬参数，墙面不是UClimbableSurfaceComponent(或者是模拟端)时返回默认值
+	float GetClimbSurfaceSpeedScale() const;
+	EClimbGripType GetClimbGripType() const;
+
+	// 墙面检测模板四周的内角/外角，SampleClimbSurface用左右两侧的结果绕过墙角，只有本地控制和服务器上有
+	const FClimbCornerInfo& GetClimbCorner(EClimbCornerSide Side) const { return SurfaceSampler.GetCorner(Side); }
+
+	/**
+	 * 外部(UClimbingCrowdSubsystem)批量算好的墙面数据，在下一次PhysClimbing里代替自己的检测
+	 * 只在当前帧和下一帧有效，过期之后PhysClimbing会自己重新检测
+	 */
+	void SetPrecomputedClimbSurface(const FClimbSurfaceSample& Sample);
+
+	// 角色自己的墙壁检测已经找到的墙面，同一帧里进入攀爬时Enter过渡直接用它，不再从胶囊体中心重新检测
+	void SetClimbEnterSurface(const FHitResult& WallHit);
+
+	// 按ClimbSurfaceProbeInterval是否该重新检测墙面了，UClimbingCrowdSubsystem用它跳过不需要检测的角色
+	bool IsClimbSurfaceProbeDue() const;
+
+	/**
+	 * UClimbingCrowdSubsystem用的墙面检测，和SampleClimbSurface是同一个FClimbSurfaceSampler，只是检测由它批量异步提交
+	 * Begin取出这一次要检测的线，结果回来之后逐个Apply，再用Finish拟合出绕过墙角之后的位置和法线
+	 * Climbing.SurfaceSampler为0时模板只有中间一个格子，相当于DetectClimbSurface的单根检测线
+	 */
+	void BeginDeferredClimbSurfaceSample(TArray<FClimbSurfaceSampler::FProbeRequest>& OutRequests);
+	void ApplyDeferredClimbSurfaceProbe(const FClimbSurfaceSampler::FProbeRequest& Request, const FHitResult* Hit);
+	bool FinishDeferredClimbSurfaceSample(FVector& OutLocation, FVector& OutNormal, const UPrimitiveComponent*& OutComponent);
+
+	// UCharacterMovementComponent interface
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	virtual float GetMaxSpeed() const override;
+	virtual float GetMaxBrakingDeceleration() const override;
+	virtual FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+	virtual void UpdateCharacterStateBeforeMovement(float DeltaSeconds) override;
+	virtual void UpdateCharacterStateAfterMovement(float DeltaSeconds) override;
+	virtual void OnClientCorrectionReceived(FNetworkPredictionData_Client_Character& ClientData, float TimeStamp, FVector NewLocation, FVector NewVelocity, UPrimitiveComponent* NewBase, FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode) override;
+
+protected:
+	virtual void PhysCustom(float deltaTime, int32 Iterations) override;
+	virtual void OnMovementModeChanged(EMovementMode PreviousMovementMode, uint8 PreviousCustomMode) override;
+	virtual FVector ConstrainInputAcceleration(const FVector& InputAcceleration) const override;
+	virtual void UpdateFromCompressedFlags(uint8 Flags) override;
+
+private:
+	void PhysClimbing(float deltaTime, int32 Iterations);
+
+	// 攀爬的一个积分步: 算速度、贴墙、转向、带碰撞移动
+	void ClimbStep(float TimeTick, const FVector& SnapTarget, const FRotator& DesiredRotation);
+
+	// 固定步长下Mesh的显示位置在上一步和这一步之间按剩余时间插值，Clear时恢复Mesh原来的相对位置
+	void UpdateClimbMeshInterpolation();
+	void ClearClimbMeshInterpolation();
+
+	// 过渡动作中只跟随Root Motion Source，不再贴墙
+	void PhysClimbTransition(float deltaTime, int32 Iterations);
+
+	// 切换过渡阶段并挂上这个阶段的Root Motion Source，切到None时移除正在进行的Source
+	void SetClimbTransition(EClimbTransition NewTransition);
+	void AdvanceClimbTransition();
+	uint16 ApplyClimbTransitionSource(const FVector& TargetLocation, float Duration, UCurveVector* PathOffsetCurve, bool bStopOnFinish);
+
+	// 从角色中心向前检测墙面
+	bool DetectClimbSurface(FClimbSurfaceSample& OutSample, float ProbeLength) const;
+
+	// 攀爬中用FClimbSurfaceSampler的多点拟合检测墙面，Climbing.SurfaceSampler为0时退回到DetectClimbSurface
+	// 网格存在FSavedMove里，回放时复用的格子和第一次模拟一样；往左右的墙角移动时朝向按ClimbCornerWrapBlend转过去
+	bool SampleClimbSurface(FClimbSurfaceSample& OutSample, float DeltaTime);
+	void MakeClimbSurfaceSample(const FVector& Location, const FVector& Normal, const UPrimitiveComponent* Component, FClimbSurfaceSample& OutSample) const;
+	FClimbSurfaceSampler::FSettings GetSurfaceSamplerSettings() const;
+	FVector WrapClimbSurfaceNormal(const FVector& Normal) const;
+	bool ConsumePrecomputedClimbSurface(FClimbSurfaceSample& OutSample);
+	bool ConsumeClimbEnterSurface(FClimbSurfaceSample& OutSample);
+
+	FClimbSurfaceSample PrecomputedSurface;
+	uint64 PrecomputedSurfaceFrame;
+
+	FClimbSurfaceSample EnterSurface;
+	uint64 EnterSurfaceFrame;
+
+	FClimbSurfaceSample CachedSurface;		// 最近一次检测到的墙面，两次检测之间沿用
+	FClimbSurfaceSampler SurfaceSampler;
+	float TimeSinceSurfaceProbe;
+
+	float ClimbStepAccumulator;				// 还没凑够一个固定步长的时间
+	FVector ClimbPrevStepLocation;			// 最后一步之前的位置和朝向，给Mesh插值用
+	FQuat ClimbPrevStepRotation;
+	bool bClimbMeshInterpolated;
+
+	FVector ClimbSurfaceNormal;
+	FVector ClimbSurfaceLocation;
+	FVector ClimbSurfaceRight;
+	FVector ClimbSurfaceUp;
+	bool bHasClimbSurface;
+
+	uint8 bWantsToClimb : 1;
+	uint8 bWantsToMantle : 1;
+	uint8 bWantsToLeap : 1;
+	uint32 NumClientCorrections;
+
+	EClimbTransition ClimbTransition;
+	uint16 ClimbTransitionSourceID;
+	TEnumAsByte<EMovementMode> ClimbEnterFromMode;		// 进入攀爬之前的移动模式，决定Enter的时长
+	FVector MantleTargetLocation;
+	FVector LeapTargetLocation;
+	FQuat LeapTargetRotation;
+	FQuat ClimbTransitionStartRotation;
+	FQuat ClimbTransitionTargetRotation;
+
+	// 预先分配好的Source，轮流使用，上一个阶段的Source可能还没从CurrentRootMotion里移除
+	TSharedPtr<FRootMotionSource_MoveToForce> ClimbTransitionSources[2];
+
+	friend class FSavedMove_Climbing;
+};
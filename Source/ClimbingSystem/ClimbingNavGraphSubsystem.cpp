@@ -0,0 +1,758 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingNavGraphSubsystem.h"
+#include "ClimbableSurfaceSubsystem.h"
+#include "ClimbingMathKernels.h"
+#include "ClimbingStats.h"
+#include "ClimbingSystem.h"
+#include "DrawDebugHelpers.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "GraphAStar.h"
+#include "NavigationData.h"
+#include "NavigationSystem.h"
+#include "Tasks/Task.h"
+
+static TAutoConsoleVariable<float> CVarClimbingNavGraphNodeSpacing(
+	TEXT("Climbing.NavGraph.NodeSpacing"),
+	200.f,
+	TEXT("宽的墙面沿水平方向每隔多远放一列攀爬节点"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarClimbingNavGraphClimbUpCost(
+	TEXT("Climbing.NavGraph.ClimbUpCost"),
+	3.f,
+	TEXT("往上爬每厘米的代价，走路每厘米的代价是1，不能小于1"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarClimbingNavGraphClimbDownCost(
+	TEXT("Climbing.NavGraph.ClimbDownCost"),
+	2.f,
+	TEXT("往下爬每厘米的代价，不能小于1"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarClimbingNavGraphAngleCost(
+	TEXT("Climbing.NavGraph.AngleCost"),
+	1.f,
+	TEXT("墙面倾斜带来的额外代价，倾斜到会退出攀爬的角度时攀爬代价变成(1 + AngleCost)倍"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarClimbingNavGraphWalkLinkDistance(
+	TEXT("Climbing.NavGraph.WalkLinkDistance"),
+	2000.f,
+	TEXT("两个节点直线距离在这个范围内才尝试在导航网格上连一条走路的边，查询的起点终点也用这个距离连到图上"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarClimbingNavGraphMaxWalkLinks(
+	TEXT("Climbing.NavGraph.MaxWalkLinks"),
+	8,
+	TEXT("每个节点最多尝试连多少条走路的边，只取最近的几个"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarClimbingNavGraphQueryLinkMaxHeight(
+	TEXT("Climbing.NavGraph.QueryLinkMaxHeight"),
+	100.f,
+	TEXT("查询的起点终点只尝试连到高度差在这个范围内的节点，连之前还要在导航网格上用射线确认走得通"),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorldAndArgs ClimbingNavGraphFindPathCommand(
+	TEXT("Climbing.NavGraph.FindPath"),
+	TEXT("从第一个本地玩家的位置到给定的位置(X Y Z)做一次攀爬寻路，输出路径并画出来"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World) {
+		UClimbingNavGraphSubsystem* NavGraph = World ? World->GetSubsystem<UClimbingNavGraphSubsystem>() : nullptr;
+		const APlayerController* PlayerController = World ? World->GetFirstPlayerController() : nullptr;
+		const APawn* Pawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+		if (!NavGraph || !Pawn || Args.Num() < 3) {
+			UE_LOG(LogClimbing, Warning, TEXT("Usage: Climbing.NavGraph.FindPath X Y Z (needs a local player pawn)"));
+			return;
+		}
+
+		const FVector End(FCString::Atod(*Args[0]), FCString::Atod(*Args[1]), FCString::Atod(*Args[2]));
+		TWeakObjectPtr<UWorld> WeakWorld(World);
+		NavGraph->FindPathAsync(Pawn->GetNavAgentLocation(), End, FOnClimbNavPathFound::CreateLambda([WeakWorld](uint32 QueryID, const FClimbNavPath& Path) {
+			if (!Path.IsValid()) {
+				UE_LOG(LogClimbing, Display, TEXT("Climb nav path %u: not found"), QueryID);
+				return;
+			}
+			UE_LOG(LogClimbing, Display, TEXT("Climb nav path %u: %d points, cost %.1f"), QueryID, Path.Points.Num(), Path.Cost);
+			for (int32 Index = 0; Index < Path.Points.Num(); ++Index) {
+				const FClimbNavPathPoint& Point = Path.Points[Index];
+				UE_LOG(LogClimbing, Display, TEXT("  %d: %s (%s)"), Index, *Point.Location.ToString(), *UEnum::GetValueAsString(Point.LinkType));
+#if ENABLE_DRAW_DEBUG
+				if (Index > 0 && WeakWorld.IsValid()) {
+					const FColor Color = Point.LinkType == EClimbNavLinkType::Walk ? FColor::Green : FColor::Orange;
+					DrawDebugLine(WeakWorld.Get(), Path.Points[Index - 1].Location, Point.Location, Color, false, 10.f, 0, 3.f);
+				}
+#endif
+			}
+		}));
+	}));
+
+// 投影到导航网格时的搜索范围
+static const FVector NavProjectionExtent(50.f, 50.f, 150.f);
+
+// 墙脚节点离墙的距离和顶边节点往墙里缩进的距离，和CheckMantle的站立点一致
+static constexpr float WallStandOff = 50.f;
+static constexpr float LedgeStandInset = 50.f;
+
+namespace ClimbingNavGraph {
+	// 查询的时候在快照后面接上两个虚拟节点: 起点和终点
+	struct FQueryGraph {
+		typedef int32 FNodeRef;
+
+		const FClimbNavGraphSnapshot& Graph;
+		const FVector Start;
+		const FVector End;
+		const int32 StartRef;
+		const int32 EndRef;
+
+		TArray<FClimbNavGraphSnapshot::FEdge> StartEdges;
+		TArray<float> EndCosts;		// 每个节点走到终点的代价，小于0表示连不上
+
+		FQueryGraph(const FClimbNavGraphSnapshot& InGraph, const FVector& InStart, const FVector& InEnd)
+			: Graph(InGraph), Start(InStart), End(InEnd), StartRef(InGraph.Nodes.Num()), EndRef(InGraph.Nodes.Num() + 1) {
+		}
+
+		const FVector& GetLocation(int32 NodeRef) const {
+			return NodeRef == StartRef ? Start : NodeRef == EndRef ? End : Graph.Nodes[NodeRef].Location;
+		}
+
+		int32 GetNumRealEdges(int32 NodeRef) const {
+			return Graph.EdgeOffsets[NodeRef + 1] - Graph.EdgeOffsets[NodeRef];
+		}
+
+		bool IsValidRef(FNodeRef NodeRef) const {
+			return NodeRef >= 0 && NodeRef <= EndRef;
+		}
+
+		int32 GetNeighbourCount(FNodeRef NodeRef) const {
+			if (NodeRef == StartRef) {
+				return StartEdges.Num();
+			}
+			if (NodeRef == EndRef) {
+				return 0;
+			}
+			return GetNumRealEdges(NodeRef) + (EndCosts[NodeRef] >= 0.f ? 1 : 0);
+		}
+
+		FNodeRef GetNeighbour(const FGraphAStarDefaultNode<FQueryGraph>& Node, const int32 NeighbourIndex) const {
+			if (Node.NodeRef == StartRef) {
+				return StartEdges[NeighbourIndex].Target;
+			}
+			if (NeighbourIndex == GetNumRealEdges(Node.NodeRef)) {
+				return EndRef;
+			}
+			return Graph.Edges[Graph.EdgeOffsets[Node.NodeRef] + NeighbourIndex].Target;
+		}
+
+		// 两个节点之间最多只有一条边
+		const FClimbNavGraphSnapshot::FEdge* FindEdge(int32 From, int32 To) const {
+			if (From == StartRef) {
+				return StartEdges.FindByPredicate([To](const FClimbNavGraphSnapshot::FEdge& Edge) { return Edge.Target == To; });
+			}
+			for (int32 EdgeIndex = Graph.EdgeOffsets[From]; EdgeIndex < Graph.EdgeOffsets[From + 1]; ++EdgeIndex) {
+				if (Graph.Edges[EdgeIndex].Target == To) {
+					return &Graph.Edges[EdgeIndex];
+				}
+			}
+			return nullptr;
+		}
+
+		float GetCost(int32 From, int32 To) const {
+			if (To == EndRef && From != StartRef) {
+				return EndCosts[From];
+			}
+			const FClimbNavGraphSnapshot::FEdge* Edge = FindEdge(From, To);
+			return Edge ? Edge->Cost : 0.f;
+		}
+
+		EClimbNavLinkType GetLinkType(int32 From, int32 To) const {
+			if (To == EndRef && From != StartRef) {
+				return EClimbNavLinkType::Walk;
+			}
+			const FClimbNavGraphSnapshot::FEdge* Edge = FindEdge(From, To);
+			return Edge ? Edge->Type : EClimbNavLinkType::Walk;
+		}
+	};
+
+	// PublishSnapshot把所有边的代价截到不小于两点间的直线距离，起点终点的边不小于直线距离，用直线距离做启发值不会高估
+	struct FQueryFilter {
+		typedef FGraphAStarDefaultNode<FQueryGraph> FSearchNode;
+
+		const FQueryGraph& Graph;
+
+		explicit FQueryFilter(const FQueryGraph& InGraph) : Graph(InGraph) {}
+
+		FVector::FReal GetHeuristicScale() const { return 1.0; }
+
+		FVector::FReal GetHeuristicCost(const FSearchNode& StartNode, const FSearchNode& EndNode) const {
+			return FVector::Dist(Graph.GetLocation(StartNode.NodeRef), Graph.GetLocation(EndNode.NodeRef));
+		}
+
+		FVector::FReal GetTraversalCost(const FSearchNode& StartNode, const FSearchNode& EndNode) const {
+			return Graph.GetCost(StartNode.NodeRef, EndNode.NodeRef);
+		}
+
+		bool IsTraversalAllowed(const int32 NodeA, const int32 NodeB) const { return true; }
+		bool WantsPartialSolution() const { return false; }
+	};
+}
+
+UClimbingNavGraphSubsystem::UClimbingNavGraphSubsystem()
+	: CompletedQueries(MakeShared<FCompletedQueue, ESPMode::ThreadSafe>()) {
+}
+
+void UClimbingNavGraphSubsystem::Initialize(FSubsystemCollectionBase& Collection) {
+	Super::Initialize(Collection);
+	Collection.InitializeDependency<UClimbableSurfaceSubsystem>();
+}
+
+void UClimbingNavGraphSubsystem::Deinitialize() {
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+	UNavigationSystemV1::NavigationDirtyEvent.Remove(NavigationDirtyHandle);
+
+	if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld())) {
+		NavSys->OnNavigationGenerationFinishedDelegate.RemoveDynamic(this, &UClimbingNavGraphSubsystem::OnNavigationGenerationFinished);
+	}
+	CancelWalkLinks();
+
+	// 还在工作线程上跑的查询只持有快照和结果队列，不会再碰到这个对象
+	PendingQueries.Reset();
+	PendingLevels.Reset();
+	NavDirtyBounds.Reset();
+	PendingDirtyBounds.Reset();
+	EditNodes.Reset();
+	Snapshot.Reset();
+
+	Super::Deinitialize();
+}
+
+bool UClimbingNavGraphSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UClimbingNavGraphSubsystem::OnWorldBeginPlay(UWorld& InWorld) {
+	Super::OnWorldBeginPlay(InWorld);
+
+	for (ULevel* Level : InWorld.GetLevels()) {
+		PendingLevels.AddUnique(Level);
+	}
+
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UClimbingNavGraphSubsystem::OnLevelAddedToWorld);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &UClimbingNavGraphSubsystem::OnLevelRemovedFromWorld);
+
+	if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(&InWorld)) {
+		NavSys->OnNavigationGenerationFinishedDelegate.AddUniqueDynamic(this, &UClimbingNavGraphSubsystem::OnNavigationGenerationFinished);
+	}
+	NavigationDirtyHandle = UNavigationSystemV1::NavigationDirtyEvent.AddUObject(this, &UClimbingNavGraphSubsystem::OnNavigationDirty);
+}
+
+TStatId UClimbingNavGraphSubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UClimbingNavGraphSubsystem, STATGROUP_Tickables);
+}
+
+void UClimbingNavGraphSubsystem::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+
+	// 1. 每帧最多加一个关卡的节点，没有要加的关卡时重建导航网格变脏的范围，导航网格还在生成的时候先等着
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (NavSys && !NavSys->IsNavigationBuildInProgress()) {
+		while (PendingLevels.Num() > 0) {
+			ULevel* Level = PendingLevels[0].Get();
+			PendingLevels.RemoveAt(0);
+			if (Level) {
+				AddLevelNodes(Level, *NavSys);
+				break;
+			}
+		}
+		if (PendingLevels.Num() == 0 && PendingDirtyBounds.Num() > 0) {
+			const TArray<FBox> DirtyBounds = MoveTemp(PendingDirtyBounds);
+			PendingDirtyBounds.Reset();
+			RebuildDirtyBounds(DirtyBounds, *NavSys);
+		}
+	}
+
+	// 2. 所有改动都完成了(包括走路的边的异步寻路)才发布新的快照，之前提交的查询一直用旧的
+	if (bSnapshotDirty && PendingLevels.Num() == 0 && PendingDirtyBounds.Num() == 0 && PendingWalkLinks.Num() == 0) {
+		PublishSnapshot();
+		bSnapshotDirty = false;
+	}
+
+	// 3. 把工作线程上算完的结果交给请求的人
+	FCompletedQuery Completed;
+	while (CompletedQueries->Dequeue(Completed)) {
+		FOnClimbNavPathFound OnFound;
+		if (PendingQueries.RemoveAndCopyValue(Completed.QueryID, OnFound)) {
+			OnFound.ExecuteIfBound(Completed.QueryID, Completed.Path);
+		}
+	}
+}
+
+uint32 UClimbingNavGraphSubsystem::FindPathAsync(const FVector& Start, const FVector& End, FOnClimbNavPathFound OnFound) {
+	const uint32 QueryID = NextQueryID++;
+	if (NextQueryID == 0) {
+		NextQueryID = 1;
+	}
+	PendingQueries.Add(QueryID, MoveTemp(OnFound));
+
+	// 还没有发布过快照时用一张空图，只能直接走过去
+	TSharedPtr<const FClimbNavGraphSnapshot, ESPMode::ThreadSafe> Graph = Snapshot;
+	if (!Graph) {
+		TSharedRef<FClimbNavGraphSnapshot, ESPMode::ThreadSafe> EmptyGraph = MakeShared<FClimbNavGraphSnapshot, ESPMode::ThreadSafe>();
+		EmptyGraph->EdgeOffsets.Add(0);
+		Graph = EmptyGraph;
+	}
+
+	// 导航网格只能在GameThread上查，起点终点的边在这里确认好再交给工作线程
+	FQueryLinks Links;
+	BuildQueryLinks(*Graph, FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()), Start, End, Links);
+
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [Graph, Results = CompletedQueries, QueryID, Start, End, Links = MoveTemp(Links)]() {
+		FCompletedQuery Completed;
+		Completed.QueryID = QueryID;
+		FindPath(*Graph, Start, End, Links, Completed.Path);
+		Results->Enqueue(MoveTemp(Completed));
+	});
+
+	return QueryID;
+}
+
+void UClimbingNavGraphSubsystem::CancelQuery(uint32 QueryID) {
+	PendingQueries.Remove(QueryID);
+}
+
+void UClimbingNavGraphSubsystem::RequestRebuild() {
+	// AddLevelNodes会先去掉这个关卡原来的节点，不用在这里清空，旧的快照一直用到全部重建完
+	for (ULevel* Level : GetWorld()->GetLevels()) {
+		PendingLevels.AddUnique(Level);
+	}
+}
+
+void UClimbingNavGraphSubsystem::BuildQueryLinks(const FClimbNavGraphSnapshot& Graph, UNavigationSystemV1* NavSys, const FVector& Start, const FVector& End, FQueryLinks& OutLinks) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingNavGraphQuery);
+
+	// 起点或者终点不在导航网格上时一条走路的边都连不上
+	const ANavigationData* NavData = NavSys ? NavSys->GetDefaultNavDataInstance() : nullptr;
+	FNavLocation StartLocation;
+	FNavLocation EndLocation;
+	if (!NavData || !NavSys->ProjectPointToNavigation(Start, StartLocation, NavProjectionExtent) || !NavSys->ProjectPointToNavigation(End, EndLocation, NavProjectionExtent)) {
+		return;
+	}
+
+	const float LinkDistance = CVarClimbingNavGraphWalkLinkDistance.GetValueOnGameThread();
+	const float LinkMaxHeight = CVarClimbingNavGraphQueryLinkMaxHeight.GetValueOnGameThread();
+	const int32 MaxLinks = CVarClimbingNavGraphMaxWalkLinks.GetValueOnGameThread();
+	const FSharedConstNavQueryFilter QueryFilter = NavData->GetDefaultQueryFilter();
+
+	// 导航网格上的射线没被挡住就是直线走得通，代价是没投影之前的直线距离，和启发值用的位置一致
+	auto IsStraightWalkable = [NavData, &QueryFilter](const FVector& From, const FVector& To) {
+		FVector HitLocation;
+		return !NavData->Raycast(From, To, HitLocation, QueryFilter);
+	};
+
+	// 1. 起点终点各自只试最近的几个节点，和节点之间连边的数量一致
+	auto GatherCandidates = [&](const FVector& Location, TArray<TPair<double, int32>, TInlineAllocator<32>>& OutCandidates) {
+		for (int32 NodeIndex = 0; NodeIndex < Graph.Nodes.Num(); ++NodeIndex) {
+			const FVector& NodeLocation = Graph.Nodes[NodeIndex].Location;
+			const double DistanceSquared = FVector::DistSquared(NodeLocation, Location);
+			if (FMath::Abs(NodeLocation.Z - Location.Z) <= LinkMaxHeight && DistanceSquared <= FMath::Square(LinkDistance)) {
+				OutCandidates.Emplace(DistanceSquared, NodeIndex);
+			}
+		}
+		OutCandidates.Sort([](const TPair<double, int32>& A, const TPair<double, int32>& B) { return A.Key < B.Key; });
+		OutCandidates.SetNum(FMath::Min(OutCandidates.Num(), MaxLinks), false);
+	};
+
+	TArray<TPair<double, int32>, TInlineAllocator<32>> Candidates;
+	GatherCandidates(StartLocation.Location, Candidates);
+	for (const TPair<double, int32>& Candidate : Candidates) {
+		const FVector& NodeLocation = Graph.Nodes[Candidate.Value].Location;
+		if (IsStraightWalkable(StartLocation.Location, NodeLocation)) {
+			OutLinks.StartEdges.Add({ Candidate.Value, float(FVector::Dist(Start, NodeLocation)), EClimbNavLinkType::Walk });
+		}
+	}
+
+	Candidates.Reset();
+	GatherCandidates(EndLocation.Location, Candidates);
+	for (const TPair<double, int32>& Candidate : Candidates) {
+		const FVector& NodeLocation = Graph.Nodes[Candidate.Value].Location;
+		if (IsStraightWalkable(NodeLocation, EndLocation.Location)) {
+			OutLinks.EndLinks.Emplace(Candidate.Value, float(FVector::Dist(NodeLocation, End)));
+		}
+	}
+
+	// 2. 起点直接走到终点: 直线走不通时再在导航网格上同步寻一次路，绕得过去的按路径长度算，完全走不到就只能靠攀爬
+	if (FMath::Abs(EndLocation.Location.Z - StartLocation.Location.Z) > LinkMaxHeight) {
+		return;
+	}
+	const int32 EndRef = Graph.Nodes.Num();
+	if (IsStraightWalkable(StartLocation.Location, EndLocation.Location)) {
+		OutLinks.StartEdges.Add({ EndRef, float(FVector::Dist(Start, End)), EClimbNavLinkType::Walk });
+		return;
+	}
+	FPathFindingQuery Query(NavSys, *NavData, StartLocation.Location, EndLocation.Location, QueryFilter);
+	Query.SetAllowPartialPaths(false);
+	const FPathFindingResult Result = NavSys->FindPathSync(Query, EPathFindingMode::Regular);
+	if (Result.IsSuccessful() && Result.Path.IsValid() && !Result.IsPartial()) {
+		OutLinks.StartEdges.Add({ EndRef, FMath::Max(float(Result.Path->GetLength()), float(FVector::Dist(Start, End))), EClimbNavLinkType::Walk });
+	}
+}
+
+void UClimbingNavGraphSubsystem::FindPath(const FClimbNavGraphSnapshot& Graph, const FVector& Start, const FVector& End, const FQueryLinks& Links, FClimbNavPath& OutPath) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingNavGraphQuery);
+
+	using namespace ClimbingNavGraph;
+
+	// 1. 起点终点只连提交时在导航网格上确认过的边
+	FQueryGraph QueryGraph(Graph, Start, End);
+	QueryGraph.StartEdges = Links.StartEdges;
+	QueryGraph.EndCosts.Init(-1.f, Graph.Nodes.Num());
+	for (const TPair<int32, float>& EndLink : Links.EndLinks) {
+		QueryGraph.EndCosts[EndLink.Key] = EndLink.Value;
+	}
+
+	// 2. A*
+	FGraphAStar<FQueryGraph> AStar(QueryGraph);
+	TArray<int32> NodePath;
+	const EGraphAStarResult Result = AStar.FindPath(FQueryFilter::FSearchNode(QueryGraph.StartRef), FQueryFilter::FSearchNode(QueryGraph.EndRef), FQueryFilter(QueryGraph), NodePath);
+	if (Result != SearchSuccess) {
+		return;
+	}
+
+	// 3. 转成路径点，每个点带上从上一个点过来的方式
+	if (NodePath.Num() == 0 || NodePath[0] != QueryGraph.StartRef) {
+		NodePath.Insert(QueryGraph.StartRef, 0);
+	}
+
+	OutPath.Points.Reserve(NodePath.Num());
+	OutPath.Points.Add({ Start, EClimbNavLinkType::Walk });
+	for (int32 PathIndex = 1; PathIndex < NodePath.Num(); ++PathIndex) {
+		const int32 From = NodePath[PathIndex - 1];
+		const int32 To = NodePath[PathIndex];
+		OutPath.Points.Add({ QueryGraph.GetLocation(To), QueryGraph.GetLinkType(From, To) });
+		OutPath.Cost += QueryGraph.GetCost(From, To);
+	}
+}
+
+void UClimbingNavGraphSubsystem::AddLevelNodes(ULevel* Level, UNavigationSystemV1& NavSys, const TArray<FBox>* DirtyBounds) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingNavGraphBuild);
+
+	const UClimbableSurfaceSubsystem* SurfaceSubsystem = GetWorld()->GetSubsystem<UClimbableSurfaceSubsystem>();
+	if (!SurfaceSubsystem) {
+		return;
+	}
+
+	// 只重建一部分时，判断一列要不要重建和删掉旧的节点用的是同一个条件(投影之前的墙脚和顶边碰到了变脏的范围)
+	auto IsColumnDirty = [DirtyBounds](const FBox& ColumnBounds) {
+		return !DirtyBounds || DirtyBounds->ContainsByPredicate([&ColumnBounds](const FBox& Bounds) { return Bounds.Intersect(ColumnBounds); });
+	};
+
+	// 重复加同一个关卡时先把旧的去掉
+	const TObjectKey<ULevel> LevelKey(Level);
+	RemoveNodes([&](const FEditNode& Node) { return Node.Level == LevelKey && IsColumnDirty(Node.ColumnBounds); });
+
+	const float NodeSpacing = FMath::Max(CVarClimbingNavGraphNodeSpacing.GetValueOnGameThread(), 50.f);
+	const float ClimbUpCost = FMath::Max(CVarClimbingNavGraphClimbUpCost.GetValueOnGameThread(), 1.f);
+	const float ClimbDownCost = FMath::Max(CVarClimbingNavGraphClimbDownCost.GetValueOnGameThread(), 1.f);
+	const float AngleCost = FMath::Max(CVarClimbingNavGraphAngleCost.GetValueOnGameThread(), 0.f);
+
+	// 墙面法线的Z超过这个值时贴上去角色就倾斜到要退出攀爬了
+	const double MaxWallNormalZ = FMath::Sqrt(1.0 - FMath::Square(double(ClimbingMath::ExitTiltCos)));
+	const float MaxStepHeight = GetDefault<UCharacterMovementComponent>()->MaxStepHeight;
+
+	TArray<int32> NewNodes;
+	SurfaceSubsystem->ForEachPatchInLevel(Level, [&](const FClimbableSurfacePatch& Patch) {
+		const double NormalZ = FMath::Abs(Patch.Normal.Z);
+		if (NormalZ >= MaxWallNormalZ) {
+			return;
+		}
+
+		// 面内更接近水平的轴是墙的宽度方向，另一条是沿着墙往上的方向
+		const bool bUIsHorizontal = FMath::Abs(Patch.AxisU.Z) < FMath::Abs(Patch.AxisV.Z);
+		const FVector Across = bUIsHorizontal ? Patch.AxisU : Patch.AxisV;
+		const double HalfWidth = bUIsHorizontal ? Patch.HalfU : Patch.HalfV;
+		const FVector Along = bUIsHorizontal ? Patch.AxisV : Patch.AxisU;
+		const FVector WallUp = Along * FMath::Sign(Along.Z);
+		const double HalfHeight = bUIsHorizontal ? Patch.HalfV : Patch.HalfU;
+
+		const FVector Normal2D = Patch.Normal.GetSafeNormal2D();
+		const FVector Bottom = Patch.Center - WallUp * HalfHeight + Normal2D * WallStandOff;
+		const FVector Top = Patch.Center + WallUp * HalfHeight - Normal2D * LedgeStandInset;
+
+		// 爬的代价按高度算，墙越斜越贵
+		const float AngleScale = 1.f + AngleCost * float(NormalZ / MaxWallNormalZ);
+
+		const int32 NumColumns = FMath::Max(FMath::FloorToInt32(2.0 * HalfWidth / NodeSpacing), 1);
+		for (int32 Column = 0; Column < NumColumns; ++Column) {
+			const FVector Offset = Across * (((Column + 0.5) / NumColumns * 2.0 - 1.0) * HalfWidth);
+			const FBox ColumnBounds(TArray<FVector>{ Bottom + Offset, Top + Offset });
+			if (!IsColumnDirty(ColumnBounds)) {
+				continue;
+			}
+
+			// 墙脚和顶上都要能投影到导航网格上，投影不到说明站不住(比如顶上太窄或者被挡住)
+			FNavLocation BottomLocation;
+			FNavLocation TopLocation;
+			if (!NavSys.ProjectPointToNavigation(Bottom + Offset, BottomLocation, NavProjectionExtent)
+				|| !NavSys.ProjectPointToNavigation(Top + Offset, TopLocation, NavProjectionExtent)) {
+				continue;
+			}
+
+			// 矮到能直接跨上去的不需要爬
+			const double Height = TopLocation.Location.Z - BottomLocation.Location.Z;
+			if (Height <= MaxStepHeight) {
+				continue;
+			}
+
+			const int32 BottomIndex = EditNodes.Add({ BottomLocation.Location, BottomLocation.NodeRef, Level, ColumnBounds, NextNodeSerial++, {}, {} });
+			const int32 TopIndex = EditNodes.Add({ TopLocation.Location, TopLocation.NodeRef, Level, ColumnBounds, NextNodeSerial++, {}, {} });
+			EditNodes[BottomIndex].ClimbEdges.Add({ TopIndex, float(Height) * ClimbUpCost * AngleScale, EClimbNavLinkType::ClimbUp });
+			EditNodes[TopIndex].ClimbEdges.Add({ BottomIndex, float(Height) * ClimbDownCost * AngleScale, EClimbNavLinkType::ClimbDown });
+			NewNodes.Add(BottomIndex);
+			NewNodes.Add(TopIndex);
+		}
+	});
+
+	for (const int32 NodeIndex : NewNodes) {
+		LinkWalkEdges(NodeIndex, NavSys);
+	}
+
+	if (NewNodes.Num() > 0) {
+		bSnapshotDirty = true;
+		UE_LOG(LogClimbing, Log, TEXT("Climb nav graph: added %d nodes for level '%s', %d nodes total"), NewNodes.Num(), *GetNameSafe(Level->GetOuter()), EditNodes.Num());
+	}
+}
+
+void UClimbingNavGraphSubsystem::RemoveLevelNodes(TObjectKey<ULevel> LevelKey) {
+	RemoveNodes([LevelKey](const FEditNode& Node) { return Node.Level == LevelKey; });
+}
+
+void UClimbingNavGraphSubsystem::RemoveNodes(TFunctionRef<bool(const FEditNode&)> Predicate) {
+	TBitArray<> Removed(false, EditNodes.GetMaxIndex());
+	bool bAnyRemoved = false;
+	for (TSparseArray<FEditNode>::TIterator It(EditNodes); It; ++It) {
+		if (Predicate(*It)) {
+			Removed[It.GetIndex()] = true;
+			It.RemoveCurrent();
+			bAnyRemoved = true;
+		}
+	}
+
+	if (!bAnyRemoved) {
+		return;
+	}
+
+	// 留下来的节点去掉指向被删节点的边，这些下标之后可能会被新节点复用，还没回来的寻路靠Serial丢掉
+	for (FEditNode& Node : EditNodes) {
+		Node.ClimbEdges.RemoveAllSwap([&Removed](const FEditEdge& Edge) { return Removed[Edge.Target]; });
+		Node.WalkEdges.RemoveAllSwap([&Removed](const FEditEdge& Edge) { return Removed[Edge.Target]; });
+	}
+	bSnapshotDirty = true;
+}
+
+void UClimbingNavGraphSubsystem::RebuildDirtyBounds(const TArray<FBox>& DirtyBounds, UNavigationSystemV1& NavSys) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingNavGraphBuild);
+
+	// 1. 碰到变脏范围的攀爬列整列重建，新节点在AddLevelNodes里连走路的边
+	TSet<uint32> OldSerials;
+	for (const FEditNode& Node : EditNodes) {
+		OldSerials.Add(Node.Serial);
+	}
+	for (ULevel* Level : GetWorld()->GetLevels()) {
+		AddLevelNodes(Level, NavSys, &DirtyBounds);
+	}
+
+	// 2. 留下来的节点里，走路的边可能穿过变脏范围的(离变脏范围不超过连边距离)重新连
+	const float LinkDistance = CVarClimbingNavGraphWalkLinkDistance.GetValueOnGameThread();
+	TArray<int32> Relink;
+	for (TSparseArray<FEditNode>::TConstIterator It(EditNodes); It; ++It) {
+		if (!OldSerials.Contains(It->Serial)) {
+			continue;
+		}
+		const FVector Location = It->Location;
+		if (DirtyBounds.ContainsByPredicate([&Location, LinkDistance](const FBox& Bounds) { return Bounds.ComputeSquaredDistanceToPoint(Location) <= FMath::Square(LinkDistance); })) {
+			Relink.Add(It.GetIndex());
+		}
+	}
+	if (Relink.Num() == 0) {
+		return;
+	}
+
+	TBitArray<> Relinked(false, EditNodes.GetMaxIndex());
+	for (const int32 NodeIndex : Relink) {
+		Relinked[NodeIndex] = true;
+	}
+	for (TSparseArray<FEditNode>::TIterator It(EditNodes); It; ++It) {
+		if (Relinked[It.GetIndex()]) {
+			It->WalkEdges.Reset();
+		} else {
+			It->WalkEdges.RemoveAllSwap([&Relinked](const FEditEdge& Edge) { return Relinked[Edge.Target]; });
+		}
+	}
+	for (const int32 NodeIndex : Relink) {
+		LinkWalkEdges(NodeIndex, NavSys);
+	}
+	bSnapshotDirty = true;
+}
+
+void UClimbingNavGraphSubsystem::LinkWalkEdges(int32 NodeIndex, UNavigationSystemV1& NavSys) {
+	ANavigationData* NavData = NavSys.GetDefaultNavDataInstance();
+	if (!NavData) {
+		return;
+	}
+
+	const float LinkDistance = CVarClimbingNavGraphWalkLinkDistance.GetValueOnGameThread();
+	const int32 MaxLinks = CVarClimbingNavGraphMaxWalkLinks.GetValueOnGameThread();
+	const FVector Location = EditNodes[NodeIndex].Location;
+
+	// 1. 直线距离内还没有连过的节点，按距离排序只取最近的几个
+	TArray<TPair<double, int32>, TInlineAllocator<32>> Candidates;
+	for (TSparseArray<FEditNode>::TConstIterator It(EditNodes); It; ++It) {
+		if (It.GetIndex() == NodeIndex) {
+			continue;
+		}
+		const double DistanceSquared = FVector::DistSquared(Location, It->Location);
+		if (DistanceSquared > FMath::Square(LinkDistance)) {
+			continue;
+		}
+		const int32 OtherIndex = It.GetIndex();
+		if (EditNodes[NodeIndex].WalkEdges.ContainsByPredicate([OtherIndex](const FEditEdge& Edge) { return Edge.Target == OtherIndex; })) {
+			continue;
+		}
+		Candidates.Emplace(DistanceSquared, OtherIndex);
+	}
+	Candidates.Sort([](const TPair<double, int32>& A, const TPair<double, int32>& B) { return A.Key < B.Key; });
+
+	// 2. 在导航网格上的路径交给导航系统的异步寻路，不在GameThread上同步算，走得通的在回调里连上双向的边
+	for (int32 CandidateIndex = 0; CandidateIndex < FMath::Min(Candidates.Num(), MaxLinks); ++CandidateIndex) {
+		const int32 OtherIndex = Candidates[CandidateIndex].Value;
+		FPathFindingQuery Query(this, *NavData, Location, EditNodes[OtherIndex].Location);
+		Query.SetAllowPartialPaths(false);
+		const uint32 NavQueryID = NavSys.FindPathAsync(FNavAgentProperties::DefaultProperties, Query,
+			FNavPathQueryDelegate::CreateUObject(this, &UClimbingNavGraphSubsystem::OnWalkLinkPathFound), EPathFindingMode::Regular);
+		if (NavQueryID != INVALID_NAVQUERYID) {
+			PendingWalkLinks.Add(NavQueryID, { NodeIndex, EditNodes[NodeIndex].Serial, OtherIndex, EditNodes[OtherIndex].Serial });
+		}
+	}
+}
+
+void UClimbingNavGraphSubsystem::OnWalkLinkPathFound(uint32 NavQueryID, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path) {
+	FPendingWalkLink Link;
+	if (!PendingWalkLinks.RemoveAndCopyValue(NavQueryID, Link)) {
+		return;
+	}
+
+	// 寻路期间两端的节点可能已经被删掉，下标也可能被新节点复用了
+	const bool bFromValid = EditNodes.IsValidIndex(Link.From) && EditNodes[Link.From].Serial == Link.FromSerial;
+	const bool bToValid = EditNodes.IsValidIndex(Link.To) && EditNodes[Link.To].Serial == Link.ToSerial;
+	if (!bFromValid || !bToValid || Result != ENavigationQueryResult::Success || !Path.IsValid() || Path->IsPartial()) {
+		return;
+	}
+
+	const float PathLength = float(Path->GetLength());
+	AddWalkEdge(Link.From, Link.To, PathLength);
+	AddWalkEdge(Link.To, Link.From, PathLength);
+	bSnapshotDirty = true;
+}
+
+void UClimbingNavGraphSubsystem::AddWalkEdge(int32 From, int32 To, float Cost) {
+	TArray<FEditEdge>& Edges = EditNodes[From].WalkEdges;
+	if (FEditEdge* Existing = Edges.FindByPredicate([To](const FEditEdge& Edge) { return Edge.Target == To; })) {
+		Existing->Cost = FMath::Min(Existing->Cost, Cost);
+		return;
+	}
+	Edges.Add({ To, Cost, EClimbNavLinkType::Walk });
+}
+
+void UClimbingNavGraphSubsystem::CancelWalkLinks() {
+	if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld())) {
+		for (const TPair<uint32, FPendingWalkLink>& Pair : PendingWalkLinks) {
+			NavSys->AbortAsyncFindPathRequest(Pair.Key);
+		}
+	}
+	PendingWalkLinks.Reset();
+}
+
+void UClimbingNavGraphSubsystem::PublishSnapshot() {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingNavGraphBuild);
+
+	// 稀疏数组压成连续的下标
+	TArray<int32> Remap;
+	Remap.Init(INDEX_NONE, EditNodes.GetMaxIndex());
+
+	TSharedRef<FClimbNavGraphSnapshot, ESPMode::ThreadSafe> NewSnapshot = MakeShared<FClimbNavGraphSnapshot, ESPMode::ThreadSafe>();
+	NewSnapshot->Nodes.Reserve(EditNodes.Num());
+	for (TSparseArray<FEditNode>::TConstIterator It(EditNodes); It; ++It) {
+		Remap[It.GetIndex()] = NewSnapshot->Nodes.Num();
+		NewSnapshot->Nodes.Add({ It->Location, It->NavPoly });
+	}
+
+	// 两个节点之间只留代价小的那条边(A*只按节点对取代价)
+	// 代价截到不小于直线距离: 墙脚和顶边前后错开了，矮墙按高度算的攀爬代价可能比直线距离还小，启发值就高估了
+	NewSnapshot->EdgeOffsets.Reserve(EditNodes.Num() + 1);
+	for (const FEditNode& Node : EditNodes) {
+		const int32 FirstEdge = NewSnapshot->Edges.Num();
+		NewSnapshot->EdgeOffsets.Add(FirstEdge);
+		for (const TArray<FEditEdge>* Edges : { &Node.ClimbEdges, &Node.WalkEdges }) {
+			for (const FEditEdge& Edge : *Edges) {
+				const int32 Target = Remap[Edge.Target];
+				const float Cost = FMath::Max(Edge.Cost, float(FVector::Dist(Node.Location, EditNodes[Edge.Target].Location)));
+				FClimbNavGraphSnapshot::FEdge* Existing = nullptr;
+				for (int32 EdgeIndex = FirstEdge; EdgeIndex < NewSnapshot->Edges.Num(); ++EdgeIndex) {
+					if (NewSnapshot->Edges[EdgeIndex].Target == Target) {
+						Existing = &NewSnapshot->Edges[EdgeIndex];
+						break;
+					}
+				}
+				if (!Existing) {
+					NewSnapshot->Edges.Add({ Target, Cost, Edge.Type });
+				} else if (Cost < Existing->Cost) {
+					Existing->Cost = Cost;
+					Existing->Type = Edge.Type;
+				}
+			}
+		}
+	}
+	NewSnapshot->EdgeOffsets.Add(NewSnapshot->Edges.Num());
+
+	Snapshot = NewSnapshot;
+}
+
+void UClimbingNavGraphSubsystem::OnLevelAddedToWorld(ULevel* Level, UWorld* World) {
+	if (World == GetWorld()) {
+		PendingLevels.AddUnique(Level);
+	}
+}
+
+void UClimbingNavGraphSubsystem::OnLevelRemovedFromWorld(ULevel* Level, UWorld* World) {
+	// Level为空表示整个World都要被清掉了
+	if (World == GetWorld() && Level) {
+		PendingLevels.Remove(Level);
+		RemoveLevelNodes(Level);
+	}
+}
+
+void UClimbingNavGraphSubsystem::OnNavigationDirty(const FBox& Bounds) {
+	// 这个事件是全局的，别的World的也会进来，多重建几列不影响结果
+	// 导航网格一直不重新生成的时候范围会一直攒下去，攒太多了就合成一个
+	static constexpr int32 MaxDirtyBounds = 256;
+	if (NavDirtyBounds.Num() >= MaxDirtyBounds) {
+		FBox Merged(ForceInit);
+		for (const FBox& DirtyBounds : NavDirtyBounds) {
+			Merged += DirtyBounds;
+		}
+		NavDirtyBounds.Reset();
+		NavDirtyBounds.Add(Merged);
+	}
+	NavDirtyBounds.Add(Bounds.ExpandBy(NavProjectionExtent));
+}
+
+void UClimbingNavGraphSubsystem::OnNavigationGenerationFinished(ANavigationData* NavData) {
+	// 导航网格生成完了，变脏范围里投影的位置和走路的边都可能不对了，只重建这些范围
+	PendingDirtyBounds.Append(NavDirtyBounds);
+	NavDirtyBounds.Reset();
+}
@@ -0,0 +1,187 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI/Navigation/NavigationTypes.h"
+#include "Containers/Queue.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "ClimbingNavGraphSubsystem.generated.h"
+
+class ANavigationData;
+class ULevel;
+class UNavigationSystemV1;
+
+/** 从路径上的上一个点到这个点的移动方式 */
+UENUM()
+enum class EClimbNavLinkType : uint8 {
+	Walk,			// 在导航网格上走过去，具体怎么走由AI自己的寻路决定
+	ClimbUp,		// 从墙脚爬上去再Mantle到顶上
+	ClimbDown,		// 从顶边爬下来
+};
+
+struct FClimbNavPathPoint {
+	FVector Location;
+	EClimbNavLinkType LinkType;
+};
+
+struct FClimbNavPath {
+	TArray<FClimbNavPathPoint> Points;
+	double Cost = 0.0;
+
+	bool IsValid() const { return Points.Num() > 0; }
+};
+
+DECLARE_DELEGATE_TwoParams(FOnClimbNavPathFound, uint32 /*QueryID*/, const FClimbNavPath& /*Path*/);
+
+/**
+ * 发布给工作线程的只读图，边用CSR的方式存放，发布之后不会再改
+ * 两个节点之间最多只有一条边，走路和攀爬都能到的时候只保留代价小的那条
+ */
+struct FClimbNavGraphSnapshot {
+	struct FNode {
+		FVector Location;		// 投影到导航网格上的位置
+		NavNodeRef NavPoly;		// 所在的导航网格多边形
+	};
+
+	struct FEdge {
+		int32 Target;
+		float Cost;
+		EClimbNavLinkType Type;
+	};
+
+	TArray<FNode> Nodes;
+	TArray<int32> EdgeOffsets;		// Nodes.Num() + 1个，第i个节点的边是Edges[EdgeOffsets[i], EdgeOffsets[i + 1])
+	TArray<FEdge> Edges;
+};
+
+/**
+ * 给AI用的攀爬寻路图
+ * 节点是可攀爬墙面的墙脚和顶边，各自投影到导航网格上，同一列的墙脚和顶边之间是攀爬的边，代价按高度和墙面倾斜的角度算
+ * 节点之间能在导航网格上走通的再连上走路的边，代价是导航网格上的路径长度
+ * 墙面数据来自UClimbableSurfaceSubsystem的缓存，关卡流送进出时只增删这个关卡的节点
+ * 导航网格局部重新生成之后只重建变脏的范围里的攀爬列，附近节点的走路的边重新连
+ * 走路的边的路径长度用导航系统的异步寻路算，所有改动(包括还没回来的寻路)都完成之后才发布新的快照，之前一直用旧的
+ * 查询在工作线程上对快照做A*，结果在GameThread的Tick里通过回调返回，正在跑的查询拿着旧快照不受影响
+ * 起点终点连到图上的走路的边在提交时(GameThread上)用导航网格的射线检测确认走得通，工作线程上只用确认过的边
+ */
+UCLASS()
+class UClimbingNavGraphSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UClimbingNavGraphSubsystem();
+
+	/**
+	 * 提交一次异步寻路，Start和End都应该在导航网格上
+	 * @return 查询的ID，回调的时候原样带回来，可以用来取消
+	 */
+	uint32 FindPathAsync(const FVector& Start, const FVector& End, FOnClimbNavPathFound OnFound);
+
+	// 取消之后回调不会再被调用，工作线程上已经开始的计算还会跑完
+	void CancelQuery(uint32 QueryID);
+
+	// 所有关卡的节点分帧重建，重建完之前查询用的还是旧的快照
+	void RequestRebuild();
+
+	int32 GetNumNodes() const { return EditNodes.Num(); }
+	int32 GetNumPendingQueries() const { return PendingQueries.Num(); }
+
+	// USubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// UWorldSubsystem interface
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FEditEdge {
+		int32 Target;
+		float Cost;
+		EClimbNavLinkType Type;
+	};
+
+	struct FEditNode {
+		FVector Location;
+		NavNodeRef NavPoly;
+		TObjectKey<ULevel> Level;
+		FBox ColumnBounds;				// 所在的那一列投影之前的墙脚和顶边，导航网格变脏的范围碰到它时整列重建
+		uint32 Serial;					// 下标会被复用，异步寻路回来时用它确认还是同一个节点
+		TArray<FEditEdge> ClimbEdges;
+		TArray<FEditEdge> WalkEdges;
+	};
+
+	struct FPendingWalkLink {
+		int32 From;
+		uint32 FromSerial;
+		int32 To;
+		uint32 ToSerial;
+	};
+
+	struct FCompletedQuery {
+		uint32 QueryID;
+		FClimbNavPath Path;
+	};
+
+	// 提交查询时确认过的起点终点的边，下标是快照里的节点
+	struct FQueryLinks {
+		TArray<FClimbNavGraphSnapshot::FEdge> StartEdges;	// 目标是快照的节点数时表示直接走到终点
+		TArray<TPair<int32, float>> EndLinks;
+	};
+
+	using FCompletedQueue = TQueue<FCompletedQuery, EQueueMode::Mpsc>;
+
+	// DirtyBounds不为空时只重建碰到这些范围的攀爬列
+	void AddLevelNodes(ULevel* Level, UNavigationSystemV1& NavSys, const TArray<FBox>* DirtyBounds = nullptr);
+	void RemoveLevelNodes(TObjectKey<ULevel> LevelKey);
+	void RemoveNodes(TFunctionRef<bool(const FEditNode&)> Predicate);
+	void RebuildDirtyBounds(const TArray<FBox>& DirtyBounds, UNavigationSystemV1& NavSys);
+
+	// 对附近的节点提交异步寻路，走得通的在OnWalkLinkPathFound里连上双向的边
+	void LinkWalkEdges(int32 NodeIndex, UNavigationSystemV1& NavSys);
+	void OnWalkLinkPathFound(uint32 NavQueryID, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path);
+	void AddWalkEdge(int32 From, int32 To, float Cost);
+	void CancelWalkLinks();
+	void PublishSnapshot();
+
+	void OnLevelAddedToWorld(ULevel* Level, UWorld* World);
+	void OnLevelRemovedFromWorld(ULevel* Level, UWorld* World);
+
+	UFUNCTION()
+	void OnNavigationGenerationFinished(ANavigationData* NavData);
+	void OnNavigationDirty(const FBox& Bounds);
+
+	// 在GameThread上用导航网格确认起点终点能走到哪些节点，走不通的边不加
+	static void BuildQueryLinks(const FClimbNavGraphSnapshot& Graph, UNavigationSystemV1* NavSys, const FVector& Start, const FVector& End, FQueryLinks& OutLinks);
+
+	// 在工作线程上跑
+	static void FindPath(const FClimbNavGraphSnapshot& Graph, const FVector& Start, const FVector& End, const FQueryLinks& Links, FClimbNavPath& OutPath);
+
+	TSparseArray<FEditNode> EditNodes;
+	TArray<TWeakObjectPtr<ULevel>> PendingLevels;		// 等导航网格准备好之后再加节点
+	TArray<FBox> NavDirtyBounds;						// 导航网格变脏的范围，生成完之后转到PendingDirtyBounds
+	TArray<FBox> PendingDirtyBounds;
+	TMap<uint32, FPendingWalkLink> PendingWalkLinks;	// 按导航系统的异步寻路ID
+	uint32 NextNodeSerial = 1;
+	bool bSnapshotDirty = false;
+
+	TSharedPtr<const FClimbNavGraphSnapshot, ESPMode::ThreadSafe> Snapshot;
+
+	// 工作线程把结果放进来，Tick里取出来调回调，队列本身由还没跑完的查询共同持有
+	TSharedRef<FCompletedQueue, ESPMode::ThreadSafe> CompletedQueries;
+	TMap<uint32, FOnClimbNavPathFound> PendingQueries;
+	uint32 NextQueryID = 1;
+
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
+	FDelegateHandle NavigationDirtyHandle;
+};
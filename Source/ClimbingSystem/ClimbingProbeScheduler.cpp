@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingProbeScheduler.h"
+#include "ClimbingSignificanceSubsystem.h"
+#include "ClimbingStats.h"
+#include "ClimbingSystemCharacter.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+static TAutoConsoleVariable<int32> CVarClimbingProbeBudget(
+	TEXT("Climbing.ProbeBudget"),
+	64,
+	TEXT("每帧攀爬检测最多发出多少条LineTrace，玩家控制的角色不受限制但会占用预算\n")
+	TEXT("0: 不限制"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarClimbingProbeBudgetMaxStaleFrames(
+	TEXT("Climbing.ProbeBudget.MaxStaleFrames"),
+	4,
+	TEXT("被推迟的检测最多沿用多少帧之前的结果，超过之后当作没有检测到"),
+	ECVF_Default);
+
+bool UClimbingProbeScheduler::TryAcquireProbe(const AClimbingSystemCharacter* Character, int32 NumTraces) {
+	const TObjectKey<AClimbingSystemCharacter> CharacterKey(Character);
+	Requests.Add({ Character, NumTraces });
+
+	const int32 Budget = CVarClimbingProbeBudget.GetValueOnGameThread();
+	bool bGranted = Budget <= 0 || Character->IsPlayerControlled() || Reservations.Contains(CharacterKey);
+	if (!bGranted && ReservedTraces + UnreservedTraces + NumTraces <= Budget) {
+		// 上一帧没有为它预留，但本帧还有余量(比如有预留的角色已经不在Falling了)
+		UnreservedTraces += NumTraces;
+		bGranted = true;
+	}
+
+	if (bGranted) {
+		LastGrantedFrames.Add(CharacterKey, GFrameCounter);
+		++NumGranted;
+		INC_DWORD_STAT(STAT_ClimbingProbesGranted);
+	} else {
+		++NumDeferred;
+		INC_DWORD_STAT(STAT_ClimbingProbesDeferred);
+	}
+	return bGranted;
+}
+
+int32 UClimbingProbeScheduler::GetMaxStaleFrames() {
+	return CVarClimbingProbeBudgetMaxStaleFrames.GetValueOnGameThread();
+}
+
+bool UClimbingProbeScheduler::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UClimbingProbeScheduler::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UClimbingProbeScheduler, STATGROUP_Tickables);
+}
+
+void UClimbingProbeScheduler::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+
+	NumGrantedLastFrame = NumGranted;
+	NumDeferredLastFrame = NumDeferred;
+	NumGranted = 0;
+	NumDeferred = 0;
+	UnreservedTraces = 0;
+	ReservedTraces = 0;
+	Reservations.Reset();
+
+	// 只保留这一帧还在申请的角色，不再Falling的角色自然就被清掉了
+	TMap<TObjectKey<AClimbingSystemCharacter>, uint64> ActiveGrantedFrames;
+	ActiveGrantedFrames.Reserve(Requests.Num());
+
+	const int32 Budget = CVarClimbingProbeBudget.GetValueOnGameThread();
+	if (Budget <= 0 || Requests.Num() == 0) {
+		Requests.Reset();
+		LastGrantedFrames.Reset();
+		return;
+	}
+
+	// 服务器上按离最近的玩家视角的距离排，和UClimbingSignificanceSubsystem一样
+	TArray<FVector> ViewLocations;
+	UClimbingSignificanceSubsystem::GetViewLocations(GetWorld(), ViewLocations);
+	const bool bCheckRendered = GetWorld()->GetNetMode() != NM_DedicatedServer;
+
+	// 1. 给每个请求算优先级，数值越小越优先
+	struct FPrioritizedRequest {
+		const AClimbingSystemCharacter* Character;
+		int32 NumTraces;
+		int32 Tier;
+		double Score;
+	};
+	TArray<FPrioritizedRequest> Prioritized;
+	Prioritized.Reserve(Requests.Num());
+	for (const FProbeRequest& Request : Requests) {
+		const AClimbingSystemCharacter* Character = Request.Character.Get();
+		if (!Character) {
+			continue;
+		}
+		const TObjectKey<AClimbingSystemCharacter> CharacterKey(Character);
+		if (ActiveGrantedFrames.Contains(CharacterKey)) {
+			continue;
+		}
+		const uint64 LastGrantedFrame = LastGrantedFrames.FindRef(CharacterKey);
+		ActiveGrantedFrames.Add(CharacterKey, LastGrantedFrame);
+
+		const int32 Tier = Character->IsPlayerControlled() ? 0 : (!bCheckRendered || Character->WasRecentlyRendered(0.2f) ? 1 : 2);
+		// 等待的帧数越多，相当于离玩家视角越近，保证远处的角色不会一直拿不到预算
+		const uint64 WaitedFrames = GFrameCounter - LastGrantedFrame;
+		const double Distance = FMath::Sqrt(UClimbingSignificanceSubsystem::GetMinDistanceSquared(Character->GetActorLocation(), ViewLocations));
+		const double Score = Distance / double(1 + FMath::Min<uint64>(WaitedFrames, 60));
+		Prioritized.Add({ Character, Request.NumTraces, Tier, Score });
+	}
+	Requests.Reset();
+	LastGrantedFrames = MoveTemp(ActiveGrantedFrames);
+
+	Prioritized.Sort([](const FPrioritizedRequest& A, const FPrioritizedRequest& B) {
+		return A.Tier != B.Tier ? A.Tier < B.Tier : A.Score < B.Score;
+	});
+
+	// 2. 按优先级为下一帧预留预算
+	for (const FPrioritizedRequest& Request : Prioritized) {
+		if (Request.Tier > 0 && ReservedTraces + Request.NumTraces > Budget) {
+			break;
+		}
+		ReservedTraces += Request.NumTraces;
+		Reservations.Add(TObjectKey<AClimbingSystemCharacter>(Request.Character));
+	}
+}
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "ClimbingProbeScheduler.generated.h"
+
+class AClimbingSystemCharacter;
+
+/**
+ * 给攀爬的场景查询(目前是Falling状态和地面上起跳时的墙壁检测)设一个每帧的预算
+ * 角色在Tick里真正要发出检测时才申请，异步检测在等结果的帧里不申请、不占预算
+ * 本帧没拿到预算的角色沿用上一次的检测结果，并标记为过期
+ * 每帧末尾按优先级为下一帧分配预算: 玩家控制的角色 > 屏幕上的角色 > 按到最近的玩家视角的距离，等得越久的越靠前
+ * 玩家控制的角色永远不会被推迟，它们的消耗最先计入预算
+ */
+UCLASS()
+class UClimbingProbeScheduler : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * 申请在本帧发出NumTraces条检测，只在确实要发出检测时调用，取回异步检测的结果不需要申请
+	 * @return false表示这次检测被推迟了，调用方应该使用上一次的结果
+	 */
+	bool TryAcquireProbe(const AClimbingSystemCharacter* Character, int32 NumTraces);
+
+	// Climbing.ProbeBudget.MaxStaleFrames，被推迟的结果最多能沿用多少帧
+	static int32 GetMaxStaleFrames();
+
+	int32 GetNumGrantedLastFrame() const { return NumGrantedLastFrame; }
+	int32 GetNumDeferredLastFrame() const { return NumDeferredLastFrame; }
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FProbeRequest {
+		TWeakObjectPtr<const AClimbingSystemCharacter> Character;
+		int32 NumTraces;
+	};
+
+	// 本帧收到的所有请求，Tick里用来给下一帧排优先级
+	TArray<FProbeRequest> Requests;
+
+	// 每个还在申请的角色最近一次拿到预算的帧
+	TMap<TObjectKey<AClimbingSystemCharacter>, uint64> LastGrantedFrames;
+
+	// 上一次Tick为本帧预留的预算
+	TSet<TObjectKey<AClimbingSystemCharacter>> Reservations;
+	int32 ReservedTraces = 0;
+
+	// 本帧没有预留、用余量执行的检测数
+	int32 UnreservedTraces = 0;
+
+	int32 NumGranted = 0;
+	int32 NumDeferred = 0;
+	int32 NumGrantedLastFrame = 0;
+	int32 NumDeferredLastFrame = 0;
+};
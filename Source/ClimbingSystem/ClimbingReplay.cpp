@@ -0,0 +1,462 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingReplay.h"
+#include "ClimbingMathKernels.h"
+#include "ClimbingSystem.h"
+#include "ClimbingSystemCharacter.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+
+namespace ClimbingReplay {
+	// 每个Tick的标记字节，位置的差值总是会写，不需要标记
+	enum ETickFlags : uint8 {
+		Flag_DeltaTime		= 1 << 0,
+		Flag_Move			= 1 << 1,
+		Flag_Look			= 1 << 2,
+		Flag_Rotation		= 1 << 3,
+		Flag_JumpPressed	= 1 << 4,
+		Flag_JumpReleased	= 1 << 5,
+		Flag_Mode			= 1 << 6,
+		Flag_Normal			= 1 << 7,
+	};
+
+	constexpr double LocationScale = 10.0;
+	constexpr double InputScale = 10000.0;
+
+	FString GetReplayDir() {
+		return FPaths::ProfilingDir() / TEXT("Climbing") / TEXT("Replays");
+	}
+
+	static void WriteVarUInt(TArray<uint8>& Buffer, uint32 Value) {
+		while (Value >= 0x80) {
+			Buffer.Add(uint8(Value) | 0x80);
+			Value >>= 7;
+		}
+		Buffer.Add(uint8(Value));
+	}
+
+	static void WriteVarInt(TArray<uint8>& Buffer, int32 Value) {
+		// ZigZag，绝对值小的负数也只占一个字节
+		WriteVarUInt(Buffer, (uint32(Value) << 1) ^ uint32(Value >> 31));
+	}
+
+	template<typename T>
+	static void WriteRaw(TArray<uint8>& Buffer, const T& Value) {
+		Buffer.Append(reinterpret_cast<const uint8*>(&Value), sizeof(T));
+	}
+
+	/** 从缓冲区里按顺序读，越界之后所有的读取都返回false */
+	struct FByteCursor {
+		const uint8* Data;
+		int32 Num;
+		int32 Offset;
+
+		bool ReadVarUInt(uint32& OutValue) {
+			OutValue = 0;
+			for (int32 Shift = 0; Shift < 35; Shift += 7) {
+				if (Offset >= Num) {
+					return false;
+				}
+				const uint8 Byte = Data[Offset++];
+				OutValue |= uint32(Byte & 0x7F) << Shift;
+				if ((Byte & 0x80) == 0) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool ReadVarInt(int32& OutValue) {
+			uint32 Encoded;
+			if (!ReadVarUInt(Encoded)) {
+				return false;
+			}
+			OutValue = int32(Encoded >> 1) ^ -int32(Encoded & 1);
+			return true;
+		}
+
+		template<typename T>
+		bool ReadRaw(T& OutValue) {
+			if (Offset + int32(sizeof(T)) > Num) {
+				return false;
+			}
+			FMemory::Memcpy(&OutValue, Data + Offset, sizeof(T));
+			Offset += sizeof(T);
+			return true;
+		}
+	};
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FClimbingReplayQuantized
+
+void FClimbingReplayQuantized::FromTick(const FClimbingReplayTick& Tick) {
+	using namespace ClimbingReplay;
+	DeltaMicros = FMath::RoundToInt32(Tick.DeltaTime * 1000000.0);
+	Move[0] = FMath::RoundToInt32(Tick.Input.Move.X * InputScale);
+	Move[1] = FMath::RoundToInt32(Tick.Input.Move.Y * InputScale);
+	Look[0] = FMath::RoundToInt32(Tick.Input.Look.X * InputScale);
+	Look[1] = FMath::RoundToInt32(Tick.Input.Look.Y * InputScale);
+	Pitch = FRotator::CompressAxisToShort(Tick.ControlRotation.Pitch);
+	Yaw = FRotator::CompressAxisToShort(Tick.ControlRotation.Yaw);
+	Mode = Tick.Mode;
+	for (int32 Axis = 0; Axis < 3; ++Axis) {
+		Location[Axis] = FMath::RoundToInt32(Tick.Location[Axis] * LocationScale);
+	}
+	if (Tick.Mode == Climbing) {
+		ClimbingMath::EncodeOctahedral8(Tick.WallNormal.X, Tick.WallNormal.Y, Tick.WallNormal.Z, NormalU, NormalV);
+	}
+}
+
+void FClimbingReplayQuantized::ToTick(FClimbingReplayTick& OutTick) const {
+	using namespace ClimbingReplay;
+	OutTick.DeltaTime = float(DeltaMicros / 1000000.0);
+	OutTick.Input.Move = FVector2D(Move[0] / InputScale, Move[1] / InputScale);
+	OutTick.Input.Look = FVector2D(Look[0] / InputScale, Look[1] / InputScale);
+	OutTick.ControlRotation = FRotator(FRotator::DecompressAxisFromShort(Pitch), FRotator::DecompressAxisFromShort(Yaw), 0.f);
+	OutTick.Mode = Mode;
+	OutTick.Location = FVector(Location[0] / LocationScale, Location[1] / LocationScale, Location[2] / LocationScale);
+	OutTick.WallNormal = FVector::ZeroVector;
+	if (Mode == Climbing) {
+		ClimbingMath::DecodeOctahedral8(NormalU, NormalV, OutTick.WallNormal.X, OutTick.WallNormal.Y, OutTick.WallNormal.Z);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FClimbingReplayWriter
+
+FClimbingReplayWriter::FClimbingReplayWriter()
+	: NumTicks(0)
+	, NumBytes(0) {
+}
+
+FClimbingReplayWriter::~FClimbingReplayWriter() {
+	Close();
+}
+
+bool FClimbingReplayWriter::Open(const FString& Filename, const FClimbingReplayHeader& Header) {
+	using namespace ClimbingReplay;
+	Close();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+	File.Reset(PlatformFile.OpenWrite(*Filename));
+	if (!File) {
+		UE_LOG(LogClimbing, Error, TEXT("Failed to open climbing replay '%s' for writing"), *Filename);
+		return false;
+	}
+
+	Buffer.Reset(BufferSize);
+	Previous = FClimbingReplayQuantized();
+	Footer = FClimbingReplayFooter();
+	NumTicks = 0;
+	NumBytes = 0;
+
+	const FTCHARToUTF8 MapName(*Header.MapName);
+	WriteRaw(Buffer, Magic);
+	WriteRaw(Buffer, Version);
+	WriteVarUInt(Buffer, uint32(MapName.Length()));
+	Buffer.Append(reinterpret_cast<const uint8*>(MapName.Get()), MapName.Length());
+	for (int32 Axis = 0; Axis < 3; ++Axis) {
+		WriteRaw(Buffer, float(Header.StartLocation[Axis]));
+	}
+	WriteRaw(Buffer, float(Header.StartRotation.Pitch));
+	WriteRaw(Buffer, float(Header.StartRotation.Yaw));
+	WriteRaw(Buffer, float(Header.StartRotation.Roll));
+	WriteRaw(Buffer, Header.StartMode);
+	return true;
+}
+
+void FClimbingReplayWriter::WriteTick(const FClimbingReplayTick& Tick) {
+	using namespace ClimbingReplay;
+	if (!File) {
+		return;
+	}
+
+	// 关键帧之前把上一个Tick当成全零，所有字段都写完整的值
+	const bool bKeyframe = NumTicks % KeyframeInterval == 0;
+	if (bKeyframe) {
+		Previous = FClimbingReplayQuantized();
+	}
+
+	FClimbingReplayQuantized Current;
+	Current.FromTick(Tick);
+	if (Current.Mode != Climbing) {
+		Current.NormalU = Previous.NormalU;
+		Current.NormalV = Previous.NormalV;
+	}
+
+	uint8 Flags = 0;
+	if (bKeyframe || Current.DeltaMicros != Previous.DeltaMicros) {
+		Flags |= Flag_DeltaTime;
+	}
+	if (Current.Move[0] != Previous.Move[0] || Current.Move[1] != Previous.Move[1]) {
+		Flags |= Flag_Move;
+	}
+	if (Current.Look[0] != 0 || Current.Look[1] != 0) {
+		Flags |= Flag_Look;
+	}
+	if (bKeyframe || Current.Pitch != Previous.Pitch || Current.Yaw != Previous.Yaw) {
+		Flags |= Flag_Rotation;
+	}
+	if (Tick.Input.bJumpPressed) {
+		Flags |= Flag_JumpPressed;
+	}
+	if (Tick.Input.bJumpReleased) {
+		Flags |= Flag_JumpReleased;
+	}
+	if (bKeyframe || Current.Mode != Previous.Mode) {
+		Flags |= Flag_Mode;
+	}
+	if (Current.Mode == Climbing && (bKeyframe || Current.NormalU != Previous.NormalU || Current.NormalV != Previous.NormalV)) {
+		Flags |= Flag_Normal;
+	}
+
+	Buffer.Add(Flags);
+	if (Flags & Flag_DeltaTime) {
+		WriteVarInt(Buffer, Current.DeltaMicros - Previous.DeltaMicros);
+	}
+	if (Flags & Flag_Move) {
+		WriteVarInt(Buffer, Current.Move[0] - Previous.Move[0]);
+		WriteVarInt(Buffer, Current.Move[1] - Previous.Move[1]);
+	}
+	if (Flags & Flag_Look) {
+		// Look本身就是这一帧的增量，不再和上一帧做差
+		WriteVarInt(Buffer, Current.Look[0]);
+		WriteVarInt(Buffer, Current.Look[1]);
+	}
+	if (Flags & Flag_Rotation) {
+		WriteRaw(Buffer, Current.Pitch);
+		WriteRaw(Buffer, Current.Yaw);
+	}
+	if (Flags & Flag_Mode) {
+		Buffer.Add(Current.Mode);
+	}
+	if (Flags & Flag_Normal) {
+		Buffer.Add(Current.NormalU);
+		Buffer.Add(Current.NormalV);
+	}
+	for (int32 Axis = 0; Axis < 3; ++Axis) {
+		WriteVarInt(Buffer, Current.Location[Axis] - Previous.Location[Axis]);
+	}
+
+	Previous = Current;
+	Footer.EndLocation = Tick.Location;
+	Footer.EndRotation = Tick.Rotation;
+	++NumTicks;
+	if (Buffer.Num() > BufferSize - MaxTickBytes) {
+		Flush();
+	}
+}
+
+void FClimbingReplayWriter::Flush() {
+	if (File && Buffer.Num() > 0) {
+		File->Write(Buffer.GetData(), Buffer.Num());
+		NumBytes += Buffer.Num();
+	}
+	Buffer.Reset();
+}
+
+void FClimbingReplayWriter::Close() {
+	using namespace ClimbingReplay;
+	if (File) {
+		WriteRaw(Buffer, FooterMagic);
+		for (int32 Axis = 0; Axis < 3; ++Axis) {
+			WriteRaw(Buffer, float(Footer.EndLocation[Axis]));
+		}
+		WriteRaw(Buffer, float(Footer.EndRotation.Pitch));
+		WriteRaw(Buffer, float(Footer.EndRotation.Yaw));
+		WriteRaw(Buffer, float(Footer.EndRotation.Roll));
+		Flush();
+		File->Flush();
+		File.Reset();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FClimbingReplayReader
+
+FClimbingReplayReader::FClimbingReplayReader()
+	: ReadOffset(0)
+	, RemainingFileBytes(0)
+	, bHasFooter(false)
+	, NumTicks(0) {
+}
+
+FClimbingReplayReader::~FClimbingReplayReader() {
+	Close();
+}
+
+bool FClimbingReplayReader::Open(const FString& Filename, FClimbingReplayHeader& OutHeader) {
+	using namespace ClimbingReplay;
+	Close();
+
+	File.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Filename));
+	if (!File) {
+		UE_LOG(LogClimbing, Error, TEXT("Failed to open climbing replay '%s'"), *Filename);
+		return false;
+	}
+
+	RemainingFileBytes = File->Size();
+	ReadFooter();
+	Buffer.Reset(BufferSize);
+	ReadOffset = 0;
+	Previous = FClimbingReplayQuantized();
+	NumTicks = 0;
+	Refill();
+
+	// 头部只有地图名是变长的，一个缓冲区肯定放得下
+	FByteCursor Cursor{ Buffer.GetData(), Buffer.Num(), 0 };
+	uint32 FileMagic = 0, FileVersion = 0, MapNameLength = 0;
+	if (!Cursor.ReadRaw(FileMagic) || FileMagic != Magic || !Cursor.ReadRaw(FileVersion) || FileVersion != Version
+		|| !Cursor.ReadVarUInt(MapNameLength) || Cursor.Offset + int32(MapNameLength) > Cursor.Num) {
+		UE_LOG(LogClimbing, Error, TEXT("'%s' is not a climbing replay (or was written by another version)"), *Filename);
+		Close();
+		return false;
+	}
+	OutHeader.MapName = FString(FUTF8ToTCHAR(reinterpret_cast<const ANSICHAR*>(Cursor.Data + Cursor.Offset), MapNameLength));
+	Cursor.Offset += MapNameLength;
+
+	float Values[6];
+	for (float& Value : Values) {
+		if (!Cursor.ReadRaw(Value)) {
+			Close();
+			return false;
+		}
+	}
+	if (!Cursor.ReadRaw(OutHeader.StartMode)) {
+		Close();
+		return false;
+	}
+	OutHeader.StartLocation = FVector(Values[0], Values[1], Values[2]);
+	OutHeader.StartRotation = FRotator(Values[3], Values[4], Values[5]);
+	ReadOffset = Cursor.Offset;
+	return true;
+}
+
+bool FClimbingReplayReader::ReadTick(FClimbingReplayTick& OutTick) {
+	using namespace ClimbingReplay;
+	if (!File) {
+		return false;
+	}
+
+	Refill();
+	if (ReadOffset >= Buffer.Num()) {
+		return false;
+	}
+
+	if (NumTicks % KeyframeInterval == 0) {
+		Previous = FClimbingReplayQuantized();
+	}
+
+	FByteCursor Cursor{ Buffer.GetData(), Buffer.Num(), ReadOffset };
+	FClimbingReplayQuantized Current = Previous;
+	Current.Look[0] = 0;
+	Current.Look[1] = 0;
+
+	uint8 Flags = 0;
+	int32 Delta[3];
+	bool bValid = Cursor.ReadRaw(Flags);
+	if (bValid && (Flags & Flag_DeltaTime)) {
+		bValid = Cursor.ReadVarInt(Delta[0]);
+		Current.DeltaMicros += Delta[0];
+	}
+	if (bValid && (Flags & Flag_Move)) {
+		bValid = Cursor.ReadVarInt(Delta[0]) && Cursor.ReadVarInt(Delta[1]);
+		Current.Move[0] += Delta[0];
+		Current.Move[1] += Delta[1];
+	}
+	if (bValid && (Flags & Flag_Look)) {
+		bValid = Cursor.ReadVarInt(Current.Look[0]) && Cursor.ReadVarInt(Current.Look[1]);
+	}
+	if (bValid && (Flags & Flag_Rotation)) {
+		bValid = Cursor.ReadRaw(Current.Pitch) && Cursor.ReadRaw(Current.Yaw);
+	}
+	if (bValid && (Flags & Flag_Mode)) {
+		bValid = Cursor.ReadRaw(Current.Mode);
+	}
+	if (bValid && (Flags & Flag_Normal)) {
+		bValid = Cursor.ReadRaw(Current.NormalU) && Cursor.ReadRaw(Current.NormalV);
+	}
+	for (int32 Axis = 0; bValid && Axis < 3; ++Axis) {
+		bValid = Cursor.ReadVarInt(Delta[Axis]);
+		Current.Location[Axis] += Delta[Axis];
+	}
+	if (!bValid) {
+		UE_LOG(LogClimbing, Warning, TEXT("Climbing replay is truncated after %d ticks"), NumTicks);
+		Close();
+		return false;
+	}
+
+	Current.ToTick(OutTick);
+	OutTick.Input.bJumpPressed = (Flags & Flag_JumpPressed) != 0;
+	OutTick.Input.bJumpReleased = (Flags & Flag_JumpReleased) != 0;
+
+	Previous = Current;
+	ReadOffset = Cursor.Offset;
+	++NumTicks;
+	return true;
+}
+
+void FClimbingReplayReader::ReadFooter() {
+	using namespace ClimbingReplay;
+	bHasFooter = false;
+	if (RemainingFileBytes < FooterSize || !File->Seek(RemainingFileBytes - FooterSize)) {
+		return;
+	}
+
+	uint8 Bytes[FooterSize];
+	const bool bRead = File->Read(Bytes, FooterSize);
+	File->Seek(0);
+	FByteCursor Cursor{ Bytes, FooterSize, 0 };
+	uint32 FileMagic = 0;
+	float Values[6];
+	if (!bRead || !Cursor.ReadRaw(FileMagic) || FileMagic != FooterMagic) {
+		return;
+	}
+	for (float& Value : Values) {
+		Cursor.ReadRaw(Value);
+	}
+	Footer.EndLocation = FVector(Values[0], Values[1], Values[2]);
+	Footer.EndRotation = FRotator(Values[3], Values[4], Values[5]);
+	bHasFooter = true;
+	RemainingFileBytes -= FooterSize;
+}
+
+bool FClimbingReplayReader::GetFooter(FClimbingReplayFooter& OutFooter) const {
+	if (bHasFooter) {
+		OutFooter = Footer;
+	}
+	return bHasFooter;
+}
+
+void FClimbingReplayReader::Refill() {
+	using namespace ClimbingReplay;
+	if (!File || RemainingFileBytes <= 0 || Buffer.Num() - ReadOffset >= MaxTickBytes) {
+		return;
+	}
+
+	// 没读完的部分挪到最前面，后面接着从文件里读
+	const int32 Unread = Buffer.Num() - ReadOffset;
+	if (Unread > 0 && ReadOffset > 0) {
+		FMemory::Memmove(Buffer.GetData(), Buffer.GetData() + ReadOffset, Unread);
+	}
+	ReadOffset = 0;
+
+	const int32 NumToRead = int32(FMath::Min<int64>(BufferSize - Unread, RemainingFileBytes));
+	Buffer.SetNumUninitialized(Unread + NumToRead, false);
+	if (!File->Read(Buffer.GetData() + Unread, NumToRead)) {
+		UE_LOG(LogClimbing, Warning, TEXT("Failed to read climbing replay"));
+		Buffer.SetNum(Unread, false);
+		RemainingFileBytes = 0;
+		return;
+	}
+	RemainingFileBytes -= NumToRead;
+}
+
+void FClimbingReplayReader::Close() {
+	File.Reset();
+	Buffer.Reset();
+	ReadOffset = 0;
+	RemainingFileBytes = 0;
+}
@@ -0,0 +1,137 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IFileHandle;
+
+/** 一个Tick里角色收到的输入，和EnhancedInput回调里拿到的值一致 */
+struct FClimbingInputFrame {
+	FVector2D Move = FVector2D::ZeroVector;		// 这个Tick最后一次Move的值，没有触发时是零
+	FVector2D Look = FVector2D::ZeroVector;		// 这个Tick所有Look的累加
+	bool bJumpPressed = false;
+	bool bJumpReleased = false;
+};
+
+/** 录像里一个Tick的记录，读出来的值都是量化之后的 */
+struct FClimbingReplayTick {
+	float DeltaTime = 0.f;
+	FClimbingInputFrame Input;
+	FRotator ControlRotation = FRotator::ZeroRotator;	// Look作用之后的结果，回放时直接设置，不依赖PlayerController
+	uint8 Mode = 0;										// 这个Tick结束时的ECharacterMovementMode
+	FVector Location = FVector::ZeroVector;				// 这个Tick结束时的位置
+	FVector WallNormal = FVector::ZeroVector;			// 攀爬时的墙面法线，不在攀爬时不记录
+	FRotator Rotation = FRotator::ZeroRotator;			// 这个Tick结束时角色的朝向，只有最后一个Tick的值写在文件末尾
+};
+
+/** 录像开始时的状态，回放时按它生成角色 */
+struct FClimbingReplayHeader {
+	FString MapName;
+	FVector StartLocation = FVector::ZeroVector;
+	FRotator StartRotation = FRotator::ZeroRotator;
+	uint8 StartMode = 0;
+};
+
+/** 录像结束时角色的位置和朝向，正常关闭的录像才有，回放结束时用它检查最终的结果 */
+struct FClimbingReplayFooter {
+	FVector EndLocation = FVector::ZeroVector;
+	FRotator EndRotation = FRotator::ZeroRotator;
+};
+
+namespace ClimbingReplay {
+	constexpr uint32 Magic = 0x50524C43;			// "CLRP"
+	constexpr uint32 FooterMagic = 0x45524C43;		// "CLRE"
+	constexpr uint32 Version = 2;
+	constexpr int32 FooterSize = sizeof(uint32) + 6 * sizeof(float);
+	constexpr int32 KeyframeInterval = 256;			// 每隔这么多Tick写一次不依赖前一个Tick的完整记录，文件截断时也能读到最近的关键帧
+	constexpr int32 BufferSize = 64 * 1024;			// 读写都只用这么大的缓冲区，录多长都不会涨内存
+	constexpr int32 MaxTickBytes = 64;				// 一个Tick编码之后最多的字节数
+
+	// 录像的默认目录，Saved/Profiling/Climbing/Replays/
+	FString GetReplayDir();
+}
+
+/**
+ * 量化之后的状态，编码和解码两边各维护一份，每个Tick只写和上一个Tick不同的部分
+ * 位置是0.1cm的整数，输入是1/10000的整数，法线是八面体编码的两个字节
+ */
+struct FClimbingReplayQuantized {
+	int32 DeltaMicros = 0;
+	int32 Move[2] = { 0, 0 };
+	int32 Look[2] = { 0, 0 };
+	uint16 Pitch = 0;
+	uint16 Yaw = 0;
+	uint8 Mode = 0;
+	int32 Location[3] = { 0, 0, 0 };
+	uint8 NormalU = 128;
+	uint8 NormalV = 128;
+
+	void FromTick(const FClimbingReplayTick& Tick);
+	void ToTick(FClimbingReplayTick& OutTick) const;
+};
+
+/**
+ * 流式写入录像文件，攒满一个缓冲区就写到磁盘
+ * 每个Tick一个标记字节，后面只跟变化了的字段，位置写成和上一个Tick的差值(ZigZag + 变长整数)，不动的时候一个Tick只有4个字节
+ */
+class FClimbingReplayWriter {
+public:
+	FClimbingReplayWriter();
+	~FClimbingReplayWriter();
+
+	bool Open(const FString& Filename, const FClimbingReplayHeader& Header);
+	void WriteTick(const FClimbingReplayTick& Tick);
+
+	// 把最后一个Tick的位置和朝向写成文件尾，再关闭文件
+	void Close();
+
+	bool IsOpen() const { return File.IsValid(); }
+	int32 GetNumTicks() const { return NumTicks; }
+	int64 GetNumBytes() const { return NumBytes; }
+
+private:
+	void Flush();
+
+	TUniquePtr<IFileHandle> File;
+	TArray<uint8> Buffer;
+	FClimbingReplayQuantized Previous;
+	FClimbingReplayFooter Footer;
+	int32 NumTicks;
+	int64 NumBytes;
+};
+
+/** 流式读取录像文件，和FClimbingReplayWriter一样只用一个固定大小的缓冲区 */
+class FClimbingReplayReader {
+public:
+	FClimbingReplayReader();
+	~FClimbingReplayReader();
+
+	bool Open(const FString& Filename, FClimbingReplayHeader& OutHeader);
+
+	// 读到文件结尾或者文件被截断时返回false
+	bool ReadTick(FClimbingReplayTick& OutTick);
+	void Close();
+
+	bool IsOpen() const { return File.IsValid(); }
+	int32 GetNumTicks() const { return NumTicks; }
+
+	// 录制中途退出(文件被截断)的录像没有文件尾，返回false
+	bool GetFooter(FClimbingReplayFooter& OutFooter) const;
+
+private:
+	// 文件末尾有文件尾时读出来，并且不把它当成Tick数据
+	void ReadFooter();
+
+	// 缓冲区里剩下的数据不够一个Tick时从文件里补
+	void Refill();
+
+	TUniquePtr<IFileHandle> File;
+	TArray<uint8> Buffer;
+	int32 ReadOffset;
+	int64 RemainingFileBytes;
+	FClimbingReplayQuantized Previous;
+	FClimbingReplayFooter Footer;
+	bool bHasFooter;
+	int32 NumTicks;
+};
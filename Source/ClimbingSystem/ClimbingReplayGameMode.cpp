@@ -0,0 +1,262 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingReplayGameMode.h"
+#include "ClimbingSystem.h"
+#include "Dom/JsonObject.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "UObject/ConstructorHelpers.h"
+
+AClimbingReplayGameMode::AClimbingReplayGameMode() {
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	static ConstructorHelpers::FClassFinder<AClimbingSystemCharacter> ClimberBPClass(TEXT("/Game/ThirdPerson/Blueprints/BP_ThirdPersonCharacter"));
+	ClimberClass = ClimberBPClass.Class ? ClimberBPClass.Class : TSubclassOf<AClimbingSystemCharacter>(AClimbingSystemCharacter::StaticClass());
+
+	// 本地玩家先只观察，回放的角色生成之后由它控制
+	DefaultPawnClass = nullptr;
+	bStartPlayersAsSpectators = true;
+
+	LocationTolerance = 1.f;
+	NormalTolerance = 0.05f;
+	RotationTolerance = 1.f;
+	bQuitWhenFinished = true;
+
+	bHasNextTick = false;
+	bHasPendingTick = false;
+	NumTicks = 0;
+	NumDivergentTicks = 0;
+	FirstDivergentTick = INDEX_NONE;
+	NumModeMismatches = 0;
+	MaxLocationError = 0.f;
+	FinalLocationError = 0.f;
+	FinalRotationError = 0.f;
+	bHasFinalTransform = false;
+	bFinalTransformMismatch = false;
+	SimulatedSeconds = 0.0;
+	StartTime = 0.0;
+	bFinished = false;
+}
+
+void AClimbingReplayGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) {
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	const TCHAR* CommandLine = FCommandLine::Get();
+	FParse::Value(CommandLine, TEXT("ClimbingReplay="), ReplayFilename);
+	FParse::Value(CommandLine, TEXT("ClimbingReplayTolerance="), LocationTolerance);
+
+	// 只给名字时在默认的录像目录里找
+	if (!ReplayFilename.IsEmpty() && FPaths::IsRelative(ReplayFilename) && !FPaths::FileExists(ReplayFilename)) {
+		ReplayFilename = ClimbingReplay::GetReplayDir() / ReplayFilename;
+		if (FPaths::GetExtension(ReplayFilename).IsEmpty()) {
+			ReplayFilename += TEXT(".climbreplay");
+		}
+	}
+	if (ReplayFilename.IsEmpty() || !Reader.Open(ReplayFilename, Header)) {
+		UE_LOG(LogClimbing, Error, TEXT("Climbing replay: no replay to play, pass -ClimbingReplay=<Name>"));
+		return;
+	}
+
+	FString CurrentMap = GetWorld()->GetMapName();
+	CurrentMap.RemoveFromStart(GetWorld()->StreamingLevelsPrefix);
+	if (CurrentMap != Header.MapName) {
+		UE_LOG(LogClimbing, Warning, TEXT("Climbing replay was recorded on '%s' but is playing on '%s', expect divergence"), *Header.MapName, *CurrentMap);
+	}
+
+	// 每帧用录像里的DeltaTime，不等待真实时间
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetBenchmarking(true);
+	bHasNextTick = Reader.ReadTick(NextTick);
+	if (bHasNextTick) {
+		FApp::SetFixedDeltaTime(NextTick.DeltaTime);
+	}
+}
+
+void AClimbingReplayGameMode::StartPlay() {
+	Super::StartPlay();
+
+	StartTime = FPlatformTime::Seconds();
+	if (!bHasNextTick) {
+		Finish();
+		return;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	AClimbingSystemCharacter* Climber = GetWorld()->SpawnActor<AClimbingSystemCharacter>(ClimberClass, Header.StartLocation, Header.StartRotation, SpawnParams);
+	if (!Climber) {
+		UE_LOG(LogClimbing, Error, TEXT("Climbing replay: failed to spawn %s"), *GetNameSafe(ClimberClass));
+		Finish();
+		return;
+	}
+
+	// 录像来自玩家控制的角色，群体系统、LOD和检测预算都按IsPlayerControlled区分，回放也必须由PlayerController控制
+	// 否则AIController控制的角色会走另一条检测和Tick的路径，回放从一开始就注定不一致
+	APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (!PlayerController) {
+		FActorSpawnParameters ControllerSpawnParams;
+		ControllerSpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		PlayerController = GetWorld()->SpawnActor<APlayerController>(PlayerControllerClass ? PlayerControllerClass.Get() : APlayerController::StaticClass(), ControllerSpawnParams);
+	}
+	PlayerController->Possess(Climber);
+
+	// 输入要在角色移动之前给到，和PlayerController处理输入的顺序一样
+	Climber->GetCharacterMovement()->PrimaryComponentTick.AddPrerequisite(this, PrimaryActorTick);
+	if (Header.StartMode == Climbing) {
+		Climber->ScriptedEnterClimbing();
+	}
+	Character = Climber;
+
+	UE_LOG(LogClimbing, Display, TEXT("Climbing replay: playing '%s' recorded on '%s'"), *ReplayFilename, *Header.MapName);
+}
+
+void AClimbingReplayGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+	if (!bFinished) {
+		WriteResults();
+		bFinished = true;
+	}
+	Reader.Close();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AClimbingReplayGameMode::Tick(float DeltaSeconds) {
+	Super::Tick(DeltaSeconds);
+
+	if (bFinished) {
+		return;
+	}
+
+	AClimbingSystemCharacter* Climber = Character.Get();
+	if (!Climber) {
+		Finish();
+		return;
+	}
+
+	// 上一帧的移动已经跑完了，先对比结果
+	if (bHasPendingTick) {
+		VerifyTick(PendingTick);
+		bHasPendingTick = false;
+	}
+
+	if (!bHasNextTick) {
+		Finish();
+		return;
+	}
+
+	PendingTick = NextTick;
+	bHasPendingTick = true;
+	SimulatedSeconds += PendingTick.DeltaTime;
+
+	// 下一帧的步长要在这一帧结束前设置好
+	bHasNextTick = Reader.ReadTick(NextTick);
+	if (bHasNextTick) {
+		FApp::SetFixedDeltaTime(NextTick.DeltaTime);
+	}
+
+	// 直接设置录下来的朝向，Look的输入已经包含在里面了，不再交给PlayerController累加一次
+	if (AController* Controller = Climber->GetController()) {
+		Controller->SetControlRotation(PendingTick.ControlRotation);
+	}
+	FClimbingInputFrame Input = PendingTick.Input;
+	Input.Look = FVector2D::ZeroVector;
+	Climber->ReplayInput(Input);
+}
+
+void AClimbingReplayGameMode::VerifyTick(const FClimbingReplayTick& Expected) {
+	const AClimbingSystemCharacter* Climber = Character.Get();
+	const float LocationError = float(FVector::Dist(Climber->GetActorLocation(), Expected.Location));
+	const bool bModeMismatch = Climber->GetCharacterMovementMode() != Expected.Mode;
+	const bool bNormalMismatch = !bModeMismatch && Expected.Mode == Climbing
+		&& FVector::DotProduct(Climber->GetClimbingMovement()->GetClimbSurfaceNormal(), Expected.WallNormal) < 1.f - NormalTolerance;
+
+	MaxLocationError = FMath::Max(MaxLocationError, LocationError);
+	if (bModeMismatch) {
+		++NumModeMismatches;
+	}
+	if (bModeMismatch || bNormalMismatch || LocationError > LocationTolerance) {
+		if (NumDivergentTicks == 0) {
+			FirstDivergentTick = NumTicks;
+			UE_LOG(LogClimbing, Warning, TEXT("Climbing replay diverged at tick %d: mode %d (expected %d), location error %.2fcm"),
+				NumTicks, int32(Climber->GetCharacterMovementMode()), int32(Expected.Mode), LocationError);
+		}
+		++NumDivergentTicks;
+	}
+	++NumTicks;
+}
+
+void AClimbingReplayGameMode::VerifyFinalTransform() {
+	const AClimbingSystemCharacter* Climber = Character.Get();
+	FClimbingReplayFooter Footer;
+	bHasFinalTransform = Climber && NumTicks > 0 && Reader.GetFooter(Footer);
+	if (!bHasFinalTransform) {
+		UE_LOG(LogClimbing, Warning, TEXT("Climbing replay has no final transform (recording was not stopped cleanly), skipping the final check"));
+		return;
+	}
+
+	FinalLocationError = float(FVector::Dist(Climber->GetActorLocation(), Footer.EndLocation));
+	FinalRotationError = float(FMath::RadiansToDegrees(Climber->GetActorQuat().AngularDistance(Footer.EndRotation.Quaternion())));
+	bFinalTransformMismatch = FinalLocationError > LocationTolerance || FinalRotationError > RotationTolerance;
+	if (bFinalTransformMismatch) {
+		UE_LOG(LogClimbing, Warning, TEXT("Climbing replay ended at a different transform: location error %.2fcm, rotation error %.2fdeg"), FinalLocationError, FinalRotationError);
+	}
+}
+
+void AClimbingReplayGameMode::Finish() {
+	VerifyFinalTransform();
+	WriteResults();
+	bFinished = true;
+	Reader.Close();
+
+	if (bQuitWhenFinished) {
+		const bool bFailed = NumTicks == 0 || NumDivergentTicks > 0 || bFinalTransformMismatch;
+		FPlatformMisc::RequestExitWithStatus(false, bFailed ? 1 : 0);
+	}
+}
+
+void AClimbingReplayGameMode::WriteResults() {
+	if (NumTicks == 0) {
+		UE_LOG(LogClimbing, Warning, TEXT("Climbing replay finished without playing any ticks"));
+		return;
+	}
+
+	const double WallSeconds = FPlatformTime::Seconds() - StartTime;
+
+	TSharedRef<FJsonObject> Summary = MakeShared<FJsonObject>();
+	Summary->SetStringField(TEXT("Replay"), ReplayFilename);
+	Summary->SetStringField(TEXT("Map"), Header.MapName);
+	Summary->SetNumberField(TEXT("Ticks"), NumTicks);
+	Summary->SetNumberField(TEXT("SimulatedSeconds"), SimulatedSeconds);
+	Summary->SetNumberField(TEXT("WallSeconds"), WallSeconds);
+	Summary->SetNumberField(TEXT("SpeedFactor"), WallSeconds > 0.0 ? SimulatedSeconds / WallSeconds : 0.0);
+	Summary->SetNumberField(TEXT("LocationTolerance"), LocationTolerance);
+	Summary->SetNumberField(TEXT("DivergentTicks"), NumDivergentTicks);
+	Summary->SetNumberField(TEXT("FirstDivergentTick"), FirstDivergentTick);
+	Summary->SetNumberField(TEXT("MaxLocationError"), MaxLocationError);
+	Summary->SetNumberField(TEXT("ModeMismatches"), NumModeMismatches);
+	Summary->SetBoolField(TEXT("HasFinalTransform"), bHasFinalTransform);
+	Summary->SetNumberField(TEXT("FinalLocationError"), FinalLocationError);
+	Summary->SetNumberField(TEXT("FinalRotationError"), FinalRotationError);
+	Summary->SetBoolField(TEXT("FinalTransformMismatch"), bFinalTransformMismatch);
+
+	FString Json;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Summary, Writer);
+
+	const FString Filename = FPaths::ProfilingDir() / TEXT("Climbing") / FString::Printf(TEXT("ClimbingReplay-%s-%s.json"), *FPaths::GetBaseFilename(ReplayFilename), *FDateTime::Now().ToString());
+	if (!FFileHelper::SaveStringToFile(Json, *Filename)) {
+		UE_LOG(LogClimbing, Error, TEXT("Failed to write climbing replay results to '%s'"), *Filename);
+		return;
+	}
+
+	UE_LOG(LogClimbing, Display, TEXT("Climbing replay: %d ticks (%.1fs simulated in %.1fs), %d divergent, max location error %.2fcm, results in '%s'"),
+		NumTicks, SimulatedSeconds, WallSeconds, NumDivergentTicks, MaxLocationError, *Filename);
+}
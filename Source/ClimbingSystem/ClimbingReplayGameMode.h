@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/GameModeBase.h"
+#include "ClimbingReplay.h"
+#include "ClimbingSystemCharacter.h"
+#include "ClimbingReplayGameMode.generated.h"
+
+/**
+ * 无头回放UClimbingReplaySubsystem录下来的攀爬录像，检查回放出来的状态和录像是否一致:
+ *   ClimbingSystem <RecordedMap>?game=/Script/ClimbingSystem.ClimbingReplayGameMode -nullrhi -nosound -unattended
+ *     -ClimbingReplay=<Name或完整路径> [-ClimbingReplayTolerance=1.0]
+ *
+ * 用录像里每个Tick的DeltaTime作为固定步长驱动引擎，并且开着-benchmark的行为不等待帧时间，所以比实时跑得快
+ * 回放的角色由PlayerController控制，和录像时一样走玩家角色的检测路径(不被群体系统接管，不降LOD，不受检测预算限制)
+ * 每个Tick回放录下来的输入，Tick结束之后对比状态、位置和墙面法线，最后对比录像结尾的位置和朝向，结果写到Saved/Profiling/Climbing/下的JSON
+ * 有不一致的Tick或者最终位置不一致时以返回值1退出，方便CI判断
+ */
+UCLASS(config=Game)
+class AClimbingReplayGameMode : public AGameModeBase
+{
+	GENERATED_BODY()
+
+public:
+	AClimbingReplayGameMode();
+
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void StartPlay() override;
+	virtual void Tick(float DeltaSeconds) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+protected:
+	UPROPERTY(EditAnywhere, Config, Category = Replay)
+	TSubclassOf<AClimbingSystemCharacter> ClimberClass;		// 默认是BP_ThirdPersonCharacter
+
+	UPROPERTY(EditAnywhere, Config, Category = Replay, meta = (ClampMin = "0", ForceUnits = "cm"))
+	float LocationTolerance;		// 位置误差超过这个值就算不一致
+
+	UPROPERTY(EditAnywhere, Config, Category = Replay, meta = (ClampMin = "0", ClampMax = "1"))
+	float NormalTolerance;			// 攀爬时墙面法线点积小于1减去这个值就算不一致
+
+	UPROPERTY(EditAnywhere, Config, Category = Replay, meta = (ClampMin = "0", ForceUnits = "deg"))
+	float RotationTolerance;		// 录像结尾的朝向误差超过这个值就算不一致
+
+	UPROPERTY(EditAnywhere, Config, Category = Replay)
+	bool bQuitWhenFinished;
+
+private:
+	// 对比上一个Tick回放之后的状态和录像里记录的状态
+	void VerifyTick(const FClimbingReplayTick& Expected);
+	// 对比回放结束时的位置和朝向和录像文件尾里记录的是否一致
+	void VerifyFinalTransform();
+	void Finish();
+	void WriteResults();
+
+	FClimbingReplayReader Reader;
+	FClimbingReplayHeader Header;
+	FString ReplayFilename;
+
+	TWeakObjectPtr<AClimbingSystemCharacter> Character;
+
+	FClimbingReplayTick NextTick;		// 下一个要回放的Tick，提前读出来用它的DeltaTime设置引擎的固定步长
+	FClimbingReplayTick PendingTick;	// 已经回放、等着对比结果的Tick
+	bool bHasNextTick;
+	bool bHasPendingTick;
+
+	int32 NumTicks;
+	int32 NumDivergentTicks;
+	int32 FirstDivergentTick;
+	int32 NumModeMismatches;
+	float MaxLocationError;
+	float FinalLocationError;
+	float FinalRotationError;
+	bool bHasFinalTransform;
+	bool bFinalTransformMismatch;
+	double SimulatedSeconds;
+
+	double StartTime;
+	bool bFinished;
+};
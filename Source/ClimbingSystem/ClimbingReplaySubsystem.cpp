@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingReplaySubsystem.h"
+#include "ClimbingStats.h"
+#include "ClimbingSystem.h"
+#include "ClimbingSystemCharacter.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Paths.h"
+
+static FAutoConsoleCommandWithWorldAndArgs ClimbingReplayRecordCommand(
+	TEXT("Climbing.Replay.Record"),
+	TEXT("开始录制本地玩家角色的输入和攀爬状态，参数是录像的名字，不填时按时间命名"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World) {
+		if (UClimbingReplaySubsystem* Subsystem = World ? World->GetSubsystem<UClimbingReplaySubsystem>() : nullptr) {
+			Subsystem->StartRecording(nullptr, Args.Num() > 0 ? Args[0] : FString());
+		}
+	}));
+
+static FAutoConsoleCommandWithWorld ClimbingReplayStopCommand(
+	TEXT("Climbing.Replay.Stop"),
+	TEXT("停止录制并关闭录像文件"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UClimbingReplaySubsystem* Subsystem = World ? World->GetSubsystem<UClimbingReplaySubsystem>() : nullptr) {
+			Subsystem->StopRecording();
+		}
+	}));
+
+bool UClimbingReplaySubsystem::StartRecording(AClimbingSystemCharacter* Character, const FString& Name) {
+	StopRecording();
+
+	if (!Character) {
+		Character = FindLocalCharacter();
+	}
+	if (!Character) {
+		UE_LOG(LogClimbing, Warning, TEXT("Climbing replay: no locally controlled climbing character to record"));
+		return false;
+	}
+
+	const FString ReplayName = Name.IsEmpty() ? FString::Printf(TEXT("ClimbingReplay-%s"), *FDateTime::Now().ToString()) : Name;
+	RecordingFilename = ClimbingReplay::GetReplayDir() / ReplayName + TEXT(".climbreplay");
+
+	FClimbingReplayHeader Header;
+	Header.MapName = GetWorld()->GetMapName();
+	Header.MapName.RemoveFromStart(GetWorld()->StreamingLevelsPrefix);
+	Header.StartLocation = Character->GetActorLocation();
+	Header.StartRotation = Character->GetActorRotation();
+	Header.StartMode = Character->GetCharacterMovementMode();
+	if (!Writer.Open(RecordingFilename, Header)) {
+		return false;
+	}
+
+	RecordedCharacter = Character;
+	Character->SetInputRecording(true);
+	UE_LOG(LogClimbing, Display, TEXT("Climbing replay: recording '%s' to '%s'"), *Character->GetName(), *RecordingFilename);
+	return true;
+}
+
+void UClimbingReplaySubsystem::StopRecording() {
+	if (!Writer.IsOpen()) {
+		return;
+	}
+
+	if (AClimbingSystemCharacter* Character = RecordedCharacter.Get()) {
+		Character->SetInputRecording(false);
+	}
+	Writer.Close();
+	RecordedCharacter.Reset();
+
+	UE_LOG(LogClimbing, Display, TEXT("Climbing replay: wrote %d ticks (%.1f KB, %.1f bytes/tick) to '%s'"),
+		Writer.GetNumTicks(), Writer.GetNumBytes() / 1024.0, Writer.GetNumTicks() > 0 ? double(Writer.GetNumBytes()) / Writer.GetNumTicks() : 0.0, *RecordingFilename);
+}
+
+AClimbingSystemCharacter* UClimbingReplaySubsystem::FindLocalCharacter() const {
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	return PlayerController ? Cast<AClimbingSystemCharacter>(PlayerController->GetPawn()) : nullptr;
+}
+
+bool UClimbingReplaySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UClimbingReplaySubsystem::OnWorldBeginPlay(UWorld& InWorld) {
+	Super::OnWorldBeginPlay(InWorld);
+	FParse::Value(FCommandLine::Get(), TEXT("ClimbingRecord="), PendingRecordingName);
+}
+
+void UClimbingReplaySubsystem::Deinitialize() {
+	StopRecording();
+	Super::Deinitialize();
+}
+
+TStatId UClimbingReplaySubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UClimbingReplaySubsystem, STATGROUP_Tickables);
+}
+
+void UClimbingReplaySubsystem::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+
+	if (!PendingRecordingName.IsEmpty()) {
+		if (AClimbingSystemCharacter* Character = FindLocalCharacter()) {
+			StartRecording(Character, PendingRecordingName);
+			PendingRecordingName.Reset();
+		}
+		return;
+	}
+
+	if (!Writer.IsOpen()) {
+		return;
+	}
+
+	// 在所有Tick组之后运行，这一帧的输入和移动都已经完成了
+	AClimbingSystemCharacter* Character = RecordedCharacter.Get();
+	if (!Character) {
+		StopRecording();
+		return;
+	}
+
+	FClimbingReplayTick Tick;
+	Tick.DeltaTime = DeltaTime;
+	Tick.Input = Character->ConsumeRecordedInput();
+	Tick.ControlRotation = Character->GetControlRotation();
+	Tick.Mode = Character->GetCharacterMovementMode();
+	Tick.Location = Character->GetActorLocation();
+	Tick.Rotation = Character->GetActorRotation();
+	Tick.WallNormal = Character->GetClimbingMovement()->GetClimbSurfaceNormal();
+	Writer.WriteTick(Tick);
+}
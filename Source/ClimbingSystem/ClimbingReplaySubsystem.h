@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ClimbingReplay.h"
+#include "ClimbingReplaySubsystem.generated.h"
+
+class AClimbingSystemCharacter;
+
+/**
+ * 把本地玩家角色每个Tick的输入和量化过的攀爬状态录到文件里，给AClimbingReplayGameMode回放
+ *   控制台: Climbing.Replay.Record [Name] / Climbing.Replay.Stop
+ *   命令行: -ClimbingRecord=Name，玩家角色生成之后自动开始录
+ * 文件写到Saved/Profiling/Climbing/Replays/Name.climbreplay，边录边写，内存占用是固定的
+ */
+UCLASS()
+class UClimbingReplaySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	bool StartRecording(AClimbingSystemCharacter* Character, const FString& Name);
+	void StopRecording();
+	bool IsRecording() const { return Writer.IsOpen(); }
+
+	// UWorldSubsystem interface
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	// 第一个本地玩家控制的攀爬角色
+	AClimbingSystemCharacter* FindLocalCharacter() const;
+
+	FClimbingReplayWriter Writer;
+	TWeakObjectPtr<AClimbingSystemCharacter> RecordedCharacter;
+	FString RecordingFilename;
+	FString PendingRecordingName;		// 命令行要求录像，但玩家角色还没生成
+};
@@ -0,0 +1,194 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingScriptedGameMode.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Misc/CommandLine.h"
+#include "UObject/ConstructorHelpers.h"
+
+namespace ClimbingScripted {
+	// 离墙面这么近的时候起跳，比WallDetectionLength远，保证是滞空时由Tick抓的墙
+	constexpr float JumpDistance = 160.f;
+	constexpr float JumpHoldTime = 0.15f;
+	// 给Mantle的过渡动作足够的时间走完并站稳
+	constexpr float MantleSettleTime = 1.5f;
+}
+
+AClimbingScriptedGameMode::AClimbingScriptedGameMode() {
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	static ConstructorHelpers::FClassFinder<AClimbingSystemCharacter> ClimberBPClass(TEXT("/Game/ThirdPerson/Blueprints/BP_ThirdPersonCharacter"));
+	ClimberClass = ClimberBPClass.Class ? ClimberBPClass.Class : TSubclassOf<AClimbingSystemCharacter>(AClimbingSystemCharacter::StaticClass());
+
+	// 连上来的玩家只观察，所有角色都由脚本驱动
+	DefaultPawnClass = nullptr;
+	bStartPlayersAsSpectators = true;
+
+	NumClimbers = 32;
+	StuckTimeout = 10.f;
+	bQuitWhenFinished = true;
+
+	Course = nullptr;
+	NumLaps = 0;
+	NumStuckResets = 0;
+}
+
+float AClimbingScriptedGameMode::Percentile(const TArray<float>& Sorted, float Percent) {
+	if (Sorted.Num() == 0) {
+		return 0.f;
+	}
+	const int32 Index = FMath::Clamp(FMath::CeilToInt(Percent / 100.f * Sorted.Num()) - 1, 0, Sorted.Num() - 1);
+	return Sorted[Index];
+}
+
+void AClimbingScriptedGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) {
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	ReadCommandLine(FCommandLine::Get());
+	NumClimbers = FMath::Max(NumClimbers, 1);
+
+	// 在UWorld::BeginPlay之前生成场地，这样表面缓存在OnWorldBeginPlay里就能收进去
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	Course = GetWorld()->SpawnActor<AClimbingBenchmarkCourse>(FVector::ZeroVector, FRotator::ZeroRotator, SpawnParams);
+	Course->Build(NumClimbers, CourseSettings);
+}
+
+void AClimbingScriptedGameMode::SpawnClimbers() {
+	const ACharacter* ClimberCDO = ClimberClass->GetDefaultObject<ACharacter>();
+	const float HalfHeight = ClimberCDO->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	Climbers.Reserve(Course->GetNumLanes());
+	for (int32 LaneIndex = 0; LaneIndex < Course->GetNumLanes(); ++LaneIndex) {
+		const FVector Location = Course->GetLaneStart(LaneIndex) + FVector(0.f, 0.f, HalfHeight + 2.f);
+		AClimbingSystemCharacter* Character = GetWorld()->SpawnActor<AClimbingSystemCharacter>(ClimberClass, Location, Course->GetLaneForward().Rotation(), SpawnParams);
+		if (!Character) {
+			continue;
+		}
+
+		// Move在Walking状态下需要Controller来确定前方，AIController在服务器上也算本地控制，会做墙壁检测
+		if (!Character->GetController()) {
+			Character->SpawnDefaultController();
+		}
+
+		FScriptedClimber& Climber = Climbers.AddDefaulted_GetRef();
+		Climber.Character = Character;
+		Climber.LaneIndex = LaneIndex;
+		SetPhase(Climber, EClimberPhase::Walk);
+		OnClimberSpawned(Climber);
+	}
+}
+
+void AClimbingScriptedGameMode::UpdateClimbers(float DeltaSeconds) {
+	for (FScriptedClimber& Climber : Climbers) {
+		UpdateClimber(Climber, DeltaSeconds);
+	}
+}
+
+void AClimbingScriptedGameMode::UpdateClimber(FScriptedClimber& Climber, float DeltaSeconds) {
+	AClimbingSystemCharacter* Character = Climber.Character.Get();
+	if (!Character) {
+		return;
+	}
+
+	Climber.PhaseTime += DeltaSeconds;
+	Climber.ActionTime -= DeltaSeconds;
+	if (Climber.PhaseTime > StuckTimeout) {
+		++NumStuckResets;
+		ResetClimber(Climber);
+		return;
+	}
+
+	switch (Climber.Phase) {
+	case EClimberPhase::Walk: {
+		UpdateWalkInput(Climber);
+		Character->AddScriptedMoveInput(Climber.MoveInput);
+		const float DistanceToWall = Course->GetRunUpLength() - FVector::DotProduct(Character->GetActorLocation() - Course->GetLaneStart(Climber.LaneIndex), Course->GetLaneForward());
+		if (Character->GetCharacterMovementMode() == Walking && DistanceToWall <= Climber.JumpDistance) {
+			Character->ScriptedJump();
+			Climber.bJumpHeld = true;
+			SetPhase(Climber, EClimberPhase::Jump);
+		}
+		break;
+	}
+	case EClimberPhase::Jump:
+		Character->AddScriptedMoveInput(FVector2D(0.f, 1.f));
+		if (Climber.bJumpHeld && Climber.PhaseTime >= Climber.JumpHoldTime) {
+			Character->ScriptedStopJump();
+			Climber.bJumpHeld = false;
+		}
+		if (Character->IsClimbing()) {
+			SetPhase(Climber, EClimberPhase::Climb);
+		} else if (!Climber.bJumpHeld && !Character->GetCharacterMovement()->IsFalling()) {
+			// 没抓住墙落地了，重新走一次
+			SetPhase(Climber, EClimberPhase::Walk);
+		}
+		break;
+	case EClimberPhase::Climb:
+		if (!Character->IsClimbing()) {
+			// CheckMantle在墙顶进入胶囊体半高范围内时触发，在这个高度以上退出攀爬的就是Mantle了，否则是松手或者爬到地面退出的
+			const float MantleMinZ = Course->GetWallTopZ() - Character->GetCapsuleComponent()->GetScaledCapsuleHalfHeight() - 10.f;
+			SetPhase(Climber, Character->GetActorLocation().Z >= MantleMinZ ? EClimberPhase::Mantle : EClimberPhase::Fall);
+			break;
+		}
+		UpdateClimbInput(Climber);
+		if (Climber.Phase == EClimberPhase::Climb) {
+			Character->AddScriptedMoveInput(Climber.MoveInput);
+		}
+		break;
+	case EClimberPhase::Mantle:
+		if (Climber.PhaseTime >= ClimbingScripted::MantleSettleTime && !Character->GetCharacterMovement()->IsFalling()) {
+			++NumLaps;
+			ResetClimber(Climber);
+		}
+		break;
+	case EClimberPhase::Fall:
+		if (!Character->GetCharacterMovement()->IsFalling() && Character->GetCharacterMovementMode() == Walking) {
+			SetPhase(Climber, EClimberPhase::Walk);
+		}
+		break;
+	}
+}
+
+void AClimbingScriptedGameMode::PrepareWalk(FScriptedClimber& Climber) {
+	Climber.JumpDistance = ClimbingScripted::JumpDistance;
+	Climber.JumpHoldTime = ClimbingScripted::JumpHoldTime;
+}
+
+void AClimbingScriptedGameMode::UpdateWalkInput(FScriptedClimber& Climber) {
+	Climber.MoveInput = FVector2D(0.f, 1.f);
+}
+
+void AClimbingScriptedGameMode::UpdateClimbInput(FScriptedClimber& Climber) {
+	Climber.MoveInput = FVector2D(0.f, 1.f);
+}
+
+void AClimbingScriptedGameMode::SetPhase(FScriptedClimber& Climber, EClimberPhase NewPhase) {
+	Climber.Phase = NewPhase;
+	Climber.PhaseTime = 0.f;
+	Climber.ActionTime = 0.f;
+	if (NewPhase == EClimberPhase::Walk) {
+		PrepareWalk(Climber);
+	}
+}
+
+void AClimbingScriptedGameMode::ResetClimber(FScriptedClimber& Climber) {
+	AClimbingSystemCharacter* Character = Climber.Character.Get();
+	if (Character->IsClimbing()) {
+		Character->ExitClimbing();
+	}
+	if (Climber.bJumpHeld) {
+		Character->ScriptedStopJump();
+		Climber.bJumpHeld = false;
+	}
+
+	const float HalfHeight = Character->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+	Character->GetCharacterMovement()->StopMovementImmediately();
+	Character->SetActorLocationAndRotation(Course->GetLaneStart(Climber.LaneIndex) + FVector(0.f, 0.f, HalfHeight + 2.f), Course->GetLaneForward().Rotation(), false, nullptr, ETeleportType::TeleportPhysics);
+	SetPhase(Climber, EClimberPhase::Walk);
+}
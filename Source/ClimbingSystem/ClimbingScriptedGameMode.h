@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/GameModeBase.h"
+#include "ClimbingBenchmarkCourse.h"
+#include "ClimbingSystemCharacter.h"
+#include "ClimbingScriptedGameMode.generated.h"
+
+/**
+ * 基准测试和压力测试共用的部分: 在InitGame里生成AClimbingBenchmarkCourse，每条赛道一个AI控制的角色，用脚本输入反复跑
+ * 走向墙 -> 起跳 -> 滞空时由Tick自动抓墙 -> 攀爬 -> Mantle到墙顶或者掉下来 -> 传送回起点
+ * 子类通过几个虚函数决定走路和攀爬时的输入，以及起跳的距离和按住跳跃的时间
+ */
+UCLASS(Abstract, config=Game)
+class AClimbingScriptedGameMode : public AGameModeBase
+{
+	GENERATED_BODY()
+
+public:
+	AClimbingScriptedGameMode();
+
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+
+	AClimbingBenchmarkCourse* GetCourse() const { return Course; }
+
+	// 排好序的数组里的分位数，Percent是0到100
+	static float Percentile(const TArray<float>& Sorted, float Percent);
+
+protected:
+	UPROPERTY(EditAnywhere, Config, Category = Climbers)
+	TSubclassOf<AClimbingSystemCharacter> ClimberClass;		// 默认是BP_ThirdPersonCharacter
+
+	UPROPERTY(EditAnywhere, Config, Category = Climbers, meta = (ClampMin = "1"))
+	int32 NumClimbers;
+
+	UPROPERTY(EditAnywhere, Config, Category = Climbers, meta = (ClampMin = "0", ForceUnits = "s"))
+	float StuckTimeout;				// 一个阶段卡住超过这个时间就传送回起点重来
+
+	UPROPERTY(EditAnywhere, Config, Category = Climbers)
+	bool bQuitWhenFinished;
+
+	UPROPERTY(EditAnywhere, Config, Category = Climbers)
+	FClimbingBenchmarkCourseSettings CourseSettings;
+
+	enum class EClimberPhase : uint8 {
+		Walk,		// 向墙走
+		Jump,		// 已经起跳，等Tick里的墙壁检测抓住墙
+		Climb,		// 在墙上爬，直到UpdateClimbingChecks里触发Mantle，或者松手掉下去
+		Mantle,		// 等Mantle结束站稳
+		Fall,		// 在Mantle的高度以下离开了墙，等落地
+	};
+
+	struct FScriptedClimber {
+		TWeakObjectPtr<AClimbingSystemCharacter> Character;
+		int32 LaneIndex = 0;
+		EClimberPhase Phase = EClimberPhase::Walk;
+		float PhaseTime = 0.f;
+		float ActionTime = 0.f;			// 当前这个输入还要持续的时间，子类用它决定什么时候换输入
+		FVector2D MoveInput = FVector2D::ZeroVector;
+		float JumpDistance = 0.f;		// 离墙这么近的时候起跳
+		float JumpHoldTime = 0.f;
+		bool bJumpHeld = false;
+	};
+
+	// InitGame里生成场地之前调用，从命令行读取子类自己的参数
+	virtual void ReadCommandLine(const TCHAR* CommandLine) {}
+
+	// 进入Walk阶段时调用，设置这一次的起跳距离和按住跳跃的时间
+	virtual void PrepareWalk(FScriptedClimber& Climber);
+
+	// Walk和Climb阶段每帧调用，设置Climber.MoveInput，可以调用SetPhase离开当前阶段
+	virtual void UpdateWalkInput(FScriptedClimber& Climber);
+	virtual void UpdateClimbInput(FScriptedClimber& Climber);
+
+	virtual void OnClimberSpawned(FScriptedClimber& Climber) {}
+
+	void SpawnClimbers();
+	void UpdateClimbers(float DeltaSeconds);
+	void SetPhase(FScriptedClimber& Climber, EClimberPhase NewPhase);
+	void ResetClimber(FScriptedClimber& Climber);
+
+	UPROPERTY(Transient)
+	AClimbingBenchmarkCourse* Course;
+
+	TArray<FScriptedClimber> Climbers;
+
+	uint32 NumLaps;				// 成功Mantle到墙顶的次数
+	uint32 NumStuckResets;
+
+private:
+	void UpdateClimber(FScriptedClimber& Climber, float DeltaSeconds);
+};
@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingSignificanceSubsystem.h"
+#include "ClimbingSystemCharacter.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+static TAutoConsoleVariable<int32> CVarClimbingLOD(
+	TEXT("Climbing.LOD"),
+	1,
+	TEXT("是否按重要程度降低远处攀爬角色的Tick和检测频率\n")
+	TEXT("0: 所有角色都按最高等级处理\n")
+	TEXT("1: 打开 (默认)"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarClimbingLODNearDistance(
+	TEXT("Climbing.LOD.NearDistance"),
+	2000.f,
+	TEXT("在这个距离内并且在屏幕上的角色是High"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarClimbingLODFarDistance(
+	TEXT("Climbing.LOD.FarDistance"),
+	5000.f,
+	TEXT("超过这个距离的角色是Low，中间的是Medium，不在屏幕上的再降一级"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarClimbingLODUpdateInterval(
+	TEXT("Climbing.LOD.UpdateInterval"),
+	0.25f,
+	TEXT("多久重新计算一次所有角色的LOD等级"),
+	ECVF_Default);
+
+// 按EClimbingSignificance排列
+static constexpr float SignificanceTickIntervals[] = { 0.f, 1.f / 15.f, 0.2f };
+static constexpr float SignificanceProbeIntervals[] = { 0.f, 1.f / 15.f, 0.25f };
+
+void UClimbingSignificanceSubsystem::RegisterClimber(AClimbingSystemCharacter* Climber) {
+	Climbers.AddUnique(Climber);
+}
+
+void UClimbingSignificanceSubsystem::UnregisterClimber(AClimbingSystemCharacter* Climber) {
+	Climbers.RemoveSwap(Climber);
+}
+
+float UClimbingSignificanceSubsystem::GetTickInterval(EClimbingSignificance Significance) {
+	return SignificanceTickIntervals[uint8(Significance)];
+}
+
+float UClimbingSignificanceSubsystem::GetProbeInterval(EClimbingSignificance Significance) {
+	return SignificanceProbeIntervals[uint8(Significance)];
+}
+
+void UClimbingSignificanceSubsystem::GetViewLocations(const UWorld* World, TArray<FVector>& OutViewLocations) {
+	OutViewLocations.Reset();
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It) {
+		const APlayerController* PlayerController = It->Get();
+		if (!PlayerController || (!PlayerController->GetPawn() && !PlayerController->PlayerCameraManager)) {
+			continue;
+		}
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+		OutViewLocations.Add(ViewLocation);
+	}
+}
+
+double UClimbingSignificanceSubsystem::GetMinDistanceSquared(const FVector& Location, const TArray<FVector>& ViewLocations) {
+	if (ViewLocations.Num() == 0) {
+		return 0.0;
+	}
+	double MinDistanceSquared = TNumericLimits<double>::Max();
+	for (const FVector& ViewLocation : ViewLocations) {
+		MinDistanceSquared = FMath::Min(MinDistanceSquared, FVector::DistSquared(Location, ViewLocation));
+	}
+	return MinDistanceSquared;
+}
+
+bool UClimbingSignificanceSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UClimbingSignificanceSubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UClimbingSignificanceSubsystem, STATGROUP_Tickables);
+}
+
+void UClimbingSignificanceSubsystem::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+
+	TimeUntilUpdate -= DeltaTime;
+	if (TimeUntilUpdate > 0.f) {
+		return;
+	}
+	TimeUntilUpdate = CVarClimbingLODUpdateInterval.GetValueOnGameThread();
+
+	// 服务器上有多个玩家，按离角色最近的那个算；专用服务器上没有东西被渲染，不看是否在屏幕上
+	GetViewLocations(GetWorld(), ViewLocations);
+	const bool bCheckRendered = GetWorld()->GetNetMode() != NM_DedicatedServer;
+
+	for (int32 Index = Climbers.Num() - 1; Index >= 0; --Index) {
+		AClimbingSystemCharacter* Climber = Climbers[Index].Get();
+		if (!Climber) {
+			Climbers.RemoveAtSwap(Index);
+			continue;
+		}
+		Climber->SetClimbingSignificance(EvaluateSignificance(Climber, ViewLocations, bCheckRendered));
+	}
+}
+
+EClimbingSignificance UClimbingSignificanceSubsystem::EvaluateSignificance(const AClimbingSystemCharacter* Climber, const TArray<FVector>& ViewLocations, bool bCheckRendered) const {
+	// 还没有玩家连进来的时候不知道谁会被看到，不降级
+	if (CVarClimbingLOD.GetValueOnGameThread() == 0 || Climber->IsPlayerControlled() || ViewLocations.Num() == 0) {
+		return EClimbingSignificance::High;
+	}
+
+	const double DistanceSquared = GetMinDistanceSquared(Climber->GetActorLocation(), ViewLocations);
+	const double NearDistance = CVarClimbingLODNearDistance.GetValueOnGameThread();
+	const double FarDistance = CVarClimbingLODFarDistance.GetValueOnGameThread();
+
+	uint8 Significance = DistanceSquared <= FMath::Square(NearDistance) ? 0 : (DistanceSquared <= FMath::Square(FarDistance) ? 1 : 2);
+	if (bCheckRendered && !Climber->WasRecentlyRendered(0.2f)) {
+		Significance = FMath::Min<uint8>(Significance + 1, uint8(EClimbingSignificance::Low));
+	}
+	return EClimbingSignificance(Significance);
+}
@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ClimbingSignificanceSubsystem.generated.h"
+
+class AClimbingSystemCharacter;
+
+/** 攀爬角色的LOD等级，越低的等级Tick和墙面检测越稀疏 */
+UENUM()
+enum class EClimbingSignificance : uint8 {
+	High,		// 玩家控制的角色，或者离玩家视角近并且在屏幕上
+	Medium,
+	Low,
+};
+
+/**
+ * 定期按到最近的玩家视角的距离和是否在屏幕上给所有攀爬角色分LOD等级
+ * 服务器上按所有连进来的玩家的视角算，专用服务器不渲染，不按是否在屏幕上降级
+ * 等级决定角色Tick(Falling时的墙壁检测)的间隔和攀爬时墙面检测的间隔，移动本身仍然每帧积分
+ */
+UCLASS()
+class UClimbingSignificanceSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	void RegisterClimber(AClimbingSystemCharacter* Climber);
+	void UnregisterClimber(AClimbingSystemCharacter* Climber);
+
+	// 每个等级对应的角色Tick间隔和墙面检测间隔
+	static float GetTickInterval(EClimbingSignificance Significance);
+	static float GetProbeInterval(EClimbingSignificance Significance);
+
+	// 所有玩家的视角位置，服务器上包括远端玩家(由客户端同步过来的摄像机位置)，UClimbingProbeScheduler也用它排优先级
+	static void GetViewLocations(const UWorld* World, TArray<FVector>& OutViewLocations);
+
+	// 到最近的视角的距离的平方，没有任何视角时返回0
+	static double GetMinDistanceSquared(const FVector& Location, const TArray<FVector>& ViewLocations);
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	EClimbingSignificance EvaluateSignificance(const AClimbingSystemCharacter* Climber, const TArray<FVector>& ViewLocations, bool bCheckRendered) const;
+
+	TArray<TWeakObjectPtr<AClimbingSystemCharacter>> Climbers;
+	float TimeUntilUpdate = 0.f;
+	TArray<FVector> ViewLocations;
+};
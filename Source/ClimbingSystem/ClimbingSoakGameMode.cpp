@@ -0,0 +1,256 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingSoakGameMode.h"
+#include "Animation/AnimInstance.h"
+#include "ClimbingSystem.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/LatentActionManager.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/OutputDevice.h"
+#include "Misc/Paths.h"
+#include "TimerManager.h"
+#include "UObject/UObjectArray.h"
+
+namespace ClimbingSoak {
+	constexpr float MinJumpDistance = 120.f;
+	constexpr float MaxJumpDistance = 200.f;
+	constexpr float MinJumpHoldTime = 0.05f;
+	constexpr float MaxJumpHoldTime = 0.3f;
+	constexpr float MinClimbActionTime = 0.3f;
+	constexpr float MaxClimbActionTime = 1.5f;
+	constexpr float DropChance = 0.1f;			// 每次换攀爬动作时松手的概率
+	constexpr float LeapChance = 0.2f;			// 每次换攀爬动作时顺着上一个方向跳一下的概率
+}
+
+AClimbingSoakGameMode::AClimbingSoakGameMode() {
+	NumClimbers = 64;
+	DurationHours = 4.f;
+	ReportInterval = 60.f;
+	RandomSeed = 1;
+
+	NumDrops = 0;
+	NumReports = 0;
+	StartTime = 0.0;
+	LastFrameTime = 0.0;
+	NextReportTime = 0.0;
+	StartUsedPhysical = 0;
+	LastUsedPhysical = 0;
+	StartObjectCount = 0;
+	StartTimerCount = 0;
+	LastTimerCount = 0;
+	bFinished = false;
+}
+
+void AClimbingSoakGameMode::ReadCommandLine(const TCHAR* CommandLine) {
+	FParse::Value(CommandLine, TEXT("ClimbingSoakClimbers="), NumClimbers);
+	FParse::Value(CommandLine, TEXT("ClimbingSoakHours="), DurationHours);
+	FParse::Value(CommandLine, TEXT("ClimbingSoakReportInterval="), ReportInterval);
+	FParse::Value(CommandLine, TEXT("ClimbingSoakSeed="), RandomSeed);
+	ReportInterval = FMath::Max(ReportInterval, 1.f);
+	Random.Initialize(RandomSeed);
+}
+
+void AClimbingSoakGameMode::StartPlay() {
+	Super::StartPlay();
+
+	SpawnClimbers();
+
+	StartTime = FPlatformTime::Seconds();
+	LastFrameTime = StartTime;
+	NextReportTime = ReportInterval;
+	StartUsedPhysical = FPlatformMemory::GetStats().UsedPhysical;
+	LastUsedPhysical = StartUsedPhysical;
+	StartObjectCount = GUObjectArray.GetObjectArrayNumMinusAvailable();
+	StartTimerCount = CountTimers();
+	LastTimerCount = StartTimerCount;
+	FrameMs.Reserve(FMath::CeilToInt(ReportInterval * 120.f));
+
+	CsvFilename = FPaths::ProfilingDir() / TEXT("Climbing") / FString::Printf(TEXT("ClimbingSoak-%d-%s.csv"), Climbers.Num(), *FDateTime::Now().ToString());
+	FFileHelper::SaveStringToFile(TEXT("ElapsedHours,Frames,AvgMs,P50Ms,P95Ms,P99Ms,MaxMs,UsedPhysicalMB,GrowthMB,GrowthMBPerHour,UObjects,UObjectGrowth,Laps,Drops,StuckResets,RootMotionSources,MontageInstances,LatentActions,StuckTransitions,Timers,TimerGrowth\n"), *CsvFilename);
+
+	UE_LOG(LogClimbing, Display, TEXT("Climbing soak: %d climbers, %s, report every %.0fs, seed %d, %d timers at start"),
+		Climbers.Num(), DurationHours > 0.f ? *FString::Printf(TEXT("%.1fh"), DurationHours) : TEXT("no time limit"), ReportInterval, RandomSeed, StartTimerCount);
+}
+
+void AClimbingSoakGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+	// 提前结束(比如服务器被手动关掉)时把最后一段不满一个周期的数据也报出来
+	if (!bFinished && FrameMs.Num() > 0) {
+		Report(FPlatformTime::Seconds() - StartTime);
+		bFinished = true;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AClimbingSoakGameMode::Tick(float DeltaSeconds) {
+	Super::Tick(DeltaSeconds);
+
+	if (bFinished) {
+		return;
+	}
+
+	UpdateClimbers(DeltaSeconds);
+
+	// 服务器有Tick频率上限，去掉等待的时间才是这一帧真正花掉的时间
+	const double Now = FPlatformTime::Seconds();
+	FrameMs.Add(float(FMath::Max(Now - LastFrameTime - FApp::GetIdleTime(), 0.0) * 1000.0));
+	LastFrameTime = Now;
+
+	const double Elapsed = Now - StartTime;
+	if (Elapsed >= NextReportTime) {
+		Report(Elapsed);
+		NextReportTime += ReportInterval;
+	}
+
+	if (DurationHours > 0.f && Elapsed >= DurationHours * 3600.0) {
+		if (FrameMs.Num() > 0) {
+			Report(Elapsed);
+		}
+		bFinished = true;
+		UE_LOG(LogClimbing, Display, TEXT("Climbing soak finished after %.2fh, results in '%s'"), Elapsed / 3600.0, *CsvFilename);
+
+		// 最后一次报告时的Timer比开始时多，说明有Timer没清掉
+		const bool bTimersLeaked = LastTimerCount > StartTimerCount;
+		if (bTimersLeaked) {
+			UE_LOG(LogClimbing, Error, TEXT("Climbing soak: timer count grew from %d to %d"), StartTimerCount, LastTimerCount);
+		}
+		if (bQuitWhenFinished) {
+			FPlatformMisc::RequestExitWithStatus(false, bTimersLeaked ? 1 : 0);
+		}
+	}
+}
+
+void AClimbingSoakGameMode::PrepareWalk(FScriptedClimber& Climber) {
+	Climber.JumpDistance = Random.FRandRange(ClimbingSoak::MinJumpDistance, ClimbingSoak::MaxJumpDistance);
+	Climber.JumpHoldTime = Random.FRandRange(ClimbingSoak::MinJumpHoldTime, ClimbingSoak::MaxJumpHoldTime);
+}
+
+void AClimbingSoakGameMode::UpdateWalkInput(FScriptedClimber& Climber) {
+	if (Climber.ActionTime <= 0.f) {
+		Climber.MoveInput = FVector2D(Random.FRandRange(-0.3f, 0.3f), 1.f);
+		Climber.ActionTime = Random.FRandRange(ClimbingSoak::MinClimbActionTime, ClimbingSoak::MaxClimbActionTime);
+	}
+}
+
+void AClimbingSoakGameMode::UpdateClimbInput(FScriptedClimber& Climber) {
+	if (Climber.ActionTime > 0.f) {
+		return;
+	}
+
+	if (Random.FRand() < ClimbingSoak::DropChance) {
+		++NumDrops;
+		Climber.Character->ExitClimbing();
+		SetPhase(Climber, EClimberPhase::Fall);
+		return;
+	}
+
+	// 加速度还是上一个动作的方向，跳不出去(附近没有落点)也没关系
+	if (Random.FRand() < ClimbingSoak::LeapChance) {
+		Climber.Character->ScriptedJump();
+	}
+
+	// 偏向往上爬，保证大部分时候能爬到顶Mantle
+	Climber.MoveInput = FVector2D(Random.FRandRange(-1.f, 1.f), Random.FRandRange(-0.3f, 1.f));
+	Climber.ActionTime = Random.FRandRange(ClimbingSoak::MinClimbActionTime, ClimbingSoak::MaxClimbActionTime);
+}
+
+AClimbingSoakGameMode::FLeakCounts AClimbingSoakGameMode::CountLeaks() const {
+	FLeakCounts Counts;
+	FLatentActionManager& LatentActionManager = GetWorld()->GetLatentActionManager();
+	for (const FScriptedClimber& Climber : Climbers) {
+		AClimbingSystemCharacter* Character = Climber.Character.Get();
+		if (!Character) {
+			continue;
+		}
+
+		// Mantle、Leap和进入攀爬的过渡都是Root Motion Source，过渡结束之后应该一个都不剩
+		const UClimbingMovementComponent* ClimbingMovement = Character->GetClimbingMovement();
+		if (!ClimbingMovement->IsInClimbTransition()) {
+			Counts.RootMotionSources += ClimbingMovement->CurrentRootMotion.RootMotionSources.Num();
+		} else if (!Character->IsClimbing() && Climber.Phase != EClimberPhase::Mantle) {
+			++Counts.StuckTransitions;
+		}
+
+		// 服务器上网格可能不Tick动画，播完的Montage实例不会被回收
+		if (const UAnimInstance* AnimInstance = Character->GetMesh()->GetAnimInstance()) {
+			if (!AnimInstance->IsAnyMontagePlaying()) {
+				Counts.MontageInstances += AnimInstance->MontageInstances.Num();
+			}
+		}
+
+		Counts.LatentActions += LatentActionManager.GetNumActionsForObject(Character);
+	}
+	Counts.Timers = CountTimers();
+	return Counts;
+}
+
+int32 AClimbingSoakGameMode::CountTimers() const {
+	// FTimerManager没有公开Timer的数量，只有ListTimers会把它们输出到日志，从标题行里把Active、Paused和Pending的数量加起来
+	// 每次报告时日志里会带上所有Timer的列表，数量变多时正好拿来查是谁的
+	struct FTimerListCapture : public FOutputDevice {
+		int32 NumTimers = 0;
+
+		virtual void Serialize(const TCHAR* V, ELogVerbosity::Type Verbosity, const FName& Category) override {
+			static const TCHAR* Prefix = TEXT("------- ");
+			const int32 PrefixLength = FCString::Strlen(Prefix);
+			if (FCString::Strncmp(V, Prefix, PrefixLength) == 0 && FCString::Strstr(V, TEXT(" Timers")) && !FCString::Strstr(V, TEXT("Total"))) {
+				NumTimers += FCString::Atoi(V + PrefixLength);
+			}
+		}
+		virtual bool CanBeUsedOnAnyThread() const override { return true; }
+	};
+
+	FTimerListCapture Capture;
+	GLog->AddOutputDevice(&Capture);
+	GetWorldTimerManager().ListTimers();
+	GLog->Flush();
+	GLog->RemoveOutputDevice(&Capture);
+	return Capture.NumTimers;
+}
+
+void AClimbingSoakGameMode::Report(double Elapsed) {
+	++NumReports;
+
+	TArray<float> Sorted = FrameMs;
+	Sorted.Sort();
+	double SumMs = 0.0;
+	for (const float Ms : Sorted) {
+		SumMs += Ms;
+	}
+	const float AvgMs = Sorted.Num() > 0 ? float(SumMs / Sorted.Num()) : 0.f;
+	const float P50 = Percentile(Sorted, 50.f);
+	const float P95 = Percentile(Sorted, 95.f);
+	const float P99 = Percentile(Sorted, 99.f);
+	const float MaxMs = Sorted.Num() > 0 ? Sorted.Last() : 0.f;
+
+	const uint64 UsedPhysical = FPlatformMemory::GetStats().UsedPhysical;
+	const double UsedMB = double(UsedPhysical) / (1024.0 * 1024.0);
+	const double GrowthMB = (double(UsedPhysical) - double(StartUsedPhysical)) / (1024.0 * 1024.0);
+	const double ReportGrowthMB = (double(UsedPhysical) - double(LastUsedPhysical)) / (1024.0 * 1024.0);
+	const double ElapsedHours = Elapsed / 3600.0;
+	const double GrowthPerHour = ElapsedHours > 0.0 ? GrowthMB / ElapsedHours : 0.0;
+	const int32 ObjectCount = GUObjectArray.GetObjectArrayNumMinusAvailable();
+	const FLeakCounts Leaks = CountLeaks();
+
+	UE_LOG(LogClimbing, Display, TEXT("Climbing soak %.2fh: %d frames avg %.2fms p50 %.2fms p95 %.2fms p99 %.2fms max %.2fms | mem %.1fMB (%+.1fMB total, %+.1fMB this report, %+.1fMB/h) | UObjects %d (%+d) | laps %u drops %u resets %u"),
+		ElapsedHours, Sorted.Num(), AvgMs, P50, P95, P99, MaxMs, UsedMB, GrowthMB, ReportGrowthMB, GrowthPerHour, ObjectCount, ObjectCount - StartObjectCount, NumLaps, NumDrops, NumStuckResets);
+	const int32 TimerGrowth = Leaks.Timers - StartTimerCount;
+	if (Leaks.RootMotionSources > 0 || Leaks.MontageInstances > 0 || Leaks.LatentActions > 0 || Leaks.StuckTransitions > 0 || TimerGrowth > 0) {
+		UE_LOG(LogClimbing, Warning, TEXT("Climbing soak %.2fh: leftover root motion sources %d, montage instances %d, latent actions %d, stuck transitions %d, timers %d (%+d)"),
+			ElapsedHours, Leaks.RootMotionSources, Leaks.MontageInstances, Leaks.LatentActions, Leaks.StuckTransitions, Leaks.Timers, TimerGrowth);
+	}
+
+	const FString Row = FString::Printf(TEXT("%.4f,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f,%.1f,%.2f,%d,%d,%u,%u,%u,%d,%d,%d,%d,%d,%d\n"),
+		ElapsedHours, Sorted.Num(), AvgMs, P50, P95, P99, MaxMs, UsedMB, GrowthMB, GrowthPerHour, ObjectCount, ObjectCount - StartObjectCount,
+		NumLaps, NumDrops, NumStuckResets, Leaks.RootMotionSources, Leaks.MontageInstances, Leaks.LatentActions, Leaks.StuckTransitions, Leaks.Timers, TimerGrowth);
+	if (!FFileHelper::SaveStringToFile(Row, *CsvFilename, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append)) {
+		UE_LOG(LogClimbing, Error, TEXT("Failed to append climbing soak results to '%s'"), *CsvFilename);
+	}
+
+	FrameMs.Reset();
+	LastUsedPhysical = UsedPhysical;
+	LastTimerCount = Leaks.Timers;
+}
@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ClimbingScriptedGameMode.h"
+#include "ClimbingSoakGameMode.generated.h"
+
+/**
+ * 长时间的攀爬压力测试，用Server目标在Linux上无头跑:
+ *   ClimbingSystemServer <AnyMap>?game=/Script/ClimbingSystem.ClimbingSoakGameMode -log -unattended
+ *     [-ClimbingSoakClimbers=64 -ClimbingSoakHours=4 -ClimbingSoakReportInterval=60 -ClimbingSoakSeed=1]
+ *
+ * 场地和角色的脚本见AClimbingScriptedGameMode，这里每个角色随机地走、跳、爬、松手、Mantle
+ * 每隔ReportInterval秒输出一次这段时间的帧时间分位数、内存和UObject数量的增长，以及角色身上残留的
+ * Root Motion Source、Montage实例和Latent Action的数量，同时追加到Saved/Profiling/Climbing/下的CSV
+ * 整个World的Timer数量比开始时多的话也算泄漏，结束时还多着就以返回值1退出
+ * 每次只保留一个报告周期的帧数据，跑多久内存都不会因为测试本身而增长
+ */
+UCLASS(config=Game)
+class AClimbingSoakGameMode : public AClimbingScriptedGameMode
+{
+	GENERATED_BODY()
+
+public:
+	AClimbingSoakGameMode();
+
+	virtual void StartPlay() override;
+	virtual void Tick(float DeltaSeconds) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+protected:
+	UPROPERTY(EditAnywhere, Config, Category = Soak, meta = (ClampMin = "0", ForceUnits = "h"))
+	float DurationHours;			// 0表示一直跑下去
+
+	UPROPERTY(EditAnywhere, Config, Category = Soak, meta = (ClampMin = "1", ForceUnits = "s"))
+	float ReportInterval;
+
+	UPROPERTY(EditAnywhere, Config, Category = Soak)
+	int32 RandomSeed;
+
+	virtual void ReadCommandLine(const TCHAR* CommandLine) override;
+
+	// 起跳距离和按住跳跃的时间每次走向墙时重新随机，走路时左右随机晃，攀爬时随机方向爬一段，可能跳一下或者松手掉下去
+	virtual void PrepareWalk(FScriptedClimber& Climber) override;
+	virtual void UpdateWalkInput(FScriptedClimber& Climber) override;
+	virtual void UpdateClimbInput(FScriptedClimber& Climber) override;
+
+private:
+	// 角色身上应该在过渡结束后清掉的东西，不在过渡中却还留着的就是泄漏
+	struct FLeakCounts {
+		int32 RootMotionSources = 0;
+		int32 MontageInstances = 0;
+		int32 LatentActions = 0;
+		int32 StuckTransitions = 0;		// 已经不在攀爬了，ClimbingMovement却还在过渡中
+		int32 Timers = 0;				// 整个World的TimerManager里还在的Timer，不只是角色的
+	};
+
+	FLeakCounts CountLeaks() const;
+	int32 CountTimers() const;
+	void Report(double Elapsed);
+
+	FRandomStream Random;
+
+	// 这个报告周期里每帧的游戏线程时间
+	TArray<float> FrameMs;
+	FString CsvFilename;
+
+	uint32 NumDrops;			// 主动松手的次数
+	uint32 NumReports;
+
+	double StartTime;
+	double LastFrameTime;
+	double NextReportTime;
+	uint64 StartUsedPhysical;
+	uint64 LastUsedPhysical;
+	int32 StartObjectCount;
+	int32 StartTimerCount;
+	int32 LastTimerCount;
+	bool bFinished;
+};
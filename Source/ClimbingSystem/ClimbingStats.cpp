@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingStats.h"
+#include "GameFramework/Actor.h"
+
+DEFINE_STAT(STAT_ClimbingCharacterTick);
+DEFINE_STAT(STAT_ClimbingMove);
+DEFINE_STAT(STAT_ClimbingWallDetection);
+DEFINE_STAT(STAT_ClimbingCheckMantle);
+DEFINE_STAT(STAT_ClimbingDetectShouldExit);
+DEFINE_STAT(STAT_ClimbingMantle);
+DEFINE_STAT(STAT_ClimbingPhysClimbing);
+DEFINE_STAT(STAT_ClimbingCrowdTick);
+DEFINE_STAT(STAT_ClimbingMassProbe);
+DEFINE_STAT(STAT_ClimbingMassMovement);
+DEFINE_STAT(STAT_ClimbingMassMantle);
+DEFINE_STAT(STAT_ClimbingMassPromotion);
+DEFINE_STAT(STAT_ClimbingMassGround);
+DEFINE_STAT(STAT_ClimbingMassRepresentation);
+DEFINE_STAT(STAT_ClimbingLimbIK);
+DEFINE_STAT(STAT_ClimbingNavGraphBuild);
+DEFINE_STAT(STAT_ClimbingNavGraphQuery);
+DEFINE_STAT(STAT_ClimbingLeapQuery);
+
+DEFINE_STAT(STAT_ClimbingLineTraces);
+DEFINE_STAT(STAT_ClimbingPhysicsTraces);
+DEFINE_STAT(STAT_ClimbingAsyncTraces);
+DEFINE_STAT(STAT_ClimbingSurfaceSamples);
+DEFINE_STAT(STAT_ClimbingSurfaceSamplesReused);
+DEFINE_STAT(STAT_ClimbingProbesGranted);
+DEFINE_STAT(STAT_ClimbingProbesDeferred);
+DEFINE_STAT(STAT_ClimbingEntries);
+DEFINE_STAT(STAT_ClimbingExits);
+DEFINE_STAT(STAT_ClimbingMantles);
+DEFINE_STAT(STAT_ClimbingLeaps);
+
+#if CLIMBING_TRACE_ENABLED
+
+UE_TRACE_CHANNEL_DEFINE(ClimbingChannel);
+
+UE_TRACE_EVENT_BEGIN(Climbing, StateTransition)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint32, ActorId)
+	UE_TRACE_EVENT_FIELD(uint8, PreviousMode)
+	UE_TRACE_EVENT_FIELD(uint8, NewMode)
+	UE_TRACE_EVENT_FIELD(UE::Trace::WideString, ActorName)
+UE_TRACE_EVENT_END()
+
+void ClimbingTrace::OutputStateTransition(const AActor* Actor, uint8 PreviousMode, uint8 NewMode) {
+	if (!UE_TRACE_CHANNELEXPR_IS_ENABLED(ClimbingChannel)) {
+		return;
+	}
+
+	const FString ActorName = GetNameSafe(Actor);
+	UE_TRACE_LOG(Climbing, StateTransition, ClimbingChannel)
+		<< StateTransition.Cycle(FPlatformTime::Cycles64())
+		<< StateTransition.ActorId(Actor ? Actor->GetUniqueID() : 0)
+		<< StateTransition.PreviousMode(PreviousMode)
+		<< StateTransition.NewMode(NewMode)
+		<< StateTransition.ActorName(*ActorName, ActorName.Len());
+}
+
+#endif
@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+// 攀爬系统的Stat和Insights Trace，Shipping下全部编译掉
+// stat Climbing 查看，或者用 -trace=default,climbing 录制后在Insights里看
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+
+class AActor;
+
+DECLARE_STATS_GROUP(TEXT("Climbing"), STATGROUP_Climbing, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Character Tick"), STAT_ClimbingCharacterTick, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Move"), STAT_ClimbingMove, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ClimbWallDetection"), STAT_ClimbingWallDetection, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("CheckMantle"), STAT_ClimbingCheckMantle, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("DetectShouldExitClimbing"), STAT_ClimbingDetectShouldExit, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Mantle"), STAT_ClimbingMantle, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("PhysClimbing"), STAT_ClimbingPhysClimbing, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Crowd Tick"), STAT_ClimbingCrowdTick, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Mass Probe"), STAT_ClimbingMassProbe, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Mass Movement"), STAT_ClimbingMassMovement, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Mass Mantle"), STAT_ClimbingMassMantle, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Mass Promotion"), STAT_ClimbingMassPromotion, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Mass Ground"), STAT_ClimbingMassGround, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Mass Representation"), STAT_ClimbingMassRepresentation, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Limb IK"), STAT_ClimbingLimbIK, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Nav Graph Build"), STAT_ClimbingNavGraphBuild, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Nav Graph Query"), STAT_ClimbingNavGraphQuery, STATGROUP_Climbing, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Leap Query"), STAT_ClimbingLeapQuery, STATGROUP_Climbing, );
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Line Traces"), STAT_ClimbingLineTraces, STATGROUP_Climbing, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Line Traces (Physics)"), STAT_ClimbingPhysicsTraces, STATGROUP_Climbing, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Line Traces (Async)"), STAT_ClimbingAsyncTraces, STATGROUP_Climbing, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Surface Samples"), STAT_ClimbingSurfaceSamples, STATGROUP_Climbing, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Surface Samples Reused"), STAT_ClimbingSurfaceSamplesReused, STATGROUP_Climbing, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Probes Granted"), STAT_ClimbingProbesGranted, STATGROUP_Climbing, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Probes Deferred"), STAT_ClimbingProbesDeferred, STATGROUP_Climbing, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Climb Entries"), STAT_ClimbingEntries, STATGROUP_Climbing, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Climb Exits"), STAT_ClimbingExits, STATGROUP_Climbing, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Mantles"), STAT_ClimbingMantles, STATGROUP_Climbing, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Leaps"), STAT_ClimbingLeaps, STATGROUP_Climbing, );
+
+#define CLIMBING_TRACE_ENABLED (UE_TRACE_ENABLED && !UE_BUILD_SHIPPING)
+
+#if CLIMBING_TRACE_ENABLED
+
+UE_TRACE_CHANNEL_EXTERN(ClimbingChannel);
+
+namespace ClimbingTrace {
+	// 输出一次ECharacterMovementMode的切换，只有ClimbingChannel打开时才有开销
+	void OutputStateTransition(const AActor* Actor, uint8 PreviousMode, uint8 NewMode);
+}
+
+#define TRACE_CLIMBING_STATE_TRANSITION(Actor, PreviousMode, NewMode) ClimbingTrace::OutputStateTransition(Actor, PreviousMode, NewMode)
+
+#else
+
+#define TRACE_CLIMBING_STATE_TRANSITION(Actor, PreviousMode, NewMode)
+
+#endif
@@ -0,0 +1,328 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ClimbingSurfaceSampler.h"
+#include "ClimbableSurfaceSubsystem.h"
+#include "ClimbingMathKernels.h"
+#include "ClimbingStats.h"
+#include "ClimbingSystem.h"
+#include "Engine/World.h"
+
+void FClimbSurfaceSampler::Reset() {
+	bHasGrid = false;
+	Cells.Reset();
+	Component.Reset();
+	for (FClimbCornerInfo& Corner : Corners) {
+		Corner = FClimbCornerInfo();
+	}
+}
+
+bool FClimbSurfaceSampler::Update(const UWorld* World, const FVector& Origin, const FVector& Forward, float ProbeLength, float DeltaTime, const FCollisionQueryParams& Params, const FSettings& Settings) {
+	NumNewProbes = 0;
+	NumReusedProbes = 0;
+
+	TArray<int32, TInlineAllocator<25>> ProbeIndices;
+	PrepareCells(Origin, Forward, DeltaTime, Settings, false, ProbeIndices);
+	for (const int32 CellIndex : ProbeIndices) {
+		ProbeCell(Cells[CellIndex], World, Origin, ProbeLength, Params);
+	}
+	return FinishUpdate(Origin, Settings);
+}
+
+void FClimbSurfaceSampler::BeginDeferredUpdate(const FVector& Origin, const FVector& Forward, float ProbeLength, float DeltaTime, const FSettings& Settings, TArray<FProbeRequest>& OutRequests) {
+	NumNewProbes = 0;
+	NumReusedProbes = 0;
+
+	TArray<int32, TInlineAllocator<25>> ProbeIndices;
+	PrepareCells(Origin, Forward, DeltaTime, Settings, true, ProbeIndices);
+	for (const int32 CellIndex : ProbeIndices) {
+		FCell& Cell = Cells[CellIndex];
+		Cell.bInFlight = true;
+		Cell.ProbeId = ++NextProbeId;
+
+		FProbeRequest& Request = OutRequests.AddDefaulted_GetRef();
+		Request.Coord = Cell.Coord;
+		Request.GridVersion = GridVersion;
+		Request.ProbeId = Cell.ProbeId;
+		GetCellProbe(Cell.Coord, Origin, ProbeLength, Request.Start, Request.End);
+
+		// 提交的时候就算检测过了，结果回来之前不会因为太旧再被挑出来
+		Cell.Age = 0.f;
+		++NumNewProbes;
+		INC_DWORD_STAT(STAT_ClimbingSurfaceSamples);
+	}
+}
+
+void FClimbSurfaceSampler::ApplyProbeResult(const FProbeRequest& Request, const FHitResult* Hit) {
+	if (!bHasGrid || Request.GridVersion != GridVersion) {
+		return;
+	}
+	// 角色已经移开了的格子找不到，之后又提交过或者同步检测过的格子已经有更新的结果，这两种结果都丢掉
+	FCell* Cell = Cells.FindByPredicate([&Request](const FCell& Cell) { return Cell.Coord == Request.Coord; });
+	if (Cell && Cell->bInFlight && Cell->ProbeId == Request.ProbeId) {
+		SetCellResult(*Cell, Hit);
+	}
+}
+
+bool FClimbSurfaceSampler::FinishDeferredUpdate(const FVector& Origin, const FSettings& Settings) {
+	return FinishUpdate(Origin, Settings);
+}
+
+void FClimbSurfaceSampler::PrepareCells(const FVector& Origin, const FVector& Forward, float DeltaTime, const FSettings& Settings, bool bDeferred, TArray<int32, TInlineAllocator<25>>& OutProbeIndices) {
+	// 1. 转过墙角之后角色朝向和网格对不上了，网格和缓存的格子都不能用了
+	if (!bHasGrid || GridSpacing != Settings.Spacing || FVector::DotProduct(Forward, -GridNormal) < Settings.RebaseAngleCos) {
+		GridSpacing = FMath::Max(Settings.Spacing, 1.f);
+		RebuildGrid(Origin, -Forward.GetSafeNormal());
+	}
+
+	const FVector Offset = Origin - GridOrigin;
+	CenterCoord = FIntPoint(
+		FMath::RoundToInt32(FVector::DotProduct(Offset, GridRight) / GridSpacing),
+		FMath::RoundToInt32(FVector::DotProduct(Offset, GridUp) / GridSpacing));
+	const int32 Radius = FMath::Max(Settings.Radius, 0);
+
+	// 2. 角色移开之后不在模板里的格子丢掉
+	for (int32 Index = Cells.Num() - 1; Index >= 0; --Index) {
+		FCell& Cell = Cells[Index];
+		Cell.Age += DeltaTime;
+		if (FMath::Abs(Cell.Coord.X - CenterCoord.X) > Radius || FMath::Abs(Cell.Coord.Y - CenterCoord.Y) > Radius) {
+			Cells.RemoveAtSwap(Index, 1, false);
+		}
+	}
+
+	// 3. 新进入模板的格子，以及提交之后结果一直没回来的格子
+	// 还在路上的检测不重复提交，不然同一个格子会有两个结果，晚回来的旧结果会盖掉新的；提交之后Age清零，超过MaxSampleAge还没回来就当作丢了
+	for (int32 Index = 0; Index < Cells.Num(); ++Index) {
+		const FCell& Cell = Cells[Index];
+		const bool bWaiting = Cell.bInFlight && bDeferred && Cell.Age <= Settings.MaxSampleAge;
+		if ((Cell.bPending || Cell.bInFlight) && !bWaiting) {
+			OutProbeIndices.Add(Index);
+		}
+	}
+	for (int32 Y = CenterCoord.Y - Radius; Y <= CenterCoord.Y + Radius; ++Y) {
+		for (int32 X = CenterCoord.X - Radius; X <= CenterCoord.X + Radius; ++X) {
+			const FIntPoint Coord(X, Y);
+			if (!Cells.ContainsByPredicate([&Coord](const FCell& Cell) { return Cell.Coord == Coord; })) {
+				FCell& Cell = Cells.AddDefaulted_GetRef();
+				Cell.Coord = Coord;
+				Cell.Age = 0.f;
+				Cell.bHit = false;
+				Cell.bPending = true;
+				Cell.bInFlight = false;
+				Cell.ProbeId = 0;
+				OutProbeIndices.Add(Cells.Num() - 1);
+			}
+		}
+	}
+
+	// 4. 太旧的格子每次只重新检测最旧的几个，这样一起建出来的格子不会在同一帧一起过期
+	for (int32 Refresh = 0; Refresh < Settings.MaxAgeRefreshes; ++Refresh) {
+		int32 Oldest = INDEX_NONE;
+		for (int32 Index = 0; Index < Cells.Num(); ++Index) {
+			const FCell& Cell = Cells[Index];
+			if (Cell.Age > Settings.MaxSampleAge && !OutProbeIndices.Contains(Index) && (Oldest == INDEX_NONE || Cell.Age > Cells[Oldest].Age)) {
+				Oldest = Index;
+			}
+		}
+		if (Oldest == INDEX_NONE) {
+			break;
+		}
+		OutProbeIndices.Add(Oldest);
+	}
+}
+
+bool FClimbSurfaceSampler::FinishUpdate(const FVector& Origin, const FSettings& Settings) {
+	NumReusedProbes = Cells.Num() - NumNewProbes;
+	INC_DWORD_STAT_BY(STAT_ClimbingSurfaceSamplesReused, NumReusedProbes);
+
+	// 拟合平面，再用拟合结果判断四周的墙角
+	if (!bHasGrid || !FitSurface(Origin, Settings)) {
+		for (FClimbCornerInfo& Corner : Corners) {
+			Corner = FClimbCornerInfo();
+		}
+		return false;
+	}
+	DetectCorners(Settings);
+	return true;
+}
+
+FClimbSurfaceSampler::FGridAnchor FClimbSurfaceSampler::GetGridAnchor() const {
+	FGridAnchor Anchor;
+	if (bHasGrid) {
+		Anchor.Origin = GridOrigin;
+		Anchor.Normal = GridNormal;
+		Anchor.Spacing = GridSpacing;
+	}
+	return Anchor;
+}
+
+void FClimbSurfaceSampler::RestoreGridAnchor(const FGridAnchor& Anchor) {
+	if (Anchor.Spacing <= 0.f) {
+		Reset();
+		return;
+	}
+	if (GetGridAnchor() == Anchor) {
+		return;
+	}
+	GridSpacing = Anchor.Spacing;
+	RebuildGrid(Anchor.Origin, Anchor.Normal);
+}
+
+void FClimbSurfaceSampler::RebuildGrid(const FVector& Origin, const FVector& Normal) {
+	GridNormal = Normal;
+
+	// 和角色用的墙面切线一致，法线接近竖直(趴在天花板上)时切线退化，随便取一个水平方向
+	ClimbingMath::RightTangent(GridNormal.X, GridNormal.Y, GridNormal.Z, GridRight.X, GridRight.Y, GridRight.Z);
+	GridRight = GridRight.GetSafeNormal();
+	if (GridRight.IsZero()) {
+		GridRight = FVector::RightVector;
+	}
+	GridUp = FVector::CrossProduct(GridNormal, GridRight);
+	GridOrigin = Origin;
+	bHasGrid = true;
+	++GridVersion;
+
+	Cells.Reset();
+}
+
+void FClimbSurfaceSampler::GetCellProbe(const FIntPoint& Coord, const FVector& Origin, float ProbeLength, FVector& OutStart, FVector& OutEnd) const {
+	// 检测线从角色当前所在的深度出发，沿网格法线的反方向打到墙上
+	const double Depth = FVector::DotProduct(Origin - GridOrigin, GridNormal);
+	OutStart = GridOrigin + GridRight * (Coord.X * GridSpacing) + GridUp * (Coord.Y * GridSpacing) + GridNormal * Depth;
+	OutEnd = OutStart - GridNormal * ProbeLength;
+}
+
+void FClimbSurfaceSampler::ProbeCell(FCell& Cell, const UWorld* World, const FVector& Origin, float ProbeLength, const FCollisionQueryParams& Params) {
+	FVector Start, End;
+	GetCellProbe(Cell.Coord, Origin, ProbeLength, Start, End);
+
+	FHitResult Hit;
+	const bool bHit = UClimbableSurfaceSubsystem::LineTraceClimbing(World, Hit, Start, End, ECC_Climbable, Params);
+	SetCellResult(Cell, bHit ? &Hit : nullptr);
+	Cell.Age = 0.f;
+
+	++NumNewProbes;
+	INC_DWORD_STAT(STAT_ClimbingSurfaceSamples);
+}
+
+void FClimbSurfaceSampler::SetCellResult(FCell& Cell, const FHitResult* Hit) {
+	Cell.bPending = false;
+	Cell.bInFlight = false;
+	Cell.bHit = Hit != nullptr;
+	if (Hit) {
+		Cell.HitLocation = Hit->ImpactPoint;
+		Cell.HitNormal = Hit->ImpactNormal;
+		Cell.HitComponent = Hit->GetComponent();
+	} else {
+		Cell.HitComponent.Reset();
+	}
+}
+
+bool FClimbSurfaceSampler::FitSurface(const FVector& Origin, const FSettings& Settings) {
+	// 1. 离角色最近的命中格子作为参考，和它法线差不多的格子才是同一面墙
+	const FVector Offset = Origin - GridOrigin;
+	const double OriginU = FVector::DotProduct(Offset, GridRight);
+	const double OriginV = FVector::DotProduct(Offset, GridUp);
+
+	const FCell* Reference = nullptr;
+	double ReferenceDistance = TNumericLimits<double>::Max();
+	for (const FCell& Cell : Cells) {
+		if (!Cell.bHit) {
+			continue;
+		}
+		const double Distance = FMath::Square(Cell.Coord.X * GridSpacing - OriginU) + FMath::Square(Cell.Coord.Y * GridSpacing - OriginV);
+		if (Distance < ReferenceDistance) {
+			Reference = &Cell;
+			ReferenceDistance = Distance;
+		}
+	}
+	if (!Reference) {
+		return false;
+	}
+	Component = Reference->HitComponent;
+
+	TArray<double, TInlineAllocator<25>> U, V, W;
+	FVector NormalSum = FVector::ZeroVector;
+	FVector LocationSum = FVector::ZeroVector;
+	for (const FCell& Cell : Cells) {
+		if (!Cell.bHit || FVector::DotProduct(Cell.HitNormal, Reference->HitNormal) < Settings.CornerAngleCos) {
+			continue;
+		}
+		const FVector HitOffset = Cell.HitLocation - GridOrigin;
+		U.Add(FVector::DotProduct(HitOffset, GridRight));
+		V.Add(FVector::DotProduct(HitOffset, GridUp));
+		W.Add(FVector::DotProduct(HitOffset, GridNormal));
+		NormalSum += Cell.HitNormal;
+		LocationSum += Cell.HitLocation;
+	}
+
+	// 2. 点够的时候拟合平面，拟合结果和参考法线差太多(点几乎在一条线上)时退回到法线平均
+	double A = 0.0, B = 0.0, C = 0.0;
+	if (ClimbingMath::FitPlaneLocal(U.GetData(), V.GetData(), W.GetData(), U.Num(), A, B, C)) {
+		const FVector FittedNormal = (GridRight * -A + GridUp * -B + GridNormal).GetSafeNormal();
+		if (FVector::DotProduct(FittedNormal, Reference->HitNormal) >= Settings.CornerAngleCos) {
+			Normal = FittedNormal;
+			Location = GridOrigin + GridRight * OriginU + GridUp * OriginV + GridNormal * (A * OriginU + B * OriginV + C);
+			return true;
+		}
+	}
+
+	Normal = NormalSum.GetSafeNormal();
+	const FVector Centroid = LocationSum / U.Num();
+	Location = Origin - Normal * FVector::DotProduct(Origin - Centroid, Normal);
+	return true;
+}
+
+void FClimbSurfaceSampler::DetectCorners(const FSettings& Settings) {
+	const int32 Radius = FMath::Max(Settings.Radius, 0);
+
+	for (int32 Side = 0; Side < (int32)EClimbCornerSide::Num; ++Side) {
+		FClimbCornerInfo& Corner = Corners[Side];
+		Corner = FClimbCornerInfo();
+		if (Radius == 0) {
+			continue;
+		}
+
+		// 模板在这一侧最外面的一列或一行
+		int32 NumEdgeCells = 0;
+		int32 NumInner = 0;
+		int32 NumOuter = 0;
+		FVector InnerNormal = FVector::ZeroVector;
+		FVector OuterNormal = FVector::ZeroVector;
+		for (const FCell& Cell : Cells) {
+			bool bOnEdge = false;
+			switch ((EClimbCornerSide)Side) {
+			case EClimbCornerSide::Left:	bOnEdge = Cell.Coord.X == CenterCoord.X - Radius; break;
+			case EClimbCornerSide::Right:	bOnEdge = Cell.Coord.X == CenterCoord.X + Radius; break;
+			case EClimbCornerSide::Up:		bOnEdge = Cell.Coord.Y == CenterCoord.Y + Radius; break;
+			case EClimbCornerSide::Down:	bOnEdge = Cell.Coord.Y == CenterCoord.Y - Radius; break;
+			default: break;
+			}
+			if (!bOnEdge || Cell.bPending) {
+				continue;
+			}
+			++NumEdgeCells;
+
+			// 没打到墙就是墙到头了，打到了但法线不一样的，在平面前面是内角，在后面是外角
+			if (!Cell.bHit) {
+				++NumOuter;
+			} else if (FVector::DotProduct(Cell.HitNormal, Normal) < Settings.CornerAngleCos) {
+				if (FVector::DotProduct(Cell.HitLocation - Location, Normal) > 0.0) {
+					++NumInner;
+					InnerNormal += Cell.HitNormal;
+				} else {
+					++NumOuter;
+					OuterNormal += Cell.HitNormal;
+				}
+			}
+		}
+
+		// 一侧超过一半的格子都是同一种情况才算
+		if (NumInner * 2 > NumEdgeCells) {
+			Corner.Type = EClimbCornerType::Inner;
+			Corner.Normal = InnerNormal.GetSafeNormal();
+		} else if (NumOuter * 2 > NumEdgeCells) {
+			Corner.Type = EClimbCornerType::Outer;
+			Corner.Normal = OuterNormal.GetSafeNormal();
+		}
+	}
+}
@@ -0,0 +1,149 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UPrimitiveComponent;
+class UWorld;
+struct FCollisionQueryParams;
+struct FHitResult;
+
+/** 从角色当前贴着的墙面看，模板边缘的墙面是怎么转折的 */
+enum class EClimbCornerType : uint8 {
+	None,
+	Inner,		// 墙面向角色这边折过来，比如墙角的另一面墙、头顶的悬挑
+	Outer,		// 墙面往远离角色的方向折过去，或者干脆没有墙了，比如墙的外角、顶边
+};
+
+enum class EClimbCornerSide : uint8 {
+	Left,
+	Right,
+	Up,
+	Down,
+	Num,
+};
+
+struct FClimbCornerInfo {
+	EClimbCornerType Type = EClimbCornerType::None;
+	FVector Normal = FVector::ZeroVector;	// 折过去的那面墙的法线，外角上没有检测到墙的时候是零向量
+};
+
+/**
+ * 用一小块网格的检测线代替单根检测线，对命中点做最小二乘平面拟合，得到稳定的墙面法线
+ * 网格固定在墙面上而不是跟着角色走，角色移动时网格里已经检测过的格子继续用，只检测新进入模板的格子和太旧的格子
+ * 和拟合出来的平面不在一个面上的格子拿来判断模板四周的内角和外角
+ * 可以用Update同步检测，也可以用BeginDeferredUpdate/ApplyProbeResult/FinishDeferredUpdate把检测交给调用者批量异步提交
+ */
+class FClimbSurfaceSampler {
+public:
+	struct FSettings {
+		int32 Radius = 1;				// 模板是(2 * Radius + 1)^2个格子
+		float Spacing = 25.f;			// 格子的边长
+		float MaxSampleAge = 0.5f;		// 格子的结果最多用多久
+		int32 MaxAgeRefreshes = 2;		// 每次更新最多因为太旧重新检测几个格子，新进入模板的格子不受限制
+		float CornerAngleCos = 0.866f;	// 法线和拟合平面夹角超过这个角度的格子不参与拟合，算作墙角
+		float RebaseAngleCos = 0.94f;	// 角色朝向和网格的法线偏差超过这个角度时重新建网格
+	};
+
+	/**
+	 * 网格固定在墙面上的位置，只有几个数，存进FSavedMove里，纠正之后回放时从第一次模拟时的网格开始
+	 * 格子的检测线只由网格和格子坐标决定，静态的墙上同一个格子检测几次结果都一样，所以网格对上了就能继续复用格子
+	 */
+	struct FGridAnchor {
+		FVector Origin = FVector::ZeroVector;
+		FVector Normal = FVector::ZeroVector;
+		float Spacing = 0.f;			// 0表示还没有网格
+
+		bool operator==(const FGridAnchor& Other) const { return Spacing == Other.Spacing && Origin == Other.Origin && Normal == Other.Normal; }
+	};
+
+	/** 延迟更新时要调用者去做的一次检测，结果通过ApplyProbeResult交回来 */
+	struct FProbeRequest {
+		FIntPoint Coord;
+		uint32 GridVersion = 0;		// 结果回来之前网格重建过的话，结果直接丢掉
+		uint32 ProbeId = 0;			// 格子之后又提交过新的检测的话，这个旧结果丢掉
+		FVector Start;
+		FVector End;
+	};
+
+	// 进入攀爬、瞬移或者Leap落地之后丢掉所有缓存的格子
+	void Reset();
+
+	FGridAnchor GetGridAnchor() const;
+	// 网格和当前的一样时保留缓存的格子，不一样时换成这个网格，格子在下一次Update里重新检测
+	void RestoreGridAnchor(const FGridAnchor& Anchor);
+
+	/**
+	 * 检测并拟合角色面前的墙面
+	 * @param Origin 角色中心
+	 * @param Forward 角色朝向，检测线沿着网格法线的反方向，刚建网格时和它一致
+	 * @return 拟合出墙面时返回true，结果用GetLocation/GetNormal取
+	 */
+	bool Update(const UWorld* World, const FVector& Origin, const FVector& Forward, float ProbeLength, float DeltaTime, const FCollisionQueryParams& Params, const FSettings& Settings);
+
+	/**
+	 * 和Update一样整理网格，但是不做检测，需要检测的格子追加到OutRequests里
+	 * 等结果的格子保留旧的结果，新进入模板的格子在结果回来之前不参与拟合和墙角判断
+	 * 已经提交、结果还没回来的格子不会重复提交，超过MaxSampleAge还没回来的当作丢了重新提交
+	 */
+	void BeginDeferredUpdate(const FVector& Origin, const FVector& Forward, float ProbeLength, float DeltaTime, const FSettings& Settings, TArray<FProbeRequest>& OutRequests);
+	// Hit为空表示没打到
+	void ApplyProbeResult(const FProbeRequest& Request, const FHitResult* Hit);
+	// 用格子现在的结果拟合，返回值和Update一样
+	bool FinishDeferredUpdate(const FVector& Origin, const FSettings& Settings);
+
+	const FVector& GetLocation() const { return Location; }		// 角色中心投影到拟合平面上的点
+	const FVector& GetNormal() const { return Normal; }
+	const UPrimitiveComponent* GetComponent() const { return Component.Get(); }	// 离角色最近的命中格子打到的组件
+	const FClimbCornerInfo& GetCorner(EClimbCornerSide Side) const { return Corners[(int32)Side]; }
+
+	// 最近一次更新新发出和复用的检测数量
+	int32 GetNumNewProbes() const { return NumNewProbes; }
+	int32 GetNumReusedProbes() const { return NumReusedProbes; }
+
+private:
+	struct FCell {
+		FIntPoint Coord;
+		float Age;
+		bool bHit;
+		bool bPending;			// 延迟更新时新进入模板、还没有结果的格子
+		bool bInFlight;			// 提交了延迟检测，结果还没回来
+		uint32 ProbeId;			// 最近一次提交的检测，只接受这一次的结果
+		FVector HitLocation;
+		FVector HitNormal;
+		TWeakObjectPtr<const UPrimitiveComponent> HitComponent;
+	};
+
+	void RebuildGrid(const FVector& Origin, const FVector& Normal);
+	// 整理模板里的格子，OutProbeIndices是这一次需要检测的格子
+	// bDeferred为false时同步检测，还在等延迟检测结果的格子也直接重新检测
+	void PrepareCells(const FVector& Origin, const FVector& Forward, float DeltaTime, const FSettings& Settings, bool bDeferred, TArray<int32, TInlineAllocator<25>>& OutProbeIndices);
+	void GetCellProbe(const FIntPoint& Coord, const FVector& Origin, float ProbeLength, FVector& OutStart, FVector& OutEnd) const;
+	void ProbeCell(FCell& Cell, const UWorld* World, const FVector& Origin, float ProbeLength, const FCollisionQueryParams& Params);
+	void SetCellResult(FCell& Cell, const FHitResult* Hit);
+	bool FinishUpdate(const FVector& Origin, const FSettings& Settings);
+	bool FitSurface(const FVector& Origin, const FSettings& Settings);
+	void DetectCorners(const FSettings& Settings);
+
+	// 网格固定在墙面上，格子的坐标是沿GridRight/GridUp的整数倍Spacing
+	FVector GridOrigin = FVector::ZeroVector;
+	FVector GridRight = FVector::ZeroVector;
+	FVector GridUp = FVector::ZeroVector;
+	FVector GridNormal = FVector::ZeroVector;
+	float GridSpacing = 0.f;
+	bool bHasGrid = false;
+	uint32 GridVersion = 0;
+	uint32 NextProbeId = 0;
+	FIntPoint CenterCoord = FIntPoint::ZeroValue;
+
+	TArray<FCell, TInlineAllocator<25>> Cells;
+
+	FVector Location = FVector::ZeroVector;
+	FVector Normal = FVector::ZeroVector;
+	TWeakObjectPtr<const UPrimitiveComponent> Component;
+	FClimbCornerInfo Corners[(int32)EClimbCornerSide::Num];
+
+	int32 NumNewProbes = 0;
+	int32 NumReusedProbes = 0;
+};
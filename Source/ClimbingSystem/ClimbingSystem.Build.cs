@@ -8,6 +8,12 @@ public class ClimbingSystem : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "EnhancedInput" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "EnhancedInput", "Json", "MassEntity", "MassCommon", "MassSpawner", "NavigationSystem", "AIModule", "NetCore" });
+
+		if (Target.bBuildEditor)
+		{
+			// Tests/ClimbingNetworkTest.cpp 要开监听服务器+客户端的PIE
+			PrivateDependencyModuleNames.Add("UnrealEd");
+		}
 	}
 }
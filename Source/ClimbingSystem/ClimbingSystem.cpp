@@ -3,5 +3,6 @@
 #include "ClimbingSystem.h"
 #include "Modules/ModuleManager.h"
 
+DEFINE_LOG_CATEGORY(LogClimbing);
+
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, ClimbingSystem, "ClimbingSystem" );
- 
\ No newline at end of file
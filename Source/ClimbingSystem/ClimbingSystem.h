@@ -3,3 +3,10 @@
 #pragma once
 
 #include "CoreMinimal.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogClimbing, Log, All);
+
+// 攀爬检测专用的Trace通道，在DefaultEngine.ini里叫Climbable
+// BlockAll这类静态几何体默认挡它(关卡里现有的墙不用改资源就能爬)，Pawn、物理物体和动态物体的预设都忽略它
+// 新的墙用ClimbableWall预设或者攀爬代理(UClimbableSurfaceComponent)，等关卡内容都迁移过去之后再把默认改成Ignore
+#define ECC_Climbable ECC_GameTraceChannel1
@@ -2,6 +2,8 @@
 
 #include "ClimbingSystemCharacter.h"
 #include "Engine/LocalPlayer.h"
+#include "Animation/AnimInstance.h"
+#include "Animation/AnimMontage.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
@@ -13,13 +15,36 @@
 #include "DrawDebugHelpers.h"
 #include "KismetTraceUtils.h"
 #include "Components/ArrowComponent.h"
+#include "ClimbingMovementComponent.h"
+#include "Net/UnrealNetwork.h"
+#include "ClimbableSurfaceSubsystem.h"
+#include "ClimbingLedgeGraph.h"
+#include "ClimbingLedgeSubsystem.h"
+#include "ClimbingLimbIKComponent.h"
+#include "ClimbingCrowdSubsystem.h"
+#include "ClimbingDebugSubsystem.h"
+#include "ClimbingMathKernels.h"
+#include "ClimbingMontagePreloadSubsystem.h"
+#include "ClimbingProbeScheduler.h"
+#include "ClimbingSignificanceSubsystem.h"
+#include "ClimbingStats.h"
+#include "ClimbingSystem.h"
 
 DEFINE_LOG_CATEGORY(LogTemplateCharacter);
 
+static TAutoConsoleVariable<int32> CVarClimbingAsyncWallDetection(
+	TEXT("Climbing.AsyncWallDetection"),
+	0,
+	TEXT("Falling状态下的墙壁检测方式\n")
+	TEXT("0: 同步LineTrace (默认)\n")
+	TEXT("1: 异步LineTrace，使用上一帧提交的检测结果"),
+	ECVF_Default);
+
 //////////////////////////////////////////////////////////////////////////
 // AClimbingSystemCharacter
 
-AClimbingSystemCharacter::AClimbingSystemCharacter()
+AClimbingSystemCharacter::AClimbingSystemCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UClimbingMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(42.f, 96.0f);
@@ -41,6 +66,7 @@ AClimbingSystemCharacter::AClimbingSystemCharacter()
 	GetCharacterMovement()->MinAnalogWalkSpeed = 20.f;
 	GetCharacterMovement()->BrakingDecelerationWalking = 2000.f;
 	GetCharacterMovement()->BrakingDecelerationFalling = 1500.0f;
+	ClimbingMovement = Cast<UClimbingMovementComponent>(GetCharacterMovement());
 
 	// Create a camera boom (pulls in towards the player if there is a collision)
 	CameraBoom = CreateDefaultSubobject<USpringArmComponent>(TEXT("CameraBoom"));
@@ -61,11 +87,28 @@ AClimbingSystemCharacter::AClimbingSystemCharacter()
 
 	DetectionArrowPelvis = CreateDefaultSubobject<UArrowComponent>(TEXT("DetectionArrowPelvis"));
 	DetectionArrowPelvis->SetupAttachment(GetMesh());
+
+	LimbIK = CreateDefaultSubobject<UClimbingLimbIKComponent>(TEXT("LimbIK"));
 	
 	WallDetectionLength = 75.f;
 	WallDistanceOffset = 3.f;
 	WallDistance = GetCapsuleComponent()->GetScaledCapsuleRadius();
 	ExitClimbingDetection = GetCapsuleComponent()->GetScaledCapsuleHalfHeight() + 50.f;
+
+	// Tick只在Falling时做墙壁检测，由OnMovementModeChanged打开和关闭
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+	ClimbingSignificance = EClimbingSignificance::High;
+
+	WallDetectionSubmitFrame = 0;
+	LastWallDetectionFrame = 0;
+	bLastWallDetected = false;
+	bWallDetectionStale = false;
+	bPelvisTraceDone = false;
+	bHeadTraceDone = false;
+	bManagedByClimbingCrowd = false;
+	bLeapRequested = false;
+	bRecordingInput = false;
 }
 
 void AClimbingSystemCharacter::BeginPlay()
@@ -73,6 +116,24 @@ void AClimbingSystemCharacter::BeginPlay()
 	// Call the base class  
 	Super::BeginPlay();
 
+	WallDetectionTraceDelegate.BindUObject(this, &AClimbingSystemCharacter::OnWallDetectionTraceDone);
+
+	// 服务器也要模拟攀爬，所以在这里而不是进入攀爬时设置
+	ClimbingMovement->ClimbWallDistance = WallDistance + WallDistanceOffset;
+	ClimbingMovement->ClimbProbeLength = WallDistance + 50.f;
+
+	if (UClimbingMontagePreloadSubsystem* PreloadSubsystem = GetWorld()->GetSubsystem<UClimbingMontagePreloadSubsystem>()) {
+		PreloadSubsystem->PreloadMontages(this);
+	}
+	ClimbingMovement->OnClimbTransitionFinished.AddUObject(this, &AClimbingSystemCharacter::OnClimbTransitionFinished);
+
+	if (UClimbingCrowdSubsystem* CrowdSubsystem = GetWorld()->GetSubsystem<UClimbingCrowdSubsystem>()) {
+		CrowdSubsystem->RegisterClimber(this);
+	}
+	if (UClimbingSignificanceSubsystem* SignificanceSubsystem = GetWorld()->GetSubsystem<UClimbingSignificanceSubsystem>()) {
+		SignificanceSubsystem->RegisterClimber(this);
+	}
+
 	//Add Input Mapping Context
 	if (APlayerController* PlayerController = Cast<APlayerController>(Controller))
 	{
@@ -83,16 +144,120 @@ void AClimbingSystemCharacter::BeginPlay()
 	}
 }
 
+void AClimbingSystemCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+	if (UClimbingCrowdSubsystem* CrowdSubsystem = GetWorld()->GetSubsystem<UClimbingCrowdSubsystem>()) {
+		CrowdSubsystem->UnregisterClimber(this);
+	}
+	if (UClimbingSignificanceSubsystem* SignificanceSubsystem = GetWorld()->GetSubsystem<UClimbingSignificanceSubsystem>()) {
+		SignificanceSubsystem->UnregisterClimber(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
 void AClimbingSystemCharacter::Tick(float DeltaSeconds) {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingCharacterTick);
 	Super::Tick(DeltaSeconds);
 
-	if(GetCharacterMovement()->IsFalling()) {
-		if(FHitResult PelvisHitResult, HeadHitResult; ClimbWallDetection(PelvisHitResult, HeadHitResult)) {
-			EnterClimbingWithoutMontage(PelvisHitResult);
+	// 只有控制这个角色的一端做墙壁检测，服务器通过移动里的bWantsToClimb得知进入了攀爬
+	if(GetCharacterMovement()->IsFalling() && IsLocallyControlled()) {
+		FHitResult PelvisHitResult, HeadHitResult;
+		bool bWallDetected = false;
+		UClimbingProbeScheduler* ProbeScheduler = GetWorld()->GetSubsystem<UClimbingProbeScheduler>();
+		if(CVarClimbingAsyncWallDetection.GetValueOnGameThread() != 0) {
+			// 取回上一次提交的结果不发出检测，不占预算；检测还没回来的帧什么都不做，也不向调度器申请
+			bool bResolved = false;
+			if(HasPendingWallDetection()) {
+				bResolved = ResolveAsyncWallDetection(PelvisHitResult, HeadHitResult, bWallDetected);
+				if(bResolved) {
+					CacheWallDetection(bWallDetected, PelvisHitResult, HeadHitResult);
+				}
+			}
+			if(!HasPendingWallDetection()) {
+				if(!ProbeScheduler || ProbeScheduler->TryAcquireProbe(this, 2)) {
+					SubmitAsyncWallDetection();
+				} else if(!bResolved) {
+					// 本帧的预算不够，这一帧也没有新回来的结果，沿用上一次的检测结果
+					bWallDetected = ReuseWallDetection(PelvisHitResult, HeadHitResult);
+				}
+			}
+		} else if(!ProbeScheduler || ProbeScheduler->TryAcquireProbe(this, 2)) {
+			bWallDetected = ClimbWallDetection(PelvisHitResult, HeadHitResult);
+			CacheWallDetection(bWallDetected, PelvisHitResult, HeadHitResult);
+		} else {
+			// 本帧的预算不够，沿用上一次的检测结果
+			bWallDetected = ReuseWallDetection(PelvisHitResult, HeadHitResult);
+		}
+		if(bWallDetected) {
+			EnterClimbingWithoutMontage(&PelvisHitResult);
 		}
 	}
 }
 
+void AClimbingSystemCharacter::OnMovementModeChanged(EMovementMode PrevMovementMode, uint8 PreviousCustomMode) {
+	Super::OnMovementModeChanged(PrevMovementMode, PreviousCustomMode);
+
+	// 进出攀爬的表现在这里处理，本地、服务器和模拟端都会走到这里
+	if(ClimbingMovement->IsClimbing()) {
+		GetCharacterMovement()->bOrientRotationToMovement = false;
+		SetCharacterMovementMode(Climbing);
+	} else if(PrevMovementMode == MOVE_Custom && PreviousCustomMode == CMOVE_Climbing) {
+		bLeapRequested = false;
+		GetCharacterMovement()->bOrientRotationToMovement = true;
+		// 调整Actor的Rotation使其垂直于XY平面(地面)
+		const FRotator CurrentRotation = GetActorRotation();
+		SetActorRotation(FRotator(CurrentRotation.Pitch, CurrentRotation.Yaw, 0));
+		SetCharacterMovementMode(Walking);
+	}
+
+	// 只有Falling的时候才需要每帧检测墙壁，其他状态下整个Tick都关掉
+	const bool bFalling = GetCharacterMovement()->IsFalling();
+	SetActorTickEnabled(bFalling);
+	if(!bFalling) {
+		// 离开Falling之后还没回来的异步结果已经没有意义了
+		ResetAsyncWallDetection();
+	}
+}
+
+void AClimbingSystemCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const {
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	// 控制端和服务器自己模拟，只需要发给模拟端
+	DOREPLIFETIME_CONDITION(AClimbingSystemCharacter, ClimbingNetState, COND_SimulatedOnly);
+}
+
+void AClimbingSystemCharacter::UpdateClimbingNetState() {
+	if(!HasAuthority()) {
+		return;
+	}
+
+	FClimbingNetState NewState;
+	NewState.Mode = uint8(CharacterMovementMode.GetValue());
+	if(CharacterMovementMode == Climbing && ClimbingMovement->HasClimbSurface()) {
+		NewState.SetNormal(ClimbingMovement->GetClimbSurfaceNormal());
+	}
+	if(!(NewState == ClimbingNetState)) {
+		ClimbingNetState = NewState;
+	}
+}
+
+void AClimbingSystemCharacter::OnRep_ClimbingNetState() {
+	SetCharacterMovementMode(ECharacterMovementMode(ClimbingNetState.Mode));
+	if(ClimbingNetState.Mode == Climbing) {
+		ClimbingMovement->SetReplicatedClimbSurface(ClimbingNetState.GetNormal());
+	}
+}
+
+void AClimbingSystemCharacter::SetClimbingSignificance(EClimbingSignificance NewSignificance) {
+	if(ClimbingSignificance == NewSignificance) {
+		return;
+	}
+
+	ClimbingSignificance = NewSignificance;
+	SetActorTickInterval(UClimbingSignificanceSubsystem::GetTickInterval(NewSignificance));
+	ClimbingMovement->ClimbSurfaceProbeInterval = UClimbingSignificanceSubsystem::GetProbeInterval(NewSignificance);
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Input
 
@@ -119,9 +284,13 @@ void AClimbingSystemCharacter::SetupPlayerInputComponent(UInputComponent* Player
 
 void AClimbingSystemCharacter::Move(const FInputActionValue& Value)
 {
+    SCOPE_CYCLE_COUNTER(STAT_ClimbingMove);
+
     // input is a Vector2D
     FVector2D MovementVector = Value.Get<FVector2D>();
-    GEngine->AddOnScreenDebugMessage(-1, 0.f, FColor::Red, MovementVector.ToString());
+    if (bRecordingInput) {
+        RecordedInput.Move = MovementVector;
+    }
 
     if (CharacterMovementMode == Walking || CharacterMovementMode == Jumping) {
         if (Controller != nullptr) {
@@ -140,50 +309,84 @@ void AClimbingSystemCharacter::Move(const FInputActionValue& Value)
             AddMovementInput(RightDirection, MovementVector.X);
         }
     } else if (CharacterMovementMode == Climbing) {
-        // 1. 爬墙的上下左右
-        FHitResult HitResult;
-        FCollisionQueryParams Params;
-        Params.AddIgnoredActor(this);
-
-        // 使用线追踪获取墙面法线
-        if (GetWorld()->LineTraceSingleByChannel(HitResult, GetActorLocation(), GetActorLocation() + GetActorForwardVector() * (WallDistance + 50.f), ECC_Visibility, Params)) {
-            FVector WallNormal = HitResult.ImpactNormal;
-            FVector RightDirection = GetRightVectorOfCurrentVector(WallNormal);
-            FVector UpDirection = GetUpVectorOfCurrentVector(WallNormal);
-        	
-            AddMovementInput(-RightDirection, MovementVector.X);
-        	AddMovementInput(UpDirection, MovementVector.Y);
-
-            // 调整角色位置和旋转，使其保持靠近墙面
-			FVector TargetLocation = HitResult.ImpactPoint + WallNormal * (WallDistance + WallDistanceOffset);
-			SetActorLocation(FMath::VInterpTo(GetActorLocation(), TargetLocation, GetWorld()->GetDeltaSeconds(), 5.f));
-        	const FRotator DesiredRotation = FRotationMatrix::MakeFromX(-HitResult.Normal).Rotator();
-        	SetActorRotation(FMath::RInterpTo(GetActorRotation(), DesiredRotation, GetWorld()->GetDeltaSeconds(), 5.f));
+        // Enter、Mantle和Leap的过渡动作中不接受输入
+        if (ClimbingMovement->IsInClimbTransition()) {
+            return;
         }
 
-    	// 2. 进行站立检测
-    	if(DetectShouldExitClimbing()) {
-    		return;
-    	}
-
-    	// 3. 向上爬的时候检测现在是否已经能爬上去了
-    	if (MovementVector.Y > 0) {
-    		// 检查是否能站到顶上
-    		FVector MantleTargetLocation;
-    		if (CheckMantle(MantleTargetLocation)) {
-    			// 爬到顶上能站的地方
-    			GEngine->AddOnScreenDebugMessage(-1, 0.f, FColor::Red, "Can Mantle!");
-    			Mantle(MantleTargetLocation);
-    			return;
-		    }
-    	}
+        // 爬墙的上下左右，这里只记录输入，贴墙和转向由ClimbingMovement在PhysClimbing里每个Tick处理一次
+        // 退出和Mantle的检测也不在这里做，由ClimbingMovement每个Tick在移动之前调用UpdateClimbingChecks
+        if (ClimbingMovement->HasClimbSurface()) {
+            AddMovementInput(-ClimbingMovement->GetClimbSurfaceRight(), MovementVector.X);
+            AddMovementInput(ClimbingMovement->GetClimbSurfaceUp(), MovementVector.Y);
+        }
     }
 }
 
+void AClimbingSystemCharacter::UpdateClimbingChecks(const FVector& PendingInput) {
+	const bool bWantsToLeap = bLeapRequested;
+	bLeapRequested = false;
+
+	// 1. 进行站立检测，交给UClimbingCrowdSubsystem管理的时候由它在帧末统一检测
+	if (!bManagedByClimbingCrowd && DetectShouldExitClimbing()) {
+		return;
+	}
+
+	// 2. 向上爬的时候检测现在是否已经能爬上去了
+	if (ClimbingMovement->HasClimbSurface() && FVector::DotProduct(PendingInput, ClimbingMovement->GetClimbSurfaceUp()) > 0.f) {
+		// 检查是否能站到顶上
+		FVector MantleTargetLocation;
+		if (CheckMantle(MantleTargetLocation)) {
+			// 爬到顶上能站的地方
+			CLIMBING_DEBUG_MANTLE_TARGET(GetWorld(), MantleTargetLocation);
+			Mantle(MantleTargetLocation);
+		}
+	}
+
+	// 3. 按跳跃键请求的Leap，方向和这一帧发给服务器的加速度是同一个值，两边选出的落点一致
+	if (bWantsToLeap && !ClimbingMovement->IsInClimbTransition()) {
+		Leap(ClimbingMovement->GetInputAcceleration(PendingInput));
+	}
+}
+
+void AClimbingSystemCharacter::AddScriptedMoveInput(const FVector2D& MovementVector) {
+	Move(FInputActionValue(MovementVector));
+}
+
+void AClimbingSystemCharacter::SetInputRecording(bool bEnabled) {
+	bRecordingInput = bEnabled;
+	RecordedInput = FClimbingInputFrame();
+}
+
+FClimbingInputFrame AClimbingSystemCharacter::ConsumeRecordedInput() {
+	const FClimbingInputFrame Input = RecordedInput;
+	RecordedInput = FClimbingInputFrame();
+	return Input;
+}
+
+void AClimbingSystemCharacter::ReplayInput(const FClimbingInputFrame& Input) {
+	// 和EnhancedInput一样，按下在Move之前，松开在Move之后；Move只在有输入的Tick触发(Triggered)
+	if (Input.bJumpPressed) {
+		CharacterJump();
+	}
+	if (!Input.Move.IsZero()) {
+		Move(FInputActionValue(Input.Move));
+	}
+	if (!Input.Look.IsZero()) {
+		Look(FInputActionValue(Input.Look));
+	}
+	if (Input.bJumpReleased) {
+		CharacterStopJump();
+	}
+}
+
 void AClimbingSystemCharacter::Look(const FInputActionValue& Value)
 {
 	// input is a Vector2D
 	FVector2D LookAxisVector = Value.Get<FVector2D>();
+	if (bRecordingInput) {
+		RecordedInput.Look += LookAxisVector;
+	}
 
 	if (Controller != nullptr)
 	{
@@ -194,66 +397,197 @@ void AClimbingSystemCharacter::Look(const FInputActionValue& Value)
 }
 
 void AClimbingSystemCharacter::CharacterJump() {
+	if (bRecordingInput) {
+		RecordedInput.bJumpPressed = true;
+	}
+
 	// 判断当前的状态
 	if (CharacterMovementMode == ECharacterMovementMode::Walking) {
-		// 1. 判断前面是不是墙
+		// 1. 判断前面是不是墙，和Falling时的检测一样要向调度器申请预算，没拿到就沿用上一次的结果
 		FHitResult PelvisHitResult, HeadHitResult;
-		if (ClimbWallDetection(PelvisHitResult, HeadHitResult)) {
+		bool bWallDetected = false;
+		UClimbingProbeScheduler* ProbeScheduler = GetWorld()->GetSubsystem<UClimbingProbeScheduler>();
+		if (!ProbeScheduler || ProbeScheduler->TryAcquireProbe(this, 2)) {
+			bWallDetected = ClimbWallDetection(PelvisHitResult, HeadHitResult);
+			CacheWallDetection(bWallDetected, PelvisHitResult, HeadHitResult);
+		} else {
+			bWallDetected = ReuseWallDetection(PelvisHitResult, HeadHitResult);
+		}
+		if (bWallDetected) {
 			// 2. 如果是墙，则进入攀爬状态
-			EnterClimbing(HeadHitResult);
+			EnterClimbing(PelvisHitResult);
 			return;
 		}
 
 		// 3. 如果不是墙，则执行跳跃
 		this->Jump();
-		this->CharacterMovementMode = Jumping;
+		SetCharacterMovementMode(Jumping);
 	} else if (CharacterMovementMode == Climbing) {
-		// 在攀爬状态下处理进一步的跳跃逻辑
-		// 1. 检测通过这次跳跃是否到达了顶端
-		// 2. 如果不是，往上跳一大格
-		// 3. 如果是，则MoveComponent到具体的位置，然后播放到达顶端的动画
-		// 这里你需要实现具体的逻辑来判断是否到达顶端并执行相应的动作
+		// Enter、Mantle和Leap的过渡中按跳跃什么都不做，也就不用花Ledge图和Climbable通道的检测
+		if (ClimbingMovement->IsInClimbTransition()) {
+			return;
+		}
+
+		// 1. 顶端已经在够得着的范围内，直接Mantle
+		FVector MantleTargetLocation;
+		if (CheckMantle(MantleTargetLocation)) {
+			CLIMBING_DEBUG_MANTLE_TARGET(GetWorld(), MantleTargetLocation);
+			Mantle(MantleTargetLocation);
+			return;
+		}
+
+		// 2. 否则跳到下一个抓点，落下之后在OnClimbTransitionFinished里再看一次能不能Mantle
+		//    方向要等这一帧的输入收齐，在ClimbingMovement生成FSavedMove之前由UpdateClimbingChecks发起
+		bLeapRequested = true;
 	}
 }
 
 void AClimbingSystemCharacter::CharacterStopJump() {
+	if (bRecordingInput) {
+		RecordedInput.bJumpReleased = true;
+	}
+
 	if(CharacterMovementMode == Jumping) {
 		this->StopJumping();
-		this->CharacterMovementMode = Walking;
+		SetCharacterMovementMode(Walking);
 	}
 }
 
+void AClimbingSystemCharacter::SetCharacterMovementMode(ECharacterMovementMode NewMode) {
+	const ECharacterMovementMode PreviousMode = CharacterMovementMode;
+	if (PreviousMode == NewMode) {
+		return;
+	}
+
+	CharacterMovementMode = NewMode;
+	UpdateClimbingNetState();
+
+	if (NewMode == Climbing) {
+		INC_DWORD_STAT(STAT_ClimbingEntries);
+	} else if (PreviousMode == Climbing) {
+		INC_DWORD_STAT(STAT_ClimbingExits);
+	}
+	TRACE_CLIMBING_STATE_TRANSITION(this, PreviousMode, NewMode);
+
+	OnCharacterMovementModeChanged.Broadcast(this, PreviousMode, NewMode);
+}
+
 bool AClimbingSystemCharacter::ClimbWallDetection(FHitResult& PelvisHitResult, FHitResult& HeadHitResult) const {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingWallDetection);
+
 	FVector PelvisStart = DetectionArrowPelvis->GetComponentLocation();
 	FVector PelvisEnd = DetectionArrowPelvis->GetForwardVector() * WallDetectionLength + PelvisStart;
 	FCollisionQueryParams Params;
 	Params.AddIgnoredActor(this);
-	bool Result = GetWorld()->LineTraceSingleByChannel(PelvisHitResult, PelvisStart, PelvisEnd, ECC_Visibility, Params);
+	bool Result = UClimbableSurfaceSubsystem::LineTraceClimbing(GetWorld(), PelvisHitResult, PelvisStart, PelvisEnd, ECC_Climbable, Params);
 	if(!Result) { return false; }
 	
 	FVector HeadStart = DetectionArrowHead->GetComponentLocation();
 	FVector HeadEnd = DetectionArrowHead->GetForwardVector() * WallDetectionLength + HeadStart;
-	Result = GetWorld()->LineTraceSingleByChannel(HeadHitResult, HeadStart, HeadEnd, ECC_Visibility, Params);
+	Result = UClimbableSurfaceSubsystem::LineTraceClimbing(GetWorld(), HeadHitResult, HeadStart, HeadEnd, ECC_Climbable, Params);
 	if(!Result) { return false; }
 	
 	return true;
 }
 
+bool AClimbingSystemCharacter::ResolveAsyncWallDetection(FHitResult& PelvisHitResult, FHitResult& HeadHitResult, bool& bOutWallDetected) {
+	// 还有没回来的检测，不重复提交
+	if(!bPelvisTraceDone || !bHeadTraceDone) {
+		return false;
+	}
+
+	bOutWallDetected = AsyncPelvisHitResult.bBlockingHit && AsyncHeadHitResult.bBlockingHit;
+	if(bOutWallDetected) {
+		PelvisHitResult = AsyncPelvisHitResult;
+		HeadHitResult = AsyncHeadHitResult;
+	}
+	UE_LOG(LogTemplateCharacter, Verbose, TEXT("'%s' async wall detection latency: %llu frame(s)"), *GetNameSafe(this), GFrameCounter - WallDetectionSubmitFrame);
+	ResetAsyncWallDetection();
+	return true;
+}
+
+void AClimbingSystemCharacter::SubmitAsyncWallDetection() {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingWallDetection);
+
+	// 两条检测线在同一帧一起提交，引擎会把它们和其他异步检测放在同一批里处理
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(AsyncClimbWallDetection), false, this);
+
+	const FVector PelvisStart = DetectionArrowPelvis->GetComponentLocation();
+	const FVector PelvisEnd = DetectionArrowPelvis->GetForwardVector() * WallDetectionLength + PelvisStart;
+	PelvisTraceHandle = GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, PelvisStart, PelvisEnd, ECC_Climbable, Params, FCollisionResponseParams::DefaultResponseParam, &WallDetectionTraceDelegate);
+
+	const FVector HeadStart = DetectionArrowHead->GetComponentLocation();
+	const FVector HeadEnd = DetectionArrowHead->GetForwardVector() * WallDetectionLength + HeadStart;
+	HeadTraceHandle = GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, HeadStart, HeadEnd, ECC_Climbable, Params, FCollisionResponseParams::DefaultResponseParam, &WallDetectionTraceDelegate);
+
+	UClimbableSurfaceSubsystem::CountAsyncTraces(GetWorld(), 2);
+	WallDetectionSubmitFrame = GFrameCounter;
+}
+
+void AClimbingSystemCharacter::OnWallDetectionTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum) {
+	FHitResult* Target = nullptr;
+	if(TraceHandle == PelvisTraceHandle) {
+		Target = &AsyncPelvisHitResult;
+		bPelvisTraceDone = true;
+	} else if(TraceHandle == HeadTraceHandle) {
+		Target = &AsyncHeadHitResult;
+		bHeadTraceDone = true;
+	} else {
+		// 不是当前这组检测的结果(已经被Reset掉了)，直接丢弃
+		return;
+	}
+
+	*Target = TraceDatum.OutHits.Num() > 0 ? TraceDatum.OutHits[0] : FHitResult();
+	CLIMBING_DEBUG_PROBE(GetWorld(), TraceDatum.Start, TraceDatum.End, Target);
+}
+
+void AClimbingSystemCharacter::CacheWallDetection(bool bWallDetected, const FHitResult& PelvisHitResult, const FHitResult& HeadHitResult) {
+	bLastWallDetected = bWallDetected;
+	if(bWallDetected) {
+		LastPelvisHitResult = PelvisHitResult;
+		LastHeadHitResult = HeadHitResult;
+	}
+	LastWallDetectionFrame = GFrameCounter;
+	bWallDetectionStale = false;
+}
+
+bool AClimbingSystemCharacter::ReuseWallDetection(FHitResult& PelvisHitResult, FHitResult& HeadHitResult) {
+	bWallDetectionStale = true;
+	if(!bLastWallDetected || GFrameCounter - LastWallDetectionFrame > uint64(UClimbingProbeScheduler::GetMaxStaleFrames())) {
+		return false;
+	}
+
+	PelvisHitResult = LastPelvisHitResult;
+	HeadHitResult = LastHeadHitResult;
+	bLastWallDetected = false;		// 一个结果只用一次，避免重复进入攀爬
+	return true;
+}
+
+void AClimbingSystemCharacter::ResetAsyncWallDetection() {
+	// 只清异步检测自己的状态，其他标记(比如是否由群体系统托管)由各自的系统负责
+	PelvisTraceHandle.Invalidate();
+	HeadTraceHandle.Invalidate();
+	bPelvisTraceDone = false;
+	bHeadTraceDone = false;
+	AsyncPelvisHitResult = FHitResult();
+	AsyncHeadHitResult = FHitResult();
+}
+
 bool AClimbingSystemCharacter::DetectShouldExitClimbing() {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingDetectShouldExit);
+
 	// 向下做检测
 	FHitResult HitResult;
 	FCollisionQueryParams Params;
 	Params.AddIgnoredActor(this);
-	bool Result = GetWorld()->LineTraceSingleByChannel(HitResult, GetActorLocation(), GetActorLocation() + (GetActorUpVector() * -1.f * ExitClimbingDetection), ECC_Visibility, Params);
+	bool Result = UClimbableSurfaceSubsystem::LineTraceClimbing(GetWorld(), HitResult, GetActorLocation(), GetActorLocation() + (GetActorUpVector() * -1.f * ExitClimbingDetection), ECC_Visibility, Params);
 	if(Result) {
 		ExitClimbing();
 		return true;
 	}
 
-	// 检查角色与墙面的夹角
-	double DotValue = FVector::DotProduct(GetActorUpVector(), FVector::UpVector);
-	double CosineToAngle = FMath::Acos(DotValue);
-	if(double AngleInDegrees = FMath::RadiansToDegrees(CosineToAngle); AngleInDegrees >= 30.0) {
+	// 检查角色与墙面的夹角，Dot(ActorUp, WorldUp)就是ActorUp.Z，直接和cos(30°)比较
+	if(ClimbingMath::ShouldExitByTilt(GetActorUpVector().Z)) {
 		ExitClimbing();
 		return true;
 	}
@@ -261,86 +595,69 @@ bool AClimbingSystemCharacter::DetectShouldExitClimbing() {
 	return false;
 }
 
-void AClimbingSystemCharacter::EnterClimbing(const FHitResult& HitResult) {
-	GetCharacterMovement()->SetMovementMode(MOVE_Flying);
-	GetCharacterMovement()->bOrientRotationToMovement = false;
-	
-	const FRotator DesiredRotation = FRotationMatrix::MakeFromX(-HitResult.Normal).Rotator();
+void AClimbingSystemCharacter::EnterClimbing(const FHitResult& WallHitResult) {
+	// 贴墙和转向由ClimbingMovement的Enter过渡完成，模式切换通过bWantsToClimb随移动一起发给服务器
+	ClimbingMovement->SetClimbEnterSurface(WallHitResult);
+	ClimbingMovement->SetWantsToClimb(true);
+	GetCharacterMovement()->SetMovementMode(MOVE_Custom, CMOVE_Climbing);
 
-	float PlayTime = GetMesh()->GetAnimInstance()->Montage_Play(IdleToOnWallMontage);	// 播放蒙太奇
-	
-	FLatentActionInfo LatentInfo;
-	LatentInfo.CallbackTarget = this;
-	UKismetSystemLibrary::MoveComponentTo(
-		RootComponent, 
-		HitResult.Location + HitResult.Normal * (WallDistance + WallDistanceOffset), 
-		DesiredRotation, 
-		true, false, PlayTime, false, 
-		EMoveComponentAction::Type::Move, 
-		LatentInfo
-	);
-
-	// 调整飞行的速度为攀爬的速度
-	GetCharacterMovement()->MaxFlySpeed = 100.f;
-	GetCharacterMovement()->BrakingDecelerationFlying = 2048.f;
-	this->CharacterMovementMode = Climbing;
-}
-
-void AClimbingSystemCharacter::EnterClimbingWithoutMontage(const FHitResult& HitResult) {
-	GetCharacterMovement()->SetMovementMode(MOVE_Flying);
-	GetCharacterMovement()->bOrientRotationToMovement = false;
-
-	const FRotator DesiredRotation = FRotationMatrix::MakeFromX(-HitResult.Normal).Rotator();
-	
-	FLatentActionInfo LatentInfo;
-	LatentInfo.CallbackTarget = this;
-	UKismetSystemLibrary::MoveComponentTo(
-		RootComponent, 
-		HitResult.Location + HitResult.Normal * WallDistance, 
-		DesiredRotation, 
-		true, false, 0.3, false, 
-		EMoveComponentAction::Type::Move, 
-		LatentInfo
-	);
-
-	// 调整飞行的速度为攀爬的速度
-	GetCharacterMovement()->MaxFlySpeed = 100.f;
-	GetCharacterMovement()->BrakingDecelerationFlying = 2048.f;
-	this->CharacterMovementMode = Climbing;
+	// 只从地面起跳时走到这里，贴墙的时长是ClimbEnterFromGroundDuration
+	const EClimbGripType GripType = UClimbableSurfaceComponent::GetGripType(WallHitResult.GetComponent());
+	PlayClimbingMontage(ResolveClimbingMontage(IdleToOnWallMontage, IdleToOnWallMontageVariants, GripType), ClimbingMovement->ClimbEnterFromGroundDuration);
+
+	SetCharacterMovementMode(Climbing);
+}
+
+void AClimbingSystemCharacter::EnterClimbingWithoutMontage(const FHitResult* WallHitResult) {
+	if (WallHitResult) {
+		ClimbingMovement->SetClimbEnterSurface(*WallHitResult);
+	}
+	ClimbingMovement->SetWantsToClimb(true);
+	GetCharacterMovement()->SetMovementMode(MOVE_Custom, CMOVE_Climbing);
+
+	SetCharacterMovementMode(Climbing);
 }
 
 void AClimbingSystemCharacter::ExitClimbing() {
-	// 退出攀爬模式
+	// 退出攀爬模式，朝向和状态的修改在OnMovementModeChanged里，服务器和模拟端也会走到那里
+	ClimbingMovement->SetWantsToClimb(false);
 	GetCharacterMovement()->SetMovementMode(MOVE_Walking);
-	GetCharacterMovement()->bOrientRotationToMovement = true;
-	// 调整Actor的Rotation使其垂直于XY平面(地面)
-	FRotator CurrentRotation = this->GetActorRotation();
-	this->SetActorRotation(FRotator(CurrentRotation.Pitch, CurrentRotation.Yaw, 0));
-	GetCharacterMovement()->MaxFlySpeed = 600.f;
-	GetCharacterMovement()->BrakingDecelerationFlying = 0.f;
-	this->CharacterMovementMode = Walking;
-
-	GetCapsuleComponent()->SetCollisionEnabled(ECollisionEnabled::Type::QueryAndPhysics);
-	GetMesh()->SetCollisionEnabled(ECollisionEnabled::Type::QueryAndPhysics);
+	SetCharacterMovementMode(Walking);
 }
 
 FVector AClimbingSystemCharacter::GetUpVectorOfCurrentVector(const FVector& DetectedNormal) {
-	FVector RightVector = FVector::CrossProduct(FVector::UpVector, DetectedNormal);
-	return FVector::CrossProduct(DetectedNormal, RightVector);
+	FVector UpVector;
+	ClimbingMath::UpTangent(DetectedNormal.X, DetectedNormal.Y, DetectedNormal.Z, UpVector.X, UpVector.Y, UpVector.Z);
+	return UpVector;
 }
 
 FVector AClimbingSystemCharacter::GetRightVectorOfCurrentVector(const FVector& DetectedNormal) {
-	return FVector::CrossProduct(FVector::UpVector, DetectedNormal);
+	FVector RightVector;
+	ClimbingMath::RightTangent(DetectedNormal.X, DetectedNormal.Y, DetectedNormal.Z, RightVector.X, RightVector.Y, RightVector.Z);
+	return RightVector;
 }
 
 bool AClimbingSystemCharacter::CheckMantle(FVector& MantleTargetLocation) const {
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingCheckMantle);
+
 	const FVector ActorForward = GetActorForwardVector();
 	FVector TrueForwardVector = ActorForward.GetSafeNormal2D();
 
+	// 有烘焙好的Ledge数据时先查表，这里的墙没有烘焙过(流式子关卡、运行时生成的几何体)时继续走LineTrace
+	if (const UClimbingLedgeSubsystem* LedgeSubsystem = GetWorld()->GetSubsystem<UClimbingLedgeSubsystem>()) {
+		if (const UClimbingLedgeGraph* LedgeGraph = LedgeSubsystem->GetLedgeGraph()) {
+			bool bCovered = false;
+			const bool bFound = LedgeGraph->FindMantleTarget(GetActorLocation(), TrueForwardVector, WallDetectionLength, GetCapsuleComponent()->GetScaledCapsuleHalfHeight(), MantleTargetLocation, bCovered);
+			if (bCovered) {
+				return bFound;
+			}
+		}
+	}
+
 	FHitResult HitResult;
 	FCollisionQueryParams Params;
 	Params.AddIgnoredActor(this);
-	bool Result = GetWorld()->LineTraceSingleByChannel(HitResult, GetActorLocation(), GetActorLocation() + TrueForwardVector * WallDetectionLength, ECC_Visibility, Params);
+	bool Result = UClimbableSurfaceSubsystem::LineTraceClimbing(GetWorld(), HitResult, GetActorLocation(), GetActorLocation() + TrueForwardVector * WallDetectionLength, ECC_Climbable, Params);
 	if(!Result) {
 		return false;
 	}
@@ -348,7 +665,7 @@ bool AClimbingSystemCharacter::CheckMantle(FVector& MantleTargetLocation) const
 	FVector Start = HitResult.ImpactPoint + HitResult.ImpactNormal * -50.f + FVector::UpVector * GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
 	FVector End = Start + FVector::DownVector * GetCapsuleComponent()->GetScaledCapsuleHalfHeight() * 2.f;
 	FHitResult MantleHitResult;
-	Result = GetWorld()->LineTraceSingleByChannel(MantleHitResult, Start, End, ECC_Visibility, Params);
+	Result = UClimbableSurfaceSubsystem::LineTraceClimbing(GetWorld(), MantleHitResult, Start, End, ECC_Climbable, Params);
 	if(!Result) {
 		return false;
 	}
@@ -360,40 +677,75 @@ bool AClimbingSystemCharacter::CheckMantle(FVector& MantleTargetLocation) const
 }
 
 void AClimbingSystemCharacter::Mantle(const FVector& TargetLocation) {
-	GetCapsuleComponent()->SetCollisionEnabled(ECollisionEnabled::NoCollision);
-	GetMesh()->SetCollisionEnabled(ECollisionEnabled::Type::NoCollision);
+	SCOPE_CYCLE_COUNTER(STAT_ClimbingMantle);
 
-	const float PlayTime = GetMesh()->GetAnimInstance()->Montage_Play(MantleMontage);	// 播放蒙太奇
-	this->CameraBoom->bDoCollisionTest = false;
-	
-	FTimerHandle Handle;
-	GetWorldTimerManager().SetTimer(Handle, FTimerDelegate::CreateLambda([this, TargetLocation, PlayTime]() {
-		// 将组件移动到指定的位置
-		FLatentActionInfo LatentInfo;
-		LatentInfo.CallbackTarget = this;
-		UKismetSystemLibrary::MoveComponentTo(
-			RootComponent, 
-			GetActorLocation() + FVector(0, 0, GetCapsuleComponent()->GetScaledCapsuleHalfHeight()), 
-			GetActorRotation(), 
-			false, false, 0.1, false, 
-			EMoveComponentAction::Type::Move, 
-			LatentInfo
-		);
-		
-		UKismetSystemLibrary::MoveComponentTo(
-			RootComponent, 
-			TargetLocation + FVector(0, 0, GetCapsuleComponent()->GetScaledCapsuleHalfHeight()), 
-			GetActorRotation(), 
-			false, false, 0.1, false, 
-			EMoveComponentAction::Type::Move, 
-			LatentInfo
-		);
-		// this->SetActorLocation(TargetLocation + FVector(0, 0, GetCapsuleComponent()->GetScaledCapsuleHalfHeight()));
-		ExitClimbing();
+	// 上升和平移都由ClimbingMovement里的Root Motion Source完成，结束时回调OnClimbTransitionFinished
+	if (!ClimbingMovement->StartMantle(TargetLocation)) {
+		return;
+	}
+	INC_DWORD_STAT(STAT_ClimbingMantles);
+
+	PlayClimbingMontage(ResolveClimbingMontage(MantleMontage, MantleMontageVariants, ClimbingMovement->GetClimbGripType()), ClimbingMovement->MantleRiseDuration);
+	CameraBoom->bDoCollisionTest = false;
+}
+
+bool AClimbingSystemCharacter::Leap(const FVector& Direction) {
+	// 没有输入时往上跳，过渡中和范围内没有落点时什么都不做
+	if (!ClimbingMovement->StartLeap(Direction)) {
+		return false;
+	}
 
-		FTimerHandle Handle;
-		GetWorldTimerManager().SetTimer(Handle, FTimerDelegate::CreateLambda([this]() {
-			this->CameraBoom->bDoCollisionTest = true;
-		}), 0.3f, false);
-	}), PlayTime, false);
+	PlayClimbingMontage(ResolveClimbingMontage(LeapMontage, {}, ClimbingMovement->GetClimbGripType()), ClimbingMovement->LeapDuration);
+	return true;
+}
+
+void AClimbingSystemCharacter::GetClimbingMontagePaths(TArray<FSoftObjectPath>& OutPaths) const {
+	auto AddPath = [&OutPaths](const TSoftObjectPtr<UAnimMontage>& Montage) {
+		if (!Montage.IsNull()) {
+			OutPaths.AddUnique(Montage.ToSoftObjectPath());
+		}
+	};
+
+	AddPath(IdleToOnWallMontage);
+	AddPath(MantleMontage);
+	AddPath(LeapMontage);
+	for (const TPair<EClimbGripType, TSoftObjectPtr<UAnimMontage>>& Variant : IdleToOnWallMontageVariants) {
+		AddPath(Variant.Value);
+	}
+	for (const TPair<EClimbGripType, TSoftObjectPtr<UAnimMontage>>& Variant : MantleMontageVariants) {
+		AddPath(Variant.Value);
+	}
+}
+
+UAnimMontage* AClimbingSystemCharacter::ResolveClimbingMontage(const TSoftObjectPtr<UAnimMontage>& DefaultMontage, const TMap<EClimbGripType, TSoftObjectPtr<UAnimMontage>>& Variants, EClimbGripType GripType) const {
+	const TSoftObjectPtr<UAnimMontage>* Variant = Variants.Find(GripType);
+	const TSoftObjectPtr<UAnimMontage>& Montage = Variant && !Variant->IsNull() ? *Variant : DefaultMontage;
+	if (UAnimMontage* LoadedMontage = Montage.Get()) {
+		return LoadedMontage;
+	}
+	if (Montage.IsNull() || UClimbingMontagePreloadSubsystem::IsPreloadEnabled()) {
+		return nullptr;
+	}
+	return Montage.LoadSynchronous();
+}
+
+void AClimbingSystemCharacter::PlayClimbingMontage(UAnimMontage* Montage, float Duration) {
+	UAnimInstance* AnimInstance = GetMesh()->GetAnimInstance();
+	if (!AnimInstance || !Montage) {
+		return;
+	}
+	const float PlayRate = Duration > UE_KINDA_SMALL_NUMBER ? Montage->GetPlayLength() / Duration : 1.f;
+	AnimInstance->Montage_Play(Montage, PlayRate);	// 播放蒙太奇
+}
+
+void AClimbingSystemCharacter::OnClimbTransitionFinished(EClimbTransition Transition) {
+	if (Transition == EClimbTransition::MantleOver) {
+		CameraBoom->bDoCollisionTest = true;
+	} else if (Transition == EClimbTransition::Leap && IsLocallyControlled()) {
+		// 跳上去之后顶端进入范围就接着Mantle，和输入驱动的Mantle一样只在本地发起
+		FVector MantleTargetLocation;
+		if (CheckMantle(MantleTargetLocation)) {
+			Mantle(MantleTargetLocation);
+		}
+	}
 }
\ No newline at end of file
@@ -5,13 +5,19 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
 #include "Logging/LogMacros.h"
+#include "WorldCollision.h"
+#include "ClimbingMovementComponent.h"
+#include "ClimbingReplay.h"
 #include "ClimbingSystemCharacter.generated.h"
 
 class USpringArmComponent;
 class UCameraComponent;
 class UInputMappingContext;
 class UInputAction;
+class UClimbingMovementComponent;
+class UClimbingLimbIKComponent;
 struct FInputActionValue;
+enum class EClimbingSignificance : uint8;
 
 DECLARE_LOG_CATEGORY_EXTERN(LogTemplateCharacter, Log, All);
 
@@ -22,6 +28,11 @@ enum ECharacterMovementMode {
 	Jumping = 2,		// 跳跃后正在滞空的情况
 };
 
+class AClimbingSystemCharacter;
+
+// CharacterMovementMode发生变化时广播，参数是角色、之前的状态和新的状态
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FOnCharacterMovementModeChanged, AClimbingSystemCharacter*, ECharacterMovementMode, ECharacterMovementMode);
+
 UCLASS(config=Game)
 class AClimbingSystemCharacter : public ACharacter
 {
@@ -54,6 +65,12 @@ class AClimbingSystemCharacter : public ACharacter
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = Movement, meta = (AllowPrivateAccess = "true"))
 	TEnumAsByte<ECharacterMovementMode> CharacterMovementMode;				// 表示当前的运动状态
 
+	UPROPERTY()
+	UClimbingMovementComponent* ClimbingMovement;			// 带攀爬模式的移动组件，和GetCharacterMovement()是同一个对象
+
+	UPROPERTY(ReplicatedUsing = OnRep_ClimbingNetState)
+	FClimbingNetState ClimbingNetState;						// 给模拟端的攀爬状态和量化过的墙面法线
+
 private:	// Climbing System Components
 
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
@@ -62,6 +79,9 @@ private:	// Climbing System Components
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
 	UArrowComponent* DetectionArrowPelvis;		// 用来在攀爬的时候进行标记LineTrace起点的Arrow
 
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
+	UClimbingLimbIKComponent* LimbIK;			// 攀爬时手脚在墙上的接触点，给AnimBP做IK
+
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
 	float WallDetectionLength;			// 墙壁的检测长度
 
@@ -71,18 +91,80 @@ private:	// Climbing System Components
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
 	float ExitClimbingDetection;		// 当在攀爬状态下向下行走的过程中，不断的向下进行LineTrace，当在这个距离内检测到地面了，则脱出攀爬模式回到Walking
 
+	// Montage都是软引用，由UClimbingMontagePreloadSubsystem在角色生成时异步加载，角色类本身不再带着动画数据一起加载
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
+	TSoftObjectPtr<UAnimMontage> IdleToOnWallMontage;	// 从Walking到抓在墙上的Montage
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
+	TSoftObjectPtr<UAnimMontage> MantleMontage;		// Mantle的时候用的Montage
+
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
-	UAnimMontage* IdleToOnWallMontage;	// 从Walking到抓在墙上的Montage
+	TSoftObjectPtr<UAnimMontage> LeapMontage;		// 攀爬中跳到下一个抓点的Montage，时长由ClimbingMovement的LeapDuration决定
 
+	// 按墙面的抓握方式替换上面的Montage，没配的抓握方式用默认的；过渡的时长只按默认的算，变体的长度要和默认的一致
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
-	UAnimMontage* MantleMontage;		// Mantle的时候用的Montage
+	TMap<EClimbGripType, TSoftObjectPtr<UAnimMontage>> IdleToOnWallMontageVariants;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
+	TMap<EClimbGripType, TSoftObjectPtr<UAnimMontage>> MantleMontageVariants;
 
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
 	float WallDistanceOffset;
 	
 public:
-	AClimbingSystemCharacter();
-	
+	AClimbingSystemCharacter(const FObjectInitializer& ObjectInitializer);
+
+	bool IsClimbing() const { return CharacterMovementMode == Climbing; }
+	ECharacterMovementMode GetCharacterMovementMode() const { return CharacterMovementMode; }
+	void ExitClimbing();
+
+	FOnCharacterMovementModeChanged OnCharacterMovementModeChanged;
+
+	// 不经过EnhancedInput直接驱动角色，给Benchmark这种没有玩家输入的调用方用，行为和按键输入完全一样
+	void AddScriptedMoveInput(const FVector2D& MovementVector);
+	void ScriptedJump() { CharacterJump(); }
+	void ScriptedStopJump() { CharacterStopJump(); }
+	void ScriptedEnterClimbing() { EnterClimbingWithoutMontage(); }
+
+	// 录像用: 打开之后输入回调把一个Tick里的Move/Look/Jump攒到一起，由UClimbingReplaySubsystem每个Tick取走
+	void SetInputRecording(bool bEnabled);
+	FClimbingInputFrame ConsumeRecordedInput();
+
+	// 回放用: 按录下来的一个Tick的输入驱动角色，走的是和按键输入同样的回调
+	void ReplayInput(const FClimbingInputFrame& Input);
+
+	// 预加载用: 这个角色会用到的所有Montage
+	void GetClimbingMontagePaths(TArray<FSoftObjectPath>& OutPaths) const;
+
+	// 计算当前检测到的面的向上的切线
+	static FVector GetUpVectorOfCurrentVector(const FVector& DetectedNormal);
+
+	// 计算当前检测到的面的向右的切线
+	static FVector GetRightVectorOfCurrentVector(const FVector& DetectedNormal);
+
+	// 交给UClimbingCrowdSubsystem批量处理攀爬检测时，自己不再在UpdateClimbingChecks里做退出检测
+	void SetManagedByClimbingCrowd(bool bManaged) { bManagedByClimbingCrowd = bManaged; }
+	bool IsManagedByClimbingCrowd() const { return bManagedByClimbingCrowd; }
+
+	// 本帧的墙壁检测被UClimbingProbeScheduler推迟，用的是之前的结果
+	bool IsWallDetectionStale() const { return bWallDetectionStale; }
+
+	// 由UClimbingSignificanceSubsystem设置，决定Tick和墙面检测的频率
+	void SetClimbingSignificance(EClimbingSignificance NewSignificance);
+	EClimbingSignificance GetClimbingSignificance() const { return ClimbingSignificance; }
+
+	// ACharacter interface
+	virtual void OnMovementModeChanged(EMovementMode PrevMovementMode, uint8 PreviousCustomMode = 0) override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	// 服务器上攀爬状态或者墙面变化时调用，更新ClimbingNetState
+	void UpdateClimbingNetState();
+
+	// 检查目前是否满足Mantle的条件，返回是否能站到顶上以及目标位置，服务器在移动里也用它算Mantle的目标
+	bool CheckMantle(FVector& MantleTargetLocation) const;
+
+	// 攀爬中由ClimbingMovement每个Tick在本地移动之前调用一次: 检查是否该退出攀爬，有向上的输入时检查能不能Mantle
+	void UpdateClimbingChecks(const FVector& PendingInput);
 
 protected:
 
@@ -99,27 +181,71 @@ protected:
 	void CharacterStopJump();
 
 private:
+	// 所有对CharacterMovementMode的修改都走这里，方便统一广播OnCharacterMovementModeChanged
+	void SetCharacterMovementMode(ECharacterMovementMode NewMode);
+
+	UFUNCTION()
+	void OnRep_ClimbingNetState();
+
 	/**
 	 * 检测角色前方是否有一堵能爬的墙
 	 * @return 前面的墙是否能爬
 	 */
 	bool ClimbWallDetection(FHitResult& PelvisHitResult, FHitResult& HeadHitResult) const;
 
+	/**
+	 * ClimbWallDetection的异步版本，分成取结果和提交两步，只有提交才占UClimbingProbeScheduler的预算
+	 * ResolveAsyncWallDetection在两条检测线都回来时返回true，bOutWallDetected是它们是否检测到了能爬的墙
+	 */
+	bool ResolveAsyncWallDetection(FHitResult& PelvisHitResult, FHitResult& HeadHitResult, bool& bOutWallDetected);
+	void SubmitAsyncWallDetection();
+	bool HasPendingWallDetection() const { return PelvisTraceHandle.IsValid() || HeadTraceHandle.IsValid(); }
+	void OnWallDetectionTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum);
+	void ResetAsyncWallDetection();
+
+	// UClimbingProbeScheduler推迟了本帧的检测时，沿用上一次的结果，超过MaxStaleFrames的结果不再使用
+	void CacheWallDetection(bool bWallDetected, const FHitResult& PelvisHitResult, const FHitResult& HeadHitResult);
+	bool ReuseWallDetection(FHitResult& PelvisHitResult, FHitResult& HeadHitResult);
+
 	bool DetectShouldExitClimbing();
-	void EnterClimbing(const FHitResult& HitResult);
-	void EnterClimbingWithoutMontage(const FHitResult& HitResult);
-	void ExitClimbing();
+	void EnterClimbing(const FHitResult& WallHitResult);
+	// WallHitResult是已经检测到的墙面，交给Enter过渡贴墙用，为空时过渡自己检测
+	void EnterClimbingWithoutMontage(const FHitResult* WallHitResult = nullptr);
 
-	// 计算当前检测到的面的向上的切线
-	static FVector GetUpVectorOfCurrentVector(const FVector& DetectedNormal);
+	// 按抓握方式选Montage，还没加载好时返回空(不在播放时同步加载)，关掉预加载时才同步加载
+	UAnimMontage* ResolveClimbingMontage(const TSoftObjectPtr<UAnimMontage>& DefaultMontage, const TMap<EClimbGripType, TSoftObjectPtr<UAnimMontage>>& Variants, EClimbGripType GripType) const;
 
-	// 计算当前检测到的面的向右的切线
-	static FVector GetRightVectorOfCurrentVector(const FVector& DetectedNormal);
-	
-	// 检查目前是否满足Mantle的条件，返回是否能站到顶上以及目标位置
-	bool CheckMantle(FVector& MantleTargetLocation) const;
+	// 按过渡的时长缩放播放速度，过渡时长只来自ClimbingMovement的配置，和Montage有没有加载好无关
+	void PlayClimbingMontage(UAnimMontage* Montage, float Duration);
 
 	void Mantle(const FVector& TargetLocation);
+	bool Leap(const FVector& Direction);
+	void OnClimbTransitionFinished(EClimbTransition Transition);
+
+private:	// 异步墙壁检测的状态
+	FTraceDelegate WallDetectionTraceDelegate;
+	FTraceHandle PelvisTraceHandle;
+	FTraceHandle HeadTraceHandle;
+	FHitResult AsyncPelvisHitResult;
+	FHitResult AsyncHeadHitResult;
+	uint64 WallDetectionSubmitFrame;		// 提交当前这组检测时的GFrameCounter，用来统计异步带来的延迟
+	uint8 bPelvisTraceDone : 1;
+	uint8 bHeadTraceDone : 1;
+
+private:	// 预算调度下最近一次墙壁检测的结果
+	FHitResult LastPelvisHitResult;
+	FHitResult LastHeadHitResult;
+	uint64 LastWallDetectionFrame;
+	uint8 bLastWallDetected : 1;
+	uint8 bWallDetectionStale : 1;		// 本帧用的是之前的结果
+
+	uint8 bManagedByClimbingCrowd : 1;
+	uint8 bLeapRequested : 1;		// 攀爬中按了跳跃，等UpdateClimbingChecks拿到这一帧的输入再发起Leap
+	uint8 bRecordingInput : 1;
+
+	FClimbingInputFrame RecordedInput;
+
+	EClimbingSignificance ClimbingSignificance;
 
 protected:
 	// APawn interface
@@ -128,6 +254,8 @@ protected:
 	// To add mapping context
 	virtual void BeginPlay();
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	virtual void Tick(float DeltaSeconds) override;
 
 public:
@@ -135,5 +263,14 @@ public:
 	FORCEINLINE class USpringArmComponent* GetCameraBoom() const { return CameraBoom; }
 	/** Returns FollowCamera subobject **/
 	FORCEINLINE class UCameraComponent* GetFollowCamera() const { return FollowCamera; }
+	/** Returns ClimbingMovement subobject **/
+	FORCEINLINE UClimbingMovementComponent* GetClimbingMovement() const { return ClimbingMovement; }
+	/** Returns LimbIK subobject **/
+	FORCEINLINE UClimbingLimbIKComponent* GetLimbIK() const { return LimbIK; }
+
+	FORCEINLINE float GetWallDetectionLength() const { return WallDetectionLength; }
+	FORCEINLINE float GetWallDistance() const { return WallDistance; }
+	FORCEINLINE float GetWallDistanceOffset() const { return WallDistanceOffset; }
+	FORCEINLINE float GetExitClimbingDetection() const { return ExitClimbingDetection; }
 };
 
@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "ClimbingBenchmarkGameMode.h"
+#include "Engine/World.h"
+#include "Tests/AutomationCommon.h"
+
+namespace ClimbingBenchmarkTest {
+	const TCHAR* MapUrl = TEXT("/Game/ThirdPerson/Maps/ThirdPersonMap?game=/Script/ClimbingSystem.ClimbingBenchmarkGameMode");
+	constexpr double FindGameModeTimeout = 30.0;
+	constexpr double RunTimeout = 600.0;
+}
+
+/**
+ * 等AClimbingBenchmarkGameMode跑完，把它和基准比较的结果变成测试的错误
+ * 角色数量、时长和基准文件都用游戏模式自己的配置和命令行参数
+ */
+class FWaitForClimbingBenchmarkCommand : public IAutomationLatentCommand {
+public:
+	explicit FWaitForClimbingBenchmarkCommand(FAutomationTestBase* InTest)
+		: Test(InTest) {
+	}
+
+	virtual bool Update() override {
+		using namespace ClimbingBenchmarkTest;
+		const double Now = FPlatformTime::Seconds();
+		if (StartTime == 0.0) {
+			StartTime = Now;
+		}
+		const double Elapsed = Now - StartTime;
+
+		if (!GameMode.IsValid()) {
+			UWorld* World = AutomationCommon::GetAnyGameWorld();
+			AClimbingBenchmarkGameMode* BenchmarkGameMode = World ? World->GetAuthGameMode<AClimbingBenchmarkGameMode>() : nullptr;
+			if (!BenchmarkGameMode) {
+				if (Elapsed > FindGameModeTimeout) {
+					Test->AddError(TEXT("The map did not start with AClimbingBenchmarkGameMode"));
+					return true;
+				}
+				return false;
+			}
+			// 测试结束之后还要继续跑别的测试，不能让游戏模式退出进程
+			BenchmarkGameMode->SetQuitWhenFinished(false);
+			GameMode = BenchmarkGameMode;
+		}
+
+		if (!GameMode->IsFinished()) {
+			if (Elapsed > RunTimeout) {
+				Test->AddError(TEXT("Climbing benchmark did not finish in time"));
+				return true;
+			}
+			return false;
+		}
+
+		for (const FString& Warning : GameMode->GetWarnings()) {
+			Test->AddWarning(Warning);
+		}
+		for (const FString& Regression : GameMode->GetRegressions()) {
+			Test->AddError(Regression);
+		}
+		return true;
+	}
+
+private:
+	FAutomationTestBase* Test;
+	double StartTime = 0.0;
+	TWeakObjectPtr<AClimbingBenchmarkGameMode> GameMode;
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FClimbingBenchmarkRegressionTest, "ClimbingSystem.Benchmark.NoRegression",
+	EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+bool FClimbingBenchmarkRegressionTest::RunTest(const FString& Parameters) {
+	AutomationOpenMap(ClimbingBenchmarkTest::MapUrl, true);
+	ADD_LATENT_AUTOMATION_COMMAND(FWaitForClimbingBenchmarkCommand(this));
+	return true;
+}
+
+#endif
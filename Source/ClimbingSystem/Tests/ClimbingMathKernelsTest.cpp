@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "ClimbingMathKernelsTestFixture.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FClimbingMathKernelsBatchTest, "ClimbingSystem.Math.BatchMatchesScalar",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+// 用例在ClimbingMathKernelsTestFixture.h里，和Standalone的测试完全一样
+bool FClimbingMathKernelsBatchTest::RunTest(const FString& Parameters) {
+	AddInfo(FString::Printf(TEXT("CLIMBING_MATH_SSE=%d"), CLIMBING_MATH_SSE));
+
+	ClimbingMathKernelsTest::CheckBatchMatchesScalar([this](const char* Message) {
+		AddError(UTF8_TO_TCHAR(Message));
+	});
+
+	return !HasAnyErrors();
+}
+
+#endif
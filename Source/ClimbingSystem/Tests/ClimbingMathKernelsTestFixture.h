@@ -0,0 +1,170 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+// ClimbingSystem.Math.BatchMatchesScalar和Standalone/ClimbingMathKernelsStandalone.cpp共用的用例，不依赖引擎
+// 错误通过回调报告，回调的参数是格式化好的一行消息
+
+#include "ClimbingMathKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace ClimbingMathKernelsTest {
+	// 覆盖没有SIMD部分、只有SIMD部分、SIMD之后剩尾部元素的情况，ExitTiltBatch一次处理16个，要到16的倍数之后再多几个
+	constexpr int32_t MaxCount = 37;
+	constexpr int32_t Padding = 4;				// 数组末尾多出来的元素，检查批量函数没有越界写
+	constexpr float Sentinel = -12345.f;
+	constexpr float Tolerance = 1e-5f;
+
+	// 批量版本和逐个元素的标量版本应该完全一致，允许极小的舍入差异，NaN只要求两边都是NaN
+	inline bool Matches(float Batch, double Scalar) {
+		if (std::isnan(Batch) || std::isnan(Scalar)) {
+			return std::isnan(Batch) && std::isnan(Scalar);
+		}
+		return std::fabs(double(Batch) - Scalar) <= Tolerance * std::max(1.0, std::fabs(Scalar));
+	}
+
+	template<typename ErrorFunctionType, typename... ArgTypes>
+	void ReportError(ErrorFunctionType& AddError, const char* Format, ArgTypes... Args) {
+		char Message[256];
+		std::snprintf(Message, sizeof(Message), Format, Args...);
+		AddError(static_cast<const char*>(Message));
+	}
+
+	/** SoA的一组输入，前几个元素是特殊值，后面是随机的 */
+	struct FInputs {
+		std::vector<float> Nx, Ny, Nz;
+		std::vector<float> Px, Py, Pz;
+		std::vector<float> Distance;
+		std::vector<float> ActorUpZ;
+
+		FInputs(int32_t Count, bool bSpecialValues) {
+			std::mt19937 Random{ uint32_t(Count) };
+			std::normal_distribution<double> Gaussian;
+			std::uniform_real_distribution<float> Coordinate(-10000.f, 10000.f);
+			std::uniform_real_distribution<float> Offset(0.f, 100.f);
+			std::uniform_real_distribution<float> Cosine(-1.f, 1.f);
+			for (std::vector<float>* Array : { &Nx, &Ny, &Nz, &Px, &Py, &Pz, &Distance, &ActorUpZ }) {
+				Array->assign(size_t(Count + Padding), Sentinel);
+			}
+			for (int32_t Index = 0; Index < Count; ++Index) {
+				double X = Gaussian(Random), Y = Gaussian(Random), Z = Gaussian(Random);
+				const double InvLength = 1.0 / std::max(std::sqrt(X * X + Y * Y + Z * Z), 1e-12);
+				Nx[Index] = float(X * InvLength);
+				Ny[Index] = float(Y * InvLength);
+				Nz[Index] = float(Z * InvLength);
+				Px[Index] = Coordinate(Random);
+				Py[Index] = Coordinate(Random);
+				Pz[Index] = Coordinate(Random);
+				Distance[Index] = Offset(Random);
+				ActorUpZ[Index] = Cosine(Random);
+			}
+			if (!bSpecialValues) {
+				return;
+			}
+
+			// 零法线、NaN法线、正好等于阈值的余弦，分别落在SIMD部分和尾部
+			for (int32_t Index = 1; Index < Count; Index += 5) {
+				Nx[Index] = Ny[Index] = Nz[Index] = 0.f;
+				ActorUpZ[Index] = ClimbingMath::ExitTiltCos;
+			}
+			const float NaN = std::numeric_limits<float>::quiet_NaN();
+			for (int32_t Index = 2; Index < Count; Index += 5) {
+				Nx[Index] = NaN;
+				Nz[Index] = NaN;
+				ActorUpZ[Index] = NaN;
+			}
+		}
+	};
+
+	inline std::vector<float> MakeOutput(int32_t Count) {
+		return std::vector<float>(size_t(Count + Padding), Sentinel);
+	}
+
+	template<typename ErrorFunctionType>
+	void CheckPadding(ErrorFunctionType& AddError, const char* What, const std::vector<float>& Array, int32_t Count) {
+		for (size_t Index = size_t(Count); Index < Array.size(); ++Index) {
+			if (Array[Index] != Sentinel) {
+				ReportError(AddError, "%s wrote past Count %d at %d", What, int(Count), int(Index));
+				return;
+			}
+		}
+	}
+
+	template<typename ErrorFunctionType>
+	void CheckLane(ErrorFunctionType& AddError, const char* What, int32_t Count, int32_t Index, float Batch, double Scalar) {
+		if (!Matches(Batch, Scalar)) {
+			ReportError(AddError, "%s differs from the scalar version at %d/%d: %g vs %g", What, int(Index), int(Count), double(Batch), Scalar);
+		}
+	}
+
+	/** 0到MaxCount个元素，每个批量函数都和标量版本逐个比较，并检查没有写到Count之后 */
+	template<typename ErrorFunctionType>
+	void CheckBatchMatchesScalar(ErrorFunctionType&& AddError) {
+		for (int32_t Count = 0; Count <= MaxCount; ++Count) {
+			const FInputs In(Count, true);
+
+			// 1. 切线
+			std::vector<float> Rx = MakeOutput(Count), Ry = MakeOutput(Count), Rz = MakeOutput(Count);
+			std::vector<float> Ux = MakeOutput(Count), Uy = MakeOutput(Count), Uz = MakeOutput(Count);
+			ClimbingMath::TangentBasisBatch(In.Nx.data(), In.Ny.data(), In.Nz.data(),
+				Rx.data(), Ry.data(), Rz.data(), Ux.data(), Uy.data(), Uz.data(), Count);
+			for (int32_t Index = 0; Index < Count; ++Index) {
+				double X, Y, Z;
+				ClimbingMath::RightTangent(In.Nx[Index], In.Ny[Index], In.Nz[Index], X, Y, Z);
+				CheckLane(AddError, "TangentBasisBatch right.x", Count, Index, Rx[Index], X);
+				CheckLane(AddError, "TangentBasisBatch right.y", Count, Index, Ry[Index], Y);
+				CheckLane(AddError, "TangentBasisBatch right.z", Count, Index, Rz[Index], Z);
+				ClimbingMath::UpTangent(In.Nx[Index], In.Ny[Index], In.Nz[Index], X, Y, Z);
+				CheckLane(AddError, "TangentBasisBatch up.x", Count, Index, Ux[Index], X);
+				CheckLane(AddError, "TangentBasisBatch up.y", Count, Index, Uy[Index], Y);
+				CheckLane(AddError, "TangentBasisBatch up.z", Count, Index, Uz[Index], Z);
+			}
+			CheckPadding(AddError, "TangentBasisBatch", Rz, Count);
+			CheckPadding(AddError, "TangentBasisBatch", Uz, Count);
+
+			// 2. 倾斜判断，NaN在两边都不退出
+			std::vector<uint8_t> ShouldExit(size_t(Count + Padding), 0xCD);
+			ClimbingMath::ExitTiltBatch(In.ActorUpZ.data(), ClimbingMath::ExitTiltCos, ShouldExit.data(), Count);
+			for (int32_t Index = 0; Index < Count; ++Index) {
+				const uint8_t Expected = ClimbingMath::ShouldExitByTilt(In.ActorUpZ[Index], ClimbingMath::ExitTiltCos) ? 1 : 0;
+				if (ShouldExit[Index] != Expected) {
+					ReportError(AddError, "ExitTiltBatch differs from ShouldExitByTilt at %d/%d (ActorUpZ %g)", int(Index), int(Count), double(In.ActorUpZ[Index]));
+				}
+			}
+			for (size_t Index = size_t(Count); Index < ShouldExit.size(); ++Index) {
+				if (ShouldExit[Index] != 0xCD) {
+					ReportError(AddError, "ExitTiltBatch wrote past Count %d at %d", int(Count), int(Index));
+					break;
+				}
+			}
+
+			// 3. 贴墙的目标位置
+			std::vector<float> Sx = MakeOutput(Count), Sy = MakeOutput(Count), Sz = MakeOutput(Count);
+			ClimbingMath::SnapTargetBatch(In.Px.data(), In.Py.data(), In.Pz.data(), In.Nx.data(), In.Ny.data(), In.Nz.data(),
+				In.Distance.data(), Sx.data(), Sy.data(), Sz.data(), Count);
+			for (int32_t Index = 0; Index < Count; ++Index) {
+				CheckLane(AddError, "SnapTargetBatch x", Count, Index, Sx[Index], In.Px[Index] + In.Nx[Index] * In.Distance[Index]);
+				CheckLane(AddError, "SnapTargetBatch y", Count, Index, Sy[Index], In.Py[Index] + In.Ny[Index] * In.Distance[Index]);
+				CheckLane(AddError, "SnapTargetBatch z", Count, Index, Sz[Index], In.Pz[Index] + In.Nz[Index] * In.Distance[Index]);
+			}
+			CheckPadding(AddError, "SnapTargetBatch", Sz, Count);
+
+			// 4. 插值，当前位置就地更新，目标用上一步算出来的贴墙位置(含NaN)
+			const double Alpha = ClimbingMath::InterpAlpha(1.0 / 60.0, 10.0);
+			std::vector<float> Cx = In.Px, Cy = In.Py, Cz = In.Pz;
+			ClimbingMath::InterpToBatch(Cx.data(), Cy.data(), Cz.data(), Sx.data(), Sy.data(), Sz.data(), float(Alpha), Count);
+			for (int32_t Index = 0; Index < Count; ++Index) {
+				CheckLane(AddError, "InterpToBatch x", Count, Index, Cx[Index], In.Px[Index] + (Sx[Index] - In.Px[Index]) * Alpha);
+				CheckLane(AddError, "InterpToBatch y", Count, Index, Cy[Index], In.Py[Index] + (Sy[Index] - In.Py[Index]) * Alpha);
+				CheckLane(AddError, "InterpToBatch z", Count, Index, Cz[Index], In.Pz[Index] + (Sz[Index] - In.Pz[Index]) * Alpha);
+			}
+			CheckPadding(AddError, "InterpToBatch", Cz, Count);
+		}
+	}
+}
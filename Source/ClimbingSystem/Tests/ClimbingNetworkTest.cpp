@@ -0,0 +1,337 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && WITH_EDITOR
+
+#include "ClimbingBenchmarkCourse.h"
+#include "ClimbingMovementComponent.h"
+#include "ClimbingSystem.h"
+#include "ClimbingSystemCharacter.h"
+#include "Components/CapsuleComponent.h"
+#include "Editor.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Settings/LevelEditorPlaySettings.h"
+#include "Tests/AutomationEditorCommon.h"
+
+namespace ClimbingNetworkTest {
+	const TCHAR* MapName = TEXT("/Game/ThirdPerson/Maps/ThirdPersonMap");
+	const FVector CourseLocation(0.f, 0.f, 5000.f);		// 远离地图里原有的几何体
+	constexpr float JumpDistance = 150.f;				// 离墙这么近时起跳抓墙
+	constexpr float LeapAfterClimbTime = 0.5f;			// 抓上墙之后先往上爬一会儿再跳
+	constexpr float SettleTime = 1.f;					// 传送之后和结束之前等纠正都到齐
+	constexpr float StepTimeout = 10.f;
+	constexpr double MaxOutBytesPerClimber = 4096.0;	// 服务器每个攀爬角色每秒最多发多少字节
+
+	/**
+	 * 网络模拟的档位，和Net PktLag/PktLoss/PktJitter一样，延迟和丢包加在两边的NetDriver上
+	 * RoundTripLag平分到两个方向，PktLoss每个方向各丢这么多
+	 */
+	struct FNetProfile {
+		const TCHAR* Name;
+		int32 RoundTripLag;			// ms
+		int32 PktLoss;				// %
+		int32 PktJitter;			// ms
+		uint32 MaxClientCorrections;
+	};
+
+	const FNetProfile NetProfiles[] = {
+		{ TEXT("Ideal"), 0, 0, 0, 0 },
+		{ TEXT("Average"), 100, 2, 10, 2 },
+		{ TEXT("Bad"), 200, 5, 30, 6 },
+	};
+}
+
+/**
+ * 在监听服务器+一个客户端的PIE里，客户端角色跑一遍起跳抓墙、往上爬、Leap、Mantle，检查客户端收到的移动纠正次数
+ * 和服务器上每个攀爬角色的发送带宽(和Climbing.Net.Stats同样的数)，两项都按网络模拟的档位给预算
+ * 两边的World里各生成一份同样的AClimbingBenchmarkCourse(不同步，几何体完全一样)，服务器把客户端的角色传送到赛道起点
+ */
+class FClimbingNetworkRoundTripCommand : public IAutomationLatentCommand {
+public:
+	FClimbingNetworkRoundTripCommand(FAutomationTestBase* InTest, const ClimbingNetworkTest::FNetProfile& InProfile)
+		: Test(InTest)
+		, Profile(InProfile) {
+	}
+
+	virtual bool Update() override;
+
+private:
+	enum class EStep : uint8 {
+		WaitForWorlds,
+		Settle,
+		Approach,
+		Climb,
+		Mantle,
+		Verify,
+		Done,
+	};
+
+	bool FindWorlds();
+	void ApplyNetProfile(UWorld* World) const;
+	void SetStep(EStep NewStep);
+	bool Fail(const FString& Message);
+
+	FAutomationTestBase* Test;
+	ClimbingNetworkTest::FNetProfile Profile;
+	EStep Step = EStep::WaitForWorlds;
+	double StepStartTime = 0.0;
+	double CommandStartTime = 0.0;
+
+	TWeakObjectPtr<AClimbingSystemCharacter> ClientCharacter;		// 客户端World里本地控制的角色
+	TWeakObjectPtr<AClimbingBenchmarkCourse> ClientCourse;
+	TWeakObjectPtr<UWorld> ServerWorld;
+	double OutBytesPerClimberSum = 0.0;
+	int32 NumBandwidthSamples = 0;
+	bool bJumpHeld = false;
+	bool bLeapRequested = false;
+	bool bLeapSeen = false;
+	bool bMantleSeen = false;
+};
+
+void FClimbingNetworkRoundTripCommand::SetStep(EStep NewStep) {
+	Step = NewStep;
+	StepStartTime = FPlatformTime::Seconds();
+}
+
+bool FClimbingNetworkRoundTripCommand::Fail(const FString& Message) {
+	Test->AddError(FString::Printf(TEXT("[%s] %s"), Profile.Name, *Message));
+	SetStep(EStep::Done);
+	if (GEditor) {
+		GEditor->RequestEndPlayMap();
+	}
+	return false;
+}
+
+void FClimbingNetworkRoundTripCommand::ApplyNetProfile(UWorld* World) const {
+	UNetDriver* NetDriver = World->GetNetDriver();
+	if (!NetDriver) {
+		return;
+	}
+#if DO_ENABLE_NET_TEST
+	FPacketSimulationSettings Settings;
+	Settings.PktLag = Profile.RoundTripLag / 2;
+	Settings.PktLoss = Profile.PktLoss;
+	Settings.PktJitter = Profile.PktJitter;
+	NetDriver->SetPacketSimulationSettings(Settings);
+#else
+	if (Profile.RoundTripLag > 0 || Profile.PktLoss > 0 || Profile.PktJitter > 0) {
+		Test->AddWarning(FString::Printf(TEXT("[%s] Network emulation is compiled out, running without lag or loss"), Profile.Name));
+	}
+#endif
+}
+
+bool FClimbingNetworkRoundTripCommand::FindWorlds() {
+	UWorld* ListenServerWorld = nullptr;
+	UWorld* ClientWorld = nullptr;
+	for (const FWorldContext& Context : GEngine->GetWorldContexts()) {
+		UWorld* World = Context.World();
+		if (!World || Context.WorldType != EWorldType::PIE || !World->HasBegunPlay()) {
+			continue;
+		}
+		if (World->GetNetMode() == NM_ListenServer) {
+			ListenServerWorld = World;
+		} else if (World->GetNetMode() == NM_Client) {
+			ClientWorld = World;
+		}
+	}
+	if (!ListenServerWorld || !ClientWorld) {
+		return false;
+	}
+
+	APlayerController* ClientPlayerController = ClientWorld->GetFirstPlayerController();
+	AClimbingSystemCharacter* Character = ClientPlayerController ? Cast<AClimbingSystemCharacter>(ClientPlayerController->GetPawn()) : nullptr;
+	if (!Character) {
+		return false;
+	}
+
+	// 服务器上同一个角色: 由不是本地玩家的PlayerController控制
+	AClimbingSystemCharacter* ServerCharacter = nullptr;
+	for (FConstPlayerControllerIterator It = ListenServerWorld->GetPlayerControllerIterator(); It; ++It) {
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController && !PlayerController->IsLocalController()) {
+			ServerCharacter = Cast<AClimbingSystemCharacter>(PlayerController->GetPawn());
+		}
+	}
+	if (!ServerCharacter) {
+		return false;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	AClimbingBenchmarkCourse* Course = nullptr;
+	for (UWorld* World : { ListenServerWorld, ClientWorld }) {
+		Course = World->SpawnActor<AClimbingBenchmarkCourse>(ClimbingNetworkTest::CourseLocation, FRotator::ZeroRotator, SpawnParams);
+		Course->Build(1, FClimbingBenchmarkCourseSettings());
+		ApplyNetProfile(World);
+	}
+
+	// 传送由服务器做，客户端通过纠正拿到新位置，Settle之后再开始计数
+	const float HalfHeight = ServerCharacter->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+	ServerCharacter->GetCharacterMovement()->StopMovementImmediately();
+	ServerCharacter->SetActorLocationAndRotation(Course->GetLaneStart(0) + FVector(0.f, 0.f, HalfHeight + 2.f), Course->GetLaneForward().Rotation(), false, nullptr, ETeleportType::TeleportPhysics);
+	ClientPlayerController->SetControlRotation(Course->GetLaneForward().Rotation());
+
+	ClientCharacter = Character;
+	ClientCourse = Course;
+	ServerWorld = ListenServerWorld;
+	return true;
+}
+
+bool FClimbingNetworkRoundTripCommand::Update() {
+	using namespace ClimbingNetworkTest;
+	const double Now = FPlatformTime::Seconds();
+	if (CommandStartTime == 0.0) {
+		CommandStartTime = Now;
+		StepStartTime = Now;
+	}
+	const double StepTime = Now - StepStartTime;
+
+	// 等PIE真正结束再返回，下一个档位才能重新开始
+	if (Step == EStep::Done) {
+		return !GEditor || !GEditor->PlayWorld;
+	}
+
+	if (Step == EStep::WaitForWorlds) {
+		if (FindWorlds()) {
+			SetStep(EStep::Settle);
+		} else if (StepTime > StepTimeout) {
+			return Fail(TEXT("PIE listen server and client did not start with a climbing character"));
+		}
+		return false;
+	}
+
+	AClimbingSystemCharacter* Character = ClientCharacter.Get();
+	const AClimbingBenchmarkCourse* Course = ClientCourse.Get();
+	if (!Character || !Course || !ServerWorld.IsValid()) {
+		return Fail(TEXT("Client character, course or server world was destroyed during the test"));
+	}
+	if (Step != EStep::Settle && Step != EStep::Verify && StepTime > StepTimeout) {
+		return Fail(FString::Printf(TEXT("Timed out in step %d (mode %d, location %s)"), int32(Step), int32(Character->GetCharacterMovementMode()), *Character->GetActorLocation().ToString()));
+	}
+
+	UClimbingMovementComponent* ClimbingMovement = Character->GetClimbingMovement();
+	const EClimbTransition Transition = ClimbingMovement->GetClimbTransition();
+	bLeapSeen |= Transition == EClimbTransition::Leap;
+	bMantleSeen |= Transition == EClimbTransition::MantleRise || Transition == EClimbTransition::MantleOver;
+
+	// 攀爬的过程中采样服务器的发送带宽，NetDriver每秒才更新一次，按帧平均就是按时间平均
+	if (Step == EStep::Climb || Step == EStep::Mantle) {
+		OutBytesPerClimberSum += UClimbingMovementComponent::GatherNetStats(ServerWorld.Get(), false).GetOutBytesPerClimber();
+		++NumBandwidthSamples;
+	}
+
+	switch (Step) {
+	case EStep::Settle:
+		if (StepTime >= SettleTime && !Character->GetCharacterMovement()->IsFalling()) {
+			ClimbingMovement->ResetNumClientCorrections();
+			SetStep(EStep::Approach);
+		}
+		break;
+	case EStep::Approach: {
+		Character->AddScriptedMoveInput(FVector2D(0.f, 1.f));
+		const float DistanceToWall = Course->GetRunUpLength() - FVector::DotProduct(Character->GetActorLocation() - Course->GetLaneStart(0), Course->GetLaneForward());
+		if (DistanceToWall <= JumpDistance) {
+			Character->ScriptedJump();
+			bJumpHeld = true;
+		}
+		if (Character->IsClimbing()) {
+			SetStep(EStep::Climb);
+		}
+		break;
+	}
+	case EStep::Climb:
+		if (bJumpHeld) {
+			Character->ScriptedStopJump();
+			bJumpHeld = false;
+		}
+		Character->AddScriptedMoveInput(FVector2D(0.f, 1.f));
+		if (!bLeapRequested && StepTime >= LeapAfterClimbTime && !ClimbingMovement->IsInClimbTransition()) {
+			Character->ScriptedJump();
+			Character->ScriptedStopJump();
+			bLeapRequested = true;
+		}
+		if (bLeapRequested && !Character->IsClimbing()) {
+			SetStep(EStep::Mantle);
+		}
+		break;
+	case EStep::Mantle:
+		// 一直往上爬，到顶时自动触发Mantle，等它结束站到墙顶上
+		if (!Character->IsClimbing() && !ClimbingMovement->IsInClimbTransition() && !Character->GetCharacterMovement()->IsFalling()) {
+			if (Character->GetActorLocation().Z < Course->GetWallTopZ()) {
+				return Fail(FString::Printf(TEXT("Climber left the wall without mantling (z %.1f, wall top %.1f)"), Character->GetActorLocation().Z, Course->GetWallTopZ()));
+			}
+			SetStep(EStep::Verify);
+		}
+		break;
+	case EStep::Verify: {
+		if (StepTime < SettleTime) {
+			break;
+		}
+		const uint32 NumCorrections = ClimbingMovement->GetNumClientCorrections();
+		const double OutBytesPerClimber = OutBytesPerClimberSum / FMath::Max(NumBandwidthSamples, 1);
+		UE_LOG(LogClimbing, Display, TEXT("Climbing network test [%s, %dms rtt, %d%% loss, %dms jitter]: %u client corrections in %.1fs, server out %.0f B/s per climber (leap %s, mantle %s)"),
+			Profile.Name, Profile.RoundTripLag, Profile.PktLoss, Profile.PktJitter, NumCorrections, Now - CommandStartTime, OutBytesPerClimber,
+			bLeapSeen ? TEXT("yes") : TEXT("no"), bMantleSeen ? TEXT("yes") : TEXT("no"));
+		Test->TestTrue(TEXT("Client predicted a leap"), bLeapSeen);
+		Test->TestTrue(TEXT("Client predicted a mantle"), bMantleSeen);
+		Test->TestTrue(FString::Printf(TEXT("[%s] Client corrections (%u) within %u"), Profile.Name, NumCorrections, Profile.MaxClientCorrections), NumCorrections <= Profile.MaxClientCorrections);
+		Test->TestTrue(FString::Printf(TEXT("[%s] Server out bandwidth (%.0f B/s per climber) within %.0f"), Profile.Name, OutBytesPerClimber, MaxOutBytesPerClimber), OutBytesPerClimber <= MaxOutBytesPerClimber);
+		SetStep(EStep::Done);
+		GEditor->RequestEndPlayMap();
+		break;
+	}
+	default:
+		break;
+	}
+
+	return false;
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FClimbingNetworkRoundTripTest, "ClimbingSystem.Network.ClimbLeapMantle",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+void FClimbingNetworkRoundTripTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const {
+	for (const ClimbingNetworkTest::FNetProfile& Profile : ClimbingNetworkTest::NetProfiles) {
+		OutBeautifiedNames.Add(Profile.Name);
+		OutTestCommands.Add(Profile.Name);
+	}
+}
+
+bool FClimbingNetworkRoundTripTest::RunTest(const FString& Parameters) {
+	const ClimbingNetworkTest::FNetProfile* Profile = nullptr;
+	for (const ClimbingNetworkTest::FNetProfile& Candidate : ClimbingNetworkTest::NetProfiles) {
+		if (Parameters == Candidate.Name) {
+			Profile = &Candidate;
+		}
+	}
+	if (!Profile) {
+		AddError(FString::Printf(TEXT("Unknown network profile '%s'"), *Parameters));
+		return false;
+	}
+
+	if (!FAutomationEditorCommonUtils::LoadMap(ClimbingNetworkTest::MapName)) {
+		AddError(FString::Printf(TEXT("Failed to load %s"), ClimbingNetworkTest::MapName));
+		return false;
+	}
+
+	// 单进程的监听服务器 + 1个客户端
+	ULevelEditorPlaySettings* PlaySettings = NewObject<ULevelEditorPlaySettings>();
+	PlaySettings->SetPlayNetMode(EPlayNetMode::PIE_ListenServer);
+	PlaySettings->SetPlayNumberOfClients(2);
+	PlaySettings->bLaunchSeparateServer = false;
+	PlaySettings->SetRunUnderOneProcess(true);
+
+	FRequestPlaySessionParams Params;
+	Params.WorldType = EPlaySessionWorldType::PlayInEditor;
+	Params.EditorPlaySettings = PlaySettings;
+	GEditor->RequestPlaySession(Params);
+
+	ADD_LATENT_AUTOMATION_COMMAND(FClimbingNetworkRoundTripCommand(this, *Profile));
+	return true;
+}
+
+#endif
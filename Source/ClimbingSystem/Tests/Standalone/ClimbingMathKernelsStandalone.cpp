@@ -0,0 +1,195 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// 不依赖引擎的ClimbingMathKernels.h测试和benchmark，编译方法见同目录的CMakeLists.txt
+// 不带参数时检查批量版本和标量版本一致(和ClimbingSystem.Math.BatchMatchesScalar共用ClimbingMathKernelsTestFixture.h里的用例)，--bench时再测一下两者的耗时
+
+#if defined(CLIMBING_MATH_STANDALONE) && CLIMBING_MATH_STANDALONE
+
+#include "ClimbingMathKernelsTestFixture.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+
+namespace {
+	using namespace ClimbingMathKernelsTest;
+
+	int NumErrors = 0;
+
+	void AddError(const char* Format, ...) __attribute__((format(printf, 1, 2)));
+	void AddError(const char* Format, ...) {
+		va_list Args;
+		va_start(Args, Format);
+		std::fputs("error: ", stderr);
+		std::vfprintf(stderr, Format, Args);
+		std::fputc('\n', stderr);
+		va_end(Args);
+		++NumErrors;
+	}
+
+	void TestBatchMatchesScalar() {
+		CheckBatchMatchesScalar([](const char* Message) {
+			AddError("%s", Message);
+		});
+	}
+
+	// 八面体编码来回一次，误差应该在1.5°以内
+	void TestOctahedralRoundTrip() {
+		const double MinDot = std::cos(1.5 * 3.14159265358979323846 / 180.0);
+		const FInputs In(4096, false);
+		for (int32_t Index = 0; Index < 4096; ++Index) {
+			uint8_t U, V;
+			ClimbingMath::EncodeOctahedral8(In.Nx[Index], In.Ny[Index], In.Nz[Index], U, V);
+			double X, Y, Z;
+			ClimbingMath::DecodeOctahedral8(U, V, X, Y, Z);
+			const double Dot = X * In.Nx[Index] + Y * In.Ny[Index] + Z * In.Nz[Index];
+			if (Dot < MinDot) {
+				AddError("Octahedral8 round trip of (%g, %g, %g) is off by %g degrees", double(In.Nx[Index]), double(In.Ny[Index]), double(In.Nz[Index]),
+					std::acos(std::min(Dot, 1.0)) * 180.0 / 3.14159265358979323846);
+				return;
+			}
+		}
+	}
+
+	// 正好在一个平面上的点拟合出原来的平面，共线的点拟合失败
+	void TestFitPlaneLocal() {
+		const double U[] = { -20.0, 0.0, 20.0, -20.0, 0.0, 20.0, -20.0, 0.0, 20.0 };
+		const double V[] = { -20.0, -20.0, -20.0, 0.0, 0.0, 0.0, 20.0, 20.0, 20.0 };
+		double W[9];
+		for (int32_t Index = 0; Index < 9; ++Index) {
+			W[Index] = 0.25 * U[Index] - 0.5 * V[Index] + 3.0;
+		}
+		double A = 0.0, B = 0.0, C = 0.0;
+		if (!ClimbingMath::FitPlaneLocal(U, V, W, 9, A, B, C) || std::fabs(A - 0.25) > 1e-9 || std::fabs(B + 0.5) > 1e-9 || std::fabs(C - 3.0) > 1e-9) {
+			AddError("FitPlaneLocal on a 3x3 grid: %g, %g, %g, expected 0.25, -0.5, 3", A, B, C);
+		}
+		if (ClimbingMath::FitPlaneLocal(U, U, W, 9, A, B, C)) {
+			AddError("FitPlaneLocal accepted collinear points");
+		}
+		if (ClimbingMath::FitPlaneLocal(U, V, W, 2, A, B, C)) {
+			AddError("FitPlaneLocal accepted 2 points");
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Benchmark
+
+	volatile float Sink;
+
+	/** 多跑几轮取最快的一次，返回每个元素的纳秒数 */
+	template<typename FunctionType>
+	double TimePerElement(int32_t Count, int32_t Iterations, FunctionType&& Function) {
+		double Best = std::numeric_limits<double>::max();
+		for (int32_t Round = 0; Round < 5; ++Round) {
+			const auto Start = std::chrono::steady_clock::now();
+			for (int32_t Iteration = 0; Iteration < Iterations; ++Iteration) {
+				Function();
+			}
+			const std::chrono::duration<double, std::nano> Elapsed = std::chrono::steady_clock::now() - Start;
+			Best = std::min(Best, Elapsed.count() / (double(Count) * Iterations));
+		}
+		return Best;
+	}
+
+	void Report(const char* Name, double ScalarNs, double BatchNs) {
+		std::printf("%-18s scalar %7.3f ns  batch %7.3f ns  x%.2f\n", Name, ScalarNs, BatchNs, ScalarNs / BatchNs);
+	}
+
+	// 标量版本是按角色逐个调用的写法，批量版本是UClimbingCrowdSubsystem的写法
+	void RunBenchmark(bool bQuick) {
+		constexpr int32_t Count = 4096;
+		const int32_t Iterations = bQuick ? 20 : 2000;
+		FInputs In(Count, false);
+		std::vector<float> Rx = MakeOutput(Count), Ry = MakeOutput(Count), Rz = MakeOutput(Count);
+		std::vector<float> Ux = MakeOutput(Count), Uy = MakeOutput(Count), Uz = MakeOutput(Count);
+		std::vector<uint8_t> ShouldExit(size_t(Count + Padding));
+		std::vector<float> Cx = In.Px, Cy = In.Py, Cz = In.Pz;
+
+		std::printf("CLIMBING_MATH_SSE=%d, %d elements x %d iterations, best of 5 rounds, time per element\n", CLIMBING_MATH_SSE, Count, Iterations);
+
+		const double TangentScalar = TimePerElement(Count, Iterations, [&]() {
+			for (int32_t Index = 0; Index < Count; ++Index) {
+				double X, Y, Z;
+				ClimbingMath::RightTangent(In.Nx[Index], In.Ny[Index], In.Nz[Index], X, Y, Z);
+				Rx[Index] = float(X); Ry[Index] = float(Y); Rz[Index] = float(Z);
+				ClimbingMath::UpTangent(In.Nx[Index], In.Ny[Index], In.Nz[Index], X, Y, Z);
+				Ux[Index] = float(X); Uy[Index] = float(Y); Uz[Index] = float(Z);
+			}
+			Sink = Uz[Count - 1];
+		});
+		const double TangentBatch = TimePerElement(Count, Iterations, [&]() {
+			ClimbingMath::TangentBasisBatch(In.Nx.data(), In.Ny.data(), In.Nz.data(),
+				Rx.data(), Ry.data(), Rz.data(), Ux.data(), Uy.data(), Uz.data(), Count);
+			Sink = Uz[Count - 1];
+		});
+		Report("TangentBasis", TangentScalar, TangentBatch);
+
+		const double ExitScalar = TimePerElement(Count, Iterations, [&]() {
+			for (int32_t Index = 0; Index < Count; ++Index) {
+				ShouldExit[Index] = ClimbingMath::ShouldExitByTilt(In.ActorUpZ[Index]) ? 1 : 0;
+			}
+			Sink = ShouldExit[Count - 1];
+		});
+		const double ExitBatch = TimePerElement(Count, Iterations, [&]() {
+			ClimbingMath::ExitTiltBatch(In.ActorUpZ.data(), ClimbingMath::ExitTiltCos, ShouldExit.data(), Count);
+			Sink = ShouldExit[Count - 1];
+		});
+		Report("ExitTilt", ExitScalar, ExitBatch);
+
+		const double SnapScalar = TimePerElement(Count, Iterations, [&]() {
+			for (int32_t Index = 0; Index < Count; ++Index) {
+				Rx[Index] = float(double(In.Px[Index]) + double(In.Nx[Index]) * In.Distance[Index]);
+				Ry[Index] = float(double(In.Py[Index]) + double(In.Ny[Index]) * In.Distance[Index]);
+				Rz[Index] = float(double(In.Pz[Index]) + double(In.Nz[Index]) * In.Distance[Index]);
+			}
+			Sink = Rz[Count - 1];
+		});
+		const double SnapBatch = TimePerElement(Count, Iterations, [&]() {
+			ClimbingMath::SnapTargetBatch(In.Px.data(), In.Py.data(), In.Pz.data(), In.Nx.data(), In.Ny.data(), In.Nz.data(),
+				In.Distance.data(), Rx.data(), Ry.data(), Rz.data(), Count);
+			Sink = Rz[Count - 1];
+		});
+		Report("SnapTarget", SnapScalar, SnapBatch);
+
+		// 插值是就地更新的，两边都从同一个起点开始反复逼近目标
+		const double Alpha = ClimbingMath::InterpAlpha(1.0 / 60.0, 10.0);
+		const double InterpScalar = TimePerElement(Count, Iterations, [&]() {
+			for (int32_t Index = 0; Index < Count; ++Index) {
+				Cx[Index] = float(Cx[Index] + (double(Rx[Index]) - Cx[Index]) * Alpha);
+				Cy[Index] = float(Cy[Index] + (double(Ry[Index]) - Cy[Index]) * Alpha);
+				Cz[Index] = float(Cz[Index] + (double(Rz[Index]) - Cz[Index]) * Alpha);
+			}
+			Sink = Cz[Count - 1];
+		});
+		Cx = In.Px; Cy = In.Py; Cz = In.Pz;
+		const double InterpBatch = TimePerElement(Count, Iterations, [&]() {
+			ClimbingMath::InterpToBatch(Cx.data(), Cy.data(), Cz.data(), Rx.data(), Ry.data(), Rz.data(), float(Alpha), Count);
+			Sink = Cz[Count - 1];
+		});
+		Report("InterpTo", InterpScalar, InterpBatch);
+	}
+}
+
+int main(int Argc, char** Argv) {
+	bool bBenchmark = false;
+	bool bQuick = false;
+	for (int Index = 1; Index < Argc; ++Index) {
+		bBenchmark |= std::strcmp(Argv[Index], "--bench") == 0;
+		bQuick |= std::strcmp(Argv[Index], "--quick") == 0;
+	}
+
+	TestBatchMatchesScalar();
+	TestOctahedralRoundTrip();
+	TestFitPlaneLocal();
+	if (NumErrors > 0) {
+		std::fprintf(stderr, "%d errors\n", NumErrors);
+		return 1;
+	}
+	std::printf("ClimbingMathKernels: batch matches scalar (CLIMBING_MATH_SSE=%d)\n", CLIMBING_MATH_SSE);
+
+	if (bBenchmark) {
+		RunBenchmark(bQuick);
+	}
+	return 0;
+}
+
+#endif // CLIMBING_MATH_STANDALONE